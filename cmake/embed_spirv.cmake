@@ -0,0 +1,37 @@
+# Turns compiled SPIR-V into a C file with one uint32_t array per shader and a table to look them up by name
+# Run in script mode: cmake -DOUTPUT=<file.c> -DHEADER=<shaders.h> -DSHADERS="<name>=<file.spv>;..." -P embed_spirv.cmake
+
+set(SOURCE "// Generated by cmake/embed_spirv.cmake, don't edit\n#include \"${HEADER}\"\n\n#include <stdint.h>\n\n")
+set(TABLE "")
+set(INDEX 0)
+
+foreach(SHADER ${SHADERS})
+    string(REPLACE "=" ";" SHADER ${SHADER})
+    list(GET SHADER 0 NAME)
+    list(GET SHADER 1 SPIRV)
+
+    file(READ ${SPIRV} BYTES HEX)
+    string(LENGTH "${BYTES}" HEX_LENGTH)
+    math(EXPR SIZE "${HEX_LENGTH} / 2")
+    math(EXPR REMAINDER "${SIZE} % 4")
+    if(NOT REMAINDER EQUAL 0 OR SIZE EQUAL 0)
+        message(FATAL_ERROR "${SPIRV} isn't valid SPIR-V, its size has to be a non-zero multiple of 4")
+    endif()
+
+    # SPIR-V is a stream of little endian words, so flip each group of 4 bytes into a word literal
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " WORDS "${BYTES}")
+    # Keeps the lines a sensible length
+    string(REGEX REPLACE "((0x........u, ){8})" "\\1\n    " WORDS "${WORDS}")
+
+    string(APPEND SOURCE "static const uint32_t SHADER_${INDEX}[] = {\n    ${WORDS}\n};\n\n")
+    string(APPEND TABLE "    { \"${NAME}\", SHADER_${INDEX}, sizeof(SHADER_${INDEX}) },\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+string(APPEND SOURCE "const EmbeddedShader EMBEDDED_SHADERS[] = {\n${TABLE}};\n")
+string(APPEND SOURCE "const uint32_t EMBEDDED_SHADER_COUNT = sizeof(EMBEDDED_SHADERS) / sizeof(EMBEDDED_SHADERS[0]);\n")
+
+# Only touch the file when something changed, so unrelated shader rebuilds don't force a recompile
+file(WRITE ${OUTPUT}.tmp "${SOURCE}")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
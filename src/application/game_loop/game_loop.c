@@ -1,93 +1,638 @@
 #include "./game_loop.h"
 #include "../../engine/globals/globals.h"
+#include "../../engine/frame/frame.h"
+#include "../../engine/sprite_batch/sprite_batch.h"
+#include "../../engine/tilemap/tilemap.h"
+#include "../../engine/profiler/profiler.h"
+#include "../../engine/ecs/ecs.h"
+#include "../../engine/timestep/timestep.h"
+#include "../../engine/thread_pool/thread_pool.h"
+#include "../../engine/spatial_hash/spatial_hash.h"
+#include "../../engine/collision_mask/collision_mask.h"
+#include "../../engine/particles/particles.h"
+#include "../../engine/falling_sand/falling_sand.h"
+#include "../../engine/software_renderer/software_renderer.h"
+#include "../../engine/bindless_textures/bindless_textures.h"
 
 #include <vulkan/vulkan.h>
 #include <SDL2/SDL.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
 
 
 InitializingInfo *initInfo;
 
 bool loopRunning = true;
+uint32_t demoSpriteCount = 0;
+uint32_t demoTilemapSize = 0;
+uint32_t demoEntityCount = 0;
+uint32_t tickRate = DEFAULT_TICK_RATE;
+bool demoCollisions = false;
+float demoCellSize = DEFAULT_SPATIAL_CELL_SIZE;
+uint32_t demoParticleCount = 0;
+bool demoSand = false;
+
+// Canvas pixels per second
+typedef struct {
+    float x, y;
+} VelocityComponent;
+
+ComponentId velocityComponent;
+
+
+// The demo sprites are reserved and filled in this many at a time, one piece per job
+#define DEMO_SPRITES_PER_BATCH 256
+#define DEMO_SPRITE_SIZE 8.0f
+
+typedef struct {
+    SpriteInstance **batches;
+    uint32_t columns;
+    uint64_t frameNumber;
+} DemoSpriteFill;
+
+// Runs on the thread pool, each batch was already reserved so every job writes to its own piece of the instance buffer
+void fillDemoSprites(uint32_t firstBatch, uint32_t batchCount, void *data) {
+    const DemoSpriteFill *fill = data;
+
+    for (uint32_t batch = firstBatch; batch < firstBatch + batchCount; batch++) {
+        uint32_t first = batch * DEMO_SPRITES_PER_BATCH;
+        uint32_t count = demoSpriteCount - first < DEMO_SPRITES_PER_BATCH ? demoSpriteCount - first : DEMO_SPRITES_PER_BATCH;
+        SpriteInstance *sprites = fill->batches[batch];
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index = first + i;
+            uint64_t phase = fill->frameNumber + index;
+            // A triangle wave is plenty to see that the sprites are being rewritten every frame
+            float wobble = (float)(phase % 16 < 8 ? phase % 8 : 8 - phase % 8) - 4.0f;
+
+            sprites[i] = (SpriteInstance){
+                .x = (index % fill->columns) * DEMO_SPRITE_SIZE + wobble,
+                .y = (float)((index / fill->columns) * DEMO_SPRITE_SIZE),
+                .width = DEMO_SPRITE_SIZE,
+                .height = DEMO_SPRITE_SIZE,
+                .u0 = 0.0f, .v0 = 0.0f, .u1 = 1.0f, .v1 = 1.0f,
+                .tint = 0x80000000 | (index * 2654435761u & 0x00FFFFFF), // Half transparent with a scrambled color per sprite
+                .layer = 0.0f,
+                .textureId = WHITE_TEXTURE_ID
+            };
+        }
+    }
+}
 
+// Fills the canvas with a grid of drifting sprites so the batcher has something to chew on
+void addDemoSprites(uint64_t frameNumber) {
+    if (demoSpriteCount == 0) { return; }
+
+    uint32_t columns = initInfo->canvasExtent.width / DEMO_SPRITE_SIZE;
+    if (columns == 0) { columns = 1; }
+
+    // Reserving has to happen in order on this thread so the sprites stay in order, but writing them can be spread out
+    // Writing straight into the mapped instance buffer saves copying each sprite through addSprite()
+    uint32_t batchCount = (demoSpriteCount + DEMO_SPRITES_PER_BATCH - 1) / DEMO_SPRITES_PER_BATCH;
+    SpriteInstance *batches[batchCount];
+    for (uint32_t batch = 0; batch < batchCount; batch++) {
+        uint32_t first = batch * DEMO_SPRITES_PER_BATCH;
+        uint32_t count = demoSpriteCount - first < DEMO_SPRITES_PER_BATCH ? demoSpriteCount - first : DEMO_SPRITES_PER_BATCH;
+
+        batches[batch] = reserveSprites(initInfo, count);
+        if (batches[batch] == NULL) {
+            batchCount = batch;
+            break;
+        }
+    }
 
-int drawFrame() {
-    // Using UINT64_MAX disables the timeout
-    vkWaitForFences(initInfo->device, 1, &initInfo->inFlightFences[initInfo->currentFrame], VK_TRUE, UINT64_MAX);
+    DemoSpriteFill fill = { .batches = batches, .columns = columns, .frameNumber = frameNumber };
+    parallelFor(initInfo, batchCount, 0, fillDemoSprites, &fill);
+}
 
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(initInfo->device, initInfo->swapChain, UINT64_MAX, initInfo->imageAvailableSemaphores[initInfo->currentFrame], VK_NULL_HANDLE, &imageIndex);
 
-    if (initInfo->imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(initInfo->device, 1, &initInfo->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+int createDemoTilemap() {
+    TilemapInfo info = {
+        .width = demoTilemapSize,
+        .height = demoTilemapSize,
+        .tileSize = 8,
+        .tilesetColumns = 4,
+        .tilesetRows = 4,
+        .layer = 0.0f
+    };
+
+    TileId *tiles = malloc((size_t)demoTilemapSize * demoTilemapSize * sizeof(TileId));
+    for (uint32_t y = 0; y < demoTilemapSize; y++) {
+        for (uint32_t x = 0; x < demoTilemapSize; x++) {
+            bool island = ((x / 24) + (y / 24)) % 2 == 0;
+            tiles[y * demoTilemapSize + x] = island ? 1 + (x * 7 + y * 13) % 16 : 0;
+        }
     }
-    initInfo->imagesInFlight[imageIndex] = initInfo->inFlightFences[initInfo->currentFrame];
 
-    VkSemaphore waitSemaphores[] = { initInfo->imageAvailableSemaphores[initInfo->currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSemaphore signalSemaphores[] = { initInfo->renderFinishedSemaphores[initInfo->currentFrame] };
-    
-    VkCommandBuffer test[1] = { initInfo->commandBuffers[imageIndex] };
+    int result = createTilemap(initInfo, &info, tiles);
+    free(tiles);
+
+    return result;
+}
 
-    VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+void updateDemoTilemap(uint64_t frameNumber) {
+    // Pans diagonally back and forth across the whole map
+    uint32_t mapPixels = demoTilemapSize * 8;
+    uint32_t range = mapPixels > initInfo->canvasExtent.width ? mapPixels - initInfo->canvasExtent.width : 1;
+    uint32_t position = frameNumber % (2 * range);
+    int32_t camera = position < range ? position : 2 * range - position;
+    setTilemapCamera(initInfo, camera, camera / 2);
+
+    uint32_t x = (camera / 8 + frameNumber % 16) % demoTilemapSize;
+    uint32_t y = (camera / 16 + frameNumber % 9) % demoTilemapSize;
+    setTile(initInfo, x, y, getTile(initInfo, x, y) == 0 ? 1 + frameNumber % 16 : 0);
+}
 
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = waitSemaphores,
-        .pWaitDstStageMask = waitStages,
 
-        .commandBufferCount = 1,
-        .pCommandBuffers = &test,
+// The spouts pour for this many seconds and then stop, after that the world settles and the chunks go to sleep one by one
+#define DEMO_SAND_POUR_SECONDS 10
 
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = signalSemaphores
+// A canvas sized world with a couple of ledges and a basin for the sand and water to land in
+int createDemoSand() {
+    SandWorldInfo info = {
+        .width = initInfo->canvasExtent.width,
+        .height = initInfo->canvasExtent.height
     };
+    if (createSandWorld(initInfo, &info) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    int32_t width = info.width;
+    int32_t height = info.height;
+    // Stairs going down towards the middle from both sides, so the piles slide off them
+    for (int32_t step = 0; step < 8; step++) {
+        fillSandRect(initInfo, width / 8 + step * 6, height / 3 + step * 3, 6, 3, SAND_STONE);
+        fillSandRect(initInfo, width * 7 / 8 - (step + 1) * 6, height / 3 + step * 3, 6, 3, SAND_STONE);
+    }
+    // The basin, with a gap in one wall for the water to find its way out of
+    fillSandRect(initInfo, width / 4, height - 8, width / 2, 8, SAND_STONE);
+    fillSandRect(initInfo, width / 4, height * 2 / 3, 4, height / 3 - 8, SAND_STONE);
+    fillSandRect(initInfo, width * 3 / 4 - 4, height * 2 / 3, 4, height / 3 - 20, SAND_STONE);
 
-    vkResetFences(initInfo->device, 1, &initInfo->inFlightFences[initInfo->currentFrame]);
+    return EXIT_SUCCESS;
+}
 
-    if (vkQueueSubmit(initInfo->graphicsQueue, 1, &submitInfo, initInfo->inFlightFences[initInfo->currentFrame]) != VK_SUCCESS) { return EXIT_FAILURE; }
+void updateDemoSand(uint64_t tickNumber) {
+    if (tickNumber < (uint64_t)tickRate * DEMO_SAND_POUR_SECONDS) {
+        // Wobbling back and forth a little so the spouts don't build one thin tower each
+        int32_t wobble = (int32_t)(tickNumber % 16 < 8 ? tickNumber % 8 : 8 - tickNumber % 8) - 4;
+        int32_t width = initInfo->canvasExtent.width;
+        fillSandRect(initInfo, width / 4 + wobble, 0, 4, 2, SAND_SAND);
+        fillSandRect(initInfo, width * 3 / 4 - wobble, 0, 4, 2, SAND_WATER);
+    }
 
-    VkSwapchainKHR swapChains[] = { initInfo->swapChain };
-    VkPresentInfoKHR presentInfo = {
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+    stepSandWorld(initInfo);
+}
 
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = signalSemaphores,
 
-        .swapchainCount = 1,
-        .pSwapchains = swapChains,
+// Cheap and stateless, so jobs on any thread can use it
+float demoRandom(uint32_t seed) {
+    seed ^= seed >> 16;
+    seed *= 0x7FEB352Du;
+    seed ^= seed >> 15;
+    seed *= 0x846CA68Bu;
+    seed ^= seed >> 16;
 
-        .pImageIndices = &imageIndex,
+    return (float)(seed >> 8) / (float)(1 << 24);
+}
 
-        .pResults = NULL
+SpriteComponent demoEntitySprite(uint32_t seed) {
+    return (SpriteComponent){
+        .width = 2.0f,
+        .height = 2.0f,
+        .u0 = 0.0f, .v0 = 0.0f, .u1 = 1.0f, .v1 = 1.0f,
+        .tint = 0xFF000000 | (seed * 2654435761u & 0x00FFFFFF),
+        .layer = 0.0f,
+        .textureId = WHITE_TEXTURE_ID // Nothing but the tint
     };
+}
 
-    vkQueuePresentKHR(initInfo->presentQueue, &presentInfo);
+VelocityComponent demoEntityVelocity(uint32_t seed) {
+    return (VelocityComponent){ .x = (demoRandom(seed * 3 + 1) - 0.5f) * 120.0f, .y = (demoRandom(seed * 3 + 2) - 0.75f) * 120.0f };
+}
 
-    vkQueueWaitIdle(initInfo->presentQueue);
+// A fountain of particles that bounce off the sides and fall out the bottom, where they're replaced by new ones at the top
+int spawnDemoEntities() {
+    velocityComponent = registerComponent(initInfo, sizeof(VelocityComponent), "velocity");
+    if (velocityComponent == UINT32_MAX) { return EXIT_FAILURE; }
 
-    // By using the modulo operator we ensure that the frame index loops around after every MAX_FRAMES_IN_FLIGHT enqueued frames
-    initInfo->currentFrame = (initInfo->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    ComponentMask components = COMPONENT_BIT(POSITION_COMPONENT) | COMPONENT_BIT(PREVIOUS_POSITION_COMPONENT) | COMPONENT_BIT(SPRITE_COMPONENT) | COMPONENT_BIT(velocityComponent);
+    if (createEntities(initInfo, components, demoEntityCount, NULL) != demoEntityCount) { return EXIT_FAILURE; }
+
+    // Filling them in through a query is much faster than looking each one up with getComponent()
+    EcsQuery query = {
+        .components = { POSITION_COMPONENT, PREVIOUS_POSITION_COMPONENT, SPRITE_COMPONENT, velocityComponent },
+        .componentsCount = 4
+    };
+    EcsChunkView view = beginQuery(initInfo, &query);
+    while (nextQueryChunk(&view)) {
+        PositionComponent *positions = view.columns[0];
+        PreviousPositionComponent *previousPositions = view.columns[1];
+        SpriteComponent *sprites = view.columns[2];
+        VelocityComponent *velocities = view.columns[3];
+
+        for (uint32_t i = 0; i < view.count; i++) {
+            uint32_t seed = view.entities[i].index;
+
+            positions[i] = (PositionComponent){ .x = demoRandom(seed) * initInfo->canvasExtent.width, .y = demoRandom(seed * 7) * initInfo->canvasExtent.height };
+            previousPositions[i] = positions[i];
+            sprites[i] = demoEntitySprite(seed);
+            velocities[i] = demoEntityVelocity(seed);
+        }
+    }
 
     return EXIT_SUCCESS;
 }
 
+typedef struct {
+    float deltaTime;
+    uint32_t tickNumber;
+} DemoEntityUpdate;
+
+// Runs on the thread pool, one chunk at a time
+void moveDemoEntities(EcsChunkView *view, void *userData) {
+    const DemoEntityUpdate *update = userData;
+    PositionComponent *positions = view->columns[0];
+    VelocityComponent *velocities = view->columns[1];
+
+    float width = view->initInfo->canvasExtent.width;
+    float height = view->initInfo->canvasExtent.height;
+    float gravity = 60.0f * update->deltaTime;
+
+    // Plain loops over packed arrays of floats, which the compiler is happy to vectorize
+    for (uint32_t i = 0; i < view->count; i++) {
+        velocities[i].y += gravity;
+        positions[i].x += velocities[i].x * update->deltaTime;
+        positions[i].y += velocities[i].y * update->deltaTime;
+    }
+    for (uint32_t i = 0; i < view->count; i++) {
+        if ((positions[i].x < 0.0f && velocities[i].x < 0.0f) || (positions[i].x > width && velocities[i].x > 0.0f)) { velocities[i].x = -velocities[i].x; }
+    }
+
+    // We're in the middle of iterating, so swapping out the ones that fell off goes through the command buffer and happens at syncWorld()
+    EcsCommands *commands = NULL;
+    for (uint32_t i = 0; i < view->count; i++) {
+        if (positions[i].y <= height) { continue; }
+        if (commands == NULL) { commands = getEcsCommands(view->initInfo); }
+
+        uint32_t seed = view->entities[i].index ^ (update->tickNumber * 0x9E3779B9u);
+        deferDestroyEntity(commands, view->entities[i]);
+
+        PositionComponent position = { .x = demoRandom(seed) * width, .y = 0.0f };
+        SpriteComponent sprite = demoEntitySprite(seed);
+        VelocityComponent velocity = demoEntityVelocity(seed);
+
+        Entity entity = deferCreateEntity(commands);
+        deferAddComponent(commands, entity, POSITION_COMPONENT, &position);
+        // Starting out with both the same, otherwise the first frame would draw it sliding in from wherever the previous value came from
+        deferAddComponent(commands, entity, PREVIOUS_POSITION_COMPONENT, &position);
+        deferAddComponent(commands, entity, SPRITE_COMPONENT, &sprite);
+        deferAddComponent(commands, entity, velocityComponent, &velocity);
+    }
+}
+
+void updateDemoEntities(uint64_t tickNumber, double deltaTime) {
+    EcsQuery query = {
+        .components = { POSITION_COMPONENT, velocityComponent },
+        .componentsCount = 2
+    };
+    DemoEntityUpdate update = { .deltaTime = (float)deltaTime, .tickNumber = (uint32_t)tickNumber };
+
+    forEachChunkParallel(initInfo, &query, moveDemoEntities, &update);
+}
+
+// Every demo entity shares one mask, a disc the size of its sprite, since they're all drawn with the same texture
+// Masks for loaded textures come with the LoadedImage instead
+CollisionMask demoEntityMask;
+
+int createDemoEntityMask() {
+    SpriteComponent sprite = demoEntitySprite(0);
+    uint32_t width = (uint32_t)ceilf(sprite.width);
+    uint32_t height = (uint32_t)ceilf(sprite.height);
+
+    uint8_t pixels[width * height * 4];
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float dx = (x + 0.5f) / width - 0.5f;
+            float dy = (y + 0.5f) / height - 0.5f;
+            uint8_t *pixel = &pixels[(y * width + x) * 4];
+
+            pixel[0] = pixel[1] = pixel[2] = 0xFF;
+            pixel[3] = dx * dx + dy * dy <= 0.25f ? 0xFF : 0x00;
+        }
+    }
+
+    return createCollisionMask(pixels, width, height, DEFAULT_COLLISION_ALPHA_THRESHOLD, &demoEntityMask);
+}
+
+// Each thread counts into its own cache line so they don't fight over one
+#define DEMO_CONTACT_STRIDE 8
+
+// Runs on the thread pool for every pair whose bounding boxes overlap, and checks whether their pixels actually do
+void touchDemoEntities(const SpatialEntry *a, const SpatialEntry *b, void *userData) {
+    uint64_t *contacts = userData;
+
+    if (masksOverlap(&demoEntityMask, (int32_t)floorf(a->minX), (int32_t)floorf(a->minY), &demoEntityMask, (int32_t)floorf(b->minX), (int32_t)floorf(b->minY))) {
+        contacts[getWorkerIndex(initInfo) * DEMO_CONTACT_STRIDE]++;
+    }
+}
+
+// Keeps the spatial hash up to date and runs the kind of queries a game would every tick
+// Returns how many pairs of entities are touching pixel for pixel
+uint64_t collideDemoEntities() {
+    rebuildSpatialHash(initInfo);
+
+    // The broadphase finds the pairs whose boxes overlap and the masks narrow those down, a real game would resolve the contacts here instead of just counting them
+    uint32_t threadCount = getThreadPoolSize(initInfo) + 1;
+    uint64_t contacts[threadCount * DEMO_CONTACT_STRIDE];
+    for (uint32_t i = 0; i < threadCount * DEMO_CONTACT_STRIDE; i++) { contacts[i] = 0; }
+
+    forEachSpatialPair(initInfo, touchDemoEntities, contacts);
+
+    uint64_t totalContacts = 0;
+    for (uint32_t i = 0; i < threadCount; i++) { totalContacts += contacts[i * DEMO_CONTACT_STRIDE]; }
+
+    // Plus a neighbour query and a line of sight check across the middle of the canvas
+    float centerX = initInfo->canvasExtent.width * 0.5f;
+    float centerY = initInfo->canvasExtent.height * 0.5f;
+    Entity neighbours[64];
+    querySpatialRadius(initInfo, centerX, centerY, 16.0f, neighbours, 64);
+
+    SpatialRayHit hit;
+    raycastSpatial(initInfo, 0.0f, centerY, 1.0f, 0.0f, initInfo->canvasExtent.width, &hit);
+
+    return totalContacts;
+}
+
+
+// A fountain at the bottom of the canvas, emitting fast enough to keep roughly demoParticleCount particles alive
+int createDemoParticles() {
+    ParticleSystemInfo particleInfo = {
+        .maxParticles = demoParticleCount,
+        .gravityY = 60.0f
+    };
+    if (createParticleSystem(initInfo, &particleInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    ParticleEmitter emitter = {
+        .x = initInfo->canvasExtent.width * 0.5f,
+        .y = initInfo->canvasExtent.height - 1.0f,
+        .direction = -1.5707963f,
+        .spread = 1.2f,
+        .minSpeed = 40.0f,
+        .maxSpeed = 120.0f,
+        .minLifetime = 2.0f,
+        .maxLifetime = 4.0f,
+        .rate = demoParticleCount / 3.0f, // The average lifetime
+        .color = 0xFF40A0FF
+    };
+    setParticleEmitter(initInfo, &emitter);
+
+    return EXIT_SUCCESS;
+}
+
+
+void handleEvent(const SDL_Event *event) {
+    if (event->type == SDL_QUIT) {
+        loopRunning = false;
+        return;
+    }
+
+    // We don't rely on vkAcquireNextImageKHR/vkQueuePresentKHR to tell us about resizes since not every driver reports them
+    if (event->type == SDL_WINDOWEVENT && event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) { initInfo->swapChainOutOfDate = true; }
+
+    // Any input could change what's on screen, and window events like being uncovered can mean the window needs repainting
+    requestRedraw(initInfo);
+}
+
 
 int gameLoop(InitializingInfo *tInitInfo) {
     initInfo = tInitInfo;
 
+    // Totals of the per frame timings, so we can report how well the CPU and GPU overlapped over the whole run
+    FrameTimings totals = {  };
+    uint64_t framesDrawn = 0;
+    uint64_t totalBytesUploaded = 0;
+    TilemapStats tilemapTotals = {  };
+
+    if (demoTilemapSize > 0 && createDemoTilemap() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (demoEntityCount > 0 && spawnDemoEntities() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    // The particles only exist on the GPU, so without one the rest of the demo carries on without them
+    if (demoParticleCount > 0 && initInfo->softwareRendering) { printf("Skipping the particles, there's no GPU to run them on\n"); }
+    else if (demoParticleCount > 0 && createDemoParticles() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (demoSand && createDemoSand() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (demoEntityCount > 0 && demoCollisions) {
+        SpatialHashInfo spatialHashInfo = {
+            .width = initInfo->canvasExtent.width,
+            .height = initInfo->canvasExtent.height,
+            .cellSize = demoCellSize
+        };
+        if (createSpatialHash(initInfo, &spatialHashInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        if (createDemoEntityMask() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    }
+    // Summed over every tick, so the end of the run can say how well the cell size worked out
+    SpatialHashStats spatialTotals = {  };
+    uint64_t totalContacts = 0;
+    // The step numbers per tick and the upload numbers per frame
+    SandStats sandTotals = {  };
+    SoftwareRendererStats softwareTotals = {  };
+
+    FixedTimestep timestep;
+    initFixedTimestep(&timestep, tickRate);
+    uint64_t ticksRun = 0;
+    uint64_t idleWaits = 0;
+    // Whatever else happens, the first frame has to be drawn
+    requestRedraw(initInfo);
+    // With nothing moving there's nothing that would ever ask for another frame, so renderOnDemand can actually go idle
+    bool animating = demoSpriteCount > 0 || demoTilemapSize > 0 || demoEntityCount > 0 || demoParticleCount > 0;
+    // Setting up the demo shouldn't count towards how busy the workers were while running
+    resetWorkerStats(initInfo);
 
     while (loopRunning) {
         // --- Events ---
-
+        SDL_Event event;
+        while (!initInfo->headless && SDL_PollEvent(&event)) { handleEvent(&event); }
+
+        // There's nothing to draw into while the window is minimized, so just sleep until something happens
+        if (!initInfo->headless && (SDL_GetWindowFlags(initInfo->window) & SDL_WINDOW_MINIMIZED)) {
+            SDL_WaitEvent(NULL);
+            continue;
+        }
+
+        // --- Idle ---
+        // Nothing has changed since the last frame was presented, so block until an event comes in or a redraw timer is due
+        // Headless runs always draw, there are no events to wake them and a benchmark that sleeps wouldn't measure much
+        if (!initInfo->headless && !isRedrawNeeded(initInfo)) {
+            int timeout = getRedrawTimeout(initInfo);
+            bool gotEvent = timeout < 0 ? SDL_WaitEvent(&event) : SDL_WaitEventTimeout(&event, timeout);
+            if (gotEvent) { handleEvent(&event); }
+
+            // Nothing was simulated while we slept, and it shouldn't all be caught up on when we wake
+            resyncFixedTimestep(&timestep);
+            idleWaits++;
+            continue;
+        }
+
+        beginCpuZone(initInfo, "frame");
+
+        // --- Simulate ---
+        // Headless runs are benchmarks, so they always step exactly one tick per frame and come out the same every time
+        if (initInfo->headless) { advanceFixedTimestepBy(&timestep, timestep.tickSeconds); }
+        else { advanceFixedTimestep(&timestep); }
+
+        // This happens before beginFrame() so it overlaps with the GPU still drawing the previous frames, instead of with the wait for a frame slot
+        while (nextTick(&timestep)) {
+            beginCpuZone(initInfo, "update");
+            if (demoEntityCount > 0) { savePreviousPositions(initInfo); }
+            if (initInfo->tilemap != NULL) { updateDemoTilemap(timestep.tickNumber); }
+            if (demoEntityCount > 0) { updateDemoEntities(timestep.tickNumber, timestep.tickSeconds); }
+            // Only adds up the time, the GPU catches up on all of it with the next frame
+            if (initInfo->particles != NULL) { simulateParticles(initInfo, (float)timestep.tickSeconds); }
+            endCpuZone(initInfo);
+
+            if (initInfo->sand != NULL) {
+                beginCpuZone(initInfo, "sand");
+                updateDemoSand(timestep.tickNumber);
+                endCpuZone(initInfo);
+
+                SandStats sandStats = getSandStats(initInfo);
+                sandTotals.chunkCount = sandStats.chunkCount;
+                sandTotals.chunksAwake += sandStats.chunksAwake;
+                sandTotals.cellsVisited += sandStats.cellsVisited;
+                sandTotals.cellsMoved += sandStats.cellsMoved;
+                sandTotals.stepMs += sandStats.stepMs;
+            }
+
+            // The sync point, every structural change the systems deferred gets applied here
+            beginCpuZone(initInfo, "sync world");
+            syncWorld(initInfo);
+            endCpuZone(initInfo);
+
+            if (initInfo->spatialHash != NULL) {
+                beginCpuZone(initInfo, "collide");
+                totalContacts += collideDemoEntities();
+                endCpuZone(initInfo);
+
+                SpatialHashStats spatialStats = getSpatialHashStats(initInfo);
+                spatialTotals.rebuildMs += spatialStats.rebuildMs;
+                spatialTotals.pairTests += spatialStats.pairTests;
+                spatialTotals.pairsFound += spatialStats.pairsFound;
+                spatialTotals.queryTests += spatialStats.queryTests;
+                spatialTotals.occupiedCells = spatialStats.occupiedCells;
+                spatialTotals.cellCount = spatialStats.cellCount;
+                if (spatialStats.maxEntitiesPerCell > spatialTotals.maxEntitiesPerCell) { spatialTotals.maxEntitiesPerCell = spatialStats.maxEntitiesPerCell; }
+            }
+            ticksRun++;
+        }
+        // How far we are between the last tick and the next one, the sprites get drawn that far along
+        initInfo->interpolationAlpha = getTimestepAlpha(&timestep);
+        // Moving things need a new frame every time around, even between ticks since they're drawn interpolated
+        if (animating) { requestRedraw(initInfo); }
 
         // -- Draw ---
-        drawFrame();
+        if (beginFrame(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        addDemoSprites(timestep.tickNumber);
+
+        if (endFrame(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        endCpuZone(initInfo);
+
+        // Only read once endFrame() is done, it's what adds the ECS's sprites
+        SpriteBatchStats spriteStats = getSpriteBatchStats(initInfo);
+        totalBytesUploaded += spriteStats.bytesUploaded;
+
+        if (initInfo->tilemap != NULL) {
+            TilemapStats tilemapStats = getTilemapStats(initInfo);
+            tilemapTotals.chunksDrawn += tilemapStats.chunksDrawn;
+            tilemapTotals.chunksCulled += tilemapStats.chunksCulled;
+            tilemapTotals.chunksUploaded += tilemapStats.chunksUploaded;
+            tilemapTotals.tilesDrawn += tilemapStats.tilesDrawn;
+        }
+        if (initInfo->softwareRenderer != NULL) {
+            SoftwareRendererStats softwareStats = getSoftwareRendererStats(initInfo);
+            softwareTotals.kernels = softwareStats.kernels;
+            softwareTotals.bands = softwareStats.bands;
+            softwareTotals.draws += softwareStats.draws;
+            softwareTotals.spritesDrawn += softwareStats.spritesDrawn;
+            softwareTotals.rasterMs += softwareStats.rasterMs;
+            softwareTotals.presentMs += softwareStats.presentMs;
+        }
+        if (initInfo->sand != NULL) {
+            SandStats sandStats = getSandStats(initInfo);
+            sandTotals.regionsUploaded += sandStats.regionsUploaded;
+            sandTotals.bytesUploaded += sandStats.bytesUploaded;
+        }
+
+        totals.cpuWaitMs += initInfo->lastFrameTimings.cpuWaitMs;
+        totals.acquireWaitMs += initInfo->lastFrameTimings.acquireWaitMs;
+        totals.cpuFrameMs += initInfo->lastFrameTimings.cpuFrameMs;
+        totals.gpuFramesQueued += initInfo->lastFrameTimings.gpuFramesQueued;
+        totals.recordMs += initInfo->lastFrameTimings.recordMs;
+        totals.recordSlices += initInfo->lastFrameTimings.recordSlices;
+        totals.recordDraws += initInfo->lastFrameTimings.recordDraws;
+        framesDrawn++;
+    }
+
+    if (finishFrames(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    if (framesDrawn > 0) {
+        printf("%llu frames with %u in flight: avg CPU wait %.3f ms, avg acquire wait %.3f ms, avg CPU frame %.3f ms, avg frames queued on GPU at submit %.2f\n",
+            (unsigned long long)framesDrawn, initInfo->maxFramesInFlight,
+            totals.cpuWaitMs / framesDrawn, totals.acquireWaitMs / framesDrawn, totals.cpuFrameMs / framesDrawn, (double)totals.gpuFramesQueued / framesDrawn);
+        printf("Sprites: %u per frame, avg %.1f KiB uploaded per frame\n",
+            demoSpriteCount, (double)totalBytesUploaded / framesDrawn / 1024.0);
+        // 0 slices means the scene was small enough to record inline on the main thread
+        printf("Recording: avg %.3f ms, avg %.1f draw calls in %.1f secondary command buffers per frame\n",
+            totals.recordMs / framesDrawn, (double)totals.recordDraws / framesDrawn, (double)totals.recordSlices / framesDrawn);
+        if (initInfo->softwareRenderer != NULL) {
+            // The CPU's version of the GPU frame time, everything from clearing the canvas to scaling it onto the window
+            printf("Software renderer: %s kernels, avg %.3f ms drawing %.0f sprites in %.1f runs over %u bands, avg %.3f ms presenting\n",
+                softwareTotals.kernels, softwareTotals.rasterMs / framesDrawn, (double)softwareTotals.spritesDrawn / framesDrawn,
+                (double)softwareTotals.draws / framesDrawn, softwareTotals.bands, softwareTotals.presentMs / framesDrawn);
+        }
+        if (initInfo->tilemap != NULL) {
+            printf("Tilemap: avg %.1f chunks drawn, %.1f culled, %.2f re-uploaded and %.0f tiles drawn per frame\n",
+                (double)tilemapTotals.chunksDrawn / framesDrawn, (double)tilemapTotals.chunksCulled / framesDrawn,
+                (double)tilemapTotals.chunksUploaded / framesDrawn, (double)tilemapTotals.tilesDrawn / framesDrawn);
+        }
+        if (initInfo->spatialHash != NULL && ticksRun > 0) {
+            // Lots of tests per pair found means the cells are too big, a low share of occupied cells and a slow rebuild mean they're too small
+            printf("Spatial hash: %.1f pixel cells, avg %.3f ms rebuild, %.0f pair tests for %.0f overlapping pairs and %.0f query tests per tick, %u of %u cells occupied, at most %u entities in one cell\n",
+                demoCellSize, spatialTotals.rebuildMs / ticksRun, (double)spatialTotals.pairTests / ticksRun, (double)spatialTotals.pairsFound / ticksRun,
+                (double)spatialTotals.queryTests / ticksRun, spatialTotals.occupiedCells, spatialTotals.cellCount, spatialTotals.maxEntitiesPerCell);
+            printf("Collision masks: %.0f of %.0f overlapping pairs touching pixel for pixel per tick\n",
+                (double)totalContacts / ticksRun, (double)spatialTotals.pairsFound / ticksRun);
+        }
+        if (initInfo->particles != NULL) {
+            // The particle count never comes back from the GPU, so all the CPU side can report is what it asked for
+            ParticleStats particleStats = getParticleStats(initInfo);
+            printf("Particles: room for %u, %llu emitted over %llu GPU steps, avg %.0f emitted per frame\n",
+                particleStats.maxParticles, (unsigned long long)particleStats.emitted, (unsigned long long)particleStats.steps, (double)particleStats.emitted / framesDrawn);
+        }
+        if (initInfo->sand != NULL && ticksRun > 0) {
+            // Once everything has settled the chunks awake drop to 0, and so does everything else
+            printf("Falling sand: avg %.1f of %u chunks awake, %.0f cells visited and %.0f moved, %.3f ms per step, avg %.1f regions and %.1f KiB uploaded per frame\n",
+                (double)sandTotals.chunksAwake / ticksRun, sandTotals.chunkCount, (double)sandTotals.cellsVisited / ticksRun, (double)sandTotals.cellsMoved / ticksRun,
+                sandTotals.stepMs / ticksRun, (double)sandTotals.regionsUploaded / framesDrawn, (double)sandTotals.bytesUploaded / framesDrawn / 1024.0);
+        }
+        if (initInfo->renderOnDemand) { printf("Render on demand: %llu frames drawn, idled %llu times waiting for something to change\n", (unsigned long long)framesDrawn, (unsigned long long)idleWaits); }
+        printf("Simulation: %llu ticks at %.0f Hz, avg %.2f ticks per frame, %llu ticks dropped to keep up\n",
+            (unsigned long long)ticksRun, 1.0 / timestep.tickSeconds, (double)ticksRun / framesDrawn, (unsigned long long)timestep.droppedTicks);
+
+        // Low utilization everywhere means the frame is bound by something other than the CPU, uneven utilization with few steals means the jobs are too coarse
+        uint32_t threadCount = getThreadPoolSize(initInfo) + 1;
+        WorkerStats workerStats[threadCount];
+        getWorkerStats(initInfo, workerStats);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            if (i + 1 < threadCount) { printf("Worker %u: ", i); }
+            else { printf("Main thread: "); }
+            printf("%llu jobs, %llu stolen, %.1f%% busy\n",
+                (unsigned long long)workerStats[i].jobsRun, (unsigned long long)workerStats[i].jobsStolen, workerStats[i].utilization * 100.0);
+        }
+        printProfilerSummary(initInfo);
     }
 
-    vkDeviceWaitIdle(initInfo->device);
+    destroyCollisionMask(&demoEntityMask);
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -8,6 +8,21 @@
 
 int gameLoop(InitializingInfo *tInitInfo);
 bool loopRunning;
+// How many test sprites to draw every frame, set with --sprites
+extern uint32_t demoSpriteCount;
+// Draws a scrolling test tilemap this many tiles a side, set with --tilemap
+extern uint32_t demoTilemapSize;
+// How many bouncing test entities to simulate with the ECS, set with --entities
+extern uint32_t demoEntityCount;
+// How many simulation ticks run per second no matter the frame rate, set with --tick-rate
+extern uint32_t tickRate;
+// Runs the entities through a spatial hash every tick, set with --collisions, and the hash's cell size in canvas pixels, set with --cell-size
+extern bool demoCollisions;
+extern float demoCellSize;
+// Runs a fountain of this many GPU simulated particles, set with --particles
+extern uint32_t demoParticleCount;
+// Pours sand and water into a falling sand world the size of the canvas for a few seconds, set with --sand
+extern bool demoSand;
 
 
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "../engine/initialize/initialize.h"
 #include "./game_loop/game_loop.h"
 #include "../engine/cleanup/cleanup.h"
+#include "../engine/image_loader/image_loader.h"
+#include "../engine/profiler/profiler.h"
 
 #include "../engine/globals/globals.h"
 
@@ -9,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 const char * APPLICATION_TITLE = "pixel_engine test application";
@@ -16,20 +19,85 @@ const uint32_t APPLICATION_VERSION = VK_MAKE_VERSION(1, 0, 0);
 const int WIN_WIDTH = 1280;
 const int WIN_HEIGHT = 720;
 
-int main() {
+
+// How many frames to render when running headless before the game loop stops on its own
+uint32_t headlessFrameLimit = 300;
+uint32_t headlessFramesCompleted = 0;
+
+void onHeadlessFrameComplete(InitializingInfo *initInfo, uint32_t imageIndex, void *userData) {
+    headlessFramesCompleted++;
+    if (headlessFramesCompleted >= headlessFrameLimit) { loopRunning = false; }
+}
+
+int main(int argc, char *argv[]) {
     // --- Initialize ---
     InitializingInfo initInfo = {  };
 
+    const char * imagePaths[argc];
+    uint32_t imagePathsCount = 0;
+
+    // --headless renders offscreen without a window, --frames sets how many frames it renders before exiting
+    // --frames-in-flight sets how far the CPU can get ahead of the GPU, --timeline uses a timeline semaphore instead of fences to track frames
+    // --sprites draws that many test sprites every frame through the sprite batcher, --image loads an image asset at startup (can be given more than once)
+    // --canvas WIDTHxHEIGHT sets the resolution the scene is rendered at before it gets scaled up to the window, --tilemap N scrolls around an N by N tile test map
+    // --entities N simulates N bouncing entities through the ECS, --tick-rate N runs the simulation N times a second independent of the frame rate
+    // --workers N sets how many worker threads the job system gets, by default there's one per core minus the main thread
+    // --on-demand only draws a frame when something changed, which lets a static scene sit at close to no CPU or GPU use
+    // --collisions finds every overlapping pair of entities each tick with a spatial hash, --cell-size N sets its cell size for tuning
+    // --particles N keeps about N particles alive in a fountain simulated entirely on the GPU
+    // --sand pours sand and water into a falling sand world until it settles, run it with --on-demand to watch it stop costing anything
+    // --software draws everything on the CPU even when there's a Vulkan device, which happens on its own when there isn't one
+    // --profile FILE times every frame on the CPU and GPU and writes the result to FILE as a Chrome trace
+    const char * tracePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) { initInfo.headless = true; }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) { headlessFrameLimit = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) { initInfo.maxFramesInFlight = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--timeline") == 0) { initInfo.useTimelineSemaphores = true; }
+        else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) { demoSpriteCount = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) { imagePaths[imagePathsCount++] = argv[++i]; }
+        else if (strcmp(argv[i], "--tilemap") == 0 && i + 1 < argc) { demoTilemapSize = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--entities") == 0 && i + 1 < argc) { demoEntityCount = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--on-demand") == 0) { initInfo.renderOnDemand = true; }
+        else if (strcmp(argv[i], "--collisions") == 0) { demoCollisions = true; }
+        else if (strcmp(argv[i], "--cell-size") == 0 && i + 1 < argc) { demoCellSize = strtof(argv[++i], NULL); }
+        else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) { demoParticleCount = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--sand") == 0) { demoSand = true; }
+        else if (strcmp(argv[i], "--software") == 0) { initInfo.softwareRendering = true; }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) { initInfo.workerThreads = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) { tickRate = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) { tracePath = argv[++i]; initInfo.profiling = true; }
+        else if (strcmp(argv[i], "--canvas") == 0 && i + 1 < argc) { sscanf(argv[++i], "%ux%u", &initInfo.canvasExtent.width, &initInfo.canvasExtent.height); }
+    }
+    if (demoSpriteCount + demoEntityCount > initInfo.maxSprites) { initInfo.maxSprites = demoSpriteCount + demoEntityCount; }
+    // Replacements are created before the entities they replace are destroyed at the sync point, so there has to be room for both
+    if (demoEntityCount * 2 > initInfo.maxEntities) { initInfo.maxEntities = demoEntityCount * 2; }
+    if (initInfo.headless) { initInfo.frameCompleteCallback = onHeadlessFrameComplete; }
+
     if (initialize(&initInfo) == EXIT_SUCCESS) { printf("Initialized properly!\n"); }
-    else { printf("Failed to initialize!\n"); }
+    else {
+        // Nothing after this can work without what failed, so just give back whatever did get made
+        printf("Failed to initialize!\n");
+        if (cleanup(&initInfo) == EXIT_FAILURE) { printf("Cleanup failed!\n"); }
+        return EXIT_FAILURE;
+    }
+
+    LoadedImage images[imagePathsCount > 0 ? imagePathsCount : 1];
+    if (imagePathsCount > 0) {
+        if (loadImages(&initInfo, imagePaths, imagePathsCount, images) == EXIT_SUCCESS) { printf("Loaded images properly!\n"); }
+        else { printf("Some images failed to load!\n"); }
+    }
     
 
     // --- Game loop ---
     if (gameLoop(&initInfo) == EXIT_SUCCESS) { printf("Game loop ran properly!\n"); }
     else { printf("Game loop failed!\n"); }
 
+    if (tracePath != NULL && exportProfilerTrace(&initInfo, tracePath) == EXIT_FAILURE) { printf("Failed to write the trace!\n"); }
+
 
     // --- Cleanup ---
+    for (int i = 0; i < imagePathsCount; i++) { destroyLoadedImage(&initInfo, &images[i]); }
     if (cleanup(&initInfo) == EXIT_SUCCESS) { printf("Cleanup ran properly!\n"); }
     else { printf("Cleanup failed!\n"); }
 
@@ -0,0 +1,447 @@
+#include "./allocator.h"
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+
+/*
+Drivers only guarantee maxMemoryAllocationCount (often just 4096) separate vkAllocateMemory calls, and every call is slow
+So instead we grab big blocks of memory and hand out pieces of them using a buddy allocator:
+- Every piece is a power of two in size, between 2^MIN_ORDER and the whole block
+- To get a piece of order n we take a free one of order n, or split a bigger one in half until we have one
+- When a piece is freed and its other half (its "buddy") is free too, the two are merged back into the bigger piece
+Since a piece of order n always starts at a multiple of 2^n, asking for at least the alignment's size also handles alignment for free
+*/
+#define MIN_ORDER 8 // 256 bytes
+#define MAX_ORDER 26 // 64 MiB blocks on heaps with room for them
+#define ORDER_COUNT (MAX_ORDER - MIN_ORDER + 1)
+
+// Spare empty blocks beyond this many per memory type are given back to the driver
+#define MAX_SPARE_BLOCKS 1
+
+
+/*
+The free pieces of one order in one block
+Merging needs to know if one particular piece (the buddy) is free and take it out, so every piece of the order has a bit that's set while it's free
+Allocating needs any free piece at all, so the offsets are also pushed onto a stack
+Taking a buddy out only clears its bit and leaves its offset on the stack, popping skips offsets whose bit isn't set anymore
+That way both are O(1), and the stack is compacted whenever it's mostly offsets that were skipped like that
+*/
+typedef struct {
+    uint64_t *freeBits; // Bit offset >> order
+    uint32_t order;
+    uint32_t freeCount; // Set bits, the stack can hold more than this
+
+    VkDeviceSize *offsets;
+    uint32_t count;
+    uint32_t capacity;
+} FreeList;
+
+typedef struct MemoryBlock {
+    VkDeviceMemory memory;
+    void *mapped;
+    uint32_t memoryType;
+    GpuResourceKind kind;
+
+    uint32_t order; // The block is 2^order bytes
+    VkDeviceSize usedBytes;
+    FreeList freeLists[ORDER_COUNT];
+} MemoryBlock;
+
+struct GpuAllocator {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    uint32_t blockOrders[VK_MAX_MEMORY_HEAPS];
+
+    MemoryBlock **blocks;
+    uint32_t blocksCount;
+    uint32_t blocksCapacity;
+
+    // Allocations too big for a block get their own VkDeviceMemory, these only track how much
+    VkDeviceSize dedicatedBytes[VK_MAX_MEMORY_HEAPS];
+    uint32_t dedicatedCount[VK_MAX_MEMORY_HEAPS];
+
+    VkDeviceSize usedBytes[VK_MAX_MEMORY_HEAPS];
+    uint32_t allocationCount[VK_MAX_MEMORY_HEAPS];
+};
+
+
+uint32_t ceilLog2(VkDeviceSize value) {
+    uint32_t order = 0;
+    while (((VkDeviceSize)1 << order) < value) { order++; }
+
+    return order;
+}
+
+uint32_t heapOfType(GpuAllocator *allocator, uint32_t memoryType) {
+    return allocator->memoryProperties.memoryTypes[memoryType].heapIndex;
+}
+
+
+bool isFreeOffset(FreeList *list, VkDeviceSize offset) {
+    uint64_t piece = offset >> list->order;
+    return (list->freeBits[piece / 64] >> (piece % 64)) & 1;
+}
+
+void setFreeOffset(FreeList *list, VkDeviceSize offset, bool isFree) {
+    uint64_t piece = offset >> list->order;
+    if (isFree) {
+        list->freeBits[piece / 64] |= (uint64_t)1 << (piece % 64);
+    } else {
+        list->freeBits[piece / 64] &= ~((uint64_t)1 << (piece % 64));
+    }
+}
+
+void compactFreeList(FreeList *list) {
+    // Keeps the first copy of every offset that's still free, clearing bits as it goes so later copies get dropped too
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (isFreeOffset(list, list->offsets[i])) {
+            setFreeOffset(list, list->offsets[i], false);
+            list->offsets[kept++] = list->offsets[i];
+        }
+    }
+    for (uint32_t i = 0; i < kept; i++) { setFreeOffset(list, list->offsets[i], true); }
+
+    list->count = kept;
+}
+
+void pushFreeOffset(FreeList *list, VkDeviceSize offset) {
+    if (list->count == list->capacity && list->count > 2 * list->freeCount) { compactFreeList(list); }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 8 : list->capacity * 2;
+        list->offsets = realloc(list->offsets, list->capacity * sizeof(VkDeviceSize));
+    }
+    list->offsets[list->count++] = offset;
+
+    setFreeOffset(list, offset, true);
+    list->freeCount++;
+}
+
+bool popFreeOffset(FreeList *list, VkDeviceSize *offset) {
+    while (list->count > 0) {
+        VkDeviceSize candidate = list->offsets[--list->count];
+        if (!isFreeOffset(list, candidate)) { continue; }
+
+        setFreeOffset(list, candidate, false);
+        list->freeCount--;
+        *offset = candidate;
+        return true;
+    }
+
+    return false;
+}
+
+bool removeFreeOffset(FreeList *list, VkDeviceSize offset) {
+    if (!isFreeOffset(list, offset)) { return false; }
+
+    // Its offset stays on the stack until a pop or a compaction skips over it
+    setFreeOffset(list, offset, false);
+    list->freeCount--;
+    return true;
+}
+
+bool takeFromBlock(MemoryBlock *block, uint32_t order, VkDeviceSize *offset) {
+    // Find the smallest free piece that's big enough
+    uint32_t found = order;
+    while (found <= block->order && block->freeLists[found - MIN_ORDER].freeCount == 0) { found++; }
+    if (found > block->order) { return false; }
+
+    popFreeOffset(&block->freeLists[found - MIN_ORDER], offset);
+
+    // Then split it in half until it's the size we want, keeping the second half of every split free
+    while (found > order) {
+        found--;
+        pushFreeOffset(&block->freeLists[found - MIN_ORDER], *offset + ((VkDeviceSize)1 << found));
+    }
+
+    block->usedBytes += (VkDeviceSize)1 << order;
+
+    return true;
+}
+
+void giveBackToBlock(MemoryBlock *block, VkDeviceSize offset, uint32_t order) {
+    block->usedBytes -= (VkDeviceSize)1 << order;
+
+    // Keep merging with our buddy for as long as it's free as well
+    while (order < block->order) {
+        VkDeviceSize buddy = offset ^ ((VkDeviceSize)1 << order);
+        if (!removeFreeOffset(&block->freeLists[order - MIN_ORDER], buddy)) { break; }
+
+        offset = offset < buddy ? offset : buddy;
+        order++;
+    }
+
+    pushFreeOffset(&block->freeLists[order - MIN_ORDER], offset);
+}
+
+MemoryBlock *createBlock(InitializingInfo *initInfo, uint32_t memoryType, GpuResourceKind kind) {
+    GpuAllocator *allocator = initInfo->allocator;
+    uint32_t order = allocator->blockOrders[heapOfType(allocator, memoryType)];
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+
+        .allocationSize = (VkDeviceSize)1 << order,
+        .memoryTypeIndex = memoryType
+    };
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(initInfo->device, &allocInfo, NULL, &memory) != VK_SUCCESS) { return NULL; }
+
+    MemoryBlock *block = calloc(1, sizeof(MemoryBlock));
+    block->memory = memory;
+    block->memoryType = memoryType;
+    block->kind = kind;
+    block->order = order;
+    for (uint32_t i = MIN_ORDER; i <= order; i++) {
+        uint64_t pieces = (uint64_t)1 << (order - i);
+        block->freeLists[i - MIN_ORDER].order = i;
+        block->freeLists[i - MIN_ORDER].freeBits = calloc((pieces + 63) / 64, sizeof(uint64_t));
+    }
+    pushFreeOffset(&block->freeLists[order - MIN_ORDER], 0);
+
+    // Host visible blocks are mapped once for their whole lifetime, mapping and unmapping per allocation is slow and a block can only be mapped once anyway
+    if (allocator->memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(initInfo->device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) { block->mapped = NULL; }
+    }
+
+    if (allocator->blocksCount == allocator->blocksCapacity) {
+        allocator->blocksCapacity = allocator->blocksCapacity == 0 ? 8 : allocator->blocksCapacity * 2;
+        allocator->blocks = realloc(allocator->blocks, allocator->blocksCapacity * sizeof(MemoryBlock *));
+    }
+    allocator->blocks[allocator->blocksCount++] = block;
+
+    return block;
+}
+
+void destroyBlock(InitializingInfo *initInfo, MemoryBlock *block) {
+    if (block->mapped != NULL) { vkUnmapMemory(initInfo->device, block->memory); }
+    vkFreeMemory(initInfo->device, block->memory, NULL);
+
+    for (int i = 0; i < ORDER_COUNT; i++) {
+        free(block->freeLists[i].freeBits);
+        free(block->freeLists[i].offsets);
+    }
+    free(block);
+}
+
+
+// Called when block has just become empty
+// A spare block is kept around so the next allocation doesn't have to go back to the driver, any more than that are freed
+void releaseSpareBlock(InitializingInfo *initInfo, MemoryBlock *block) {
+    GpuAllocator *allocator = initInfo->allocator;
+
+    uint32_t spares = 0;
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < allocator->blocksCount; i++) {
+        MemoryBlock *other = allocator->blocks[i];
+        if (other == block) {
+            index = i;
+        } else if (other->memoryType == block->memoryType && other->usedBytes == 0) {
+            spares++;
+        }
+    }
+    if (spares < MAX_SPARE_BLOCKS) { return; }
+
+    allocator->blocks[index] = allocator->blocks[--allocator->blocksCount];
+    destroyBlock(initInfo, block);
+}
+
+
+int gpuAllocate(InitializingInfo *initInfo, const VkMemoryRequirements *requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuResourceKind kind, GpuAllocation *allocation) {
+    GpuAllocator *allocator = initInfo->allocator;
+    *allocation = (GpuAllocation){ .size = requirements->size };
+
+    uint32_t memoryType = findMemoryType(initInfo->physicalDevice, requirements->memoryTypeBits, required | preferred);
+    if (memoryType == UINT32_MAX) { memoryType = findMemoryType(initInfo->physicalDevice, requirements->memoryTypeBits, required); }
+    if (memoryType == UINT32_MAX) { return EXIT_FAILURE; }
+    allocation->memoryType = memoryType;
+
+    uint32_t heap = heapOfType(allocator, memoryType);
+    VkDeviceSize pieceSize = requirements->size > requirements->alignment ? requirements->size : requirements->alignment;
+    uint32_t order = ceilLog2(pieceSize);
+    if (order < MIN_ORDER) { order = MIN_ORDER; }
+
+    // Anything bigger than half a block would waste most of a block, so it gets its own memory
+    if (order >= allocator->blockOrders[heap]) {
+        VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+
+            .allocationSize = requirements->size,
+            .memoryTypeIndex = memoryType
+        };
+
+        if (vkAllocateMemory(initInfo->device, &allocInfo, NULL, &allocation->memory) != VK_SUCCESS) { return EXIT_FAILURE; }
+        if (allocator->memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(initInfo->device, allocation->memory, 0, VK_WHOLE_SIZE, 0, &allocation->mapped) != VK_SUCCESS) { allocation->mapped = NULL; }
+        }
+
+        allocator->dedicatedBytes[heap] += requirements->size;
+        allocator->dedicatedCount[heap]++;
+    } else {
+        MemoryBlock *block = NULL;
+        VkDeviceSize offset = 0;
+
+        for (int i = 0; i < allocator->blocksCount; i++) {
+            MemoryBlock *candidate = allocator->blocks[i];
+            // An empty block has nothing to be kept apart from, so a spare one can switch kinds
+            if (candidate->memoryType != memoryType || (candidate->kind != kind && candidate->usedBytes > 0)) { continue; }
+
+            if (takeFromBlock(candidate, order, &offset)) {
+                candidate->kind = kind;
+                block = candidate;
+                break;
+            }
+        }
+
+        if (block == NULL) {
+            block = createBlock(initInfo, memoryType, kind);
+            if (block == NULL || !takeFromBlock(block, order, &offset)) { return EXIT_FAILURE; }
+        }
+
+        allocation->memory = block->memory;
+        allocation->offset = offset;
+        allocation->mapped = block->mapped != NULL ? (char *)block->mapped + offset : NULL;
+        allocation->block = block;
+        allocation->order = order;
+    }
+
+    allocator->usedBytes[heap] += requirements->size;
+    allocator->allocationCount[heap]++;
+
+    return EXIT_SUCCESS;
+}
+
+void gpuFree(InitializingInfo *initInfo, GpuAllocation *allocation) {
+    GpuAllocator *allocator = initInfo->allocator;
+    if (allocation->memory == VK_NULL_HANDLE) { return; }
+
+    uint32_t heap = heapOfType(allocator, allocation->memoryType);
+
+    if (allocation->block == NULL) {
+        if (allocation->mapped != NULL) { vkUnmapMemory(initInfo->device, allocation->memory); }
+        vkFreeMemory(initInfo->device, allocation->memory, NULL);
+
+        allocator->dedicatedBytes[heap] -= allocation->size;
+        allocator->dedicatedCount[heap]--;
+    } else {
+        giveBackToBlock(allocation->block, allocation->offset, allocation->order);
+        if (allocation->block->usedBytes == 0) { releaseSpareBlock(initInfo, allocation->block); }
+    }
+
+    allocator->usedBytes[heap] -= allocation->size;
+    allocator->allocationCount[heap]--;
+
+    *allocation = (GpuAllocation){  };
+}
+
+int allocateBufferMemory(InitializingInfo *initInfo, VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuAllocation *allocation) {
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(initInfo->device, buffer, &memoryRequirements);
+
+    if (gpuAllocate(initInfo, &memoryRequirements, required, preferred, GPU_RESOURCE_LINEAR, allocation) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (vkBindBufferMemory(initInfo->device, buffer, allocation->memory, allocation->offset) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+int allocateImageMemory(InitializingInfo *initInfo, VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuAllocation *allocation) {
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(initInfo->device, image, &memoryRequirements);
+
+    GpuResourceKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? GPU_RESOURCE_OPTIMAL : GPU_RESOURCE_LINEAR;
+    if (gpuAllocate(initInfo, &memoryRequirements, required, preferred, kind, allocation) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (vkBindImageMemory(initInfo->device, image, allocation->memory, allocation->offset) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+
+int createGpuAllocator(InitializingInfo *initInfo) {
+    GpuAllocator *allocator = calloc(1, sizeof(GpuAllocator));
+    initInfo->allocator = allocator;
+
+    vkGetPhysicalDeviceMemoryProperties(initInfo->physicalDevice, &allocator->memoryProperties);
+
+    // Small heaps (like the 256 MiB host visible device local heap without resizable BAR) get smaller blocks, so one block can't take up most of the heap
+    for (int i = 0; i < allocator->memoryProperties.memoryHeapCount; i++) {
+        uint32_t order = MAX_ORDER;
+        while (order > MIN_ORDER + 4 && ((VkDeviceSize)1 << order) > allocator->memoryProperties.memoryHeaps[i].size / 8) { order--; }
+
+        allocator->blockOrders[i] = order;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyGpuAllocator(InitializingInfo *initInfo) {
+    GpuAllocator *allocator = initInfo->allocator;
+    if (allocator == NULL) { return; }
+
+    printGpuAllocatorStats(initInfo);
+
+    for (int i = 0; i < allocator->blocksCount; i++) {
+        destroyBlock(initInfo, allocator->blocks[i]);
+    }
+    free(allocator->blocks);
+
+    free(allocator);
+    initInfo->allocator = NULL;
+}
+
+
+GpuHeapStats getGpuHeapStats(InitializingInfo *initInfo, uint32_t heapIndex) {
+    GpuAllocator *allocator = initInfo->allocator;
+
+    GpuHeapStats stats = {
+        .reservedBytes = allocator->dedicatedBytes[heapIndex],
+        .usedBytes = allocator->usedBytes[heapIndex],
+        .dedicatedCount = allocator->dedicatedCount[heapIndex],
+        .allocationCount = allocator->allocationCount[heapIndex]
+    };
+
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFree = 0;
+    for (int i = 0; i < allocator->blocksCount; i++) {
+        MemoryBlock *block = allocator->blocks[i];
+        if (heapOfType(allocator, block->memoryType) != heapIndex) { continue; }
+
+        VkDeviceSize blockSize = (VkDeviceSize)1 << block->order;
+        stats.reservedBytes += blockSize;
+        stats.blockCount++;
+
+        freeBytes += blockSize - block->usedBytes;
+        for (int order = block->order; order >= MIN_ORDER; order--) {
+            if (block->freeLists[order - MIN_ORDER].freeCount > 0) {
+                if (((VkDeviceSize)1 << order) > largestFree) { largestFree = (VkDeviceSize)1 << order; }
+                break;
+            }
+        }
+    }
+
+    // How much of the free memory we couldn't hand out in a single allocation
+    stats.fragmentation = freeBytes > 0 ? 1.0f - (float)largestFree / (float)freeBytes : 0.0f;
+
+    return stats;
+}
+
+void printGpuAllocatorStats(InitializingInfo *initInfo) {
+    GpuAllocator *allocator = initInfo->allocator;
+
+    for (uint32_t i = 0; i < allocator->memoryProperties.memoryHeapCount; i++) {
+        GpuHeapStats stats = getGpuHeapStats(initInfo, i);
+        if (stats.reservedBytes == 0) { continue; }
+
+        printf("GPU heap %u: %.2f MiB reserved, %.2f MiB used by %u allocations, %u blocks, %u dedicated, %.1f%% fragmented\n",
+            i, stats.reservedBytes / (1024.0 * 1024.0), stats.usedBytes / (1024.0 * 1024.0), stats.allocationCount,
+            stats.blockCount, stats.dedicatedCount, stats.fragmentation * 100.0f);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef ALLOCATOR
+#define ALLOCATOR
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Buffers and linearly tiled images can share blocks, optimally tiled images get blocks of their own
+// Keeping them apart means neighbouring allocations never have to be padded out to bufferImageGranularity
+typedef enum {
+    GPU_RESOURCE_LINEAR,
+    GPU_RESOURCE_OPTIMAL
+} GpuResourceKind;
+
+struct GpuAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size; // What was asked for, the allocator may have set aside more
+    void *mapped; // Points at offset when the memory is host visible, otherwise NULL
+    uint32_t memoryType;
+
+    // Used by the allocator to give the memory back, block is NULL for allocations that got their own VkDeviceMemory
+    struct MemoryBlock *block;
+    uint32_t order;
+};
+
+typedef struct {
+    VkDeviceSize reservedBytes; // Everything we got from vkAllocateMemory on this heap
+    VkDeviceSize usedBytes; // How much of that is handed out
+    uint32_t blockCount;
+    uint32_t dedicatedCount;
+    uint32_t allocationCount;
+    // 0 when all the free memory is in one piece, close to 1 when it's scattered in small pieces
+    float fragmentation;
+} GpuHeapStats;
+
+
+int createGpuAllocator(InitializingInfo *initInfo);
+void destroyGpuAllocator(InitializingInfo *initInfo);
+
+// required has to be met, preferred is used if some memory type offers it
+int gpuAllocate(InitializingInfo *initInfo, const VkMemoryRequirements *requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuResourceKind kind, GpuAllocation *allocation);
+void gpuFree(InitializingInfo *initInfo, GpuAllocation *allocation);
+
+// Allocate and bind memory in one go
+int allocateBufferMemory(InitializingInfo *initInfo, VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuAllocation *allocation);
+int allocateImageMemory(InitializingInfo *initInfo, VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuAllocation *allocation);
+
+
+GpuHeapStats getGpuHeapStats(InitializingInfo *initInfo, uint32_t heapIndex);
+void printGpuAllocatorStats(InitializingInfo *initInfo);
+
+
+#endif
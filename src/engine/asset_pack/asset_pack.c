@@ -0,0 +1,244 @@
+#include "./asset_pack.h"
+
+#include "./asset_pack_format.h"
+#include "./lz4.h"
+#include "../globals/globals.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+
+// Mapping the file means opening the pack is a handful of syscalls no matter how many assets are in it
+// The OS only reads in the pages we actually touch, and it can drop them again under memory pressure since they're backed by the file
+struct AssetPack {
+    const uint8_t *mapping;
+    size_t size;
+
+    #ifdef _WIN32
+        HANDLE file;
+        HANDLE fileMapping;
+    #endif
+
+    const AssetPackHeader *header;
+    const AssetPackEntry *entries;
+    const char * names;
+};
+
+
+char * getBasePathFor(const char * fileName) {
+    char * basePath = SDL_GetBasePath();
+    const char * directory = basePath != NULL ? basePath : "";
+
+    size_t length = strlen(directory) + strlen(fileName) + 1;
+    char * path = malloc(length);
+    snprintf(path, length, "%s%s", directory, fileName);
+
+    SDL_free(basePath);
+    return path;
+}
+
+bool mapFile(AssetPack *pack, const char * path) {
+    #ifdef _WIN32
+        pack->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (pack->file == INVALID_HANDLE_VALUE) { return false; }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(pack->file, &fileSize) || fileSize.QuadPart == 0) { return false; }
+        pack->size = (size_t)fileSize.QuadPart;
+
+        pack->fileMapping = CreateFileMappingA(pack->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (pack->fileMapping == NULL) { return false; }
+
+        pack->mapping = MapViewOfFile(pack->fileMapping, FILE_MAP_READ, 0, 0, 0);
+        return pack->mapping != NULL;
+    #else
+        int file = open(path, O_RDONLY);
+        if (file < 0) { return false; }
+
+        struct stat fileInfo;
+        if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0) {
+            close(file);
+            return false;
+        }
+        pack->size = (size_t)fileInfo.st_size;
+
+        void *mapping = mmap(NULL, pack->size, PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping keeps its own reference to the file, so we don't need the descriptor anymore
+        close(file);
+        if (mapping == MAP_FAILED) { return false; }
+
+        pack->mapping = mapping;
+        return true;
+    #endif
+}
+
+void unmapFile(AssetPack *pack) {
+    #ifdef _WIN32
+        if (pack->mapping != NULL) { UnmapViewOfFile(pack->mapping); }
+        if (pack->fileMapping != NULL) { CloseHandle(pack->fileMapping); }
+        if (pack->file != NULL && pack->file != INVALID_HANDLE_VALUE) { CloseHandle(pack->file); }
+    #else
+        if (pack->mapping != NULL) { munmap((void *)pack->mapping, pack->size); }
+    #endif
+}
+
+bool isAssetPackValid(const AssetPack *pack) {
+    if (pack->size < sizeof(AssetPackHeader)) { return false; }
+
+    const AssetPackHeader *header = pack->header;
+    if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION) { return false; }
+    if (header->entriesOffset % sizeof(uint64_t) != 0) { return false; }
+    if (header->entriesOffset > pack->size || header->entryCount > (pack->size - header->entriesOffset) / sizeof(AssetPackEntry)) { return false; }
+    if (header->namesOffset > pack->size) { return false; }
+
+    // Checking every entry up front means lookups never have to worry about reading outside the mapping
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        const AssetPackEntry *entry = &pack->entries[i];
+
+        if (entry->dataOffset > pack->size || entry->storedSize > pack->size - entry->dataOffset) { return false; }
+        if ((uint64_t)entry->nameOffset + entry->nameLength > pack->size - header->namesOffset) { return false; }
+        if (entry->compression == ASSET_COMPRESSION_NONE && entry->storedSize != entry->size) { return false; }
+        if (entry->compression > ASSET_COMPRESSION_LZ4) { return false; }
+    }
+
+    return true;
+}
+
+
+int openAssetPack(InitializingInfo *initInfo, const char * fileName) {
+    AssetPack *pack = calloc(1, sizeof(AssetPack));
+
+    char * path = getBasePathFor(fileName);
+    bool mapped = mapFile(pack, path);
+
+    // Only point into the mapping once we know the header is actually in there
+    if (mapped && pack->size >= sizeof(AssetPackHeader)) {
+        pack->header = (const AssetPackHeader *)pack->mapping;
+        pack->entries = (const AssetPackEntry *)(pack->mapping + pack->header->entriesOffset);
+        pack->names = (const char *)(pack->mapping + pack->header->namesOffset);
+    }
+
+    if (!mapped || !isAssetPackValid(pack)) {
+        if (mapped) { printf("Asset pack %s is corrupt or from a different version, ignoring it\n", path); }
+
+        unmapFile(pack);
+        free(pack);
+        free(path);
+        return EXIT_FAILURE;
+    }
+
+    printf("Mapped asset pack %s with %u assets\n", path, pack->header->entryCount);
+    free(path);
+
+    initInfo->assetPack = pack;
+
+    return EXIT_SUCCESS;
+}
+
+void closeAssetPack(InitializingInfo *initInfo) {
+    if (initInfo->assetPack == NULL) { return; }
+
+    unmapFile(initInfo->assetPack);
+    free(initInfo->assetPack);
+    initInfo->assetPack = NULL;
+}
+
+
+const AssetPackEntry *findAssetEntry(const AssetPack *pack, const char * name) {
+    uint64_t hash = hashAssetName(name);
+    size_t nameLength = strlen(name);
+
+    // Binary search for the first entry with this hash
+    uint32_t low = 0;
+    uint32_t high = pack->header->entryCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (pack->entries[middle].hash < hash) { low = middle + 1; }
+        else { high = middle; }
+    }
+
+    // Different names can share a hash, so check every entry that has it
+    for (uint32_t i = low; i < pack->header->entryCount && pack->entries[i].hash == hash; i++) {
+        const AssetPackEntry *entry = &pack->entries[i];
+        if (entry->nameLength == nameLength && memcmp(pack->names + entry->nameOffset, name, nameLength) == 0) { return entry; }
+    }
+
+    return NULL;
+}
+
+bool loadLooseAsset(const char * name, Asset *asset) {
+    char * path = getBasePathFor(name);
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (file == NULL) { return false; }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    rewind(file);
+
+    void *data = malloc(fileSize > 0 ? fileSize : 1);
+    bool read = fileSize >= 0 && fread(data, 1, fileSize, file) == (size_t)fileSize;
+    fclose(file);
+
+    if (!read) {
+        free(data);
+        return false;
+    }
+
+    *asset = (Asset){ .data = data, .size = fileSize, .owned = data };
+
+    return true;
+}
+
+bool loadAsset(InitializingInfo *initInfo, const char * name, Asset *asset) {
+    *asset = (Asset){  };
+
+    const AssetPackEntry *entry = initInfo->assetPack != NULL ? findAssetEntry(initInfo->assetPack, name) : NULL;
+    if (entry == NULL) {
+        if (loadLooseAsset(name, asset)) { return true; }
+
+        printf("Couldn't find asset %s\n", name);
+        return false;
+    }
+
+    const uint8_t *stored = initInfo->assetPack->mapping + entry->dataOffset;
+
+    if (entry->compression == ASSET_COMPRESSION_NONE) {
+        *asset = (Asset){ .data = stored, .size = entry->size };
+        return true;
+    }
+
+    void *data = malloc(entry->size > 0 ? entry->size : 1);
+    if (entry->storedSize > INT32_MAX || entry->size > INT32_MAX ||
+        lz4Decompress(stored, (int)entry->storedSize, data, (int)entry->size) < 0) {
+        printf("Asset %s is corrupt\n", name);
+        free(data);
+        return false;
+    }
+
+    *asset = (Asset){ .data = data, .size = entry->size, .owned = data };
+
+    return true;
+}
+
+void releaseAsset(Asset *asset) {
+    free(asset->owned);
+    *asset = (Asset){  };
+}
+
@@ -0,0 +1,28 @@
+#ifndef ASSET_PACK
+#define ASSET_PACK
+
+#include "../globals/globals.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+
+// What loadAsset() hands back, data points straight into the mapped pack unless the asset had to be decompressed or read from a loose file
+typedef struct {
+    const void *data;
+    size_t size;
+
+    void *owned; // Freed by releaseAsset()
+} Asset;
+
+
+// Maps the pack into memory, fileName is relative to the executable's directory
+int openAssetPack(InitializingInfo *initInfo, const char * fileName);
+void closeAssetPack(InitializingInfo *initInfo);
+
+// Looks in the pack first, and falls back to a loose file next to the executable so assets can be tried out without repacking
+bool loadAsset(InitializingInfo *initInfo, const char * name, Asset *asset);
+void releaseAsset(Asset *asset);
+
+
+#endif
@@ -0,0 +1,14 @@
+#include "./asset_pack_format.h"
+
+#include <stdint.h>
+
+
+uint64_t hashAssetName(const char * name) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
@@ -0,0 +1,50 @@
+#ifndef ASSET_PACK_FORMAT
+#define ASSET_PACK_FORMAT
+
+#include <stdint.h>
+
+
+/*
+The layout of an asset pack, shared by the engine and the packer tool
+- An AssetPackHeader at the very start
+- Every asset's data, each starting at a multiple of ASSET_PACK_ALIGNMENT so it can be used in place (SPIR-V has to be 4 byte aligned)
+- The entries, sorted by hash so they can be binary searched
+- The names of every asset, which are only used to rule out hash collisions
+Everything is little endian
+*/
+#define ASSET_PACK_MAGIC 0x4B505850 // "PXPK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 16
+
+typedef enum {
+    ASSET_COMPRESSION_NONE = 0,
+    ASSET_COMPRESSION_LZ4 = 1
+} AssetCompression;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+
+    uint64_t entriesOffset;
+    uint64_t namesOffset;
+} AssetPackHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t dataOffset;
+    uint64_t storedSize; // How many bytes are in the pack
+    uint64_t size; // How many bytes there are after decompressing
+
+    uint32_t nameOffset; // Relative to namesOffset
+    uint16_t nameLength;
+    uint16_t compression;
+} AssetPackEntry;
+
+
+// 64 bit FNV-1a, names are things like "textures/player.png"
+uint64_t hashAssetName(const char * name);
+
+
+#endif
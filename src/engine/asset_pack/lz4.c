@@ -0,0 +1,174 @@
+#include "./lz4.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+
+/*
+A block is a list of sequences, each one being:
+- A token byte, the high 4 bits are the literal count and the low 4 bits are the match length minus 4
+  Either one being 15 means more bytes follow that get added on, and every 255 means yet another byte follows
+- That many literal bytes, copied straight to the output
+- A 2 byte little endian offset back into the output, and the match copied from there (it can overlap what it's writing)
+The last sequence is just literals, and the format requires the last 5 bytes to be literals and the last match to start at least 12 bytes from the end
+*/
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MATCH_FIND_LIMIT 12
+#define MAX_OFFSET 65535
+#define HASH_LOG 16
+
+
+uint32_t read32(const uint8_t *pointer) {
+    uint32_t value;
+    memcpy(&value, pointer, sizeof(value));
+
+    return value;
+}
+
+uint32_t hashSequence(uint32_t sequence) {
+    // Knuth's multiplicative hash, keeping the top HASH_LOG bits
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+bool writeLength(uint8_t *dst, int *op, int dstCapacity, int length) {
+    while (length >= 255) {
+        if (*op >= dstCapacity) { return false; }
+        dst[(*op)++] = 255;
+        length -= 255;
+    }
+    if (*op >= dstCapacity) { return false; }
+    dst[(*op)++] = length;
+
+    return true;
+}
+
+bool writeSequence(uint8_t *dst, int *op, int dstCapacity, const uint8_t *literals, int literalCount, int offset, int matchLength) {
+    if (*op >= dstCapacity) { return false; }
+    int token = *op;
+    (*op)++;
+
+    dst[token] = (literalCount >= 15 ? 15 : literalCount) << 4;
+    if (literalCount >= 15 && !writeLength(dst, op, dstCapacity, literalCount - 15)) { return false; }
+
+    if (*op + literalCount > dstCapacity) { return false; }
+    memcpy(dst + *op, literals, literalCount);
+    *op += literalCount;
+
+    // The last sequence stops after its literals
+    if (matchLength == 0) { return true; }
+
+    if (*op + 2 > dstCapacity) { return false; }
+    dst[(*op)++] = offset & 0xFF;
+    dst[(*op)++] = offset >> 8;
+
+    int extraLength = matchLength - MIN_MATCH;
+    dst[token] |= extraLength >= 15 ? 15 : extraLength;
+    if (extraLength >= 15 && !writeLength(dst, op, dstCapacity, extraLength - 15)) { return false; }
+
+    return true;
+}
+
+
+int lz4CompressBound(int srcSize) {
+    return srcSize + srcSize / 255 + 16;
+}
+
+int lz4Compress(const uint8_t *src, int srcSize, uint8_t *dst, int dstCapacity) {
+    // Position + 1 of the last place each hashed 4 byte sequence was seen, so 0 means never
+    uint32_t *table = calloc(1 << HASH_LOG, sizeof(uint32_t));
+
+    int ip = 0;
+    int anchor = 0; // Start of the literals that haven't been written yet
+    int op = 0;
+
+    if (srcSize > MATCH_FIND_LIMIT) {
+        int matchLimit = srcSize - LAST_LITERALS;
+
+        while (ip + MATCH_FIND_LIMIT <= srcSize) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t hash = hashSequence(sequence);
+            int candidate = (int)table[hash] - 1;
+            table[hash] = ip + 1;
+
+            if (candidate < 0 || ip - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+                ip++;
+                continue;
+            }
+
+            int matchLength = MIN_MATCH;
+            while (ip + matchLength < matchLimit && src[candidate + matchLength] == src[ip + matchLength]) { matchLength++; }
+
+            if (!writeSequence(dst, &op, dstCapacity, src + anchor, ip - anchor, ip - candidate, matchLength)) {
+                free(table);
+                return 0;
+            }
+
+            ip += matchLength;
+            anchor = ip;
+        }
+    }
+
+    bool fits = writeSequence(dst, &op, dstCapacity, src + anchor, srcSize - anchor, 0, 0);
+    free(table);
+
+    return fits ? op : 0;
+}
+
+int lz4Decompress(const uint8_t *src, int srcSize, uint8_t *dst, int dstSize) {
+    int ip = 0;
+    int op = 0;
+
+    // Everything read from src is checked, since a corrupt pack shouldn't be able to make us write past dst
+    while (ip < srcSize) {
+        uint8_t token = src[ip++];
+
+        int literalCount = token >> 4;
+        if (literalCount == 15) {
+            uint8_t extra;
+            do {
+                if (ip >= srcSize) { return -1; }
+                extra = src[ip++];
+                literalCount += extra;
+            } while (extra == 255);
+        }
+
+        if (ip + literalCount > srcSize || op + literalCount > dstSize) { return -1; }
+        memcpy(dst + op, src + ip, literalCount);
+        ip += literalCount;
+        op += literalCount;
+
+        if (ip == srcSize) { break; }
+
+        if (ip + 2 > srcSize) { return -1; }
+        int offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) { return -1; }
+
+        int matchLength = token & 15;
+        if (matchLength == 15) {
+            uint8_t extra;
+            do {
+                if (ip >= srcSize) { return -1; }
+                extra = src[ip++];
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += MIN_MATCH;
+
+        if (op + matchLength > dstSize) { return -1; }
+
+        // A match closer than its own length repeats the bytes it's in the middle of writing, so it has to be copied a byte at a time
+        if (offset >= matchLength) {
+            memcpy(dst + op, dst + op - offset, matchLength);
+            op += matchLength;
+        } else {
+            for (int i = 0; i < matchLength; i++, op++) { dst[op] = dst[op - offset]; }
+        }
+    }
+
+    return op == dstSize ? op : -1;
+}
@@ -0,0 +1,18 @@
+#ifndef LZ4
+#define LZ4
+
+#include <stdint.h>
+
+
+// A small implementation of the LZ4 block format (no frame header), shared by the engine and the asset packer
+// Decompression is the part that matters at runtime, so compression is a simple greedy matcher rather than anything clever
+
+// The most space compressing srcSize bytes can take
+int lz4CompressBound(int srcSize);
+// Returns the compressed size, or 0 if it didn't fit in dstCapacity
+int lz4Compress(const uint8_t *src, int srcSize, uint8_t *dst, int dstCapacity);
+// dstSize has to be the exact decompressed size, returns it on success or -1 if the data is malformed
+int lz4Decompress(const uint8_t *src, int srcSize, uint8_t *dst, int dstSize);
+
+
+#endif
@@ -0,0 +1,303 @@
+#include "./bindless_textures.h"
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+struct BindlessTextures {
+    // Binding 0 is the one sampler every texture is read with, binding 1 is the array of images
+    VkSampler sampler;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet set;
+
+    uint32_t capacity;
+    uint32_t registered;
+    // Slots from here up have never been written, so they're free straight away
+    uint32_t nextUnused;
+
+    // Whether each slot currently has a texture in it, so unregistering one that doesn't can be ignored
+    bool *slotInUse;
+
+    // Unregistered slots, oldest first, along with the frame they were unregistered in
+    // A ring of capacity entries, since slotInUse stops a slot being retired twice without being registered in between
+    uint32_t *retiredIds;
+    uint64_t *retiredFrames;
+    uint32_t retiredFirst;
+    uint32_t retiredCount;
+
+    // Behind WHITE_TEXTURE_ID
+    VkImage whiteImage;
+    GpuAllocation whiteMemory;
+    VkImageView whiteView;
+};
+
+
+// The array has to fit in every limit on update-after-bind descriptors, the sampler counts towards the last one too
+uint32_t findBindlessCapacity(InitializingInfo *initInfo) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &indexingProperties
+    };
+    vkGetPhysicalDeviceProperties2(initInfo->physicalDevice, &properties);
+
+    uint32_t capacity = initInfo->maxTextures > 0 ? initInfo->maxTextures : DEFAULT_MAX_TEXTURES;
+    if (capacity > indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages) { capacity = indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages; }
+    if (capacity > indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages) { capacity = indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages; }
+    if (capacity > indexingProperties.maxUpdateAfterBindDescriptorsInAllPools - 1) { capacity = indexingProperties.maxUpdateAfterBindDescriptorsInAllPools - 1; }
+
+    return capacity;
+}
+
+int createBindlessSet(InitializingInfo *initInfo, BindlessTextures *textures) {
+    // Nearest filtering and clamped edges, so pixel art stays crisp and tiles from a tileset don't bleed into each other
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f
+    };
+    if (vkCreateSampler(initInfo->device, &samplerInfo, NULL, &textures->sampler) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // The sampler is baked into the layout, so it never needs writing into the set
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = &textures->sampler
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .descriptorCount = textures->capacity,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+        }
+    };
+
+    /* The flags are what make one set for the whole run possible
+    - UPDATE_AFTER_BIND: slots can be written after the set was bound in a command buffer that's still being recorded or is in flight
+    - UPDATE_UNUSED_WHILE_PENDING: as long as that command buffer doesn't draw with those slots
+    - PARTIALLY_BOUND: slots that were never written are fine as long as nothing draws with them, so we don't have to fill thousands up front */
+    VkDescriptorBindingFlags bindingFlags[] = {
+        0,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+
+        .bindingCount = 2,
+        .pBindingFlags = bindingFlags
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsInfo,
+
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 2,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(initInfo->device, &layoutInfo, NULL, &textures->setLayout) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { .type = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = 1 },
+        { .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = textures->capacity }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(initInfo->device, &poolInfo, NULL, &textures->descriptorPool) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+
+        .descriptorPool = textures->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &textures->setLayout
+    };
+    if (vkAllocateDescriptorSets(initInfo->device, &allocInfo, &textures->set) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+int createWhiteTexture(InitializingInfo *initInfo, BindlessTextures *textures) {
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_SRGB,
+        .extent = { .width = 1, .height = 1, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (vkCreateImage(initInfo->device, &imageInfo, NULL, &textures->whiteImage) != VK_SUCCESS) { return EXIT_FAILURE; }
+    if (allocateImageMemory(initInfo, textures->whiteImage, imageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &textures->whiteMemory) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+
+        .image = textures->whiteImage,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = imageInfo.format,
+
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1
+    };
+    if (vkCreateImageView(initInfo->device, &viewInfo, NULL, &textures->whiteView) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // It's 4 bytes, waiting for it here means no frame can ever see it half uploaded
+    const uint32_t white = 0xFFFFFFFF;
+    UploadTicket ticket = uploadImage(initInfo, textures->whiteImage, imageInfo.extent, &white, sizeof(white), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (ticket == 0) { return EXIT_FAILURE; }
+    waitForUpload(initInfo, ticket);
+
+    return EXIT_SUCCESS;
+}
+
+void writeTextureSlot(InitializingInfo *initInfo, uint32_t textureId, VkImageView view) {
+    BindlessTextures *textures = initInfo->textures;
+
+    VkDescriptorImageInfo imageInfo = {
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+
+        .dstSet = textures->set,
+        .dstBinding = 1,
+        .dstArrayElement = textureId,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &imageInfo
+    };
+    vkUpdateDescriptorSets(initInfo->device, 1, &write, 0, NULL);
+}
+
+int createBindlessTextures(InitializingInfo *initInfo) {
+    BindlessTextures *textures = calloc(1, sizeof(struct BindlessTextures));
+    initInfo->textures = textures;
+
+    textures->capacity = findBindlessCapacity(initInfo);
+    if (textures->capacity == 0) { return EXIT_FAILURE; }
+    textures->retiredIds = malloc(textures->capacity * sizeof(uint32_t));
+    textures->retiredFrames = malloc(textures->capacity * sizeof(uint64_t));
+    textures->slotInUse = calloc(textures->capacity, sizeof(bool));
+
+    if (createBindlessSet(initInfo, textures) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createWhiteTexture(initInfo, textures) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    // Nothing else has had a chance to register anything yet, so this is always slot 0
+    if (registerTexture(initInfo, textures->whiteView) != WHITE_TEXTURE_ID) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyBindlessTextures(InitializingInfo *initInfo) {
+    BindlessTextures *textures = initInfo->textures;
+    if (textures == NULL) { return; }
+
+    // Destroying the pool frees the set along with it
+    vkDestroyDescriptorPool(initInfo->device, textures->descriptorPool, NULL);
+    vkDestroyDescriptorSetLayout(initInfo->device, textures->setLayout, NULL);
+    vkDestroySampler(initInfo->device, textures->sampler, NULL);
+
+    vkDestroyImageView(initInfo->device, textures->whiteView, NULL);
+    vkDestroyImage(initInfo->device, textures->whiteImage, NULL);
+    gpuFree(initInfo, &textures->whiteMemory);
+
+    free(textures->retiredIds);
+    free(textures->retiredFrames);
+    free(textures->slotInUse);
+    free(textures);
+    initInfo->textures = NULL;
+}
+
+
+uint32_t registerTexture(InitializingInfo *initInfo, VkImageView view) {
+    BindlessTextures *textures = initInfo->textures;
+    if (textures == NULL) { return UINT32_MAX; }
+
+    // Fresh slots first, so retired ones get as long as possible to fall out of the frames in flight
+    uint32_t textureId;
+    if (textures->nextUnused < textures->capacity) {
+        textureId = textures->nextUnused++;
+    } else if (textures->retiredCount > 0 && initInfo->frameNumber > textures->retiredFrames[textures->retiredFirst] + initInfo->maxFramesInFlight) {
+        // Every frame up to and including the one it was unregistered in has been waited on by now, so writing the slot can't change what one of them draws
+        textureId = textures->retiredIds[textures->retiredFirst];
+        textures->retiredFirst = (textures->retiredFirst + 1) % textures->capacity;
+        textures->retiredCount--;
+    } else {
+        printf("No room for another texture, %u are registered\n", textures->registered);
+        return UINT32_MAX;
+    }
+
+    writeTextureSlot(initInfo, textureId, view);
+    textures->slotInUse[textureId] = true;
+    textures->registered++;
+
+    return textureId;
+}
+
+void unregisterTexture(InitializingInfo *initInfo, uint32_t textureId) {
+    BindlessTextures *textures = initInfo->textures;
+    if (textures == NULL || textureId == WHITE_TEXTURE_ID || textureId >= textures->nextUnused) { return; }
+    // Already retired (or retired and not handed out again yet), putting it in the ring twice would hand it out to two textures later
+    if (!textures->slotInUse[textureId]) { return; }
+    textures->slotInUse[textureId] = false;
+
+    // Nothing gets written to the slot, partially bound means a stale view there is fine as long as nothing draws with it
+    uint32_t last = (textures->retiredFirst + textures->retiredCount) % textures->capacity;
+    textures->retiredIds[last] = textureId;
+    textures->retiredFrames[last] = initInfo->frameNumber;
+    textures->retiredCount++;
+    textures->registered--;
+}
+
+
+VkDescriptorSetLayout getBindlessSetLayout(InitializingInfo *initInfo) {
+    return initInfo->textures->setLayout;
+}
+
+void bindBindlessTextures(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &initInfo->textures->set, 0, NULL);
+}
+
+BindlessTextureStats getBindlessTextureStats(InitializingInfo *initInfo) {
+    BindlessTextures *textures = initInfo->textures;
+    if (textures == NULL) { return (BindlessTextureStats){  }; }
+
+    return (BindlessTextureStats){
+        .capacity = textures->capacity,
+        .registered = textures->registered
+    };
+}
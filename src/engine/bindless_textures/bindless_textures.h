@@ -0,0 +1,48 @@
+#ifndef BINDLESS_TEXTURES
+#define BINDLESS_TEXTURES
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+// Always registered, a single white texel, so a sprite that was never given a texture draws as just its tint
+#define WHITE_TEXTURE_ID 0
+
+typedef struct {
+    uint32_t capacity; // How many textures fit in the array on this device, including the white one
+    uint32_t registered;
+} BindlessTextureStats;
+
+
+/*
+Every texture the sprite shader can read lives in one global descriptor set, a sampler and a big array of sampled images
+Each SpriteInstance's textureId indexes the array, so sprites with different textures still go out in the same draw call
+The set is bound along with the sprite pipeline and never changes after that, textures come and go by writing single slots of the array
+The array is update-after-bind and partially bound, so a slot can be written while frames that don't use it are in flight,
+and slots that were never written cost nothing as long as nothing draws with them
+*/
+
+// Called by initialize(), before anything makes a pipeline out of getBindlessSetLayout()
+int createBindlessTextures(InitializingInfo *initInfo);
+// Called by cleanup()
+void destroyBindlessTextures(InitializingInfo *initInfo);
+
+// Returns the textureId to draw view with, or UINT32_MAX if the array is full
+// The image has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL before a frame draws with it, for an uploaded image that means its ticket is complete
+uint32_t registerTexture(InitializingInfo *initInfo, VkImageView view);
+// The slot is only handed out again once every frame that could have drawn with it has finished
+// Unregistering a slot that isn't registered right now does nothing
+// The view still has to outlive those frames, so only destroy it after finishFrames() or maxFramesInFlight frames later
+void unregisterTexture(InitializingInfo *initInfo, uint32_t textureId);
+
+// Set 0 of every pipeline that reads textures
+VkDescriptorSetLayout getBindlessSetLayout(InitializingInfo *initInfo);
+void bindBindlessTextures(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+
+BindlessTextureStats getBindlessTextureStats(InitializingInfo *initInfo);
+
+
+#endif
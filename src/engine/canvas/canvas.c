@@ -0,0 +1,253 @@
+#include "./canvas.h"
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+#include "../software_renderer/software_renderer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// One canvas image per frame in flight, so a frame never draws into an image the previous frame is still blitting from
+struct Canvas {
+    uint32_t imageCount;
+    VkImage *images;
+    GpuAllocation *imagesMemory;
+    VkImageView *imageViews;
+    VkFramebuffer *framebuffers;
+};
+
+
+int createCanvasImages(InitializingInfo *initInfo, Canvas *canvas) {
+    for (int i = 0; i < canvas->imageCount; i++) {
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+
+            .imageType = VK_IMAGE_TYPE_2D,
+            // Same format as the swap chain so the render pass and every pipeline made against it work unchanged
+            .format = initInfo->swapChainImageFormat,
+            .extent = { .width = initInfo->canvasExtent.width, .height = initInfo->canvasExtent.height, .depth = 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+
+            // We render the scene into it and then blit out of it
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+
+        if (vkCreateImage(initInfo->device, &imageInfo, NULL, &canvas->images[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+        if (allocateImageMemory(initInfo, canvas->images[i], imageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &canvas->imagesMemory[i]) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+        VkImageViewCreateInfo viewInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+
+            .image = canvas->images[i],
+
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = imageInfo.format,
+
+            // This lets us swizzle the color channels around. For example, if we mapped all of the channels to the red channel, we'd have a monochrome texture
+            .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+
+            // The canvas is a plain color target without any mipmapping levels or multiple layers
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.baseMipLevel = 0,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.baseArrayLayer = 0,
+            .subresourceRange.layerCount = 1
+        };
+
+        if (vkCreateImageView(initInfo->device, &viewInfo, NULL, &canvas->imageViews[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+        VkFramebufferCreateInfo framebufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+
+            .renderPass = initInfo->renderPass,
+            .attachmentCount = 1,
+            .pAttachments = &canvas->imageViews[i],
+
+            .width = initInfo->canvasExtent.width,
+            .height = initInfo->canvasExtent.height,
+            .layers = 1
+        };
+
+        if (vkCreateFramebuffer(initInfo->device, &framebufferInfo, NULL, &canvas->framebuffers[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyCanvasImages(InitializingInfo *initInfo, Canvas *canvas) {
+    // Everything starts out as VK_NULL_HANDLE, so this also cleans up after a createCanvasImages() that failed halfway
+    for (int i = 0; i < canvas->imageCount; i++) {
+        vkDestroyFramebuffer(initInfo->device, canvas->framebuffers[i], NULL);
+        vkDestroyImageView(initInfo->device, canvas->imageViews[i], NULL);
+        vkDestroyImage(initInfo->device, canvas->images[i], NULL);
+        gpuFree(initInfo, &canvas->imagesMemory[i]);
+
+        canvas->framebuffers[i] = VK_NULL_HANDLE;
+        canvas->imageViews[i] = VK_NULL_HANDLE;
+        canvas->images[i] = VK_NULL_HANDLE;
+        canvas->imagesMemory[i] = (GpuAllocation){  };
+    }
+}
+
+
+int createCanvas(InitializingInfo *initInfo) {
+    if (initInfo->canvasExtent.width == 0 || initInfo->canvasExtent.height == 0) {
+        initInfo->canvasExtent = (VkExtent2D){ .width = DEFAULT_CANVAS_WIDTH, .height = DEFAULT_CANVAS_HEIGHT };
+    }
+
+    // Blitting needs format support on both ends, which every desktop driver has for the usual 8 bit swap chain formats
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(initInfo->physicalDevice, initInfo->swapChainImageFormat, &formatProperties);
+    VkFormatFeatureFlags neededFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((formatProperties.optimalTilingFeatures & neededFeatures) != neededFeatures) {
+        printf("The swap chain's format can't be blitted, so the canvas can't be scaled onto it!\n");
+        return EXIT_FAILURE;
+    }
+
+    Canvas *canvas = calloc(1, sizeof(Canvas));
+    initInfo->canvas = canvas;
+
+    canvas->imageCount = initInfo->maxFramesInFlight;
+    canvas->images = calloc(canvas->imageCount, sizeof(VkImage));
+    canvas->imagesMemory = calloc(canvas->imageCount, sizeof(GpuAllocation));
+    canvas->imageViews = calloc(canvas->imageCount, sizeof(VkImageView));
+    canvas->framebuffers = calloc(canvas->imageCount, sizeof(VkFramebuffer));
+
+    if (createCanvasImages(initInfo, canvas) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    printf("Rendering into a %ux%u canvas\n", initInfo->canvasExtent.width, initInfo->canvasExtent.height);
+
+    return EXIT_SUCCESS;
+}
+
+void destroyCanvas(InitializingInfo *initInfo) {
+    Canvas *canvas = initInfo->canvas;
+    if (canvas == NULL) { return; }
+
+    destroyCanvasImages(initInfo, canvas);
+
+    free(canvas->images);
+    free(canvas->imagesMemory);
+    free(canvas->imageViews);
+    free(canvas->framebuffers);
+    free(canvas);
+    initInfo->canvas = NULL;
+}
+
+int setCanvasSize(InitializingInfo *initInfo, uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0) { return EXIT_FAILURE; }
+    if (width == initInfo->canvasExtent.width && height == initInfo->canvasExtent.height) { return EXIT_SUCCESS; }
+    if (initInfo->softwareRendering) { return resizeSoftwareCanvas(initInfo, width, height); }
+
+    // Changing resolution is rare enough that simply waiting for every frame to finish beats keeping old canvases around like we do for the swap chain
+    if (vkDeviceWaitIdle(initInfo->device) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    destroyCanvasImages(initInfo, initInfo->canvas);
+    initInfo->canvasExtent = (VkExtent2D){ .width = width, .height = height };
+
+    return createCanvasImages(initInfo, initInfo->canvas);
+}
+
+
+VkFramebuffer getCanvasFramebuffer(InitializingInfo *initInfo, uint32_t frame) {
+    return initInfo->canvas->framebuffers[frame];
+}
+
+VkRect2D getCanvasScreenRect(InitializingInfo *initInfo) {
+    VkExtent2D canvasExtent = initInfo->canvasExtent;
+    VkExtent2D screenExtent = initInfo->swapChainExtent;
+
+    // Whole number scales keep every canvas pixel the same size on screen
+    uint32_t scaleX = screenExtent.width / canvasExtent.width;
+    uint32_t scaleY = screenExtent.height / canvasExtent.height;
+    uint32_t scale = scaleX < scaleY ? scaleX : scaleY;
+
+    VkExtent2D extent;
+    if (scale >= 1) {
+        extent = (VkExtent2D){ .width = canvasExtent.width * scale, .height = canvasExtent.height * scale };
+    } else if ((uint64_t)screenExtent.width * canvasExtent.height < (uint64_t)screenExtent.height * canvasExtent.width) {
+        // The window is smaller than the canvas, so all we can do is shrink it down to fit while keeping its shape
+        extent = (VkExtent2D){ .width = screenExtent.width, .height = (uint32_t)((uint64_t)screenExtent.width * canvasExtent.height / canvasExtent.width) };
+    } else {
+        extent = (VkExtent2D){ .width = (uint32_t)((uint64_t)screenExtent.height * canvasExtent.width / canvasExtent.height), .height = screenExtent.height };
+    }
+
+    return (VkRect2D){
+        .offset = { .x = (int32_t)(screenExtent.width - extent.width) / 2, .y = (int32_t)(screenExtent.height - extent.height) / 2 },
+        .extent = extent
+    };
+}
+
+
+void transitionTarget(VkCommandBuffer commandBuffer, VkImage target, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+
+        .image = target,
+        .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 }
+    };
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void recordCanvasBlit(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, uint32_t frame, VkImage target) {
+    VkRect2D screenRect = getCanvasScreenRect(initInfo);
+
+    // We don't care what was in the swap chain image before, the blit and the letterbox bars overwrite all of it
+    // The submit waits on the image being acquired at the transfer stage, so this barrier is chained onto that wait
+    transitionTarget(commandBuffer, target, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // Clearing the whole image is only needed when there are bars to fill in
+    bool letterboxed = screenRect.extent.width != initInfo->swapChainExtent.width || screenRect.extent.height != initInfo->swapChainExtent.height;
+    if (letterboxed) {
+        VkClearColorValue black = { .float32 = { 0.0f, 0.0f, 0.0f, 1.0f } };
+        VkImageSubresourceRange range = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 };
+        vkCmdClearColorImage(commandBuffer, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &range);
+
+        // The clear and the blit both write the middle of the image, so the blit has to wait for the clear
+        transitionTarget(commandBuffer, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+
+    // The render pass already left the canvas in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and its outgoing dependency makes the scene visible to this read
+    VkImageBlit blit = {
+        .srcSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+        .srcOffsets = { { 0, 0, 0 }, { (int32_t)initInfo->canvasExtent.width, (int32_t)initInfo->canvasExtent.height, 1 } },
+
+        .dstSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+        .dstOffsets = {
+            { screenRect.offset.x, screenRect.offset.y, 0 },
+            { screenRect.offset.x + (int32_t)screenRect.extent.width, screenRect.offset.y + (int32_t)screenRect.extent.height, 1 }
+        }
+    };
+    // Nearest keeps the pixels crisp, with a whole number scale every canvas pixel turns into an exact square of screen pixels
+    vkCmdBlitImage(commandBuffer, initInfo->canvas->images[frame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+
+    // Presenting (or the headless frame complete callback) is ordered after this by the semaphore or fence the submit signals
+    transitionTarget(commandBuffer, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        initInfo->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
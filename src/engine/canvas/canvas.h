@@ -0,0 +1,30 @@
+#ifndef CANVAS
+#define CANVAS
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+// The scene is rendered into a small canvas (DEFAULT_CANVAS_WIDTH x DEFAULT_CANVAS_HEIGHT unless canvasExtent says otherwise)
+// and then blown up onto the swap chain image with a nearest neighbour blit, scaled by the biggest whole number that fits with black bars around it
+// Every pixel the scene shades is a canvas pixel, so fill rate and bandwidth drop by the square of the scale factor
+int createCanvas(InitializingInfo *initInfo);
+void destroyCanvas(InitializingInfo *initInfo);
+
+// Can be called any time outside of beginFrame()/endFrame(), waits for the GPU to go idle and rebuilds the canvas at the new size
+int setCanvasSize(InitializingInfo *initInfo, uint32_t width, uint32_t height);
+
+// The framebuffer this frame in flight renders the scene into
+VkFramebuffer getCanvasFramebuffer(InitializingInfo *initInfo, uint32_t frame);
+// Where the canvas ends up on the swap chain image, handy for turning mouse positions into canvas pixels
+VkRect2D getCanvasScreenRect(InitializingInfo *initInfo);
+
+// Called by the frame's command buffer recording after the scene's render pass
+// Leaves the swap chain image ready to present, or in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL in headless mode
+void recordCanvasBlit(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, uint32_t frame, VkImage target);
+
+
+#endif
@@ -1,47 +1,128 @@
 #include "./cleanup.h"
 
 #include "../globals/globals.h"
+#include "../pipeline_cache/pipeline_cache.h"
+#include "../sprite_batch/sprite_batch.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+#include "../bindless_textures/bindless_textures.h"
+#include "../thread_pool/thread_pool.h"
+#include "../command_recording/command_recording.h"
+#include "../profiler/profiler.h"
+#include "../ecs/ecs.h"
+#include "../spatial_hash/spatial_hash.h"
+#include "../asset_pack/asset_pack.h"
+#include "../canvas/canvas.h"
+#include "../tilemap/tilemap.h"
+#include "../particles/particles.h"
+#include "../falling_sand/falling_sand.h"
+#include "../software_renderer/software_renderer.h"
 
 #include <vulkan/vulkan.h>
 #include <SDL2/SDL.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 
 
-int cleanup(InitializingInfo *tInitInfo) {
+void destroyRetiredSwapChain(InitializingInfo *tInitInfo) {
     InitializingInfo *initInfo = tInitInfo;
 
+    if (initInfo->retiredSwapChain == VK_NULL_HANDLE) { return; }
 
-    vkDestroySurfaceKHR(initInfo->instance, initInfo->surface, NULL);
+    vkDestroySwapchainKHR(initInfo->device, initInfo->retiredSwapChain, NULL);
+    initInfo->retiredSwapChain = VK_NULL_HANDLE;
+}
 
-    vkDestroyInstance(initInfo->instance, NULL);
 
-    vkDestroySwapchainKHR(initInfo->device, initInfo->swapChain, NULL);
+// Everything made from the logical device, and the device itself
+void destroyDeviceObjects(InitializingInfo *tInitInfo) {
+    InitializingInfo *initInfo = tInitInfo;
 
-    for (int i = 0; i < initInfo->swapChainFramebuffersCount; i++) {
-        vkDestroyFramebuffer(initInfo->device, initInfo->swapChainFramebuffers[i], NULL);
-    }
-    for (int i = 0; i < initInfo->swapChainImageViewsCount; i++) {
-        vkDestroyImageView(initInfo->device, initInfo->swapChainImageViews[i], NULL);
+    // Whatever initialize() or the last frames submitted has to be finished before anything it uses goes away
+    vkDeviceWaitIdle(initInfo->device);
+
+    destroyRetiredSwapChain(initInfo);
+    destroyCanvas(initInfo);
+
+    if (initInfo->headless) {
+        // These are our own images rather than ones owned by a swap chain, so we have to destroy them ourselves
+        for (int i = 0; i < initInfo->swapChainImagesCount; i++) {
+            vkDestroyImage(initInfo->device, initInfo->swapChainImages[i], NULL);
+        }
+        for (int i = 0; i < initInfo->offscreenImagesMemoryCount; i++) {
+            gpuFree(initInfo, &initInfo->offscreenImagesMemory[i]);
+        }
+        free(initInfo->offscreenImagesMemory);
+    } else {
+        vkDestroySwapchainKHR(initInfo->device, initInfo->swapChain, NULL);
     }
 
-    vkDestroyPipeline(initInfo->device, initInfo->graphicsPipeline, NULL);
-    vkDestroyPipelineLayout(initInfo->device, initInfo->pipelineLayout, NULL);
+    destroyProfiler(initInfo);
+    destroyTilemap(initInfo);
+    destroyParticleSystem(initInfo);
+    destroySandWorld(initInfo);
+    destroySpriteBatcher(initInfo);
+    destroyBindlessTextures(initInfo);
+    destroyUploadManager(initInfo);
+
+    if (savePipelineCache(initInfo) == EXIT_FAILURE) { printf("Failed to save the pipeline cache!\n"); }
+    vkDestroyPipelineCache(initInfo->device, initInfo->pipelineCache, NULL);
+
     vkDestroyRenderPass(initInfo->device, initInfo->renderPass, NULL);
 
+    destroyCommandRecorder(initInfo);
     vkDestroyCommandPool(initInfo->device, initInfo->commandPool, NULL);
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    // Null until createSyncObjects() got that far
+    for (int i = 0; initInfo->inFlightFences != NULL && i < initInfo->maxFramesInFlight; i++) {
         vkDestroySemaphore(initInfo->device, initInfo->imageAvailableSemaphores[i], NULL);
         vkDestroySemaphore(initInfo->device, initInfo->renderFinishedSemaphores[i], NULL);
 
         vkDestroyFence(initInfo->device, initInfo->inFlightFences[i], NULL);
     }
+    vkDestroySemaphore(initInfo->device, initInfo->frameTimelineSemaphore, NULL);
+
+    // Everything that got memory from the allocator is gone by now
+    destroyGpuAllocator(initInfo);
 
     vkDestroyDevice(initInfo->device, NULL);
+}
+
+int cleanup(InitializingInfo *tInitInfo) {
+    InitializingInfo *initInfo = tInitInfo;
+
+
+    destroySpatialHash(initInfo);
+    destroyWorld(initInfo);
+    destroyThreadPool(initInfo);
+
+    // None of the Vulkan objects below were ever made, everything the CPU renderer draws from is in ordinary memory
+    if (initInfo->softwareRendering) {
+        destroyProfiler(initInfo);
+        destroyTilemap(initInfo);
+        destroySandWorld(initInfo);
+        destroySpriteBatcher(initInfo);
+        destroySoftwareRenderer(initInfo);
+
+        if (!initInfo->headless && initInfo->window != NULL) { SDL_DestroyWindow(initInfo->window); }
+
+        closeAssetPack(initInfo);
+
+        return EXIT_SUCCESS;
+    }
+
+    // initialize() can fail before there's a device, then there's nothing made from one to destroy
+    if (initInfo->device != VK_NULL_HANDLE) { destroyDeviceObjects(initInfo); }
+
+    // The surface and instance have to outlive every object created from them, so they go last
+    if (!initInfo->headless && initInfo->instance != VK_NULL_HANDLE) { vkDestroySurfaceKHR(initInfo->instance, initInfo->surface, NULL); }
+    vkDestroyInstance(initInfo->instance, NULL);
+
 
+    if (!initInfo->headless && initInfo->window != NULL) { SDL_DestroyWindow(initInfo->window); }
 
-    SDL_DestroyWindow(initInfo->window);
+    closeAssetPack(initInfo);
 
 
     return EXIT_SUCCESS;
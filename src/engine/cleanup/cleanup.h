@@ -8,6 +8,8 @@
 
 
 int cleanup(InitializingInfo *tInitInfo);
+// Destroys the swap chain that recreateSwapChain() replaced, once no frame in flight can be using it
+void destroyRetiredSwapChain(InitializingInfo *tInitInfo);
 
 
 #endif
\ No newline at end of file
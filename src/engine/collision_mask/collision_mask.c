@@ -0,0 +1,283 @@
+#include "./collision_mask.h"
+
+#include "../globals/globals.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// SSE2 is part of x86-64 so it's always there, AVX2 gets compiled in for just the functions that use it and is only called if the CPU has it
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define COLLISION_MASK_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(COLLISION_MASK_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define COLLISION_MASK_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+
+// Where two masks overlap, worked out once per test so the row loops are just loads, shifts and ANDs
+typedef struct {
+    const uint64_t *rowsA, *rowsB; // The first overlapping row of each
+    uint32_t wordsPerRowA, wordsPerRowB;
+    uint32_t bitA, bitB; // Where the overlap's left edge is in each row
+    uint32_t width, height; // Of the overlap, in pixels
+} MaskOverlap;
+
+// Returns the first row from firstRow on where the masks share a set bit, or a row at most a few before it, or overlap->height if there isn't one
+// The SIMD versions test several rows at once and only say which group hit, findOverlappingRow() narrows it down
+typedef uint32_t (*RowTestFunction)(const MaskOverlap *overlap, uint32_t firstRow);
+
+
+bool findMaskOverlap(const CollisionMask *a, int32_t ax, int32_t ay, const CollisionMask *b, int32_t bx, int32_t by, MaskOverlap *overlap) {
+    // The bounding box reject, done in 64 bits so positions far apart can't overflow
+    int64_t left = ax > bx ? ax : bx;
+    int64_t top = ay > by ? ay : by;
+    int64_t right = (int64_t)ax + a->width < (int64_t)bx + b->width ? (int64_t)ax + a->width : (int64_t)bx + b->width;
+    int64_t bottom = (int64_t)ay + a->height < (int64_t)by + b->height ? (int64_t)ay + a->height : (int64_t)by + b->height;
+    if (left >= right || top >= bottom || a->bits == NULL || b->bits == NULL) { return false; }
+
+    *overlap = (MaskOverlap){
+        .rowsA = a->bits + (top - ay) * a->wordsPerRow,
+        .rowsB = b->bits + (top - by) * b->wordsPerRow,
+        .wordsPerRowA = a->wordsPerRow,
+        .wordsPerRowB = b->wordsPerRow,
+        .bitA = (uint32_t)(left - ax),
+        .bitB = (uint32_t)(left - bx),
+        .width = (uint32_t)(right - left),
+        .height = (uint32_t)(bottom - top)
+    };
+    return true;
+}
+
+// The 64 pixels of row starting at bit, pulled out of the two words they straddle
+uint64_t extractRowBits(const uint64_t *row, uint32_t wordsPerRow, uint32_t bit) {
+    uint32_t word = bit >> 6;
+    uint32_t shift = bit & 63;
+
+    uint64_t bits = row[word] >> shift;
+    if (shift != 0 && word + 1 < wordsPerRow) { bits |= row[word + 1] << (64 - shift); }
+
+    return bits;
+}
+
+// Only the first count pixels of a 64 pixel column are part of the overlap
+uint64_t columnMask(uint32_t count) {
+    return count >= 64 ? UINT64_MAX : ((uint64_t)1 << count) - 1;
+}
+
+uint64_t overlapRowBits(const MaskOverlap *overlap, uint32_t row, uint32_t column) {
+    uint32_t pixel = column * 64;
+    uint64_t bitsA = extractRowBits(overlap->rowsA + row * overlap->wordsPerRowA, overlap->wordsPerRowA, overlap->bitA + pixel);
+    uint64_t bitsB = extractRowBits(overlap->rowsB + row * overlap->wordsPerRowB, overlap->wordsPerRowB, overlap->bitB + pixel);
+
+    return bitsA & bitsB & columnMask(overlap->width - pixel);
+}
+
+uint32_t firstOverlappingRowScalar(const MaskOverlap *overlap, uint32_t firstRow) {
+    uint32_t columns = (overlap->width + 63) / 64;
+
+    for (uint32_t row = firstRow; row < overlap->height; row++) {
+        for (uint32_t column = 0; column < columns; column++) {
+            if (overlapRowBits(overlap, row, column) != 0) { return row; }
+        }
+    }
+
+    return overlap->height;
+}
+
+
+#ifdef COLLISION_MASK_SSE2
+// Two rows at a time, one per 64 bit lane. Every row of a mask is shifted by the same amount, so one shift count does both lanes
+uint32_t firstOverlappingRowSSE2(const MaskOverlap *overlap, uint32_t firstRow) {
+    uint32_t columns = (overlap->width + 63) / 64;
+    uint32_t strideA = overlap->wordsPerRowA;
+    uint32_t strideB = overlap->wordsPerRowB;
+
+    // Shifting a lane by 64 or more gives 0, which is exactly what the high word should add when the overlap starts on a word boundary
+    __m128i shiftA = _mm_cvtsi32_si128(overlap->bitA & 63);
+    __m128i shiftHighA = _mm_cvtsi32_si128(64 - (overlap->bitA & 63));
+    __m128i shiftB = _mm_cvtsi32_si128(overlap->bitB & 63);
+    __m128i shiftHighB = _mm_cvtsi32_si128(64 - (overlap->bitB & 63));
+    __m128i zero = _mm_setzero_si128();
+
+    uint32_t row = firstRow;
+    for (; row + 2 <= overlap->height; row += 2) {
+        __m128i any = zero;
+
+        for (uint32_t column = 0; column < columns; column++) {
+            uint32_t wordA = (overlap->bitA >> 6) + column;
+            uint32_t wordB = (overlap->bitB >> 6) + column;
+            const uint64_t *a = overlap->rowsA + row * strideA + wordA;
+            const uint64_t *b = overlap->rowsB + row * strideB + wordB;
+
+            __m128i lowA = _mm_set_epi64x((long long)a[strideA], (long long)a[0]);
+            __m128i highA = wordA + 1 < strideA ? _mm_set_epi64x((long long)a[strideA + 1], (long long)a[1]) : zero;
+            __m128i lowB = _mm_set_epi64x((long long)b[strideB], (long long)b[0]);
+            __m128i highB = wordB + 1 < strideB ? _mm_set_epi64x((long long)b[strideB + 1], (long long)b[1]) : zero;
+
+            __m128i bitsA = _mm_or_si128(_mm_srl_epi64(lowA, shiftA), _mm_sll_epi64(highA, shiftHighA));
+            __m128i bitsB = _mm_or_si128(_mm_srl_epi64(lowB, shiftB), _mm_sll_epi64(highB, shiftHighB));
+            __m128i valid = _mm_set1_epi64x((long long)columnMask(overlap->width - column * 64));
+
+            any = _mm_or_si128(any, _mm_and_si128(_mm_and_si128(bitsA, bitsB), valid));
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, zero)) != 0xFFFF) { return row; }
+    }
+
+    return firstOverlappingRowScalar(overlap, row);
+}
+#endif
+
+#ifdef COLLISION_MASK_AVX2
+// Same thing four rows at a time
+TARGET_AVX2 uint32_t firstOverlappingRowAVX2(const MaskOverlap *overlap, uint32_t firstRow) {
+    uint32_t columns = (overlap->width + 63) / 64;
+    uint32_t strideA = overlap->wordsPerRowA;
+    uint32_t strideB = overlap->wordsPerRowB;
+
+    __m128i shiftA = _mm_cvtsi32_si128(overlap->bitA & 63);
+    __m128i shiftHighA = _mm_cvtsi32_si128(64 - (overlap->bitA & 63));
+    __m128i shiftB = _mm_cvtsi32_si128(overlap->bitB & 63);
+    __m128i shiftHighB = _mm_cvtsi32_si128(64 - (overlap->bitB & 63));
+    __m256i zero = _mm256_setzero_si256();
+
+    uint32_t row = firstRow;
+    for (; row + 4 <= overlap->height; row += 4) {
+        __m256i any = zero;
+
+        for (uint32_t column = 0; column < columns; column++) {
+            uint32_t wordA = (overlap->bitA >> 6) + column;
+            uint32_t wordB = (overlap->bitB >> 6) + column;
+            const uint64_t *a = overlap->rowsA + row * strideA + wordA;
+            const uint64_t *b = overlap->rowsB + row * strideB + wordB;
+
+            __m256i lowA = _mm256_set_epi64x((long long)a[strideA * 3], (long long)a[strideA * 2], (long long)a[strideA], (long long)a[0]);
+            __m256i highA = wordA + 1 < strideA ? _mm256_set_epi64x((long long)a[strideA * 3 + 1], (long long)a[strideA * 2 + 1], (long long)a[strideA + 1], (long long)a[1]) : zero;
+            __m256i lowB = _mm256_set_epi64x((long long)b[strideB * 3], (long long)b[strideB * 2], (long long)b[strideB], (long long)b[0]);
+            __m256i highB = wordB + 1 < strideB ? _mm256_set_epi64x((long long)b[strideB * 3 + 1], (long long)b[strideB * 2 + 1], (long long)b[strideB + 1], (long long)b[1]) : zero;
+
+            __m256i bitsA = _mm256_or_si256(_mm256_srl_epi64(lowA, shiftA), _mm256_sll_epi64(highA, shiftHighA));
+            __m256i bitsB = _mm256_or_si256(_mm256_srl_epi64(lowB, shiftB), _mm256_sll_epi64(highB, shiftHighB));
+            __m256i valid = _mm256_set1_epi64x((long long)columnMask(overlap->width - column * 64));
+
+            any = _mm256_or_si256(any, _mm256_and_si256(_mm256_and_si256(bitsA, bitsB), valid));
+        }
+
+        if (!_mm256_testz_si256(any, any)) { return row; }
+    }
+
+    return firstOverlappingRowScalar(overlap, row);
+}
+#endif
+
+
+RowTestFunction firstOverlappingRow = firstOverlappingRowScalar;
+
+void selectCollisionMaskRoutines(void) {
+    firstOverlappingRow = firstOverlappingRowScalar;
+
+#ifdef COLLISION_MASK_SSE2
+    if (SDL_HasSSE2()) { firstOverlappingRow = firstOverlappingRowSSE2; }
+#endif
+#ifdef COLLISION_MASK_AVX2
+    if (SDL_HasAVX2()) { firstOverlappingRow = firstOverlappingRowAVX2; }
+#endif
+}
+
+
+int createCollisionMask(const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t alphaThreshold, CollisionMask *mask) {
+    *mask = (CollisionMask){ .width = width, .height = height, .wordsPerRow = (width + 63) / 64 };
+    if (width == 0 || height == 0) { return EXIT_SUCCESS; }
+
+    mask->bits = calloc((size_t)mask->wordsPerRow * height, sizeof(uint64_t));
+    if (mask->bits == NULL) { return EXIT_FAILURE; }
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *row = pixels + (size_t)y * width * 4;
+        uint64_t *bits = mask->bits + (size_t)y * mask->wordsPerRow;
+
+        // A word at a time, so each one is written once instead of once per pixel
+        for (uint32_t word = 0; word < mask->wordsPerRow; word++) {
+            uint32_t first = word * 64;
+            uint32_t count = width - first < 64 ? width - first : 64;
+
+            uint64_t solid = 0;
+            for (uint32_t i = 0; i < count; i++) { solid |= (uint64_t)(row[(first + i) * 4 + 3] >= alphaThreshold) << i; }
+            bits[word] = solid;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyCollisionMask(CollisionMask *mask) {
+    free(mask->bits);
+    *mask = (CollisionMask){  };
+}
+
+
+bool masksOverlap(const CollisionMask *a, int32_t ax, int32_t ay, const CollisionMask *b, int32_t bx, int32_t by) {
+    MaskOverlap overlap;
+    if (!findMaskOverlap(a, ax, ay, b, bx, by, &overlap)) { return false; }
+
+    return firstOverlappingRow(&overlap, 0) < overlap.height;
+}
+
+bool findMaskContact(const CollisionMask *a, int32_t ax, int32_t ay, const CollisionMask *b, int32_t bx, int32_t by, int32_t *contactX, int32_t *contactY) {
+    MaskOverlap overlap;
+    if (!findMaskOverlap(a, ax, ay, b, bx, by, &overlap)) { return false; }
+
+    uint32_t row = firstOverlappingRow(&overlap, 0);
+    if (row >= overlap.height) { return false; }
+
+    // The fast path only says which group of rows hit, so go through them one at a time to find the exact pixel
+    uint32_t columns = (overlap.width + 63) / 64;
+    for (; row < overlap.height; row++) {
+        for (uint32_t column = 0; column < columns; column++) {
+            uint64_t bits = overlapRowBits(&overlap, row, column);
+            if (bits == 0) { continue; }
+
+            uint32_t bit = 0;
+            while (!(bits & ((uint64_t)1 << bit))) { bit++; }
+
+            // Back from the overlap's corner to canvas pixels
+            *contactX = (ax > bx ? ax : bx) + column * 64 + bit;
+            *contactY = (ay > by ? ay : by) + row;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int32_t sweepMasks(const CollisionMask *a, int32_t ax, int32_t ay, int32_t dx, int32_t dy, const CollisionMask *b, int32_t bx, int32_t by) {
+    // If b isn't anywhere near the whole path there's no point walking it
+    int64_t sweptLeft = dx < 0 ? (int64_t)ax + dx : ax;
+    int64_t sweptTop = dy < 0 ? (int64_t)ay + dy : ay;
+    int64_t sweptRight = (int64_t)ax + a->width + (dx > 0 ? dx : 0);
+    int64_t sweptBottom = (int64_t)ay + a->height + (dy > 0 ? dy : 0);
+    if (sweptRight <= bx || (int64_t)bx + b->width <= sweptLeft || sweptBottom <= by || (int64_t)by + b->height <= sweptTop) { return -1; }
+
+    int32_t steps = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+    for (int32_t step = 0; step <= steps; step++) {
+        // Along the line a pixel at a time, the longer axis moves every step and the shorter one only some of them
+        int32_t x = ax + (steps == 0 ? 0 : (int32_t)((int64_t)dx * step / steps));
+        int32_t y = ay + (steps == 0 ? 0 : (int32_t)((int64_t)dy * step / steps));
+
+        if (masksOverlap(a, x, y, b, bx, by)) { return step; }
+    }
+
+    return -1;
+}
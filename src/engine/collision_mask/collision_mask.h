@@ -0,0 +1,40 @@
+#ifndef COLLISION_MASK
+#define COLLISION_MASK
+
+#include "../globals/globals.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Pixels with at least this much alpha are solid
+#define DEFAULT_COLLISION_ALPHA_THRESHOLD 128
+
+// One bit per pixel, set where the image is solid
+// Every row starts on a fresh 64 bit word, bit x of a row is bit x % 64 of word x / 64, so whole rows can be shifted and ANDed against each other
+typedef struct {
+    uint32_t width, height;
+    uint32_t wordsPerRow;
+    uint64_t *bits;
+} CollisionMask;
+
+
+// Picks the AVX2, SSE2 or plain C row tests for this CPU, called by initialize(). The plain C ones are used until then
+void selectCollisionMaskRoutines(void);
+
+// pixels is width * height RGBA pixels with 8 bits per channel, like the ones stb_image decodes
+int createCollisionMask(const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t alphaThreshold, CollisionMask *mask);
+void destroyCollisionMask(CollisionMask *mask);
+
+// Positions are the masks' top left corners in whole canvas pixels
+// These only read the masks, so any number of threads can test the same ones at once
+// Both start with a bounding box test, so pairs that don't even touch cost next to nothing
+bool masksOverlap(const CollisionMask *a, int32_t ax, int32_t ay, const CollisionMask *b, int32_t bx, int32_t by);
+// The first pixel both masks cover, top to bottom and then left to right
+bool findMaskContact(const CollisionMask *a, int32_t ax, int32_t ay, const CollisionMask *b, int32_t bx, int32_t by, int32_t *contactX, int32_t *contactY);
+// Moves a from (ax, ay) towards (ax + dx, ay + dy) a pixel at a time and returns how many steps it takes before it first touches b
+// 0 means they already overlap, -1 means a gets all the way there without touching b
+int32_t sweepMasks(const CollisionMask *a, int32_t ax, int32_t ay, int32_t dx, int32_t dy, const CollisionMask *b, int32_t bx, int32_t by);
+
+
+#endif
@@ -0,0 +1,298 @@
+#include "./command_recording.h"
+
+#include "../globals/globals.h"
+#include "../thread_pool/thread_pool.h"
+#include "../sprite_batch/sprite_batch.h"
+#include "../tilemap/tilemap.h"
+#include "../particles/particles.h"
+#include "../falling_sand/falling_sand.h"
+#include "../profiler/profiler.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Never more slices than this, no matter how many cores there are
+#define MAX_RECORDING_SLICES 32
+
+
+// A command pool can only be used by one thread at a time, so each thread gets its own for every frame in flight
+// Resetting the whole pool at once is much cheaper than resetting its command buffers one by one, and the buffers stay allocated for next time
+typedef struct {
+    VkCommandPool pool;
+    VkCommandBuffer *commandBuffers;
+    uint32_t commandBuffersCount;
+    uint32_t commandBuffersUsed;
+} ThreadCommandPool;
+
+// Every draw call in the scene, in the order they're drawn: the sand, one per visible tilemap chunk, the sprites and then the particles
+// Draw calls are what recording costs, so slices are cut out of this list rather than out of the sprites
+typedef struct {
+    uint32_t sandDraws;
+    uint32_t tilemapDraws;
+    uint32_t spriteDraws;
+    uint32_t particleDraws;
+} SceneDraws;
+
+typedef struct {
+    InitializingInfo *initInfo;
+    const VkCommandBufferInheritanceInfo *inheritanceInfo;
+    const SceneDraws *draws;
+
+    // Which of the scene's draw calls this slice records
+    uint32_t firstDraw;
+    uint32_t drawCount;
+
+    VkCommandBuffer commandBuffer;
+    int result;
+} RecordingSlice;
+
+struct CommandRecorder {
+    uint32_t poolsPerFrame; // One per worker, plus one for the main thread
+    ThreadCommandPool *pools; // poolsPerFrame for frame 0, then poolsPerFrame for frame 1...
+
+    RecordingSlice slices[MAX_RECORDING_SLICES];
+};
+
+
+VkCommandBuffer getSecondaryCommandBuffer(InitializingInfo *initInfo, ThreadCommandPool *threadPool) {
+    if (threadPool->commandBuffersUsed == threadPool->commandBuffersCount) {
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+
+            .commandPool = threadPool->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1
+        };
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(initInfo->device, &allocInfo, &commandBuffer) != VK_SUCCESS) { return VK_NULL_HANDLE; }
+
+        threadPool->commandBuffers = realloc(threadPool->commandBuffers, (threadPool->commandBuffersCount + 1) * sizeof(VkCommandBuffer));
+        threadPool->commandBuffers[threadPool->commandBuffersCount++] = commandBuffer;
+    }
+
+    return threadPool->commandBuffers[threadPool->commandBuffersUsed++];
+}
+
+
+void setCanvasViewport(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    // The viewport and scissor are dynamic state in our pipelines, so they follow the canvas's current size without rebuilding the pipelines
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+
+        .width = initInfo->canvasExtent.width,
+        .height = initInfo->canvasExtent.height,
+
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {
+        .offset = { 0, 0 },
+        .extent = initInfo->canvasExtent
+    };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+// Where the slice's draws overlap the count draws starting at start, as a range relative to start
+uint32_t sliceOverlap(const RecordingSlice *slice, uint32_t start, uint32_t count, uint32_t *first) {
+    uint32_t from = slice->firstDraw > start ? slice->firstDraw : start;
+    uint32_t to = slice->firstDraw + slice->drawCount < start + count ? slice->firstDraw + slice->drawCount : start + count;
+
+    *first = from - start;
+    return to > from ? to - from : 0;
+}
+
+// The same commands go into the primary command buffer when recording inline, or into a secondary one per slice
+void recordSceneSlice(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, const RecordingSlice *slice) {
+    const SceneDraws *draws = slice->draws;
+    uint32_t start = 0;
+    uint32_t first;
+
+    // Secondary command buffers don't inherit any state from the primary one, so every slice sets up its own
+    setCanvasViewport(initInfo, commandBuffer);
+
+    // The sand world is the back of the scene, then the tilemap goes under the sprites
+    if (sliceOverlap(slice, start, draws->sandDraws, &first) > 0) { recordSandWorld(initInfo, commandBuffer); }
+    start += draws->sandDraws;
+
+    uint32_t chunks = sliceOverlap(slice, start, draws->tilemapDraws, &first);
+    if (chunks > 0) { recordTilemapChunks(initInfo, commandBuffer, first, chunks); }
+    start += draws->tilemapDraws;
+
+    // All the sprites are one instanced draw, splitting it would only add draw calls
+    if (sliceOverlap(slice, start, draws->spriteDraws, &first) > 0) { recordSpriteBatches(initInfo, commandBuffer); }
+    start += draws->spriteDraws;
+
+    // The particles go on top of everything
+    if (sliceOverlap(slice, start, draws->particleDraws, &first) > 0) { recordParticles(initInfo, commandBuffer); }
+}
+
+void recordSliceJob(void *data) {
+    RecordingSlice *slice = data;
+    InitializingInfo *initInfo = slice->initInfo;
+    CommandRecorder *recorder = initInfo->commandRecorder;
+
+    // Only this thread ever touches its own pool, so there's no locking anywhere in here
+    ThreadCommandPool *threadPool = &recorder->pools[initInfo->currentFrame * recorder->poolsPerFrame + getWorkerIndex(initInfo)];
+
+    slice->result = EXIT_FAILURE;
+    slice->commandBuffer = getSecondaryCommandBuffer(initInfo, threadPool);
+    if (slice->commandBuffer == VK_NULL_HANDLE) { return; }
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+
+        // RENDER_PASS_CONTINUE says this whole command buffer runs inside the render pass described by the inheritance info
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = slice->inheritanceInfo
+    };
+    if (vkBeginCommandBuffer(slice->commandBuffer, &beginInfo) != VK_SUCCESS) { return; }
+
+    recordSceneSlice(initInfo, slice->commandBuffer, slice);
+
+    if (vkEndCommandBuffer(slice->commandBuffer) != VK_SUCCESS) { return; }
+    slice->result = EXIT_SUCCESS;
+}
+
+void recordSliceRange(uint32_t first, uint32_t count, void *data) {
+    RecordingSlice *slices = data;
+
+    for (uint32_t i = first; i < first + count; i++) { recordSliceJob(&slices[i]); }
+}
+
+
+int createCommandRecorder(InitializingInfo *initInfo) {
+    CommandRecorder *recorder = calloc(1, sizeof(CommandRecorder));
+    initInfo->commandRecorder = recorder;
+
+    recorder->poolsPerFrame = getThreadPoolSize(initInfo) + 1;
+    recorder->pools = calloc(recorder->poolsPerFrame * initInfo->maxFramesInFlight, sizeof(ThreadCommandPool));
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+
+        .queueFamilyIndex = initInfo->graphicsQueueFamily,
+        // The buffers only live for one frame before the whole pool gets reset, which is exactly what TRANSIENT hints at
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+    };
+
+    for (int i = 0; i < recorder->poolsPerFrame * initInfo->maxFramesInFlight; i++) {
+        if (vkCreateCommandPool(initInfo->device, &poolInfo, NULL, &recorder->pools[i].pool) != VK_SUCCESS) { return EXIT_FAILURE; }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyCommandRecorder(InitializingInfo *initInfo) {
+    CommandRecorder *recorder = initInfo->commandRecorder;
+    if (recorder == NULL) { return; }
+
+    // Destroying a pool frees every command buffer allocated from it
+    for (int i = 0; i < recorder->poolsPerFrame * initInfo->maxFramesInFlight; i++) {
+        vkDestroyCommandPool(initInfo->device, recorder->pools[i].pool, NULL);
+        free(recorder->pools[i].commandBuffers);
+    }
+
+    free(recorder->pools);
+    free(recorder);
+    initInfo->commandRecorder = NULL;
+}
+
+void resetCommandRecorder(InitializingInfo *initInfo) {
+    CommandRecorder *recorder = initInfo->commandRecorder;
+    if (recorder == NULL) { return; }
+
+    for (int i = 0; i < recorder->poolsPerFrame; i++) {
+        ThreadCommandPool *threadPool = &recorder->pools[initInfo->currentFrame * recorder->poolsPerFrame + i];
+        if (threadPool->commandBuffersUsed == 0) { continue; }
+
+        vkResetCommandPool(initInfo->device, threadPool->pool, 0);
+        threadPool->commandBuffersUsed = 0;
+    }
+}
+
+
+int recordScene(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassInfo, uint32_t *sliceCount, uint32_t *drawCount) {
+    CommandRecorder *recorder = initInfo->commandRecorder;
+    *sliceCount = 0;
+
+    // Working out the visible chunks writes to the tilemap, so it happens here before any other thread gets involved
+    SceneDraws draws = {
+        .sandDraws = initInfo->sand != NULL ? 1 : 0,
+        .tilemapDraws = initInfo->tilemap != NULL ? findTilemapDraws(initInfo) : 0,
+        .spriteDraws = getSpriteBatchStats(initInfo).spriteCount > 0 ? 1 : 0,
+        .particleDraws = initInfo->particles != NULL ? 1 : 0
+    };
+    *drawCount = draws.sandDraws + draws.tilemapDraws + draws.spriteDraws + draws.particleDraws;
+
+    /* The final command specifies how the drawing commands within the render pass will be provided
+    - VK_SUBPASS_CONTENTS_INLINE: the render pass commands will be embedded in the primary command buffer itself and no secondary command buffer will be executed
+    - VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: the render pass commands will be executed from secondary command buffers
+    Scenes with only a few draw calls are quicker to record on this thread, so they use the first option */
+    if (recorder == NULL || *drawCount < PARALLEL_RECORDING_MIN_DRAWS) {
+        vkCmdBeginRenderPass(commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        recordSceneSlice(initInfo, commandBuffer, &(RecordingSlice){ .draws = &draws, .firstDraw = 0, .drawCount = *drawCount });
+        vkCmdEndRenderPass(commandBuffer);
+
+        return EXIT_SUCCESS;
+    }
+
+    // Each slice gets at least half the threshold's worth of draw calls, so the slices are never so small that the overhead takes over
+    uint32_t slices = recorder->poolsPerFrame;
+    uint32_t maxSlicesForDraws = *drawCount / (PARALLEL_RECORDING_MIN_DRAWS / 2);
+    if (slices > maxSlicesForDraws) { slices = maxSlicesForDraws; }
+    if (slices > MAX_RECORDING_SLICES) { slices = MAX_RECORDING_SLICES; }
+    if (slices == 0) { slices = 1; }
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+
+        .renderPass = renderPassInfo->renderPass,
+        .subpass = 0,
+        // Optional, but knowing the framebuffer up front can let the driver optimize the secondary command buffers
+        .framebuffer = renderPassInfo->framebuffer,
+        // The profiler's pipeline statistics query is running around the whole render pass, and the secondaries have to say they count towards it
+        .pipelineStatistics = getProfilerPipelineStatistics(initInfo)
+    };
+
+    uint32_t firstDraw = 0;
+    for (uint32_t i = 0; i < slices; i++) {
+        // Spread the remainder over the first few slices, so no two slices differ by more than one draw call
+        uint32_t count = *drawCount / slices + (i < *drawCount % slices ? 1 : 0);
+
+        recorder->slices[i] = (RecordingSlice){
+            .initInfo = initInfo,
+            .inheritanceInfo = &inheritanceInfo,
+            .draws = &draws,
+            .firstDraw = firstDraw,
+            .drawCount = count
+        };
+        firstDraw += count;
+    }
+
+    // One slice per job, the main thread records the first one itself and steals whatever the workers haven't gotten to yet
+    parallelFor(initInfo, slices, 1, recordSliceRange, recorder->slices);
+
+    VkCommandBuffer secondaryCommandBuffers[MAX_RECORDING_SLICES];
+    for (uint32_t i = 0; i < slices; i++) {
+        if (recorder->slices[i].result == EXIT_FAILURE) { return EXIT_FAILURE; }
+        secondaryCommandBuffers[i] = recorder->slices[i].commandBuffer;
+    }
+
+    // They run in the order they're listed, which keeps the draw order exactly the same as recording inline
+    vkCmdBeginRenderPass(commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, slices, secondaryCommandBuffers);
+    vkCmdEndRenderPass(commandBuffer);
+
+    *sliceCount = slices;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#ifndef COMMAND_RECORDING
+#define COMMAND_RECORDING
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+// Scenes with fewer draw calls than this are recorded straight into the primary command buffer
+// Below it, handing the work to other threads costs more than recording it ourselves
+// How many sprites there are doesn't matter, they're one instanced draw however many there are
+#define PARALLEL_RECORDING_MIN_DRAWS 512
+
+
+// Gives every worker thread (plus the main thread) its own command pool per frame in flight, so nothing is shared between threads while recording
+// Call it after the thread pool has been created
+int createCommandRecorder(InitializingInfo *initInfo);
+void destroyCommandRecorder(InitializingInfo *initInfo);
+
+// Called by beginFrame() once the GPU is done with this frame slot, resets the slot's pools so their command buffers can be recorded again
+void resetCommandRecorder(InitializingInfo *initInfo);
+
+// Records the scene's render pass, everything inside it split into slices recorded into secondary command buffers on the thread pool
+// Falls back to recording inline when there isn't enough to draw to be worth spreading out
+// Returns how many slices it used through sliceCount (0 for inline), and how many draw calls went into them through drawCount
+int recordScene(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassInfo, uint32_t *sliceCount, uint32_t *drawCount);
+
+
+#endif
@@ -0,0 +1,590 @@
+#include "./ecs.h"
+
+#include "../globals/globals.h"
+#include "../thread_pool/thread_pool.h"
+#include "../frame/frame.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+// Entities that don't have any components don't need any storage, so they don't belong to an archetype
+#define NO_ARCHETYPE UINT32_MAX
+
+
+typedef struct {
+    size_t size;
+    const char * name;
+} ComponentInfo;
+
+// The entity handles come first, followed by one array per component, each starting on a 16 byte boundary
+typedef struct {
+    uint8_t *data;
+    uint32_t count;
+} EcsChunk;
+
+// Every entity with exactly the same set of components lives in the same archetype
+// Iterating a component is then just walking a packed array per chunk, with no gaps and nothing else in between
+typedef struct {
+    ComponentMask mask;
+    uint32_t capacity; // Entities per chunk
+    size_t chunkBytes;
+    size_t columnOffsets[MAX_COMPONENTS]; // Indexed by ComponentId, only the ones in mask mean anything
+
+    // Every chunk but the last one is always full, removing an entity moves the very last one into its place
+    EcsChunk *chunks;
+    uint32_t chunksCount;
+    uint32_t chunksCapacity;
+} Archetype;
+
+typedef struct {
+    uint32_t generation;
+    bool alive;
+
+    uint32_t archetype;
+    uint32_t chunk;
+    uint32_t row;
+} EntityRecord;
+
+typedef enum {
+    ECS_COMMAND_DESTROY,
+    ECS_COMMAND_ADD,
+    ECS_COMMAND_REMOVE
+} EcsCommandType;
+
+// The component's value (if there is one) comes right after this, padded out to 8 bytes
+typedef struct {
+    uint32_t type;
+    ComponentId component;
+    Entity entity;
+    uint32_t size;
+    uint32_t padding;
+} EcsCommandHeader;
+
+struct EcsCommands {
+    World *world;
+
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+struct World {
+    ComponentInfo components[MAX_COMPONENTS];
+    uint32_t componentsCount;
+
+    Archetype *archetypes;
+    uint32_t archetypesCount;
+    uint32_t archetypesCapacity;
+
+    // Sized for maxEntities up front so it never moves, which is what lets deferCreateEntity() run on any thread
+    EntityRecord *records;
+    uint32_t maxEntities;
+    uint32_t nextUnusedIndex;
+    uint32_t *freeIndices;
+    uint32_t freeIndicesCount;
+    uint32_t entityCount;
+    // Guards handing out and taking back entity slots
+    SDL_mutex *mutex;
+
+    // One per worker thread plus one for the main thread
+    EcsCommands *commands;
+    uint32_t commandsCount;
+
+    EcsChunkView *views;
+    uint32_t viewsCapacity;
+};
+
+
+size_t alignTo16(size_t value) {
+    return (value + 15) & ~(size_t)15;
+}
+
+Entity *getChunkEntities(EcsChunk *chunk) {
+    return (Entity *)chunk->data;
+}
+
+void *getChunkComponent(World *world, Archetype *archetype, EcsChunk *chunk, ComponentId component, uint32_t row) {
+    return chunk->data + archetype->columnOffsets[component] + (size_t)row * world->components[component].size;
+}
+
+
+// Works out how many entities fit in a chunk and where each component's array starts
+void layOutArchetype(World *world, Archetype *archetype) {
+    size_t bytesPerEntity = sizeof(Entity);
+    uint32_t columns = 0;
+    for (ComponentId c = 0; c < world->componentsCount; c++) {
+        if (archetype->mask & COMPONENT_BIT(c)) {
+            bytesPerEntity += world->components[c].size;
+            columns++;
+        }
+    }
+
+    // Start from the best case and back off until the padding between the arrays fits too
+    uint32_t capacity = ECS_CHUNK_SIZE / bytesPerEntity;
+    if (capacity == 0) { capacity = 1; }
+
+    while (true) {
+        size_t offset = alignTo16(capacity * sizeof(Entity));
+        for (ComponentId c = 0; c < world->componentsCount; c++) {
+            if (!(archetype->mask & COMPONENT_BIT(c))) { continue; }
+
+            archetype->columnOffsets[c] = offset;
+            offset = alignTo16(offset + capacity * world->components[c].size);
+        }
+
+        // A single entity with huge components still gets a chunk, it's just bigger than usual
+        if (offset <= ECS_CHUNK_SIZE || capacity == 1) {
+            archetype->capacity = capacity;
+            archetype->chunkBytes = offset;
+            return;
+        }
+        capacity--;
+    }
+}
+
+uint32_t findOrCreateArchetype(World *world, ComponentMask mask) {
+    for (uint32_t i = 0; i < world->archetypesCount; i++) {
+        if (world->archetypes[i].mask == mask) { return i; }
+    }
+
+    if (world->archetypesCount == world->archetypesCapacity) {
+        world->archetypesCapacity = world->archetypesCapacity == 0 ? 16 : world->archetypesCapacity * 2;
+        world->archetypes = realloc(world->archetypes, world->archetypesCapacity * sizeof(Archetype));
+    }
+
+    Archetype *archetype = &world->archetypes[world->archetypesCount];
+    *archetype = (Archetype){ .mask = mask };
+    layOutArchetype(world, archetype);
+
+    return world->archetypesCount++;
+}
+
+uint32_t allocateRow(World *world, Archetype *archetype, uint32_t *chunkIndex) {
+    if (archetype->chunksCount == 0 || archetype->chunks[archetype->chunksCount - 1].count == archetype->capacity) {
+        if (archetype->chunksCount == archetype->chunksCapacity) {
+            archetype->chunksCapacity = archetype->chunksCapacity == 0 ? 4 : archetype->chunksCapacity * 2;
+            archetype->chunks = realloc(archetype->chunks, archetype->chunksCapacity * sizeof(EcsChunk));
+        }
+
+        archetype->chunks[archetype->chunksCount++] = (EcsChunk){ .data = malloc(archetype->chunkBytes), .count = 0 };
+    }
+
+    *chunkIndex = archetype->chunksCount - 1;
+    return archetype->chunks[*chunkIndex].count++;
+}
+
+// Fills the hole with the archetype's last entity, so the chunks stay packed
+void removeRow(World *world, Archetype *archetype, uint32_t chunkIndex, uint32_t row) {
+    EcsChunk *chunk = &archetype->chunks[chunkIndex];
+    EcsChunk *lastChunk = &archetype->chunks[archetype->chunksCount - 1];
+    uint32_t lastRow = lastChunk->count - 1;
+
+    if (chunk != lastChunk || row != lastRow) {
+        Entity moved = getChunkEntities(lastChunk)[lastRow];
+        getChunkEntities(chunk)[row] = moved;
+
+        for (ComponentId c = 0; c < world->componentsCount; c++) {
+            if (!(archetype->mask & COMPONENT_BIT(c))) { continue; }
+            memcpy(getChunkComponent(world, archetype, chunk, c, row), getChunkComponent(world, archetype, lastChunk, c, lastRow), world->components[c].size);
+        }
+
+        world->records[moved.index].chunk = chunkIndex;
+        world->records[moved.index].row = row;
+    }
+
+    lastChunk->count--;
+    if (lastChunk->count == 0) {
+        free(lastChunk->data);
+        archetype->chunksCount--;
+    }
+}
+
+// Moves the entity into the archetype for mask, keeping the components it already had and zeroing the new ones
+void moveEntity(World *world, uint32_t index, ComponentMask mask) {
+    EntityRecord *record = &world->records[index];
+    ComponentMask oldMask = record->archetype == NO_ARCHETYPE ? 0 : world->archetypes[record->archetype].mask;
+    if (oldMask == mask) { return; }
+
+    if (mask == 0) {
+        removeRow(world, &world->archetypes[record->archetype], record->chunk, record->row);
+        record->archetype = NO_ARCHETYPE;
+        return;
+    }
+
+    // This can grow the archetype array, so no pointers into it are taken before here
+    uint32_t newArchetype = findOrCreateArchetype(world, mask);
+    Archetype *to = &world->archetypes[newArchetype];
+    Archetype *from = record->archetype == NO_ARCHETYPE ? NULL : &world->archetypes[record->archetype];
+
+    uint32_t chunkIndex;
+    uint32_t row = allocateRow(world, to, &chunkIndex);
+    EcsChunk *toChunk = &to->chunks[chunkIndex];
+    getChunkEntities(toChunk)[row] = (Entity){ index, record->generation };
+
+    for (ComponentId c = 0; c < world->componentsCount; c++) {
+        if (!(mask & COMPONENT_BIT(c))) { continue; }
+
+        void *destination = getChunkComponent(world, to, toChunk, c, row);
+        if (oldMask & COMPONENT_BIT(c)) { memcpy(destination, getChunkComponent(world, from, &from->chunks[record->chunk], c, record->row), world->components[c].size); }
+        else { memset(destination, 0, world->components[c].size); }
+    }
+
+    if (from != NULL) { removeRow(world, from, record->chunk, record->row); }
+
+    record->archetype = newArchetype;
+    record->chunk = chunkIndex;
+    record->row = row;
+}
+
+// Returns 0 when every slot is taken
+uint32_t reserveEntityIndex(World *world) {
+    SDL_LockMutex(world->mutex);
+
+    uint32_t index = 0;
+    if (world->freeIndicesCount > 0) { index = world->freeIndices[--world->freeIndicesCount]; }
+    else if (world->nextUnusedIndex < world->maxEntities) { index = world->nextUnusedIndex++; }
+
+    if (index != 0) {
+        EntityRecord *record = &world->records[index];
+        if (record->generation == 0) { record->generation = 1; }
+        record->alive = true;
+        record->archetype = NO_ARCHETYPE;
+        world->entityCount++;
+    }
+
+    SDL_UnlockMutex(world->mutex);
+
+    return index;
+}
+
+
+int createWorld(InitializingInfo *initInfo) {
+    World *world = calloc(1, sizeof(World));
+    initInfo->world = world;
+
+    if (initInfo->maxEntities == 0) { initInfo->maxEntities = DEFAULT_MAX_ENTITIES; }
+
+    // One extra for slot 0, which NULL_ENTITY uses
+    world->maxEntities = initInfo->maxEntities + 1;
+    world->records = calloc(world->maxEntities, sizeof(EntityRecord));
+    world->freeIndices = malloc(world->maxEntities * sizeof(uint32_t));
+    world->nextUnusedIndex = 1;
+    world->mutex = SDL_CreateMutex();
+    if (world->records == NULL || world->freeIndices == NULL || world->mutex == NULL) { return EXIT_FAILURE; }
+
+    world->commandsCount = getThreadPoolSize(initInfo) + 1;
+    world->commands = calloc(world->commandsCount, sizeof(EcsCommands));
+    for (uint32_t i = 0; i < world->commandsCount; i++) { world->commands[i].world = world; }
+
+    // The engine's own components always get the same ids
+    if (registerComponent(initInfo, sizeof(PositionComponent), "position") != POSITION_COMPONENT) { return EXIT_FAILURE; }
+    if (registerComponent(initInfo, sizeof(SpriteComponent), "sprite") != SPRITE_COMPONENT) { return EXIT_FAILURE; }
+    if (registerComponent(initInfo, sizeof(PreviousPositionComponent), "previous position") != PREVIOUS_POSITION_COMPONENT) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyWorld(InitializingInfo *initInfo) {
+    World *world = initInfo->world;
+    if (world == NULL) { return; }
+
+    for (uint32_t i = 0; i < world->archetypesCount; i++) {
+        for (uint32_t j = 0; j < world->archetypes[i].chunksCount; j++) { free(world->archetypes[i].chunks[j].data); }
+        free(world->archetypes[i].chunks);
+    }
+    free(world->archetypes);
+
+    for (uint32_t i = 0; i < world->commandsCount; i++) { free(world->commands[i].data); }
+    free(world->commands);
+
+    SDL_DestroyMutex(world->mutex);
+    free(world->records);
+    free(world->freeIndices);
+    free(world->views);
+    free(world);
+    initInfo->world = NULL;
+}
+
+ComponentId registerComponent(InitializingInfo *initInfo, size_t size, const char * name) {
+    World *world = initInfo->world;
+    if (world->componentsCount == MAX_COMPONENTS) {
+        printf("Can't register the %s component, all %d component ids are taken\n", name, MAX_COMPONENTS);
+        return UINT32_MAX;
+    }
+
+    world->components[world->componentsCount] = (ComponentInfo){ .size = size, .name = name };
+
+    return world->componentsCount++;
+}
+
+
+Entity createEntity(InitializingInfo *initInfo, ComponentMask components) {
+    World *world = initInfo->world;
+
+    uint32_t index = reserveEntityIndex(world);
+    if (index == 0) { return NULL_ENTITY; }
+
+    moveEntity(world, index, components);
+    // Structural changes (including the ones syncWorld() applies) are what tell an idle renderOnDemand loop the scene changed
+    requestRedraw(initInfo);
+
+    return (Entity){ index, world->records[index].generation };
+}
+
+uint32_t createEntities(InitializingInfo *initInfo, ComponentMask components, uint32_t count, Entity *entities) {
+    for (uint32_t i = 0; i < count; i++) {
+        Entity entity = createEntity(initInfo, components);
+        if (entity.index == 0) { return i; }
+
+        if (entities != NULL) { entities[i] = entity; }
+    }
+
+    return count;
+}
+
+void destroyEntity(InitializingInfo *initInfo, Entity entity) {
+    World *world = initInfo->world;
+    if (!isEntityAlive(initInfo, entity)) { return; }
+
+    EntityRecord *record = &world->records[entity.index];
+    if (record->archetype != NO_ARCHETYPE) { removeRow(world, &world->archetypes[record->archetype], record->chunk, record->row); }
+    requestRedraw(initInfo);
+
+    SDL_LockMutex(world->mutex);
+    record->alive = false;
+    record->archetype = NO_ARCHETYPE;
+    // Any handle still holding the old generation is now stale, 0 is skipped so a zeroed handle never matches
+    record->generation = record->generation + 1 == 0 ? 1 : record->generation + 1;
+    world->freeIndices[world->freeIndicesCount++] = entity.index;
+    world->entityCount--;
+    SDL_UnlockMutex(world->mutex);
+}
+
+void *addComponent(InitializingInfo *initInfo, Entity entity, ComponentId component, const void *value) {
+    World *world = initInfo->world;
+    if (!isEntityAlive(initInfo, entity) || component >= world->componentsCount) { return NULL; }
+
+    EntityRecord *record = &world->records[entity.index];
+    ComponentMask mask = record->archetype == NO_ARCHETYPE ? 0 : world->archetypes[record->archetype].mask;
+    moveEntity(world, entity.index, mask | COMPONENT_BIT(component));
+    requestRedraw(initInfo);
+
+    void *data = getComponent(initInfo, entity, component);
+    if (value != NULL) { memcpy(data, value, world->components[component].size); }
+
+    return data;
+}
+
+void removeComponent(InitializingInfo *initInfo, Entity entity, ComponentId component) {
+    World *world = initInfo->world;
+    if (!isEntityAlive(initInfo, entity) || component >= world->componentsCount) { return; }
+
+    EntityRecord *record = &world->records[entity.index];
+    if (record->archetype == NO_ARCHETYPE) { return; }
+
+    moveEntity(world, entity.index, world->archetypes[record->archetype].mask & ~COMPONENT_BIT(component));
+    requestRedraw(initInfo);
+}
+
+bool isEntityAlive(InitializingInfo *initInfo, Entity entity) {
+    World *world = initInfo->world;
+    if (entity.index == 0 || entity.index >= world->maxEntities) { return false; }
+
+    EntityRecord *record = &world->records[entity.index];
+    return record->alive && record->generation == entity.generation;
+}
+
+bool hasComponent(InitializingInfo *initInfo, Entity entity, ComponentId component) {
+    return getComponent(initInfo, entity, component) != NULL;
+}
+
+void *getComponent(InitializingInfo *initInfo, Entity entity, ComponentId component) {
+    World *world = initInfo->world;
+    if (!isEntityAlive(initInfo, entity) || component >= world->componentsCount) { return NULL; }
+
+    EntityRecord *record = &world->records[entity.index];
+    if (record->archetype == NO_ARCHETYPE) { return NULL; }
+
+    Archetype *archetype = &world->archetypes[record->archetype];
+    if (!(archetype->mask & COMPONENT_BIT(component))) { return NULL; }
+
+    return getChunkComponent(world, archetype, &archetype->chunks[record->chunk], component, record->row);
+}
+
+uint32_t getEntityCount(InitializingInfo *initInfo) {
+    return initInfo->world->entityCount;
+}
+
+
+EcsCommands *getEcsCommands(InitializingInfo *initInfo) {
+    return &initInfo->world->commands[getWorkerIndex(initInfo)];
+}
+
+void pushEcsCommand(EcsCommands *commands, EcsCommandType type, Entity entity, ComponentId component, const void *value, uint32_t size) {
+    size_t payload = (size + 7) & ~(size_t)7;
+    size_t needed = commands->size + sizeof(EcsCommandHeader) + payload;
+
+    if (needed > commands->capacity) {
+        commands->capacity = commands->capacity == 0 ? 4096 : commands->capacity;
+        while (commands->capacity < needed) { commands->capacity *= 2; }
+        commands->data = realloc(commands->data, commands->capacity);
+    }
+
+    EcsCommandHeader *header = (EcsCommandHeader *)(commands->data + commands->size);
+    *header = (EcsCommandHeader){ .type = type, .component = component, .entity = entity, .size = value != NULL ? size : 0 };
+    if (value != NULL) { memcpy(header + 1, value, size); }
+
+    commands->size += sizeof(EcsCommandHeader) + (value != NULL ? payload : 0);
+}
+
+Entity deferCreateEntity(EcsCommands *commands) {
+    World *world = commands->world;
+
+    uint32_t index = reserveEntityIndex(world);
+    if (index == 0) { return NULL_ENTITY; }
+
+    return (Entity){ index, world->records[index].generation };
+}
+
+void deferDestroyEntity(EcsCommands *commands, Entity entity) {
+    pushEcsCommand(commands, ECS_COMMAND_DESTROY, entity, 0, NULL, 0);
+}
+
+void deferAddComponent(EcsCommands *commands, Entity entity, ComponentId component, const void *value) {
+    if (component >= commands->world->componentsCount) { return; }
+
+    pushEcsCommand(commands, ECS_COMMAND_ADD, entity, component, value, commands->world->components[component].size);
+}
+
+void deferRemoveComponent(EcsCommands *commands, Entity entity, ComponentId component) {
+    pushEcsCommand(commands, ECS_COMMAND_REMOVE, entity, component, NULL, 0);
+}
+
+size_t nextEcsCommand(const EcsCommandHeader *header) {
+    return sizeof(EcsCommandHeader) + ((header->size + 7) & ~(size_t)7);
+}
+
+void applyEcsCommands(InitializingInfo *initInfo, EcsCommands *commands) {
+    World *world = initInfo->world;
+
+    size_t offset = 0;
+    while (offset < commands->size) {
+        EcsCommandHeader *header = (EcsCommandHeader *)(commands->data + offset);
+
+        if (header->type == ECS_COMMAND_DESTROY) {
+            destroyEntity(initInfo, header->entity);
+            offset += nextEcsCommand(header);
+            continue;
+        }
+
+        // Every add and remove in a row for the same entity is folded into a single move, so spawning something with five components copies it once and not five times
+        Entity entity = header->entity;
+        bool alive = isEntityAlive(initInfo, entity);
+        ComponentMask mask = alive && world->records[entity.index].archetype != NO_ARCHETYPE ? world->archetypes[world->records[entity.index].archetype].mask : 0;
+
+        size_t runStart = offset;
+        while (offset < commands->size) {
+            EcsCommandHeader *next = (EcsCommandHeader *)(commands->data + offset);
+            if (next->type == ECS_COMMAND_DESTROY || next->entity.index != entity.index || next->entity.generation != entity.generation) { break; }
+
+            if (next->type == ECS_COMMAND_ADD) { mask |= COMPONENT_BIT(next->component); }
+            else { mask &= ~COMPONENT_BIT(next->component); }
+
+            offset += nextEcsCommand(next);
+        }
+
+        // Commands for an entity that was destroyed in the meantime are just dropped
+        if (!alive) { continue; }
+        moveEntity(world, entity.index, mask);
+
+        for (size_t o = runStart; o < offset; ) {
+            EcsCommandHeader *command = (EcsCommandHeader *)(commands->data + o);
+            if (command->type == ECS_COMMAND_ADD && command->size > 0 && (mask & COMPONENT_BIT(command->component))) {
+                memcpy(getComponent(initInfo, entity, command->component), command + 1, command->size);
+            }
+
+            o += nextEcsCommand(command);
+        }
+    }
+
+    commands->size = 0;
+}
+
+void syncWorld(InitializingInfo *initInfo) {
+    World *world = initInfo->world;
+
+    for (uint32_t i = 0; i < world->commandsCount; i++) { applyEcsCommands(initInfo, &world->commands[i]); }
+}
+
+
+EcsChunkView beginQuery(InitializingInfo *initInfo, const EcsQuery *query) {
+    EcsChunkView view = { .initInfo = initInfo, .query = query };
+
+    for (uint32_t i = 0; i < query->componentsCount; i++) { view.with |= COMPONENT_BIT(query->components[i]); }
+
+    return view;
+}
+
+bool nextQueryChunk(EcsChunkView *view) {
+    World *world = view->initInfo->world;
+
+    while (view->archetype < world->archetypesCount) {
+        Archetype *archetype = &world->archetypes[view->archetype];
+
+        bool matches = (archetype->mask & view->with) == view->with && (archetype->mask & view->query->without) == 0;
+        if (matches && view->chunk < archetype->chunksCount) {
+            EcsChunk *chunk = &archetype->chunks[view->chunk++];
+
+            view->count = chunk->count;
+            view->entities = getChunkEntities(chunk);
+            for (uint32_t i = 0; i < view->query->componentsCount; i++) {
+                view->columns[i] = chunk->data + archetype->columnOffsets[view->query->components[i]];
+            }
+
+            return true;
+        }
+
+        view->archetype++;
+        view->chunk = 0;
+    }
+
+    return false;
+}
+
+typedef struct {
+    EcsChunkView *views;
+    EcsChunkFunction function;
+    void *userData;
+} EcsChunkJob;
+
+void runEcsChunkJob(uint32_t first, uint32_t count, void *data) {
+    EcsChunkJob *job = data;
+
+    for (uint32_t i = first; i < first + count; i++) { job->function(&job->views[i], job->userData); }
+}
+
+void forEachChunkParallel(InitializingInfo *initInfo, const EcsQuery *query, EcsChunkFunction function, void *userData) {
+    World *world = initInfo->world;
+
+    // Grab every matching chunk up front
+    uint32_t viewsCount = 0;
+    EcsChunkView view = beginQuery(initInfo, query);
+    while (nextQueryChunk(&view)) {
+        if (viewsCount == world->viewsCapacity) {
+            world->viewsCapacity = world->viewsCapacity == 0 ? 256 : world->viewsCapacity * 2;
+            world->views = realloc(world->views, world->viewsCapacity * sizeof(EcsChunkView));
+        }
+
+        world->views[viewsCount++] = view;
+    }
+
+    // Then deal them out a few at a time, the calling thread takes a share too
+    EcsChunkJob job = { .views = world->views, .function = function, .userData = userData };
+    parallelFor(initInfo, viewsCount, 0, runEcsChunkJob, &job);
+}
@@ -0,0 +1,125 @@
+#ifndef ECS
+#define ECS
+
+#include "../globals/globals.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Every component type gets a bit in a 64 bit mask, and an entity's mask decides which archetype it lives in
+#define MAX_COMPONENTS 64
+// How many components one query can ask for
+#define MAX_QUERY_COMPONENTS 8
+// Every archetype stores its entities in chunks of this many bytes, with one tightly packed array per component inside each chunk
+#define ECS_CHUNK_SIZE (16 * 1024)
+
+typedef uint32_t ComponentId;
+typedef uint64_t ComponentMask;
+#define COMPONENT_BIT(component) ((ComponentMask)1 << (component))
+
+// The index picks the entity's slot and the generation goes up every time the slot is reused
+// so a handle to a destroyed entity never ends up pointing at whatever took its place
+typedef struct {
+    uint32_t index;
+    uint32_t generation;
+} Entity;
+// Slot 0 is never handed out, so a zeroed Entity is always invalid
+#define NULL_ENTITY ((Entity){ 0, 0 })
+
+
+// The components the engine itself reads, registered by createWorld() so their ids are always the same
+#define POSITION_COMPONENT 0
+#define SPRITE_COMPONENT 1
+#define PREVIOUS_POSITION_COMPONENT 2
+
+typedef struct {
+    float x, y; // Top left corner in canvas pixels
+} PositionComponent;
+
+// Where the entity was as of the last simulation tick, see savePreviousPositions() in timestep.h
+// Entities that have one are drawn part of the way between the two, so movement looks smooth at any frame rate
+typedef PositionComponent PreviousPositionComponent;
+
+// Drawn by addSpriteComponents() for every entity that also has a PositionComponent
+typedef struct {
+    float width, height;
+    float u0, v0, u1, v1;
+    uint32_t tint; // RGBA with 8 bits per channel, red in the lowest byte
+    float layer;
+    uint32_t textureId;
+} SpriteComponent;
+
+
+// Matches every entity that has all of components and none of without
+// The columns handed back are in the same order as components
+typedef struct {
+    ComponentId components[MAX_QUERY_COMPONENTS];
+    uint32_t componentsCount;
+    ComponentMask without;
+} EcsQuery;
+
+// One chunk's worth of matching entities, columns[i] is a plain array of count components of type query->components[i]
+typedef struct {
+    uint32_t count;
+    Entity *entities;
+    void *columns[MAX_QUERY_COMPONENTS];
+
+    // Where nextQueryChunk() is up to, don't touch
+    InitializingInfo *initInfo;
+    const EcsQuery *query;
+    ComponentMask with;
+    uint32_t archetype;
+    uint32_t chunk;
+} EcsChunkView;
+
+typedef void (*EcsChunkFunction)(EcsChunkView *view, void *userData);
+
+// Structural changes recorded while iterating, applied all at once by syncWorld()
+// Every thread gets its own, so jobs can record into them without any locking
+typedef struct EcsCommands EcsCommands;
+
+
+// Call it after the thread pool has been created. Holds up to initInfo->maxEntities entities, or DEFAULT_MAX_ENTITIES if that's 0
+int createWorld(InitializingInfo *initInfo);
+void destroyWorld(InitializingInfo *initInfo);
+
+// Returns UINT32_MAX once all MAX_COMPONENTS are taken. size should be a multiple of 4 so the columns stay aligned for SIMD
+ComponentId registerComponent(InitializingInfo *initInfo, size_t size, const char * name);
+
+// Immediate structural changes, these move entities between chunks so they can't be used while iterating a query
+// New components start out zeroed
+Entity createEntity(InitializingInfo *initInfo, ComponentMask components);
+// Creates count entities with the same components in one go, entities can be NULL if the handles aren't needed
+uint32_t createEntities(InitializingInfo *initInfo, ComponentMask components, uint32_t count, Entity *entities);
+void destroyEntity(InitializingInfo *initInfo, Entity entity);
+void *addComponent(InitializingInfo *initInfo, Entity entity, ComponentId component, const void *value);
+void removeComponent(InitializingInfo *initInfo, Entity entity, ComponentId component);
+
+bool isEntityAlive(InitializingInfo *initInfo, Entity entity);
+bool hasComponent(InitializingInfo *initInfo, Entity entity, ComponentId component);
+// Only valid until the next structural change, NULL if the entity doesn't have the component
+void *getComponent(InitializingInfo *initInfo, Entity entity, ComponentId component);
+uint32_t getEntityCount(InitializingInfo *initInfo);
+
+// The calling thread's command buffer
+EcsCommands *getEcsCommands(InitializingInfo *initInfo);
+// The entity is alive as soon as this returns, but it has no components until the next syncWorld()
+Entity deferCreateEntity(EcsCommands *commands);
+void deferDestroyEntity(EcsCommands *commands, Entity entity);
+void deferAddComponent(EcsCommands *commands, Entity entity, ComponentId component, const void *value);
+void deferRemoveComponent(EcsCommands *commands, Entity entity, ComponentId component);
+// The sync point, applies every thread's commands in order. Has to be called from the main thread while nothing is iterating
+// Back to back adds and removes on the same entity only move it to another chunk once
+void syncWorld(InitializingInfo *initInfo);
+
+// while (nextQueryChunk(&view)) { ... } walks every chunk with matching entities, skipping empty ones
+EcsChunkView beginQuery(InitializingInfo *initInfo, const EcsQuery *query);
+bool nextQueryChunk(EcsChunkView *view);
+// Same thing, but the chunks are spread over the thread pool and this only returns once they're all done
+// function can read and write its own chunk's columns and record into getEcsCommands(), and nothing else in the world
+void forEachChunkParallel(InitializingInfo *initInfo, const EcsQuery *query, EcsChunkFunction function, void *userData);
+
+
+#endif
@@ -0,0 +1,968 @@
+#include "./falling_sand.h"
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+#include "../pipeline_cache/pipeline_cache.h"
+#include "../shaders/shaders.h"
+#include "../thread_pool/thread_pool.h"
+#include "../frame/frame.h"
+#include "../software_renderer/software_renderer.h"
+
+#include <vulkan/vulkan.h>
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+/*
+Every cell is one byte: the material in the low 6 bits and a shade in the top 2, which moves along with the cell so grains keep their look as they fall
+The cells are laid out row by row exactly like the texture they're drawn from, so uploading a rectangle is just copying its rows
+
+Updating chunks in parallel is safe because of how far a cell can reach: a cell only ever reads or moves up to SAND_WATER_SPREAD cells away,
+which never gets past the neighbouring chunk. Every step runs four passes, one per corner of each 2x2 block of chunks,
+so chunks updated at the same time are always two chunks apart and the cells they reach into never overlap
+The one thing two chunks in the same pass can both touch is a shared neighbour's dirty rectangles, which is why those are atomics
+
+A cell that moves is stamped with the step, so a grain that falls into a chunk that's updated later in the same step doesn't get moved twice
+Stamps are 16 bits and wrap every 65535 steps, so they're all cleared whenever that happens
+Otherwise a cell that last moved exactly a multiple of 65535 steps ago would look like it had already moved this step
+
+The software renderer has no texture to keep up to date, it looks every visible cell up in a palette built from the same colors as sand.frag
+*/
+
+#define SAND_MATERIAL_MASK 0x3F
+// Stamps go from 1 up to this, 0 is a cell that hasn't moved since the last time they were cleared
+#define SAND_STAMP_PERIOD 65535
+#define SAND_SHADE_SHIFT 6
+// How far water looks sideways for somewhere to flow, has to stay well under half of SAND_CHUNK_SIZE (see above)
+#define SAND_WATER_SPREAD 4
+// Matches the PushConstants block in sand.frag
+typedef struct {
+    int32_t camera[2];
+} SandPushConstants;
+
+// In world cells, inclusive, and empty when minX > maxX
+typedef struct {
+    int32_t minX, minY, maxX, maxY;
+} SandRect;
+
+typedef struct {
+    SDL_atomic_t minX, minY, maxX, maxY;
+} AtomicSandRect;
+
+typedef struct {
+    // The cells to look at this step, only touched by the thread updating the chunk
+    SandRect awake;
+    // Grown by this chunk and its neighbours as cells move, becomes awake at the start of the next step
+    AtomicSandRect nextAwake;
+    // Everything that changed since the last upload
+    AtomicSandRect changed;
+
+    // Set by whoever first grows nextAwake or changed, so every chunk goes in each list at most once
+    SDL_atomic_t wokenQueued;
+    SDL_atomic_t changedQueued;
+} SandChunk;
+
+// What a chunk's update collects before merging it into the shared rectangles in one go, indexed by neighbour from [0][0] (up left) to [2][2]
+typedef struct {
+    SandWorld *world;
+    int32_t chunkX, chunkY;
+    uint32_t random;
+    uint16_t stamp;
+
+    SandRect wake[3][3];
+    SandRect changed[3][3];
+    uint64_t cellsMoved;
+} SandChunkUpdate;
+
+struct SandWorld {
+    SandWorldInfo info;
+    uint8_t *cells;
+    uint16_t *stamps;
+    uint64_t step;
+
+    uint32_t chunksX, chunksY;
+    uint32_t chunkCount;
+    SandChunk *chunks;
+
+    // Chunks that something woke up for next step, and the ones being stepped right now split up by pass
+    uint32_t *wokenChunks;
+    SDL_atomic_t wokenCount;
+    uint32_t *awakeChunks;
+    uint32_t passStart[5];
+    // Chunks with changes that haven't been uploaded yet
+    uint32_t *changedChunks;
+    SDL_atomic_t changedCount;
+
+    // One per thread indexed by getWorkerIndex(), summed up at the end of the step
+    uint64_t *cellsVisited;
+    uint64_t *cellsMoved;
+
+    // One texel per cell, only ever written by this module's copies on the graphics queue
+    VkImage image;
+    GpuAllocation imageMemory;
+    VkImageView imageView;
+    VkSampler sampler;
+    bool imageInitialized;
+
+    // One staging buffer per frame in flight, big enough for every cell plus the padding between rectangles
+    VkBuffer *stagingBuffers;
+    GpuAllocation *stagingMemory;
+    VkDeviceSize stagingSize;
+    VkBufferImageCopy *regions;
+
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet set;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+
+    // Software renderer only, what every possible cell byte looks like as a 0xAARRGGBB canvas color
+    uint32_t palette[256];
+
+    int32_t cameraX, cameraY;
+
+    SandStats stats;
+};
+
+
+SandRect emptySandRect() {
+    return (SandRect){ .minX = INT32_MAX, .minY = INT32_MAX, .maxX = INT32_MIN, .maxY = INT32_MIN };
+}
+
+void growSandRect(SandRect *rect, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY) {
+    if (minX < rect->minX) { rect->minX = minX; }
+    if (minY < rect->minY) { rect->minY = minY; }
+    if (maxX > rect->maxX) { rect->maxX = maxX; }
+    if (maxY > rect->maxY) { rect->maxY = maxY; }
+}
+
+void lowerAtomic(SDL_atomic_t *atomic, int value) {
+    int old;
+    do {
+        old = SDL_AtomicGet(atomic);
+        if (old <= value) { return; }
+    } while (!SDL_AtomicCAS(atomic, old, value));
+}
+
+void raiseAtomic(SDL_atomic_t *atomic, int value) {
+    int old;
+    do {
+        old = SDL_AtomicGet(atomic);
+        if (old >= value) { return; }
+    } while (!SDL_AtomicCAS(atomic, old, value));
+}
+
+void clearAtomicSandRect(AtomicSandRect *rect) {
+    SDL_AtomicSet(&rect->minX, INT32_MAX);
+    SDL_AtomicSet(&rect->minY, INT32_MAX);
+    SDL_AtomicSet(&rect->maxX, INT32_MIN);
+    SDL_AtomicSet(&rect->maxY, INT32_MIN);
+}
+
+// Hands back what was in it and leaves it empty, only while nothing else is growing it
+SandRect takeAtomicSandRect(AtomicSandRect *rect) {
+    SandRect taken = {
+        .minX = SDL_AtomicGet(&rect->minX),
+        .minY = SDL_AtomicGet(&rect->minY),
+        .maxX = SDL_AtomicGet(&rect->maxX),
+        .maxY = SDL_AtomicGet(&rect->maxY)
+    };
+    clearAtomicSandRect(rect);
+
+    return taken;
+}
+
+// Grows both of a chunk's shared rectangles and queues the chunk the first time either of them gets something in it
+void mergeSandRects(SandWorld *world, uint32_t chunkIndex, const SandRect *wake, const SandRect *changed) {
+    SandChunk *chunk = &world->chunks[chunkIndex];
+
+    if (wake->minX <= wake->maxX) {
+        lowerAtomic(&chunk->nextAwake.minX, wake->minX);
+        lowerAtomic(&chunk->nextAwake.minY, wake->minY);
+        raiseAtomic(&chunk->nextAwake.maxX, wake->maxX);
+        raiseAtomic(&chunk->nextAwake.maxY, wake->maxY);
+        if (SDL_AtomicCAS(&chunk->wokenQueued, 0, 1)) { world->wokenChunks[SDL_AtomicAdd(&world->wokenCount, 1)] = chunkIndex; }
+    }
+
+    if (changed->minX <= changed->maxX) {
+        lowerAtomic(&chunk->changed.minX, changed->minX);
+        lowerAtomic(&chunk->changed.minY, changed->minY);
+        raiseAtomic(&chunk->changed.maxX, changed->maxX);
+        raiseAtomic(&chunk->changed.maxY, changed->maxY);
+        if (SDL_AtomicCAS(&chunk->changedQueued, 0, 1)) { world->changedChunks[SDL_AtomicAdd(&world->changedCount, 1)] = chunkIndex; }
+    }
+}
+
+// Splits a rectangle of cells up by chunk, into a SandChunkUpdate's 3x3 neighbourhood of rectangles
+// update is NULL to merge straight into the chunks instead, which is what edits from the main thread do
+void spreadSandRect(SandWorld *world, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, bool wake, SandChunkUpdate *update) {
+    minX = minX < 0 ? 0 : minX;
+    minY = minY < 0 ? 0 : minY;
+    maxX = maxX >= (int32_t)world->info.width ? (int32_t)world->info.width - 1 : maxX;
+    maxY = maxY >= (int32_t)world->info.height ? (int32_t)world->info.height - 1 : maxY;
+    if (minX > maxX || minY > maxY) { return; }
+
+    for (int32_t chunkY = minY / SAND_CHUNK_SIZE; chunkY <= maxY / SAND_CHUNK_SIZE; chunkY++) {
+        for (int32_t chunkX = minX / SAND_CHUNK_SIZE; chunkX <= maxX / SAND_CHUNK_SIZE; chunkX++) {
+            SandRect part = {
+                .minX = minX > chunkX * SAND_CHUNK_SIZE ? minX : chunkX * SAND_CHUNK_SIZE,
+                .minY = minY > chunkY * SAND_CHUNK_SIZE ? minY : chunkY * SAND_CHUNK_SIZE,
+                .maxX = maxX < (chunkX + 1) * SAND_CHUNK_SIZE - 1 ? maxX : (chunkX + 1) * SAND_CHUNK_SIZE - 1,
+                .maxY = maxY < (chunkY + 1) * SAND_CHUNK_SIZE - 1 ? maxY : (chunkY + 1) * SAND_CHUNK_SIZE - 1
+            };
+
+            if (update == NULL) {
+                SandRect empty = emptySandRect();
+                mergeSandRects(world, chunkY * world->chunksX + chunkX, wake ? &part : &empty, wake ? &empty : &part);
+                continue;
+            }
+
+            SandRect *rects = wake ? &update->wake[chunkY - update->chunkY + 1][chunkX - update->chunkX + 1] : &update->changed[chunkY - update->chunkY + 1][chunkX - update->chunkX + 1];
+            growSandRect(rects, part.minX, part.minY, part.maxX, part.maxY);
+        }
+    }
+}
+
+// The cells themselves changed, and everything next to them might be able to move now
+void markSandChanged(SandWorld *world, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, SandChunkUpdate *update) {
+    spreadSandRect(world, minX, minY, maxX, maxY, false, update);
+    spreadSandRect(world, minX - 1, minY - 1, maxX + 1, maxY + 1, true, update);
+}
+
+
+uint32_t nextSandRandom(SandChunkUpdate *update) {
+    // xorshift32, seeded per chunk and step so the result doesn't depend on which thread got which chunk
+    uint32_t x = update->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    update->random = x;
+
+    return x;
+}
+
+void swapSandCells(SandChunkUpdate *update, int32_t ax, int32_t ay, int32_t bx, int32_t by) {
+    SandWorld *world = update->world;
+    uint32_t a = ay * world->info.width + ax;
+    uint32_t b = by * world->info.width + bx;
+
+    uint8_t cell = world->cells[a];
+    world->cells[a] = world->cells[b];
+    world->cells[b] = cell;
+    world->stamps[a] = update->stamp;
+    world->stamps[b] = update->stamp;
+
+    markSandChanged(world, ax < bx ? ax : bx, ay < by ? ay : by, ax > bx ? ax : bx, ay > by ? ay : by, update);
+    update->cellsMoved++;
+}
+
+// Walls of stone all around the world, so nothing ever falls out of it
+uint8_t readSandMaterial(const SandWorld *world, int32_t x, int32_t y) {
+    if (x < 0 || y < 0 || x >= (int32_t)world->info.width || y >= (int32_t)world->info.height) { return SAND_STONE; }
+
+    return world->cells[y * world->info.width + x] & SAND_MATERIAL_MASK;
+}
+
+void updateSandGrain(SandChunkUpdate *update, int32_t x, int32_t y) {
+    // Sand swaps places with water, which is how it sinks through it
+    uint8_t below = readSandMaterial(update->world, x, y + 1);
+    if (below == SAND_EMPTY || below == SAND_WATER) {
+        swapSandCells(update, x, y, x, y + 1);
+        return;
+    }
+
+    // Picking a side at random keeps piles from leaning one way
+    int32_t side = nextSandRandom(update) & 1 ? 1 : -1;
+    for (int i = 0; i < 2; i++, side = -side) {
+        uint8_t diagonal = readSandMaterial(update->world, x + side, y + 1);
+        if (diagonal == SAND_EMPTY || diagonal == SAND_WATER) {
+            swapSandCells(update, x, y, x + side, y + 1);
+            return;
+        }
+    }
+}
+
+void updateSandWater(SandChunkUpdate *update, int32_t x, int32_t y) {
+    if (readSandMaterial(update->world, x, y + 1) == SAND_EMPTY) {
+        swapSandCells(update, x, y, x, y + 1);
+        return;
+    }
+
+    int32_t side = nextSandRandom(update) & 1 ? 1 : -1;
+    for (int i = 0; i < 2; i++, side = -side) {
+        if (readSandMaterial(update->world, x + side, y + 1) == SAND_EMPTY) {
+            swapSandCells(update, x, y, x + side, y + 1);
+            return;
+        }
+    }
+
+    // Nowhere to fall, so flow as far sideways as there's room for
+    for (int i = 0; i < 2; i++, side = -side) {
+        int32_t distance = 0;
+        while (distance < SAND_WATER_SPREAD && readSandMaterial(update->world, x + side * (distance + 1), y) == SAND_EMPTY) { distance++; }
+
+        if (distance > 0) {
+            swapSandCells(update, x, y, x + side * distance, y);
+            return;
+        }
+    }
+}
+
+// Which of the four passes a chunk is updated in, by which corner of its 2x2 block it's in
+uint32_t sandChunkPass(const SandWorld *world, uint32_t chunkIndex) {
+    return (chunkIndex % world->chunksX & 1) | (chunkIndex / world->chunksX & 1) << 1;
+}
+
+void updateSandChunk(InitializingInfo *initInfo, uint32_t chunkIndex) {
+    SandWorld *world = initInfo->sand;
+    SandChunk *chunk = &world->chunks[chunkIndex];
+    SandRect rect = chunk->awake;
+
+    SandChunkUpdate update = {
+        .world = world,
+        .chunkX = chunkIndex % world->chunksX,
+        .chunkY = chunkIndex / world->chunksX,
+        .random = ((uint32_t)(world->step * 0x9E3779B9u) ^ chunkIndex * 0x85EBCA6Bu) | 1,
+        .stamp = (uint16_t)(world->step % SAND_STAMP_PERIOD + 1)
+    };
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 3; x++) {
+            update.wake[y][x] = emptySandRect();
+            update.changed[y][x] = emptySandRect();
+        }
+    }
+
+    // Bottom up so a falling column moves as one, and alternating sideways so nothing drifts in the direction we scan
+    bool leftToRight = world->step & 1;
+    for (int32_t y = rect.maxY; y >= rect.minY; y--) {
+        for (int32_t i = 0; i <= rect.maxX - rect.minX; i++) {
+            int32_t x = leftToRight ? rect.minX + i : rect.maxX - i;
+            uint32_t index = y * world->info.width + x;
+
+            uint8_t material = world->cells[index] & SAND_MATERIAL_MASK;
+            if (material == SAND_EMPTY || material == SAND_STONE) { continue; }
+            if (world->stamps[index] == update.stamp) { continue; }
+
+            if (material == SAND_SAND) { updateSandGrain(&update, x, y); }
+            else if (material == SAND_WATER) { updateSandWater(&update, x, y); }
+        }
+    }
+
+    // Whatever didn't move isn't in any of these, so a chunk where nothing happened doesn't wake up next step
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 3; x++) {
+            int32_t neighbourX = update.chunkX + x - 1;
+            int32_t neighbourY = update.chunkY + y - 1;
+            if (neighbourX < 0 || neighbourY < 0 || neighbourX >= (int32_t)world->chunksX || neighbourY >= (int32_t)world->chunksY) { continue; }
+
+            mergeSandRects(world, neighbourY * world->chunksX + neighbourX, &update.wake[y][x], &update.changed[y][x]);
+        }
+    }
+
+    uint32_t worker = getWorkerIndex(initInfo);
+    world->cellsVisited[worker] += (uint64_t)(rect.maxX - rect.minX + 1) * (rect.maxY - rect.minY + 1);
+    world->cellsMoved[worker] += update.cellsMoved;
+}
+
+typedef struct {
+    InitializingInfo *initInfo;
+    uint32_t *chunks;
+} SandPass;
+
+void updateSandChunks(uint32_t first, uint32_t count, void *data) {
+    const SandPass *pass = data;
+
+    for (uint32_t i = first; i < first + count; i++) { updateSandChunk(pass->initInfo, pass->chunks[i]); }
+}
+
+
+void stepSandWorld(InitializingInfo *initInfo) {
+    SandWorld *world = initInfo->sand;
+    Uint64 start = SDL_GetPerformanceCounter();
+    world->step++;
+    if (world->step % SAND_STAMP_PERIOD == 0) { memset(world->stamps, 0, (size_t)world->info.width * world->info.height * sizeof(uint16_t)); }
+
+    // Only the chunks something woke up get looked at, the rest of the world isn't even iterated over
+    uint32_t awakeCount = SDL_AtomicGet(&world->wokenCount);
+    uint32_t passCounts[4] = { 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < awakeCount; i++) {
+        uint32_t chunkIndex = world->wokenChunks[i];
+        SandChunk *chunk = &world->chunks[chunkIndex];
+
+        chunk->awake = takeAtomicSandRect(&chunk->nextAwake);
+        SDL_AtomicSet(&chunk->wokenQueued, 0);
+        passCounts[sandChunkPass(world, chunkIndex)]++;
+    }
+
+    // A counting sort by pass, so each pass is one contiguous run to hand to parallelFor()
+    world->passStart[0] = 0;
+    for (int pass = 0; pass < 4; pass++) { world->passStart[pass + 1] = world->passStart[pass] + passCounts[pass]; }
+    uint32_t passFill[4] = { world->passStart[0], world->passStart[1], world->passStart[2], world->passStart[3] };
+    for (uint32_t i = 0; i < awakeCount; i++) {
+        uint32_t chunkIndex = world->wokenChunks[i];
+        world->awakeChunks[passFill[sandChunkPass(world, chunkIndex)]++] = chunkIndex;
+    }
+    SDL_AtomicSet(&world->wokenCount, 0);
+
+    uint32_t threadCount = getThreadPoolSize(initInfo) + 1;
+    memset(world->cellsVisited, 0, threadCount * sizeof(uint64_t));
+    memset(world->cellsMoved, 0, threadCount * sizeof(uint64_t));
+
+    // parallelFor() only returns once the whole pass is done, which is the barrier between passes
+    for (int pass = 0; pass < 4; pass++) {
+        SandPass sandPass = {
+            .initInfo = initInfo,
+            .chunks = world->awakeChunks + world->passStart[pass]
+        };
+        uint32_t count = world->passStart[pass + 1] - world->passStart[pass];
+        if (count > 0) { parallelFor(initInfo, count, 1, updateSandChunks, &sandPass); }
+    }
+
+    world->stats.chunksAwake = awakeCount;
+    world->stats.cellsVisited = 0;
+    world->stats.cellsMoved = 0;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        world->stats.cellsVisited += world->cellsVisited[i];
+        world->stats.cellsMoved += world->cellsMoved[i];
+    }
+    world->stats.stepMs = elapsedMilliseconds(start);
+
+    // A settled world changes nothing, so with renderOnDemand it doesn't keep asking for frames either
+    if (SDL_AtomicGet(&world->changedCount) > 0) { requestRedraw(initInfo); }
+}
+
+
+SandMaterial getSandCell(InitializingInfo *initInfo, int32_t x, int32_t y) {
+    return readSandMaterial(initInfo->sand, x, y);
+}
+
+void setSandCell(InitializingInfo *initInfo, int32_t x, int32_t y, SandMaterial material) {
+    fillSandRect(initInfo, x, y, 1, 1, material);
+}
+
+void fillSandRect(InitializingInfo *initInfo, int32_t x, int32_t y, int32_t width, int32_t height, SandMaterial material) {
+    SandWorld *world = initInfo->sand;
+
+    int32_t minX = x < 0 ? 0 : x;
+    int32_t minY = y < 0 ? 0 : y;
+    int32_t maxX = x + width > (int32_t)world->info.width ? (int32_t)world->info.width - 1 : x + width - 1;
+    int32_t maxY = y + height > (int32_t)world->info.height ? (int32_t)world->info.height - 1 : y + height - 1;
+    if (minX > maxX || minY > maxY) { return; }
+
+    for (int32_t cellY = minY; cellY <= maxY; cellY++) {
+        for (int32_t cellX = minX; cellX <= maxX; cellX++) {
+            // A shade scrambled from the position, so a freshly poured pile doesn't look like one flat color
+            uint8_t shade = (uint8_t)(((uint32_t)cellX * 73856093u ^ (uint32_t)cellY * 19349663u) >> 7 & 3);
+            world->cells[cellY * world->info.width + cellX] = (uint8_t)material | shade << SAND_SHADE_SHIFT;
+        }
+    }
+
+    markSandChanged(world, minX, minY, maxX, maxY, NULL);
+    requestRedraw(initInfo);
+}
+
+
+int createSandImage(InitializingInfo *initInfo, SandWorld *world) {
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+
+        .imageType = VK_IMAGE_TYPE_2D,
+        // The raw cell bytes, the fragment shader turns them into colors
+        .format = VK_FORMAT_R8_UINT,
+        .extent = { .width = world->info.width, .height = world->info.height, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (vkCreateImage(initInfo->device, &imageInfo, NULL, &world->image) != VK_SUCCESS) { return EXIT_FAILURE; }
+    if (allocateImageMemory(initInfo, world->image, imageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &world->imageMemory) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+
+        .image = world->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = imageInfo.format,
+
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1
+    };
+    if (vkCreateImageView(initInfo->device, &viewInfo, NULL, &world->imageView) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // The shader only uses texelFetch(), but a combined image sampler still needs a sampler. Integer formats can't be filtered anyway
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f
+    };
+    if (vkCreateSampler(initInfo->device, &samplerInfo, NULL, &world->sampler) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // Every rectangle starts 4 byte aligned like vkCmdCopyBufferToImage() wants, which wastes at most 3 bytes per chunk
+    world->stagingSize = (VkDeviceSize)world->info.width * world->info.height + (VkDeviceSize)world->chunkCount * 4;
+    world->stagingBuffers = calloc(initInfo->maxFramesInFlight, sizeof(VkBuffer));
+    world->stagingMemory = calloc(initInfo->maxFramesInFlight, sizeof(GpuAllocation));
+    for (uint32_t i = 0; i < initInfo->maxFramesInFlight; i++) {
+        VkBufferCreateInfo bufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+
+            .size = world->stagingSize,
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+        };
+        if (vkCreateBuffer(initInfo->device, &bufferInfo, NULL, &world->stagingBuffers[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+        if (allocateBufferMemory(initInfo, world->stagingBuffers[i], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, &world->stagingMemory[i]) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        if (world->stagingMemory[i].mapped == NULL) { return EXIT_FAILURE; }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int createSandPipeline(InitializingInfo *initInfo, SandWorld *world) {
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+
+        .bindingCount = 1,
+        .pBindings = &binding
+    };
+    if (vkCreateDescriptorSetLayout(initInfo->device, &layoutInfo, NULL, &world->setLayout) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
+    };
+    if (vkCreateDescriptorPool(initInfo->device, &poolInfo, NULL, &world->descriptorPool) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+
+        .descriptorPool = world->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &world->setLayout
+    };
+    if (vkAllocateDescriptorSets(initInfo->device, &allocInfo, &world->set) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // The image is only ever updated in place, so the set never changes after this
+    VkDescriptorImageInfo imageInfo = {
+        .sampler = world->sampler,
+        .imageView = world->imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+
+        .dstSet = world->set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo
+    };
+    vkUpdateDescriptorSets(initInfo->device, 1, &write, 0, NULL);
+
+    VkShaderModule vertShaderModule = loadShaderModule(initInfo, "sand.vert");
+    VkShaderModule fragShaderModule = loadShaderModule(initInfo, "sand.frag");
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE) {
+        // Only one of them might have loaded, and destroying a null module does nothing
+        vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+        vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+        return EXIT_FAILURE;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertShaderModule,
+            .pName = "main"
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragShaderModule,
+            .pName = "main"
+        }
+    };
+
+    // One triangle big enough to cover the canvas, made up from gl_VertexIndex
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+
+        .vertexBindingDescriptionCount = 0,
+        .vertexAttributeDescriptionCount = 0
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+
+        .viewportCount = 1,
+        .scissorCount = 1
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .minSampleShading = 1.0f
+    };
+
+    // Water is see through, everything else is opaque and empty cells are discarded
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment
+    };
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
+    };
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(SandPushConstants)
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+
+        .setLayoutCount = 1,
+        .pSetLayouts = &world->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    if (vkCreatePipelineLayout(initInfo->device, &pipelineLayoutInfo, NULL, &world->pipelineLayout) != VK_SUCCESS) {
+        vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+        vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+        return EXIT_FAILURE;
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+
+        .stageCount = 2,
+        .pStages = shaderStages,
+
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = NULL,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+
+        .layout = world->pipelineLayout,
+
+        .renderPass = initInfo->renderPass,
+        .subpass = 0,
+
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+
+    VkResult result = createGraphicsPipelineCached(initInfo, "sand", &pipelineInfo, &world->pipeline);
+
+    vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+    vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+
+    if (result != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+
+// Matches MATERIAL_COLORS and the shading in sand.frag, with SAND_EMPTY fully see-through
+void buildSandPalette(SandWorld *world) {
+    const float colors[4][4] = {
+        { 0.0f, 0.0f, 0.0f, 0.0f },
+        { 0.38f, 0.36f, 0.35f, 1.0f },
+        { 0.87f, 0.73f, 0.45f, 1.0f },
+        { 0.20f, 0.42f, 0.86f, 0.75f }
+    };
+
+    for (uint32_t value = 0; value < 256; value++) {
+        uint32_t material = value & SAND_MATERIAL_MASK;
+        material = material < 3 ? material : 3;
+        float shade = 1.0f - (float)(value >> SAND_SHADE_SHIFT) * 0.06f;
+
+        uint32_t red = (uint32_t)(colors[material][0] * shade * 255.0f + 0.5f);
+        uint32_t green = (uint32_t)(colors[material][1] * shade * 255.0f + 0.5f);
+        uint32_t blue = (uint32_t)(colors[material][2] * shade * 255.0f + 0.5f);
+        uint32_t alpha = (uint32_t)(colors[material][3] * 255.0f + 0.5f);
+        world->palette[value] = material == SAND_EMPTY ? 0 : alpha << 24 | red << 16 | green << 8 | blue;
+    }
+}
+
+int createSandWorld(InitializingInfo *initInfo, const SandWorldInfo *info) {
+    if (info->width == 0 || info->height == 0 || (uint64_t)info->width * info->height > MAX_SAND_CELLS) {
+        printf("A %ux%u sand world is either empty or bigger than the %u cells we allow\n", info->width, info->height, MAX_SAND_CELLS);
+        return EXIT_FAILURE;
+    }
+
+    SandWorld *world = calloc(1, sizeof(SandWorld));
+    initInfo->sand = world;
+
+    world->info = *info;
+    world->cells = calloc((size_t)info->width * info->height, sizeof(uint8_t));
+    world->stamps = calloc((size_t)info->width * info->height, sizeof(uint16_t));
+
+    world->chunksX = (info->width + SAND_CHUNK_SIZE - 1) / SAND_CHUNK_SIZE;
+    world->chunksY = (info->height + SAND_CHUNK_SIZE - 1) / SAND_CHUNK_SIZE;
+    world->chunkCount = world->chunksX * world->chunksY;
+    world->chunks = calloc(world->chunkCount, sizeof(SandChunk));
+    for (uint32_t i = 0; i < world->chunkCount; i++) {
+        clearAtomicSandRect(&world->chunks[i].nextAwake);
+        clearAtomicSandRect(&world->chunks[i].changed);
+    }
+
+    world->wokenChunks = malloc(world->chunkCount * sizeof(uint32_t));
+    world->awakeChunks = malloc(world->chunkCount * sizeof(uint32_t));
+    world->changedChunks = malloc(world->chunkCount * sizeof(uint32_t));
+    world->regions = malloc(world->chunkCount * sizeof(VkBufferImageCopy));
+
+    uint32_t threadCount = getThreadPoolSize(initInfo) + 1;
+    world->cellsVisited = calloc(threadCount, sizeof(uint64_t));
+    world->cellsMoved = calloc(threadCount, sizeof(uint64_t));
+
+    world->stats.chunkCount = world->chunkCount;
+
+    if (initInfo->softwareRendering) {
+        buildSandPalette(world);
+    } else {
+        if (createSandImage(initInfo, world) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        if (createSandPipeline(initInfo, world) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    }
+
+    // The image starts out undefined, so the first frame uploads the whole (empty) world. Nothing's awake yet, so stepping it costs nothing
+    spreadSandRect(world, 0, 0, info->width - 1, info->height - 1, false, NULL);
+
+    printf("Created a %ux%u sand world in %ux%u chunks\n", info->width, info->height, world->chunksX, world->chunksY);
+
+    return EXIT_SUCCESS;
+}
+
+void destroySandWorld(InitializingInfo *initInfo) {
+    SandWorld *world = initInfo->sand;
+    if (world == NULL) { return; }
+
+    if (!initInfo->softwareRendering) {
+        vkDestroyPipeline(initInfo->device, world->pipeline, NULL);
+        vkDestroyPipelineLayout(initInfo->device, world->pipelineLayout, NULL);
+        vkDestroyDescriptorPool(initInfo->device, world->descriptorPool, NULL);
+        vkDestroyDescriptorSetLayout(initInfo->device, world->setLayout, NULL);
+
+        vkDestroySampler(initInfo->device, world->sampler, NULL);
+        vkDestroyImageView(initInfo->device, world->imageView, NULL);
+        vkDestroyImage(initInfo->device, world->image, NULL);
+        gpuFree(initInfo, &world->imageMemory);
+
+        // createSandImage() allocates these arrays before creating anything in them, so they're either NULL or full of handles and VK_NULL_HANDLEs
+        for (uint32_t i = 0; world->stagingBuffers != NULL && i < initInfo->maxFramesInFlight; i++) {
+            vkDestroyBuffer(initInfo->device, world->stagingBuffers[i], NULL);
+            gpuFree(initInfo, &world->stagingMemory[i]);
+        }
+    }
+    free(world->stagingBuffers);
+    free(world->stagingMemory);
+
+    free(world->cells);
+    free(world->stamps);
+    free(world->chunks);
+    free(world->wokenChunks);
+    free(world->awakeChunks);
+    free(world->changedChunks);
+    free(world->regions);
+    free(world->cellsVisited);
+    free(world->cellsMoved);
+    free(world);
+    initInfo->sand = NULL;
+}
+
+
+void setSandCamera(InitializingInfo *initInfo, int32_t x, int32_t y) {
+    SandWorld *world = initInfo->sand;
+    if (x == world->cameraX && y == world->cameraY) { return; }
+
+    world->cameraX = x;
+    world->cameraY = y;
+    requestRedraw(initInfo);
+}
+
+
+void recordSandUploads(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    SandWorld *world = initInfo->sand;
+    world->stats.regionsUploaded = 0;
+    world->stats.bytesUploaded = 0;
+
+    uint32_t changedCount = SDL_AtomicGet(&world->changedCount);
+    if (changedCount == 0) { return; }
+
+    // beginFrame() already waited for the last frame that copied out of this staging buffer
+    uint8_t *staging = world->stagingMemory[initInfo->currentFrame].mapped;
+    VkDeviceSize offset = 0;
+
+    // Each chunk's changed rectangle becomes one copy region, with its rows packed tightly one after the other
+    for (uint32_t i = 0; i < changedCount; i++) {
+        SandChunk *chunk = &world->chunks[world->changedChunks[i]];
+        SandRect rect = takeAtomicSandRect(&chunk->changed);
+        SDL_AtomicSet(&chunk->changedQueued, 0);
+
+        uint32_t width = rect.maxX - rect.minX + 1;
+        uint32_t height = rect.maxY - rect.minY + 1;
+        offset = (offset + 3) & ~(VkDeviceSize)3;
+        for (uint32_t row = 0; row < height; row++) {
+            memcpy(staging + offset + row * width, world->cells + (size_t)(rect.minY + row) * world->info.width + rect.minX, width);
+        }
+
+        world->regions[i] = (VkBufferImageCopy){
+            .bufferOffset = offset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+
+            .imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1 },
+            .imageOffset = { rect.minX, rect.minY, 0 },
+            .imageExtent = { width, height, 1 }
+        };
+        offset += (VkDeviceSize)width * height;
+    }
+    SDL_AtomicSet(&world->changedCount, 0);
+
+    // Earlier frames on this queue may still be sampling the image, so the copy waits for their fragment shaders
+    // That's all the synchronization there is, the image is only ever touched by the graphics queue
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = world->imageInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+
+        .image = world->image,
+        .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    vkCmdCopyBufferToImage(commandBuffer, world->stagingBuffers[initInfo->currentFrame], world->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, changedCount, world->regions);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    world->imageInitialized = true;
+    world->stats.regionsUploaded = changedCount;
+    world->stats.bytesUploaded = offset;
+}
+
+void recordSandWorld(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    SandWorld *world = initInfo->sand;
+    // Only possible if a frame gets recorded without recordSandUploads(), the image would still be undefined
+    if (!world->imageInitialized) { return; }
+
+    SandPushConstants pushConstants = { .camera = { world->cameraX, world->cameraY } };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, world->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, world->pipelineLayout, 0, 1, &world->set, 0, NULL);
+    vkCmdPushConstants(commandBuffer, world->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void addSandToSoftwareFrame(InitializingInfo *initInfo) {
+    SandWorld *world = initInfo->sand;
+    world->stats.regionsUploaded = 0;
+    world->stats.bytesUploaded = 0;
+
+    // Every frame reads the cells as they are, so the changed rectangles are only kept for the redraw requests and get dropped here
+    uint32_t changedCount = SDL_AtomicGet(&world->changedCount);
+    for (uint32_t i = 0; i < changedCount; i++) {
+        SandChunk *chunk = &world->chunks[world->changedChunks[i]];
+        takeAtomicSandRect(&chunk->changed);
+        SDL_AtomicSet(&chunk->changedQueued, 0);
+    }
+    SDL_AtomicSet(&world->changedCount, 0);
+
+    addSoftwareImage(initInfo, world->cells, world->info.width, -world->cameraX, -world->cameraY, world->info.width, world->info.height, world->palette);
+}
+
+SandStats getSandStats(InitializingInfo *initInfo) {
+    return initInfo->sand->stats;
+}
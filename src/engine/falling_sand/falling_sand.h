@@ -0,0 +1,76 @@
+#ifndef FALLING_SAND
+#define FALLING_SAND
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+// The world is split into square chunks of this many cells a side, a chunk is what gets simulated on one thread and put to sleep when nothing in it moves
+#define SAND_CHUNK_SIZE 64
+// The biggest world createSandWorld() will make, in cells, 64 MiB of cells plus twice as much again for the move stamps
+#define MAX_SAND_CELLS (1 << 26)
+
+// What a cell is made of, kept in the low bits of every cell
+typedef enum {
+    SAND_EMPTY,
+    SAND_STONE, // Never moves
+    SAND_SAND, // Falls, slides off slopes and sinks through water
+    SAND_WATER, // Falls, and flows sideways when it can't
+    SAND_MATERIAL_COUNT
+} SandMaterial;
+
+typedef struct {
+    uint32_t width, height; // In cells, one cell is one canvas pixel
+} SandWorldInfo;
+
+typedef struct {
+    uint32_t chunkCount;
+    // For the last stepSandWorld()
+    uint32_t chunksAwake;
+    uint64_t cellsVisited; // Cells inside the awake chunks' dirty rectangles, everything outside them wasn't even looked at
+    uint64_t cellsMoved;
+    double stepMs;
+    // For the last frame that was recorded
+    uint32_t regionsUploaded;
+    uint64_t bytesUploaded;
+} SandStats;
+
+
+/*
+A falling sand world: every cell of a big grid is simulated on the CPU, and drawn from a texture with one texel per cell
+Each chunk keeps a dirty rectangle of the cells that could move next step, anything else in it is never looked at
+A chunk where nothing moved gets an empty rectangle and goes to sleep until something next to it changes, so a settled world costs nothing
+*/
+
+// Call it after initialize(), the world starts out empty
+int createSandWorld(InitializingInfo *initInfo, const SandWorldInfo *info);
+// Called by cleanup(), only call it yourself after finishFrames()
+void destroySandWorld(InitializingInfo *initInfo);
+
+// Only call these from the main thread and never during stepSandWorld(), cells outside the world read as SAND_STONE and ignore writes
+SandMaterial getSandCell(InitializingInfo *initInfo, int32_t x, int32_t y);
+// Wakes the cells around it up and requests a redraw, like setTile()
+void setSandCell(InitializingInfo *initInfo, int32_t x, int32_t y, SandMaterial material);
+void fillSandRect(InitializingInfo *initInfo, int32_t x, int32_t y, int32_t width, int32_t height, SandMaterial material);
+
+// One step of the simulation, call it once per tick. Every cell moves at most once per step
+// Awake chunks are updated across the thread pool in four passes, a chunk never runs at the same time as one of its neighbours
+void stepSandWorld(InitializingInfo *initInfo);
+
+// The top left corner of the view in cells, the same as setTilemapCamera()
+void setSandCamera(InitializingInfo *initInfo, int32_t x, int32_t y);
+
+// Called by the frame's command buffer recording, before the render pass, copies the rectangles that changed since the last frame into the texture
+void recordSandUploads(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+// Called by the frame's command buffer recording, inside the render pass, one triangle over the whole canvas that looks up every pixel's cell
+void recordSandWorld(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+// The software renderer's version of both, called by endFrame() to add the world to the frame
+void addSandToSoftwareFrame(InitializingInfo *initInfo);
+
+SandStats getSandStats(InitializingInfo *initInfo);
+
+
+#endif
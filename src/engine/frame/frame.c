@@ -0,0 +1,440 @@
+#include "./frame.h"
+
+#include "../globals/globals.h"
+#include "../initialize/initialize.h"
+#include "../cleanup/cleanup.h"
+#include "../sprite_batch/sprite_batch.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+#include "../canvas/canvas.h"
+#include "../tilemap/tilemap.h"
+#include "../particles/particles.h"
+#include "../falling_sand/falling_sand.h"
+#include "../command_recording/command_recording.h"
+#include "../profiler/profiler.h"
+#include "../software_renderer/software_renderer.h"
+
+#include <vulkan/vulkan.h>
+#include <SDL2/SDL.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+void reportCompletedFrame(InitializingInfo *initInfo, uint32_t frame) {
+    // In headless mode each frame in flight renders into its own offscreen image, so the frame index is also the image index
+    if (!initInfo->framesPendingCompletion[frame]) { return; }
+    initInfo->framesPendingCompletion[frame] = false;
+
+    if (initInfo->frameCompleteCallback != NULL) {
+        initInfo->frameCompleteCallback(initInfo, frame, initInfo->frameCompleteUserData);
+    }
+}
+
+
+// Frame number n signals the value n + 1 on the timeline semaphore when it finishes, so waiting for a value is waiting for that frame
+void waitForTimelineValue(InitializingInfo *initInfo, uint64_t value) {
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+
+        .semaphoreCount = 1,
+        .pSemaphores = &initInfo->frameTimelineSemaphore,
+        .pValues = &value
+    };
+
+    // Using UINT64_MAX disables the timeout
+    vkWaitSemaphores(initInfo->device, &waitInfo, UINT64_MAX);
+}
+
+void waitForFrameSlot(InitializingInfo *initInfo) {
+    if (initInfo->useTimelineSemaphores) {
+        // The frame that last used this slot was maxFramesInFlight frames ago
+        if (initInfo->frameNumber >= initInfo->maxFramesInFlight) {
+            waitForTimelineValue(initInfo, initInfo->frameNumber - initInfo->maxFramesInFlight + 1);
+        }
+    } else {
+        vkWaitForFences(initInfo->device, 1, &initInfo->inFlightFences[initInfo->currentFrame], VK_TRUE, UINT64_MAX);
+    }
+}
+
+uint32_t countFramesOnGPU(InitializingInfo *initInfo) {
+    // This is how many of our earlier frames the GPU still has to get through when we submit a new one
+    // If it's 0 the GPU ran out of work and sat idle waiting on the CPU, which is exactly what frames in flight are supposed to prevent
+    if (initInfo->useTimelineSemaphores) {
+        uint64_t completedValue = 0;
+        vkGetSemaphoreCounterValue(initInfo->device, initInfo->frameTimelineSemaphore, &completedValue);
+
+        return (uint32_t)(initInfo->frameNumber - completedValue);
+    }
+
+    uint32_t count = 0;
+    for (int i = 0; i < initInfo->maxFramesInFlight; i++) {
+        if (i != initInfo->currentFrame && vkGetFenceStatus(initInfo->device, initInfo->inFlightFences[i]) == VK_NOT_READY) { count++; }
+    }
+
+    return count;
+}
+
+
+int recordCommandBuffer(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkFramebuffer framebuffer = getCanvasFramebuffer(initInfo, initInfo->currentFrame);
+
+    // --- Begin recording the command buffer ---
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+
+        /*
+        - VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: the command buffer will be rerecorded right after executing it once
+        - VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: this is a secondary command buffer that will be entirely within a single render pass
+        - VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: the command buffer can be resubmitted while it is also already pending execution
+        */
+        // We rerecord every frame now, so each recording is only ever submitted once
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+
+        // Specifies which state to inherit from the calling primary command buffers. For now we don't need this
+        .pInheritanceInfo = NULL
+    };
+    // The command pool was made with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, so beginning a command buffer implicitly resets it
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    beginProfilerFrame(initInfo, commandBuffer);
+    beginGpuZone(initInfo, commandBuffer, "frame");
+
+    // Anything that finished uploading on the transfer queue has to be handed over to this queue before we can use it
+    recordUploadAcquires(initInfo, commandBuffer);
+
+    // Compute work can't go inside a render pass, so the particles are simulated before the scene starts
+    if (initInfo->particles != NULL) {
+        beginGpuZone(initInfo, commandBuffer, "particles");
+        recordParticleSimulation(initInfo, commandBuffer);
+        endGpuZone(initInfo, commandBuffer);
+    }
+
+    // Copies can't go inside a render pass either, only the parts of the sand world that changed get copied
+    if (initInfo->sand != NULL) {
+        beginGpuZone(initInfo, commandBuffer, "sand upload");
+        recordSandUploads(initInfo, commandBuffer);
+        endGpuZone(initInfo, commandBuffer);
+    }
+
+    //  --- Begin render pass ---
+    VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+
+        .renderPass = initInfo->renderPass,
+        // The scene goes into this frame's canvas image, not the swap chain image
+        .framebuffer = framebuffer,
+
+        // This should match the size of the attachments for the best performance
+        .renderArea.offset = { 0, 0 },
+        .renderArea.extent = initInfo->canvasExtent,
+
+        // We're using black with 100% opacity for the clear color
+        .clearValueCount = 1,
+        .pClearValues = &clearColor
+    };
+    // Everything inside the render pass, recorded across the worker threads when there's enough of it
+    Uint64 recordStart = SDL_GetPerformanceCounter();
+    beginGpuZone(initInfo, commandBuffer, "scene");
+    beginPipelineStatistics(initInfo, commandBuffer);
+    if (recordScene(initInfo, commandBuffer, &renderPassInfo, &initInfo->currentFrameTimings.recordSlices, &initInfo->currentFrameTimings.recordDraws) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    endPipelineStatistics(initInfo, commandBuffer);
+    endGpuZone(initInfo, commandBuffer);
+    initInfo->currentFrameTimings.recordMs = elapsedMilliseconds(recordStart);
+
+    // Scale the canvas up onto the image we're presenting
+    beginGpuZone(initInfo, commandBuffer, "canvas blit");
+    recordCanvasBlit(initInfo, commandBuffer, initInfo->currentFrame, initInfo->swapChainImages[imageIndex]);
+    endGpuZone(initInfo, commandBuffer);
+
+    endGpuZone(initInfo, commandBuffer);
+
+
+    // --- Finish recording the command buffer ---
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+
+// Once the frame has been handed off, the same for both renderers
+void completeFrame(InitializingInfo *initInfo, FrameTimings timings) {
+    // By using the modulo operator we ensure that the frame index loops around after every maxFramesInFlight enqueued frames
+    initInfo->currentFrame = (initInfo->currentFrame + 1) % initInfo->maxFramesInFlight;
+    initInfo->frameNumber++;
+
+    // The picture on screen is up to date now, so there's nothing to draw until something changes again
+    initInfo->redrawRequested = false;
+    if (initInfo->redrawDeadline != 0 && SDL_GetPerformanceCounter() >= initInfo->redrawDeadline) { initInfo->redrawDeadline = 0; }
+
+    timings.cpuFrameMs = elapsedMilliseconds(initInfo->frameStartCounter);
+    initInfo->lastFrameTimings = timings;
+}
+
+// The same scene recordScene() puts together, in the same order, drawn on the CPU and shown before this returns
+int endSoftwareFrame(InitializingInfo *initInfo, FrameTimings timings) {
+    if (initInfo->sand != NULL) { addSandToSoftwareFrame(initInfo); }
+    if (initInfo->tilemap != NULL) { addTilemapToSoftwareFrame(initInfo); }
+    addSoftwareSprites(initInfo, getSpriteInstances(initInfo), getSpriteBatchStats(initInfo).spriteCount, 0.0f, 0.0f);
+
+    beginCpuZone(initInfo, "software render");
+    if (drawSoftwareFrame(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    endCpuZone(initInfo);
+
+    // Finished already, so headless runs get to see it straight away
+    if (initInfo->headless && initInfo->frameCompleteCallback != NULL) {
+        initInfo->frameCompleteCallback(initInfo, 0, initInfo->frameCompleteUserData);
+    }
+
+    completeFrame(initInfo, timings);
+
+    return EXIT_SUCCESS;
+}
+
+
+int beginFrame(InitializingInfo *initInfo) {
+    initInfo->frameActive = false;
+    initInfo->frameStartCounter = SDL_GetPerformanceCounter();
+    initInfo->currentFrameTimings = (FrameTimings){ .frameNumber = initInfo->frameNumber };
+
+    // The last frame was finished before its endFrame() returned, so there's nothing to wait for
+    // SDL hands back a fresh window surface after a resize, so there's no swap chain to recreate either
+    if (initInfo->softwareRendering) {
+        beginSpriteBatch(initInfo);
+        initInfo->swapChainOutOfDate = false;
+        initInfo->frameActive = true;
+
+        return EXIT_SUCCESS;
+    }
+
+    // Only wait for the GPU to finish the frame that last used this slot's command buffer and semaphores
+    // Every frame after that one can keep running on the GPU while we record this one
+    Uint64 waitStart = SDL_GetPerformanceCounter();
+    beginCpuZone(initInfo, "wait for frame slot");
+    waitForFrameSlot(initInfo);
+    endCpuZone(initInfo);
+    initInfo->currentFrameTimings.cpuWaitMs = elapsedMilliseconds(waitStart);
+
+    // That frame was also the last one to read this slot's part of the sprite ring buffer, so it's safe to write into it again
+    beginSpriteBatch(initInfo);
+    // The same goes for the secondary command buffers this slot's scene was recorded into
+    resetCommandRecorder(initInfo);
+    // And the GPU timings it wrote can be read back without waiting on anything
+    collectProfilerFrame(initInfo);
+
+    // The wait above guarantees every frame up to frameNumber - maxFramesInFlight is done
+    // Once that covers every frame that was recorded before the last swap chain recreation, nothing can be using the old swap chain anymore
+    if (initInfo->retiredSwapChain != VK_NULL_HANDLE && initInfo->frameNumber >= initInfo->retiredSwapChainFrameNumber + initInfo->maxFramesInFlight) {
+        destroyRetiredSwapChain(initInfo);
+    }
+
+    if (!initInfo->headless && initInfo->swapChainOutOfDate) {
+        if (recreateSwapChain(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        // Still out of date means the window is minimized, so there's nothing to draw into
+        if (initInfo->swapChainOutOfDate) { return EXIT_SUCCESS; }
+    }
+
+    initInfo->frameActive = true;
+
+    return EXIT_SUCCESS;
+}
+
+int endFrame(InitializingInfo *initInfo) {
+    if (!initInfo->frameActive) { return EXIT_SUCCESS; }
+    initInfo->frameActive = false;
+
+    FrameTimings timings = initInfo->currentFrameTimings;
+
+    // Every entity with a position and a sprite, on top of whatever was added by hand
+    beginCpuZone(initInfo, "sprite components");
+    addSpriteComponents(initInfo);
+    // Drawn back to front by layer, there's no depth buffer and blending needs the order anyway
+    sortSpritesByLayer(initInfo);
+    endCpuZone(initInfo);
+
+    // Rebuilt tilemap chunks are uploaded along with everything else
+    if (initInfo->tilemap != NULL) { updateTilemap(initInfo); }
+
+    if (initInfo->softwareRendering) { return endSoftwareFrame(initInfo, timings); }
+
+    // Send off whatever was uploaded this frame, the transfer queue works on it while we draw
+    if (submitUploads(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    uint32_t imageIndex;
+    Uint64 acquireStart = SDL_GetPerformanceCounter();
+    beginCpuZone(initInfo, "acquire");
+    if (initInfo->headless) {
+        // The wait above means the GPU is done with whatever this frame rendered last time, so we can hand it off now
+        reportCompletedFrame(initInfo, initInfo->currentFrame);
+        imageIndex = initInfo->currentFrame;
+    } else {
+        VkResult acquireResult = vkAcquireNextImageKHR(initInfo->device, initInfo->swapChain, UINT64_MAX, initInfo->imageAvailableSemaphores[initInfo->currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+        // VK_ERROR_OUT_OF_DATE_KHR means the swap chain no longer matches the surface (usually because the window was resized) and can't be presented to at all
+        // Nothing has been submitted for this frame yet, so we just recreate the swap chain and skip it
+        // VK_SUBOPTIMAL_KHR still gives us an image we can present, so we finish the frame and recreate after presenting it
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            endCpuZone(initInfo);
+            initInfo->swapChainOutOfDate = true;
+            if (recreateSwapChain(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+            return EXIT_SUCCESS;
+        }
+        if (acquireResult == VK_SUBOPTIMAL_KHR) { initInfo->swapChainOutOfDate = true; }
+        else if (acquireResult != VK_SUCCESS) { return EXIT_FAILURE; }
+
+        // The swap chain can hand us images out of order, so the image might still be in use by a frame other than the one we just waited on
+        if (initInfo->useTimelineSemaphores) {
+            if (initInfo->imagesInFlightValues[imageIndex] != 0) { waitForTimelineValue(initInfo, initInfo->imagesInFlightValues[imageIndex]); }
+            initInfo->imagesInFlightValues[imageIndex] = initInfo->frameNumber + 1;
+        } else {
+            if (initInfo->imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+                vkWaitForFences(initInfo->device, 1, &initInfo->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+            }
+            initInfo->imagesInFlight[imageIndex] = initInfo->inFlightFences[initInfo->currentFrame];
+        }
+    }
+    endCpuZone(initInfo);
+    timings.acquireWaitMs = elapsedMilliseconds(acquireStart);
+
+    VkCommandBuffer commandBuffer = initInfo->commandBuffers[initInfo->currentFrame];
+    beginCpuZone(initInfo, "record");
+    if (recordCommandBuffer(initInfo, commandBuffer, imageIndex) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    endCpuZone(initInfo);
+    timings.recordMs = initInfo->currentFrameTimings.recordMs;
+    timings.recordSlices = initInfo->currentFrameTimings.recordSlices;
+    timings.recordDraws = initInfo->currentFrameTimings.recordDraws;
+
+    // Headless frames don't acquire or present anything, so there are no binary semaphores to wait on or signal
+    VkSemaphore waitSemaphores[] = { initInfo->imageAvailableSemaphores[initInfo->currentFrame] };
+    // Rendering into the canvas can start right away, it's only the blit that has to wait for the swap chain image
+    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_TRANSFER_BIT };
+    uint64_t waitValues[] = { 0 };
+    uint32_t waitCount = initInfo->headless ? 0 : 1;
+
+    VkSemaphore signalSemaphores[2];
+    uint64_t signalValues[2];
+    uint32_t signalCount = 0;
+    if (!initInfo->headless) {
+        signalSemaphores[signalCount] = initInfo->renderFinishedSemaphores[initInfo->currentFrame];
+        signalValues[signalCount++] = 0; // Ignored for binary semaphores
+    }
+    if (initInfo->useTimelineSemaphores) {
+        signalSemaphores[signalCount] = initInfo->frameTimelineSemaphore;
+        signalValues[signalCount++] = initInfo->frameNumber + 1;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+
+        .waitSemaphoreValueCount = waitCount,
+        .pWaitSemaphoreValues = waitValues,
+        .signalSemaphoreValueCount = signalCount,
+        .pSignalSemaphoreValues = signalValues
+    };
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = initInfo->useTimelineSemaphores ? &timelineInfo : NULL,
+
+        .waitSemaphoreCount = waitCount,
+        .pWaitSemaphores = waitSemaphores,
+        .pWaitDstStageMask = waitStages,
+
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+
+        .signalSemaphoreCount = signalCount,
+        .pSignalSemaphores = signalSemaphores
+    };
+
+    timings.gpuFramesQueued = countFramesOnGPU(initInfo);
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (!initInfo->useTimelineSemaphores) {
+        fence = initInfo->inFlightFences[initInfo->currentFrame];
+        vkResetFences(initInfo->device, 1, &fence);
+    }
+
+    markProfilerSubmit(initInfo);
+    if (vkQueueSubmit(initInfo->graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    if (initInfo->headless) {
+        initInfo->framesPendingCompletion[initInfo->currentFrame] = true;
+    } else {
+        VkSwapchainKHR swapChains[] = { initInfo->swapChain };
+        VkPresentInfoKHR presentInfo = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &initInfo->renderFinishedSemaphores[initInfo->currentFrame],
+
+            .swapchainCount = 1,
+            .pSwapchains = swapChains,
+
+            .pImageIndices = &imageIndex,
+
+            .pResults = NULL
+        };
+
+        VkResult presentResult = vkQueuePresentKHR(initInfo->presentQueue, &presentInfo);
+        if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) { initInfo->swapChainOutOfDate = true; }
+        else if (presentResult != VK_SUCCESS) { return EXIT_FAILURE; }
+    }
+
+    completeFrame(initInfo, timings);
+
+    return EXIT_SUCCESS;
+}
+
+int drawFrame(InitializingInfo *initInfo) {
+    if (beginFrame(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    return endFrame(initInfo);
+}
+
+int finishFrames(InitializingInfo *initInfo) {
+    // Every software frame was finished and reported by its own endFrame()
+    if (initInfo->softwareRendering) { return EXIT_SUCCESS; }
+
+    if (vkDeviceWaitIdle(initInfo->device) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // Everything has finished rendering now, so report the frames we haven't gotten around to yet
+    if (initInfo->headless) {
+        for (int i = 0; i < initInfo->maxFramesInFlight; i++) {
+            reportCompletedFrame(initInfo, (initInfo->currentFrame + i) % initInfo->maxFramesInFlight);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+void requestRedraw(InitializingInfo *initInfo) {
+    initInfo->redrawRequested = true;
+}
+
+void requestRedrawAfter(InitializingInfo *initInfo, uint32_t milliseconds) {
+    Uint64 deadline = SDL_GetPerformanceCounter() + (Uint64)milliseconds * SDL_GetPerformanceFrequency() / 1000;
+    if (initInfo->redrawDeadline == 0 || deadline < initInfo->redrawDeadline) { initInfo->redrawDeadline = deadline; }
+}
+
+bool isRedrawNeeded(InitializingInfo *initInfo) {
+    // A resize needs a new swap chain and a fresh frame to go with it
+    if (!initInfo->renderOnDemand || initInfo->redrawRequested || initInfo->swapChainOutOfDate) { return true; }
+
+    return initInfo->redrawDeadline != 0 && SDL_GetPerformanceCounter() >= initInfo->redrawDeadline;
+}
+
+int getRedrawTimeout(InitializingInfo *initInfo) {
+    if (initInfo->redrawDeadline == 0) { return -1; }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= initInfo->redrawDeadline) { return 0; }
+
+    // Rounded up, waking a millisecond late is better than waking early and going straight back to sleep
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    return (int)(((initInfo->redrawDeadline - now) * 1000 + frequency - 1) / frequency);
+}
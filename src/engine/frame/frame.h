@@ -0,0 +1,33 @@
+#ifndef FRAME
+#define FRAME
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Waits until this frame's resources are free again, only blocking if the GPU is still busy with the frame that last used them
+// Sprites for the frame can be added once this returns
+int beginFrame(InitializingInfo *initInfo);
+// Records and submits the frame started by beginFrame()
+int endFrame(InitializingInfo *initInfo);
+// Both of the above with nothing added in between
+int drawFrame(InitializingInfo *initInfo);
+// Waits for every submitted frame to finish, call this before tearing anything down
+int finishFrames(InitializingInfo *initInfo);
+
+// With renderOnDemand the game loop skips drawing (and presenting) until something calls one of these, only call them from the main thread
+// Input, scene changes like setTile() and structural changes to the world request one on their own, animations have to ask every frame
+void requestRedraw(InitializingInfo *initInfo);
+// For things that change on a timer, like a blinking cursor. Only the earliest pending timer is kept
+void requestRedrawAfter(InitializingInfo *initInfo, uint32_t milliseconds);
+// Always true without renderOnDemand, cleared once a frame has been presented
+bool isRedrawNeeded(InitializingInfo *initInfo);
+// How long the loop can sleep waiting for events before a timer comes due, -1 if there's nothing to wake up for
+int getRedrawTimeout(InitializingInfo *initInfo);
+
+
+#endif
@@ -3,33 +3,49 @@
 #include <vulkan/vulkan.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 
 const char * ENGINE_NAME = "pixel_engine";
 const uint32_t ENGINE_VERSION = VK_MAKE_VERSION(1, 0, 0);
 const uint32_t VULKAN_API_VERSION = VK_API_VERSION_1_2;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+const uint32_t DEFAULT_MAX_SPRITES = 131072;
+const uint32_t DEFAULT_MAX_TEXTURES = 4096;
+const uint32_t DEFAULT_MAX_ENTITIES = 65536;
+// A 16:9 canvas that scales by a whole number onto 720p, 1080p, 1440p and 4K
+const uint32_t DEFAULT_CANVAS_WIDTH = 320;
+const uint32_t DEFAULT_CANVAS_HEIGHT = 180;
 
 
-bytecodeInfo readShaderBytecode(const char * fileName) {
-    FILE *file = fopen(fileName, "rb");
+VkShaderModule createShaderModule(VkDevice device, const void *code, size_t size) {
+    VkShaderModuleCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 
-    if (file == NULL) {
-        printf("The file failed to load!");
-        return (bytecodeInfo){};
-    }
+        .codeSize = size,
+        .pCode = code
+    };
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) { return VK_NULL_HANDLE; }
+
+    return shaderModule;
+}
 
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    rewind(file);
 
-    char * buffer = malloc(fileSize * sizeof(char));
-    fread(buffer, sizeof(char), fileSize, file);
+double elapsedMilliseconds(Uint64 startCounter) {
+    return (double)(SDL_GetPerformanceCounter() - startCounter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
 
-    if (fclose(file) != 0) {
-        printf("The file failed to close!");
-        return (bytecodeInfo){};
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    // typeFilter is a bitmask of the memory types a resource can live in, so we pick the first of those that also has every property we asked for
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) { return i; }
     }
-    return (bytecodeInfo){ .code = buffer, .size = fileSize };
+
+    return UINT32_MAX;
 }
\ No newline at end of file
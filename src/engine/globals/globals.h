@@ -5,6 +5,7 @@
 #include <SDL2/SDL.h>
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define CLAMP(x, lo, hi) ((x) < (lo) ? (lo) : (x) > (hi) ? (hi) : (x)) // Stolen from SDL's wiki lol
 
@@ -17,34 +18,138 @@ extern const uint32_t VULKAN_API_VERSION;
 extern const int WIN_WIDTH;
 extern const int WIN_HEIGHT;
 
-extern const int MAX_FRAMES_IN_FLIGHT;
+extern const uint32_t DEFAULT_FRAMES_IN_FLIGHT;
+extern const uint32_t DEFAULT_MAX_SPRITES;
+extern const uint32_t DEFAULT_MAX_TEXTURES;
+extern const uint32_t DEFAULT_MAX_ENTITIES;
+extern const uint32_t DEFAULT_CANVAS_WIDTH;
+extern const uint32_t DEFAULT_CANVAS_HEIGHT;
+
+
+typedef struct InitializingInfo InitializingInfo;
+// Owned by the sprite_batch module, see sprite_batch.h
+typedef struct SpriteBatcher SpriteBatcher;
+// Owned by the allocator module, see allocator.h
+typedef struct GpuAllocator GpuAllocator;
+typedef struct GpuAllocation GpuAllocation;
+// Owned by the upload module, see upload.h
+typedef struct UploadManager UploadManager;
+// Owned by the thread_pool module, see thread_pool.h
+typedef struct ThreadPool ThreadPool;
+// Owned by the asset_pack module, see asset_pack.h
+typedef struct AssetPack AssetPack;
+// Owned by the canvas module, see canvas.h
+typedef struct Canvas Canvas;
+// Owned by the tilemap module, see tilemap.h
+typedef struct Tilemap Tilemap;
+// Owned by the command_recording module, see command_recording.h
+typedef struct CommandRecorder CommandRecorder;
+// Owned by the profiler module, see profiler.h
+typedef struct Profiler Profiler;
+// Owned by the ecs module, see ecs.h
+typedef struct World World;
+// Owned by the spatial_hash module, see spatial_hash.h
+typedef struct SpatialHash SpatialHash;
+// Owned by the particles module, see particles.h
+typedef struct ParticleSystem ParticleSystem;
+// Owned by the falling_sand module, see falling_sand.h
+typedef struct SandWorld SandWorld;
+// Owned by the software_renderer module, see software_renderer.h
+typedef struct SoftwareRenderer SoftwareRenderer;
+// Owned by the bindless_textures module, see bindless_textures.h
+typedef struct BindlessTextures BindlessTextures;
+
+// Filled in by drawFrame() every frame so we can see how well the CPU and GPU are overlapping
+typedef struct {
+    uint64_t frameNumber;
 
+    double cpuWaitMs; // Time the CPU spent blocked waiting for the GPU to finish the frame that last used this frame's resources
+    double acquireWaitMs; // Time spent getting a swap chain image, including waiting on any frame still using that image
+    double cpuFrameMs; // Total CPU time spent in drawFrame()
+
+    // How many earlier frames the GPU was still working on when this frame was submitted
+    // 0 means the GPU had run dry and was waiting on the CPU
+    uint32_t gpuFramesQueued;
+
+    double recordMs; // Time spent recording the scene's command buffers
+    uint32_t recordSlices; // How many secondary command buffers the scene was split into, 0 when it was recorded inline
+    uint32_t recordDraws; // Draw calls recorded inside the render pass, across all of those
+} FrameTimings;
+
+// Called in headless mode once the GPU has finished rendering into one of the offscreen images
+// The image is left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL so it can be copied out (for example to compare against a reference frame)
+// With the software renderer imageIndex is always 0 and the frame is in getSoftwarePixels() instead
+typedef void (*FrameCompleteCallback)(InitializingInfo *initInfo, uint32_t imageIndex, void *userData);
+
+struct InitializingInfo {
+    // When this is set we never create a window, surface or swap chain and instead render into engine owned images
+    // This is what lets us run the renderer on machines without a display, like CI boxes using Mesa's lavapipe
+    bool headless;
+    FrameCompleteCallback frameCompleteCallback;
+    void *frameCompleteUserData;
 
-typedef struct {
     SDL_Window *window;
 
+    // Draws everything on the CPU instead, see software_renderer.h. None of the Vulkan handles below get created when it's on
+    // Set it before initialize() to always use it, otherwise it gets switched on when there's no Vulkan driver or no usable device
+    bool softwareRendering;
+    SoftwareRenderer *softwareRenderer;
+
     VkInstance instance;
     VkSurfaceKHR surface;
     VkPhysicalDevice physicalDevice;
     VkDevice device;
+    // Every buffer and image gets its memory from here instead of calling vkAllocateMemory itself
+    GpuAllocator *allocator;
+    // Streams buffer and image data to the GPU on the transfer queue
+    UploadManager *uploader;
+    // Worker threads for anything that can run off the main thread, like decoding images, simulating and filling in sprites
+    // workerThreads is how many, set it before initialize() or leave it at 0 for one per CPU core minus the main thread
+    ThreadPool *threadPool;
+    uint32_t workerThreads;
+    // Per thread command pools, so the scene can be recorded on the worker threads
+    CommandRecorder *commandRecorder;
+    // The memory mapped assets.pack, NULL if there isn't one and assets are loaded from loose files instead
+    AssetPack *assetPack;
+    // Set this before initialize() to time CPU and GPU zones every frame, see profiler.h
+    bool profiling;
+    Profiler *profiler;
+    // Only checked when profiling, whether the device let us turn on the features pipeline statistics queries need
+    bool pipelineStatisticsSupported;
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    // When the device has a separate transfer family, uploads run on this queue alongside rendering
+    // Otherwise it's the same queue as graphicsQueue
+    VkQueue transferQueue;
+    uint32_t graphicsQueueFamily;
+    uint32_t transferQueueFamily;
 
     VkSwapchainKHR swapChain;
     VkImage *swapChainImages;
     uint32_t swapChainImagesCount;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
-    VkImageView *swapChainImageViews;
-    uint32_t swapChainImageViewsCount;
+
+    // Set when the window is resized or the swap chain reports it's out of date, drawFrame() recreates the swap chain when it sees this
+    bool swapChainOutOfDate;
+    // After a recreation the old swap chain may still be used by frames in flight, so it's kept here until those frames are done
+    VkSwapchainKHR retiredSwapChain;
+    uint64_t retiredSwapChainFrameNumber;
+
+    // In headless mode swapChainImages holds our own offscreen images and this holds the memory backing them
+    GpuAllocation *offscreenImagesMemory;
+    uint32_t offscreenImagesMemoryCount;
 
     VkRenderPass renderPass;
-    VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    // Shared by every pipeline we create, loaded from and saved back to disk so pipelines don't have to be compiled from scratch every launch
+    VkPipelineCache pipelineCache;
+    bool pipelineCreationFeedbackSupported;
 
-    VkFramebuffer *swapChainFramebuffers;
-    uint32_t swapChainFramebuffersCount;
+    // The scene is drawn at canvasExtent and scaled up onto the swap chain image, see canvas.h
+    // Set canvasExtent before initialize() or leave it at 0 for DEFAULT_CANVAS_WIDTH x DEFAULT_CANVAS_HEIGHT, and use setCanvasSize() to change it afterwards
+    Canvas *canvas;
+    VkExtent2D canvasExtent;
 
     VkCommandPool commandPool;
     VkCommandBuffer *commandBuffers;
@@ -60,15 +165,64 @@ typedef struct {
     uint32_t inFlightFencesCount;
     uint32_t imagesInFlightCount;
 
+    // How many frames the CPU is allowed to record ahead of the GPU. Set this before initialize(), 0 means DEFAULT_FRAMES_IN_FLIGHT
+    uint32_t maxFramesInFlight;
+    // Set this before initialize() to use a single Vulkan 1.2 timeline semaphore in place of the inFlightFences and imagesInFlight fences
+    // It gets switched back off if the device doesn't support timeline semaphores
+    bool useTimelineSemaphores;
+    VkSemaphore frameTimelineSemaphore;
+    uint64_t *imagesInFlightValues;
+
+    // Headless mode only, tracks which frames were submitted but have not been reported to frameCompleteCallback yet
+    bool *framesPendingCompletion;
+    uint32_t framesPendingCompletionCount;
+
+    // Sprites added between beginFrame() and endFrame() are drawn with instancing, see sprite_batch.h
+    // maxSprites is how many sprites fit in one frame, set it before initialize() or leave it at 0 for DEFAULT_MAX_SPRITES
+    SpriteBatcher *spriteBatcher;
+    uint32_t maxSprites;
+    // Every texture a sprite can be drawn with, picked by its textureId, see bindless_textures.h
+    // maxTextures is how many can be registered at once, set it before initialize() or leave it at 0 for DEFAULT_MAX_TEXTURES (or whatever less the device allows)
+    BindlessTextures *textures;
+    uint32_t maxTextures;
+    // Drawn under the sprites when there is one, made with createTilemap() after initialize()
+    Tilemap *tilemap;
+    // Every game object lives here, and every entity with a position and a sprite gets drawn, see ecs.h
+    // maxEntities is how many can be alive at once, set it before initialize() or leave it at 0 for DEFAULT_MAX_ENTITIES
+    World *world;
+    uint32_t maxEntities;
+    // Neighbour, overlap and raycast queries over the world's entities, made with createSpatialHash() after initialize()
+    SpatialHash *spatialHash;
+    // Simulated and drawn entirely on the GPU on top of the sprites, made with createParticleSystem() after initialize()
+    ParticleSystem *particles;
+    // A grid of simulated cells drawn behind the tilemap, made with createSandWorld() after initialize()
+    SandWorld *sand;
+    // How far between the previous and the current simulation tick this frame is drawn, from 0 to 1, see timestep.h
+    float interpolationAlpha;
+
     uint32_t currentFrame;
-} InitializingInfo;
+    uint64_t frameNumber;
+    FrameTimings lastFrameTimings;
+
+    // Set by beginFrame() when there's something to draw into this frame, endFrame() does nothing if it isn't set
+    bool frameActive;
+    Uint64 frameStartCounter;
+    FrameTimings currentFrameTimings;
+
+    // Only draw a frame when something has changed instead of every time around the loop, see requestRedraw() in frame.h
+    // Meant for editor and menu screens, where redrawing the same picture would just keep a core and the GPU busy for nothing
+    bool renderOnDemand;
+    bool redrawRequested;
+    // When the earliest timer asked for with requestRedrawAfter() comes due, 0 if there isn't one
+    Uint64 redrawDeadline;
+};
+
 
+// code has to be 4 byte aligned, use loadShaderModule() from shaders.h to load one by name
+VkShaderModule createShaderModule(VkDevice device, const void *code, size_t size);
 
-typedef struct { 
-    char * code;
-    long size;
-} bytecodeInfo;
-bytecodeInfo readShaderBytecode(const char * fileName);
+double elapsedMilliseconds(Uint64 startCounter);
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "./image_loader.h"
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+#include "../thread_pool/thread_pool.h"
+#include "../asset_pack/asset_pack.h"
+#include "../collision_mask/collision_mask.h"
+#include "../bindless_textures/bindless_textures.h"
+#include "../software_renderer/software_renderer.h"
+
+#include <vulkan/vulkan.h>
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+
+/*
+stb_image always allocates the decoded image itself, so normally we'd have to copy it into the staging ring afterwards
+Instead each worker thread tells our allocation hooks where the image is meant to end up, and the first allocation that's exactly
+the size of the decoded image is handed that staging memory instead of heap memory
+stb makes some temporary allocations along the way, so anything that doesn't match (or gets freed or grown) just goes to the heap as usual
+If the final image still ended up on the heap we fall back to copying it
+*/
+typedef struct {
+    void *target;
+    size_t targetSize;
+    bool targetInUse;
+} DecodeTarget;
+
+_Thread_local DecodeTarget decodeTarget;
+
+void *decodeMalloc(size_t size) {
+    if (decodeTarget.target != NULL && !decodeTarget.targetInUse && size == decodeTarget.targetSize) {
+        decodeTarget.targetInUse = true;
+        return decodeTarget.target;
+    }
+
+    return malloc(size);
+}
+
+void *decodeRealloc(void *pointer, size_t oldSize, size_t newSize) {
+    if (pointer != NULL && pointer == decodeTarget.target) {
+        // It's growing, so it wasn't the final image after all
+        void *moved = malloc(newSize);
+        memcpy(moved, pointer, oldSize < newSize ? oldSize : newSize);
+        decodeTarget.targetInUse = false;
+
+        return moved;
+    }
+
+    return realloc(pointer, newSize);
+}
+
+void decodeFree(void *pointer) {
+    if (pointer != NULL && pointer == decodeTarget.target) {
+        decodeTarget.targetInUse = false;
+        return;
+    }
+
+    free(pointer);
+}
+
+#define STBI_MALLOC(size) decodeMalloc(size)
+#define STBI_REALLOC_SIZED(pointer, oldSize, newSize) decodeRealloc(pointer, oldSize, newSize)
+#define STBI_FREE(pointer) decodeFree(pointer)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+
+typedef struct {
+    const char * path;
+    InitializingInfo *initInfo;
+
+    Asset file;
+    int width, height;
+    bool headerRead;
+
+    UploadReservation reservation;
+    bool reserved;
+    // Without Vulkan there's no staging ring, the pixels stay on the heap in the canvas's channel order until the software renderer takes them
+    uint32_t *softwarePixels;
+    bool submitted;
+    bool decoded;
+    bool zeroCopy;
+    bool committed;
+    const char * failureReason;
+
+    CollisionMask collisionMask;
+    double decodeMs;
+} DecodeJob;
+
+
+void readImageHeader(void *data) {
+    DecodeJob *job = data;
+
+    // Looking things up in the pack doesn't change anything, so it's safe from every worker at once
+    // Images are usually already compressed and stored as is, in which case this reads straight out of the mapped pack
+    if (!loadAsset(job->initInfo, job->path, &job->file)) { return; }
+
+    // Parsing just the header is cheap, and tells us how much staging memory the decoded image needs before we start decoding it
+    int channels;
+    job->headerRead = stbi_info_from_memory(job->file.data, (int)job->file.size, &job->width, &job->height, &channels);
+}
+
+void decodeImage(void *data) {
+    DecodeJob *job = data;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    decodeTarget = (DecodeTarget){ .target = job->reservation.data, .targetSize = job->reservation.size };
+
+    int width, height, channels;
+    // We always ask for 4 channels since that's what the GPU image is
+    unsigned char *pixels = stbi_load_from_memory(job->file.data, (int)job->file.size, &width, &height, &channels, 4);
+
+    if (pixels != NULL && width == job->width && height == job->height) {
+        // The pixels are still hot in this thread's cache, so this is the cheapest moment to build the mask
+        job->decoded = createCollisionMask(pixels, width, height, DEFAULT_COLLISION_ALPHA_THRESHOLD, &job->collisionMask) == EXIT_SUCCESS;
+        if (!job->decoded) { job->failureReason = "out of memory for the collision mask"; }
+
+        if (job->initInfo->softwareRendering && job->decoded) {
+            // Red and blue swap places, so a pixel read as a uint32_t is 0xAARRGGBB like the software canvas
+            for (size_t i = 0; i < (size_t)width * height * 4; i += 4) {
+                unsigned char red = pixels[i];
+                pixels[i] = pixels[i + 2];
+                pixels[i + 2] = red;
+            }
+            job->softwarePixels = (uint32_t *)pixels;
+            pixels = NULL;
+        } else if (!job->initInfo->softwareRendering) {
+            job->zeroCopy = pixels == job->reservation.data;
+            if (!job->zeroCopy) { memcpy(job->reservation.data, pixels, job->reservation.size); }
+        }
+    } else if (pixels == NULL) {
+        job->failureReason = stbi_failure_reason();
+    }
+    if (pixels != NULL && pixels != job->reservation.data) { stbi_image_free(pixels); }
+
+    decodeTarget = (DecodeTarget){  };
+
+    releaseAsset(&job->file);
+
+    job->decodeMs = elapsedMilliseconds(start);
+}
+
+
+void destroySampledImage(InitializingInfo *initInfo, LoadedImage *image) {
+    if (image->view != VK_NULL_HANDLE) { vkDestroyImageView(initInfo->device, image->view, NULL); }
+    if (image->image != VK_NULL_HANDLE) { vkDestroyImage(initInfo->device, image->image, NULL); }
+    gpuFree(initInfo, &image->memory);
+
+    image->view = VK_NULL_HANDLE;
+    image->image = VK_NULL_HANDLE;
+}
+
+// Either everything is created or nothing is left behind
+int createSampledImage(InitializingInfo *initInfo, LoadedImage *image) {
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_SRGB,
+        .extent = { .width = image->extent.width, .height = image->extent.height, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    if (vkCreateImage(initInfo->device, &imageInfo, NULL, &image->image) != VK_SUCCESS) {
+        image->image = VK_NULL_HANDLE;
+        return EXIT_FAILURE;
+    }
+    if (allocateImageMemory(initInfo, image->image, imageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &image->memory) == EXIT_FAILURE) {
+        destroySampledImage(initInfo, image);
+        return EXIT_FAILURE;
+    }
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+
+        .image = image->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = imageInfo.format,
+
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1
+    };
+    if (vkCreateImageView(initInfo->device, &viewInfo, NULL, &image->view) != VK_SUCCESS) {
+        image->view = VK_NULL_HANDLE;
+        destroySampledImage(initInfo, image);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// The software renderer's version of commitDecodedImage(), its texture table gets the decoded pixels as they are
+void commitSoftwareImage(InitializingInfo *initInfo, DecodeJob *job, LoadedImage *image) {
+    if (!job->decoded) {
+        destroyCollisionMask(&job->collisionMask);
+        printf("Failed to decode %s: %s\n", job->path, job->failureReason != NULL ? job->failureReason : "size changed");
+        return;
+    }
+
+    image->extent = (VkExtent2D){ .width = job->width, .height = job->height };
+    image->decodeMs = job->decodeMs;
+
+    uint32_t textureId = registerSoftwareTexture(initInfo, job->softwarePixels, job->width, job->height);
+    if (textureId == UINT32_MAX) {
+        free(job->softwarePixels);
+        destroyCollisionMask(&job->collisionMask);
+        printf("Out of memory for %s\n", job->path);
+        return;
+    }
+    job->softwarePixels = NULL;
+
+    image->loaded = true;
+    image->collisionMask = job->collisionMask;
+    image->textureId = textureId;
+
+    printf("Decoded %s (%dx%d) in %.2f ms\n", job->path, job->width, job->height, job->decodeMs);
+}
+
+// Vulkan objects and the upload manager are only ever touched from the main thread, so this runs there once a decode job is done
+void commitDecodedImage(InitializingInfo *initInfo, DecodeJob *job, LoadedImage *image) {
+    job->committed = true;
+
+    if (initInfo->softwareRendering) {
+        commitSoftwareImage(initInfo, job, image);
+        return;
+    }
+
+    if (!job->decoded) {
+        cancelUploadReservation(initInfo, &job->reservation);
+        destroyCollisionMask(&job->collisionMask);
+        printf("Failed to decode %s: %s\n", job->path, job->failureReason != NULL ? job->failureReason : "size changed");
+        return;
+    }
+
+    image->extent = (VkExtent2D){ .width = job->width, .height = job->height };
+    image->decodeMs = job->decodeMs;
+
+    // A failed image keeps nothing, so it's the same as one that didn't decode and destroyLoadedImage() is optional for it
+    if (createSampledImage(initInfo, image) == EXIT_FAILURE) {
+        cancelUploadReservation(initInfo, &job->reservation);
+        destroyCollisionMask(&job->collisionMask);
+        printf("Failed to create an image for %s\n", job->path);
+        return;
+    }
+
+    VkExtent3D extent = { .width = job->width, .height = job->height, .depth = 1 };
+    image->ticket = commitImageUpload(initInfo, &job->reservation, image->image, extent, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (image->ticket == 0) {
+        // The reservation is given back either way, and nothing was recorded that uses the image
+        destroySampledImage(initInfo, image);
+        destroyCollisionMask(&job->collisionMask);
+        printf("Failed to upload %s\n", job->path);
+        return;
+    }
+
+    image->loaded = true;
+    image->collisionMask = job->collisionMask;
+
+    // The slot is written now, but nothing should draw with it until the ticket is complete
+    uint32_t textureId = registerTexture(initInfo, image->view);
+    if (textureId != UINT32_MAX) { image->textureId = textureId; }
+    else { printf("%s is loaded but sprites using it will draw white\n", job->path); }
+
+    printf("Decoded %s (%dx%d) in %.2f ms%s\n", job->path, job->width, job->height, job->decodeMs, job->zeroCopy ? "" : ", copied into staging");
+}
+
+void commitFinishedJobs(InitializingInfo *initInfo, DecodeJob *jobs, uint32_t count, LoadedImage *images) {
+    waitForJobs(initInfo);
+
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].submitted && !jobs[i].committed) { commitDecodedImage(initInfo, &jobs[i], &images[i]); }
+    }
+}
+
+
+int loadImages(InitializingInfo *initInfo, const char * const * paths, uint32_t count, LoadedImage *images) {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    DecodeJob *jobs = calloc(count, sizeof(DecodeJob));
+    for (int i = 0; i < count; i++) {
+        jobs[i].path = paths[i];
+        jobs[i].initInfo = initInfo;
+        images[i] = (LoadedImage){ .path = paths[i] };
+    }
+
+    // First every file is read and has its header parsed in parallel
+    for (int i = 0; i < count; i++) { submitJob(initInfo, readImageHeader, &jobs[i]); }
+    waitForJobs(initInfo);
+
+    // Then each image gets its piece of the staging ring and is decoded straight into it
+    uint64_t fileBytes = 0;
+    uint64_t decodedBytes = 0;
+    int status = EXIT_SUCCESS;
+
+    for (int i = 0; i < count; i++) {
+        DecodeJob *job = &jobs[i];
+        fileBytes += job->file.size;
+
+        if (!job->headerRead) {
+            printf("Failed to read %s\n", job->path);
+            releaseAsset(&job->file);
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        VkDeviceSize size = (VkDeviceSize)job->width * job->height * 4;
+
+        // The software renderer keeps its textures in ordinary memory, so there's no staging to reserve
+        if (initInfo->softwareRendering) {
+            decodedBytes += size;
+            job->submitted = true;
+            submitJob(initInfo, decodeImage, job);
+            continue;
+        }
+
+        job->reserved = reserveUpload(initInfo, size, &job->reservation);
+        if (!job->reserved) {
+            // The ring is full of images still being decoded, so finish those and send them off before trying again
+            commitFinishedJobs(initInfo, jobs, i, images);
+            if (submitUploads(initInfo) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+            job->reserved = reserveUpload(initInfo, size, &job->reservation);
+        }
+        if (!job->reserved) {
+            printf("Not enough staging memory for %s\n", job->path);
+            releaseAsset(&job->file);
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        decodedBytes += size;
+        job->submitted = true;
+        submitJob(initInfo, decodeImage, job);
+    }
+
+    commitFinishedJobs(initInfo, jobs, count, images);
+    if (!initInfo->softwareRendering && submitUploads(initInfo) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+
+    double seconds = elapsedMilliseconds(start) / 1000.0;
+    double decodeMs = 0.0;
+    for (int i = 0; i < count; i++) {
+        decodeMs += jobs[i].decodeMs;
+        if (!images[i].loaded) { status = EXIT_FAILURE; }
+    }
+
+    printf("Loaded %u images on %u threads in %.2f ms: %.1f MB/s read, %.1f MB/s decoded, %.2f ms of decoding per image\n",
+        count, getThreadPoolSize(initInfo), seconds * 1000.0,
+        fileBytes / (1024.0 * 1024.0) / seconds, decodedBytes / (1024.0 * 1024.0) / seconds, count > 0 ? decodeMs / count : 0.0);
+
+    free(jobs);
+
+    return status;
+}
+
+void destroyLoadedImage(InitializingInfo *initInfo, LoadedImage *image) {
+    if (initInfo->softwareRendering) {
+        unregisterSoftwareTexture(initInfo, image->textureId);
+    } else {
+        unregisterTexture(initInfo, image->textureId);
+        destroySampledImage(initInfo, image);
+    }
+    destroyCollisionMask(&image->collisionMask);
+
+    *image = (LoadedImage){  };
+}
@@ -0,0 +1,46 @@
+#ifndef IMAGE_LOADER
+#define IMAGE_LOADER
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+#include "../collision_mask/collision_mask.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+typedef struct {
+    const char * path;
+    bool loaded;
+
+    // An R8G8B8A8_SRGB image that ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL once ticket is complete
+    // With softwareRendering these stay empty, the pixels belong to the software renderer and can be drawn with straight away
+    VkImage image;
+    VkImageView view;
+    GpuAllocation memory;
+    VkExtent2D extent;
+    UploadTicket ticket;
+    // Put this in a sprite's textureId to draw with the image, see bindless_textures.h
+    // Stays WHITE_TEXTURE_ID if the image didn't load or there was no room for it
+    uint32_t textureId;
+
+    // Built from the decoded pixels' alpha with DEFAULT_COLLISION_ALPHA_THRESHOLD, on the CPU so it's ready straight away
+    CollisionMask collisionMask;
+
+    double decodeMs;
+} LoadedImage;
+
+
+// paths are asset names, looked up in assets.pack or next to the executable like any other asset
+// Reads and decodes every file on the thread pool, and uploads the results through the upload manager (or hands them to the software renderer)
+// Returns EXIT_FAILURE if any of them failed, the ones that worked are still loaded
+int loadImages(InitializingInfo *initInfo, const char * const * paths, uint32_t count, LoadedImage *images);
+// Only once no frame in flight is drawing with it anymore, like after finishFrames()
+// Images that failed to load hold nothing, so calling this on them is safe but not needed
+void destroyLoadedImage(InitializingInfo *initInfo, LoadedImage *image);
+
+
+#endif
@@ -1,6 +1,21 @@
 #include "./initialize.h"
 
 #include "../globals/globals.h"
+#include "../pipeline_cache/pipeline_cache.h"
+#include "../cleanup/cleanup.h"
+#include "../sprite_batch/sprite_batch.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+#include "../thread_pool/thread_pool.h"
+#include "../command_recording/command_recording.h"
+#include "../profiler/profiler.h"
+#include "../ecs/ecs.h"
+#include "../asset_pack/asset_pack.h"
+#include "../shaders/shaders.h"
+#include "../canvas/canvas.h"
+#include "../collision_mask/collision_mask.h"
+#include "../software_renderer/software_renderer.h"
+#include "../bindless_textures/bindless_textures.h"
 
 #include <vulkan/vulkan.h>
 #include <SDL2/SDL.h>
@@ -25,13 +40,29 @@ const char * requiredExtensions[REQUIRED_EXTENSIONS_COUNT] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// These get enabled when the device has them, but we can run without them
+#define OPTIONAL_EXTENSIONS_COUNT 1
+const char * optionalExtensions[OPTIONAL_EXTENSIONS_COUNT] = {
+    VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME
+};
+
 
 InitializingInfo *initInfo;
 
 
 int initWindow() {
     SDL_Init(SDL_INIT_VIDEO);
-    initInfo->window = SDL_CreateWindow(APPLICATION_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_VULKAN);
+
+    // The software renderer draws into the window's surface, which SDL won't give us for a Vulkan window
+    Uint32 flags = initInfo->softwareRendering ? SDL_WINDOW_RESIZABLE : SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE;
+    initInfo->window = SDL_CreateWindow(APPLICATION_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, flags);
+
+    // Without a Vulkan loader SDL can't make a Vulkan window at all, which is as good as having no device
+    if (initInfo->window == NULL && !initInfo->softwareRendering) {
+        printf("Couldn't create a Vulkan window (%s), falling back to the software renderer\n", SDL_GetError());
+        initInfo->softwareRendering = true;
+        initInfo->window = SDL_CreateWindow(APPLICATION_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_RESIZABLE);
+    }
     if (initInfo->window == NULL) { return EXIT_FAILURE; }
 
     return EXIT_SUCCESS;
@@ -79,10 +110,14 @@ int createInstance() {
 
     // In the future if we need to add more extensions, we should rewrite this section of code to account for that
     // -- Get the extensions SDL needs
+    // In headless mode there is no window to present to, so we don't need any of the surface extensions
     unsigned int SDLExtensionsCount = 0;
-    if (!SDL_Vulkan_GetInstanceExtensions(initInfo->window, &SDLExtensionsCount, NULL)) { return EXIT_FAILURE; }
-    const char * *SDLExtenions = malloc(SDLExtensionsCount * sizeof(const char *));
-    if (!SDL_Vulkan_GetInstanceExtensions(initInfo->window, &SDLExtensionsCount, SDLExtenions)) { return EXIT_FAILURE; }
+    const char * *SDLExtenions = NULL;
+    if (!initInfo->headless) {
+        if (!SDL_Vulkan_GetInstanceExtensions(initInfo->window, &SDLExtensionsCount, NULL)) { return EXIT_FAILURE; }
+        SDLExtenions = malloc(SDLExtensionsCount * sizeof(const char *));
+        if (!SDL_Vulkan_GetInstanceExtensions(initInfo->window, &SDLExtensionsCount, SDLExtenions)) { return EXIT_FAILURE; }
+    }
     // --
 
     // Create the vulkan instance
@@ -102,7 +137,9 @@ int createInstance() {
         #endif
     };
 
-    if (vkCreateInstance(&createInfo, NULL, &initInfo->instance) != VK_SUCCESS) { return EXIT_FAILURE; }
+    VkResult result = vkCreateInstance(&createInfo, NULL, &initInfo->instance);
+    free(SDLExtenions);
+    if (result != VK_SUCCESS) { return EXIT_FAILURE; }
 
     return EXIT_SUCCESS;
 }
@@ -121,12 +158,17 @@ typedef struct {
 
     uint32_t presentFamily;
     bool foundPresentFamily;
+
+    // Always found when there's a graphics family, since graphics queues can do transfers too
+    uint32_t transferFamily;
+    bool foundTransferFamily;
 } QueueFamilyIndices;
 
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
     indices.foundGraphicsFamily = false;
     indices.foundPresentFamily = false;
+    indices.foundTransferFamily = false;
 
     uint32_t queueFamilyCount;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
@@ -134,25 +176,51 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
 
     for (int i = 0; i < queueFamilyCount; i++) {
-        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) { 
+        // Compute passes like the particle simulation are recorded into the same command buffer as the frame, so the graphics family has to run compute too
+        // Vulkan guarantees a device with graphics has at least one family that does both
+        VkQueueFlags graphicsAndCompute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+        if ((queueFamilies[i].queueFlags & graphicsAndCompute) == graphicsAndCompute) { 
             indices.graphicsFamily = i; 
             indices.foundGraphicsFamily = true;
         }
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, initInfo->surface, &presentSupport);
-        if (presentSupport) { 
-            indices.presentFamily = i; 
-            indices.foundPresentFamily = true;
+        // Without a surface there's nothing to present to, so we just let the graphics family stand in for the present family
+        if (initInfo->headless) {
+            indices.presentFamily = indices.graphicsFamily;
+            indices.foundPresentFamily = indices.foundGraphicsFamily;
+        } else {
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, initInfo->surface, &presentSupport);
+            if (presentSupport) { 
+                indices.presentFamily = i; 
+                indices.foundPresentFamily = true;
+            }
         }
 
         // If we found all the queue families we need, then we can break
         if (
             indices.foundGraphicsFamily && indices.foundPresentFamily
         ) { break; }
+    }
+
+    // Many GPUs have a family that can only do transfers, which maps onto the copy engines and runs alongside graphics work
+    // Failing that a compute family without graphics still keeps uploads off the graphics queue, and as a last resort we share the graphics family
+    int transferScore = 0;
+    for (int i = 0; i < queueFamilyCount; i++) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if (!(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) { continue; }
+
+        int score = 1;
+        if (!(flags & VK_QUEUE_GRAPHICS_BIT)) { score = 2; }
+        if (!(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) { score = 3; }
 
-        i++;
+        if (score > transferScore) {
+            indices.transferFamily = i;
+            indices.foundTransferFamily = true;
+            transferScore = score;
+        }
     }
+    if (transferScore == 1 && indices.foundGraphicsFamily) { indices.transferFamily = indices.graphicsFamily; }
 
     return indices;
 }
@@ -179,6 +247,19 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return true;
 }
 
+bool checkDeviceExtensionAvailable(VkPhysicalDevice device, const char * extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+    VkExtensionProperties availibleExtensions[extensionCount];
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, availibleExtensions);
+
+    for (int i = 0; i < extensionCount; i++) {
+        if (strcmp(extensionName, availibleExtensions[i].extensionName) == 0) { return true; }
+    }
+
+    return false;
+}
+
 typedef struct {
     VkSurfaceCapabilitiesKHR capabilities;
     VkSurfaceFormatKHR *formats;
@@ -211,6 +292,11 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
     return details;
 }
 
+void freeSwapChainSupport(SwapChainSupportDetails details) {
+    if (details.formatCount > 0) { free(details.formats); }
+    if (details.presentModeCount > 0) { free(details.presentModes); }
+}
+
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR *formats, const uint32_t formatCount) {
     // This function looks at the availible formats and aims to use the format VK_FORMAT_B8G8R8A8_SRGB and colorspace VK_COLOR_SPACE_SRGB_NONLINEAR_KHR if it can
     // If it can't, it uses the first availible option
@@ -248,9 +334,45 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR capabilities) {
         };
         actualExtent.width = CLAMP(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
         actualExtent.height = CLAMP(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+
+        return actualExtent;
     }
 }
 
+// Everything the bindless texture array needs, see bindless_textures.h
+// It's all optional even in Vulkan 1.2, but every desktop driver that has 1.2 has these too
+bool checkDescriptorIndexingSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+        printf("Skipping %s, it only supports Vulkan %u.%u and bindless textures need 1.2\n", deviceProperties.deviceName,
+            VK_API_VERSION_MAJOR(deviceProperties.apiVersion), VK_API_VERSION_MINOR(deviceProperties.apiVersion));
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features features12 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features12
+    };
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    // Name the first missing feature so it's clear why we ended up on the software renderer
+    const char *missingFeature = NULL;
+    if (!features12.runtimeDescriptorArray) { missingFeature = "runtimeDescriptorArray"; }
+    else if (!features12.shaderSampledImageArrayNonUniformIndexing) { missingFeature = "shaderSampledImageArrayNonUniformIndexing"; }
+    else if (!features12.descriptorBindingSampledImageUpdateAfterBind) { missingFeature = "descriptorBindingSampledImageUpdateAfterBind"; }
+    else if (!features12.descriptorBindingUpdateUnusedWhilePending) { missingFeature = "descriptorBindingUpdateUnusedWhilePending"; }
+    else if (!features12.descriptorBindingPartiallyBound) { missingFeature = "descriptorBindingPartiallyBound"; }
+
+    if (missingFeature != NULL) {
+        printf("Skipping %s, it doesn't support %s which bindless textures need\n", deviceProperties.deviceName, missingFeature);
+        return false;
+    }
+
+    return true;
+}
+
 int rateDeviceSuitability(VkPhysicalDevice device) {
     int score = 0;
 
@@ -260,12 +382,22 @@ int rateDeviceSuitability(VkPhysicalDevice device) {
     VkPhysicalDeviceFeatures deviceFeatures;
     vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
+    // Every sprite reads its texture out of one big descriptor array, so there's no drawing anything without it
+    // A device that can't do it scores -1, and without any other device we fall back to the software renderer
+    if (!checkDescriptorIndexingSupport(device)) { return -1; }
+
     // Right now we don't need anything special beyond a graphics card that has Vulkan support and some queue families and such, so we can mostly skip this function
     // In the future we can use this to set up a scoring system
     QueueFamilyIndices indices = findQueueFamilies(device);
     if (indices.foundGraphicsFamily) { score += 1000; }
     if (indices.foundPresentFamily) { score += 1000; }
 
+    // Headless mode never touches the swap chain, so any device that can do graphics is good enough
+    if (initInfo->headless) {
+        if (indices.foundGraphicsFamily) { score += 2000; }
+        return score;
+    }
+
     if (checkDeviceExtensionSupport(device)) { 
         score += 1000; 
     
@@ -273,6 +405,7 @@ int rateDeviceSuitability(VkPhysicalDevice device) {
         if (swapChainSupport.formatCount > 0 && swapChainSupport.presentModeCount > 0) {
             score += 1000;
         }
+        freeSwapChainSupport(swapChainSupport);
     }
 
     return score;
@@ -286,10 +419,18 @@ int pickPhysicalDevice() {
     vkEnumeratePhysicalDevices(initInfo->instance, &deviceCount, devices);
 
     for (int i = 0; i < deviceCount; i++) {
-        if (rateDeviceSuitability(devices[i]) >= 4000) {
+        int score = rateDeviceSuitability(devices[i]);
+        if (score >= 4000) {
             initInfo->physicalDevice = devices[i];
             break;
         }
+
+        // A score of -1 already printed why, anything else is missing a queue family or swap chain support
+        if (score >= 0) {
+            VkPhysicalDeviceProperties deviceProperties;
+            vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
+            printf("Skipping %s, it's missing a graphics or present queue or swap chain support\n", deviceProperties.deviceName);
+        }
     }
 
     if (initInfo->physicalDevice == VK_NULL_HANDLE) { return EXIT_FAILURE; }
@@ -300,7 +441,7 @@ int pickPhysicalDevice() {
 int createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(initInfo->physicalDevice);
 
-    const uint32_t possibleQueueFamilies[] = {indices.graphicsFamily, indices.presentFamily};
+    const uint32_t possibleQueueFamilies[] = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
     const uint32_t size = sizeof(possibleQueueFamilies) / sizeof(const uint32_t);
 
     int uniqueQueueFamilies[size];
@@ -341,16 +482,72 @@ int createLogicalDevice() {
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
 
+    // Timeline semaphores are core in Vulkan 1.2 but are still an optional feature, so we only turn them on if we asked for them and the device has them
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(initInfo->physicalDevice, &deviceProperties);
+
+    VkPhysicalDeviceVulkan12Features supportedFeatures12 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES };
+    VkPhysicalDeviceFeatures2 supportedFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supportedFeatures12
+    };
+    bool supportsVulkan12 = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+    if (supportsVulkan12) { vkGetPhysicalDeviceFeatures2(initInfo->physicalDevice, &supportedFeatures); }
+
+    if (initInfo->useTimelineSemaphores && !supportedFeatures12.timelineSemaphore) {
+        printf("Timeline semaphores aren't supported on this device, falling back to fences\n");
+        initInfo->useTimelineSemaphores = false;
+    }
+
+    // Pipeline statistics are counted around the whole scene, which gets recorded into secondary command buffers
+    // Running a query across vkCmdExecuteCommands needs inheritedQueries on top of the query type itself
+    if (initInfo->profiling) {
+        VkPhysicalDeviceFeatures supportedFeatures10;
+        vkGetPhysicalDeviceFeatures(initInfo->physicalDevice, &supportedFeatures10);
+
+        initInfo->pipelineStatisticsSupported = supportedFeatures10.pipelineStatisticsQuery && supportedFeatures10.inheritedQueries;
+        deviceFeatures.pipelineStatisticsQuery = initInfo->pipelineStatisticsSupported;
+        deviceFeatures.inheritedQueries = initInfo->pipelineStatisticsSupported;
+        if (!initInfo->pipelineStatisticsSupported) { printf("Pipeline statistics queries aren't supported on this device, profiling without them\n"); }
+    }
+
+    VkPhysicalDeviceVulkan12Features enabledFeatures12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+
+        .timelineSemaphore = initInfo->useTimelineSemaphores,
+
+        // pickPhysicalDevice() only picks devices that have all of these, see checkDescriptorIndexingSupport()
+        .runtimeDescriptorArray = VK_TRUE,
+        .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE
+    };
+
+    // Build the list of extensions to enable out of the ones we require and whichever optional ones this device has
+    const char * enabledExtensions[REQUIRED_EXTENSIONS_COUNT + OPTIONAL_EXTENSIONS_COUNT];
+    uint32_t enabledExtensionsCount = 0;
+
+    // The only extension we require right now is the swap chain, which headless mode doesn't use
+    if (!initInfo->headless) {
+        for (int i = 0; i < REQUIRED_EXTENSIONS_COUNT; i++) { enabledExtensions[enabledExtensionsCount++] = requiredExtensions[i]; }
+    }
+    for (int i = 0; i < OPTIONAL_EXTENSIONS_COUNT; i++) {
+        if (checkDeviceExtensionAvailable(initInfo->physicalDevice, optionalExtensions[i])) { enabledExtensions[enabledExtensionsCount++] = optionalExtensions[i]; }
+    }
+    initInfo->pipelineCreationFeedbackSupported = checkDeviceExtensionAvailable(initInfo->physicalDevice, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
     VkDeviceCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = supportsVulkan12 ? &enabledFeatures12 : NULL,
 
         .queueCreateInfoCount = queueCreateInfosCount,
         .pQueueCreateInfos = queueCreateInfos,
 
         .pEnabledFeatures = &deviceFeatures,
 
-        .enabledExtensionCount = REQUIRED_EXTENSIONS_COUNT,
-        .ppEnabledExtensionNames = requiredExtensions,
+        .enabledExtensionCount = enabledExtensionsCount,
+        .ppEnabledExtensionNames = enabledExtensions,
 
         // These few lines are not needed in the latest implementations of vulkan, so they're here for compatibility sake
         #if DO_VALIDATION_LAYERS == true
@@ -365,6 +562,11 @@ int createLogicalDevice() {
 
     vkGetDeviceQueue(initInfo->device, indices.graphicsFamily, 0, &initInfo->graphicsQueue);
     vkGetDeviceQueue(initInfo->device, indices.presentFamily, 0, &initInfo->presentQueue);
+    vkGetDeviceQueue(initInfo->device, indices.transferFamily, 0, &initInfo->transferQueue);
+
+    initInfo->graphicsQueueFamily = indices.graphicsFamily;
+    initInfo->transferQueueFamily = indices.transferFamily;
+    if (indices.transferFamily != indices.graphicsFamily) { printf("Using queue family %u for uploads\n", indices.transferFamily); }
 
     return EXIT_SUCCESS;
 }
@@ -385,6 +587,13 @@ int createSwapChain() {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
 
+    // Every surface is supposed to support this, but it's cheap to check and a lot clearer than a validation error
+    if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        printf("The surface doesn't allow copying into swap chain images, so the canvas can't be blitted onto it!\n");
+        freeSwapChainSupport(swapChainSupport);
+        return EXIT_FAILURE;
+    }
+
     VkSwapchainCreateInfoKHR createInfo = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         
@@ -398,8 +607,8 @@ int createSwapChain() {
         .presentMode = presentMode,
 
         .imageArrayLayers = 1, // This is always 1 unless we are developing a steroscopic 3D application, which god no I hope we are not doing ever
-        // This defines how we want to use the swap chain, which for now is only for attaching colors to the screen. In the future if we want something like postprocessing VK_IMAGE_USAGE_TRANSGER_DST_BIT could be good
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        // This defines how we want to use the swap chain. We never render into it directly, the canvas gets blitted onto it instead (see canvas.h)
+        .imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
 
         // We can use transforms such as flipping 90 degrees clockwise (or etc.), but right now we just want to use the default no transform
         .preTransform = swapChainSupport.capabilities.currentTransform,
@@ -411,9 +620,10 @@ int createSwapChain() {
 
         // A swap chain can become invalid or unoptimized while the application is running if, for example,
         // a window is resized
-        // In that case the swap chain will need to be recreated from scratch and a reference to the old one needs to be specified in this field
-        // This is a complex topic I know nothing about yet, so I'm ignoring it for now lol
-        .oldSwapchain = VK_NULL_HANDLE
+        // In that case the swap chain will need to be recreated and a reference to the old one needs to be specified in this field
+        // Passing the old one lets the driver reuse its resources and keep presenting the images that are already queued on it
+        // recreateSwapChain() retires the current swap chain right before calling this, and at startup there isn't one so this is just VK_NULL_HANDLE
+        .oldSwapchain = initInfo->retiredSwapChain
     };
 
     // We need to know if we will use EXCLUSIVE mode or CONCURRENT mode for swap chain images that are being used across multiple queue families
@@ -441,44 +651,50 @@ int createSwapChain() {
     initInfo->swapChainImageFormat = surfaceFormat.format;
     initInfo->swapChainExtent = extent;
 
+    freeSwapChainSupport(swapChainSupport);
+
     return EXIT_SUCCESS;
 }
 
-int createImageViews() {
-    initInfo->swapChainImageViewsCount = initInfo->swapChainImagesCount;
-    initInfo->swapChainImageViews = malloc(initInfo->swapChainImageViewsCount * sizeof(VkImageView));
+int createOffscreenTargets() {
+    // This stands in for createSwapChain() in headless mode
+    // We make one image per frame in flight, so a frame never has to wait on another frame's image
+    uint32_t imageCount = initInfo->maxFramesInFlight;
 
-    for (int i = 0; i < initInfo->swapChainImageViewsCount; i++) {
-        VkImageViewCreateInfo createInfo = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    initInfo->swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    initInfo->swapChainExtent = (VkExtent2D){ .width = WIN_WIDTH, .height = WIN_HEIGHT };
 
-            .image = initInfo->swapChainImages[i],
+    initInfo->swapChainImagesCount = imageCount;
+    initInfo->swapChainImages = malloc(imageCount * sizeof(VkImage));
+    initInfo->offscreenImagesMemoryCount = imageCount;
+    initInfo->offscreenImagesMemory = calloc(imageCount, sizeof(GpuAllocation));
 
-            .viewType = VK_IMAGE_TYPE_2D,
-            .format = initInfo->swapChainImageFormat,
+    for (int i = 0; i < imageCount; i++) {
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
 
-            // This lets us swizzle the color channels around. For example, if we mapped all of the channels to the red channel, we'd have a monochrome texture
-            .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
-
-            // This lets us describe what the image's purpose is and which part of the image should be accessed
-            // Our images will be used as color targets without any mipmapping levels or multiple layers, so we use this for now
-            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .subresourceRange.baseMipLevel = 0,
-            .subresourceRange.levelCount = 1,
-            .subresourceRange.baseArrayLayer = 0,
-            .subresourceRange.layerCount = 1
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = initInfo->swapChainImageFormat,
+            .extent = { .width = initInfo->swapChainExtent.width, .height = initInfo->swapChainExtent.height, .depth = 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+
+            // The canvas gets blitted into it like a swap chain image, and TRANSFER_SRC lets the frame complete callback copy the result out
+            .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
         };
 
-        if (vkCreateImageView(initInfo->device, &createInfo, NULL, &initInfo->swapChainImageViews[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+        if (vkCreateImage(initInfo->device, &imageInfo, NULL, &initInfo->swapChainImages[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+        if (allocateImageMemory(initInfo, initInfo->swapChainImages[i], imageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &initInfo->offscreenImagesMemory[i]) == EXIT_FAILURE) { return EXIT_FAILURE; }
     }
 
     return EXIT_SUCCESS;
 }
 
-
 int createRenderPass() {
     VkAttachmentDescription colorAttachment = {
         .format = initInfo->swapChainImageFormat,
@@ -513,8 +729,8 @@ int createRenderPass() {
         // The issue with this is that this does not guarantee the contents of the image to be preserved, but that does not matter since we are going to clear it anyway
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         // Specifies which layout to automatically transition to when the render pass finishes
-        // We want the image to be ready for presentation using the swap chain after rendering, which is why we use VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        // We render into the canvas rather than the swap chain, and it gets blitted onto the swap chain image right after, so we leave it ready to be copied from
+        .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
     };
 
     VkAttachmentReference colorAttachmentRef = {
@@ -547,15 +763,29 @@ int createRenderPass() {
         .pColorAttachments = &colorAttachmentRef
     };
 
-    VkSubpassDependency dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
+    VkSubpassDependency dependencies[] = {
+        {
+            // The last frame to use this canvas image was blitting out of it, and we're about to write over it
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = 0,
 
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .srcAccessMask = 0,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+        },
+        {
+            // And the blit after the render pass has to see everything we drew
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
 
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+        }
     };
 
     VkRenderPassCreateInfo renderPassInfo = {
@@ -567,8 +797,8 @@ int createRenderPass() {
         .subpassCount = 1,
         .pSubpasses = &subpass,
 
-        .dependencyCount = 1,
-        .pDependencies = &dependency
+        .dependencyCount = sizeof(dependencies) / sizeof(dependencies[0]),
+        .pDependencies = dependencies
     };
 
     if (vkCreateRenderPass(initInfo->device, &renderPassInfo, NULL, &initInfo->renderPass) != VK_SUCCESS) { return EXIT_FAILURE; }
@@ -576,287 +806,6 @@ int createRenderPass() {
     return EXIT_SUCCESS;
 }
 
-VkShaderModule createShaderModule(bytecodeInfo info) {
-    VkShaderModuleCreateInfo createInfo = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-
-        .codeSize = info.size,
-        .pCode = (uint32_t *)info.code
-    };
-
-    VkShaderModule shaderModule;
-    vkCreateShaderModule(initInfo->device, &createInfo, NULL, &shaderModule);
-
-    free(info.code);
-
-    return shaderModule;
-}
-
-int createGraphicsPipeline() {
-    VkShaderModule vertShaderModule = createShaderModule(readShaderBytecode("src/engine/shaders/compiled/vert.spv"));
-    VkShaderModule fragShaderModule = createShaderModule(readShaderBytecode("src/engine/shaders/compiled/frag.spv"));
-
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = vertShaderModule,
-        .pName = "main"
-    };
-
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-
-        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = fragShaderModule,
-        .pName = "main"
-    };
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {
-        vertShaderStageInfo,
-        fragShaderStageInfo
-    };
-
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-
-        .vertexBindingDescriptionCount = 0,
-        .pVertexBindingDescriptions = NULL,
-        .vertexAttributeDescriptionCount = 0,
-        .pVertexAttributeDescriptions = NULL
-    };
-
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-
-        /*
-        - VK_PRIMITIVE_TOPOLOGY_POINT_LIST: points from vertices
-        - VK_PRIMITIVE_TOPOLOGY_LINE_LIST: line from every 2 vertices without reuse
-        - VK_PRIMITIVE_TOPOLOGY_LINE_STRIP: the end vertex of every line is used as start vertex for the next line
-        - VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST: triangle from every 3 vertices without reuse
-        - VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP: the second and third vertex of every triangle are used as first two vertices of the next triangleVK_PRIMITIVE_TOPOLOGY_POINT_LIST: points from vertices
-        - VK_PRIMITIVE_TOPOLOGY_LINE_LIST: line from every 2 vertices without reuse
-        - VK_PRIMITIVE_TOPOLOGY_LINE_STRIP: the end vertex of every line is used as start vertex for the next line
-        - VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST: triangle from every 3 vertices without reuse
-        - VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP: the second and third vertex of every triangle are used as first two vertices of the next triangle
-        */
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        // If we set this to true then it's possible to break up lines and triangles in the _STRIP topology modes by using a special index of 0xFFFF or 0xFFFFFFFF
-        .primitiveRestartEnable = VK_FALSE
-    };
-
-
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-
-        .width = initInfo->swapChainExtent.width,
-        .height = initInfo->swapChainExtent.height,
-
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
-
-    VkRect2D scissor = {
-        .offset = { 0, 0 },
-        .extent = initInfo->swapChainExtent
-    };
-
-    VkPipelineViewportStateCreateInfo viewportState = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-
-        .viewportCount = 1,
-        .pViewports = &viewport,
-
-        .scissorCount = 1,
-        .pScissors = &scissor
-    };
-
-
-    VkPipelineRasterizationStateCreateInfo rasterizer = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-
-        // If set to true then the fragments that are beyond the near and far planes are clamped to them as opposed to ignoring them
-        .depthClampEnable = VK_FALSE,
-        // If set to true then geometry never passes through the rasterizer stage. This pretty much disables any output to the framebuffer
-        .rasterizerDiscardEnable = VK_FALSE,
-
-        /*
-        - VK_POLYGON_MODE_FILL: fill the area of the polygon with fragments
-        - VK_POLYGON_MODE_LINE: polygon edges are drawn as lines
-        - VK_POLYGON_MODE_POINT: polygon vertices are drawn as points
-        */
-        .polygonMode = VK_POLYGON_MODE_FILL,
-        
-        .lineWidth = 1.0f,
-
-        // Determines the type of face culling to use. You can disable culling, cull the front faces, cull the back faces, or both
-        .cullMode = VK_CULL_MODE_BACK_BIT,
-        // Specifies the vertex order for faces to be considered front-facing and can be clockwise or counterclockwise
-        .frontFace = VK_FRONT_FACE_CLOCKWISE,
-
-        // The rasteruzer can alter the depth values by adding a constant value or biasing them based on a frament's slope. This is sometimes used for shadow mapping, but we're not using it for now
-        .depthBiasEnable = VK_FALSE,
-        .depthBiasConstantFactor = 0.0f,
-        .depthBiasClamp = 0.0f,
-        .depthBiasSlopeFactor = 0.0f
-    };
-
-
-    // Multisampling is one of the ways to preform anti-aliasing. Enabling it requires enabling a GPU feature. For now we will leave it disabled and touch it later
-    VkPipelineMultisampleStateCreateInfo multisampling = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-
-        .sampleShadingEnable = VK_FALSE,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-        .minSampleShading = 1.0f,
-        .pSampleMask = NULL,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE
-    };
-
-
-    // Insert VkPipelineDepthStencilStateCreateInfo stuff here later
-
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
-        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-        .blendEnable = VK_FALSE,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .colorBlendOp = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp = VK_BLEND_OP_ADD
-    };
-
-    VkPipelineColorBlendStateCreateInfo colorBlending = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-
-        .logicOpEnable = VK_FALSE,
-        .logicOp = VK_LOGIC_OP_COPY,
-        
-        .attachmentCount = 1,
-        .pAttachments = &colorBlendAttachment,
-
-        .blendConstants[0] = 0.0f,
-        .blendConstants[1] = 0.0f,
-        .blendConstants[2] = 0.0f,
-        .blendConstants[3] = 0.0f
-    };
-
-
-    // Here we set some dynamic states. Some of the data we've put into all the structs in this function can be changed without recreating the pipeline
-    // This dynamic state create info struct specifies which states we can change without recreating the pipeline
-    // This will cause the configuration of these values to be ignored and we will be required to specify the data at drawing time
-    // I believe for now we want to ignore this, but maybe we'll touch on it later
-    /*
-    VkDynamicState dynamicStates[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_LINE_WIDTH
-    };
-
-    VkPipelineDynamicStateCreateInfo dynamicState = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-
-        .dynamicStateCount = 2,
-        .pDynamicStates = dynamicStates
-    };
-    */
-
-
-    // We can use uniform values in shaders, which are globals similar to the dynamic state variables, that can be changed at drawing time to alter the behavior of our shaders without having to recreate them
-    // They are commonly used to pass the transformation matrix to the vertex shader or to create texture samplers in the fragment shader
-    // We need to specify these uniform values during pipeline creation
-    // Even though we are not going to use them for now, it's still required that we at least create an empty pipeline layout (a pipeline layout being what specifies the uniform values)
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-
-        .setLayoutCount = 0,
-        .pSetLayouts = NULL,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = NULL
-    };
-
-    if (vkCreatePipelineLayout(initInfo->device, &pipelineLayoutInfo, NULL, &initInfo->pipelineLayout) != VK_SUCCESS) { return EXIT_FAILURE; }
-
-
-    VkGraphicsPipelineCreateInfo pipelineInfo = {
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-
-        .stageCount = 2,
-        .pStages = shaderStages,
-
-        .pVertexInputState = &vertexInputInfo,
-        .pInputAssemblyState = &inputAssembly,
-        .pViewportState = &viewportState,
-        .pRasterizationState = &rasterizer,
-        .pMultisampleState = &multisampling,
-        .pDepthStencilState = NULL,
-        .pColorBlendState = &colorBlending,
-        .pDynamicState = NULL,
-
-        .layout = initInfo->pipelineLayout,
-
-        .renderPass = initInfo->renderPass,
-        // Specifies the index of the sub pass where the graphics pipeline will be used
-        .subpass = 0,
-
-        // Vulkan allows you to create a new graphics pipeline by deriving from an existing pipeline
-        // The idea of pipeline derivatives is that it is less expensive to set up pipelines when they have much functionality in common with an existing pipeline
-        // Switching between pipelines from the same parent can also be done quicker
-        // Right now we of course only have the one pipeline so we specify a null handle and an invalid index
-        // These values are only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is also specified in the flags field of VkGraphicsPipelineCreateInfo
-        .basePipelineHandle = VK_NULL_HANDLE,
-        .basePipelineIndex = -1
-    };
-
-    // This function can be used to create multiple VkPipeline objects in a single call
-    // The second parameter, for which we've passed VK_NULL_HANDLE, references an optional VkPipelineCache object
-    // A pipeline cache can be used to store and reuse data relevant to pipeline creation across multiple calls to vkCreateGraphicsPipelines and even across program executions if the cache is stored to a file
-    // This makes it possible to significantly speed up pipeline creation at a later time
-    // For now we don't use this feature, but it will most likely be very useful later on
-    if (vkCreateGraphicsPipelines(initInfo->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &initInfo->graphicsPipeline) != VK_SUCCESS) { return EXIT_FAILURE; }
-
-
-    // These need to be at the end of this function because the shader modules are still used during the creation of the graphics pipeline
-    vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
-    vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
-
-    return EXIT_SUCCESS;
-}
-
-
-int createFramebuffers() {
-    initInfo->swapChainFramebuffersCount = initInfo->swapChainImageViewsCount;
-    initInfo->swapChainFramebuffers = malloc(initInfo->swapChainFramebuffersCount * sizeof(VkFramebuffer));
-
-    for (int i = 0; i < initInfo->swapChainFramebuffersCount; i++) {
-        VkImageView attachments[] = {
-            initInfo->swapChainImageViews[i]
-        };
-
-        VkFramebufferCreateInfo framebufferInfo = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-
-            .renderPass = initInfo->renderPass,
-            .attachmentCount = 1,
-            .pAttachments = attachments,
-            
-            .width = initInfo->swapChainExtent.width,
-            .height = initInfo->swapChainExtent.height,
-            .layers = 1
-        };
-
-        if (vkCreateFramebuffer(initInfo->device, &framebufferInfo, NULL, &initInfo->swapChainFramebuffers[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
-
-    }
-
-    return EXIT_SUCCESS;
-}
-
 
 int createCommandPool() {
     QueueFamilyIndices queueFamilyIndices = findQueueFamilies(initInfo->physicalDevice);
@@ -865,7 +814,8 @@ int createCommandPool() {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 
         .queueFamilyIndex = queueFamilyIndices.graphicsFamily,
-        .flags = 0
+        // Command buffers get rerecorded every frame, so we need to be able to reset them individually
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
     };
 
     if (vkCreateCommandPool(initInfo->device, &poolInfo, NULL, &initInfo->commandPool) != VK_SUCCESS) { return EXIT_FAILURE; }
@@ -874,7 +824,9 @@ int createCommandPool() {
 }
 
 int createCommandBuffers() {
-    initInfo->commandBuffersCount = initInfo->swapChainFramebuffersCount;
+    // We record a fresh command buffer every frame in drawFrame(), so we only need one per frame in flight rather than one per swap chain image
+    // Recording happens while the GPU is still working through the previous frames, which is what lets the CPU and GPU overlap
+    initInfo->commandBuffersCount = initInfo->maxFramesInFlight;
     initInfo->commandBuffers = malloc(initInfo->commandBuffersCount * sizeof(VkCommandBuffer));
 
     VkCommandBufferAllocateInfo allocInfo = {
@@ -893,76 +845,36 @@ int createCommandBuffers() {
 
     if (vkAllocateCommandBuffers(initInfo->device, &allocInfo, initInfo->commandBuffers) != VK_SUCCESS) { return EXIT_FAILURE; }
 
-    for (int i = 0; i < initInfo->commandBuffersCount; i++) {
-        // --- Begin recording the command buffer ---
-        VkCommandBufferBeginInfo beginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-
-            /*
-            - VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: the command buffer will be rerecorded right after executing it once
-            - VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: this is a secondary command buffer that will be entirely within a single render pass
-            - VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: the command buffer can be resubmitted while it is also already pending execution
-            */
-            .flags = 0,
-            
-            // Specifies which state to inherit from the calling primary command buffers. For now we don't need this
-            .pInheritanceInfo = NULL
-        };
-        if (vkBeginCommandBuffer(initInfo->commandBuffers[i], &beginInfo) != VK_SUCCESS) { return EXIT_FAILURE; }
-
-        //  --- Begin render pass ---
-        VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
-        VkRenderPassBeginInfo renderPassInfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-
-            .renderPass = initInfo->renderPass,
-            .framebuffer = initInfo->swapChainFramebuffers[i],
-
-            // This should match the size of the attachments for the best performance        
-            .renderArea.offset = { 0, 0 },
-            .renderArea.extent = initInfo->swapChainExtent,
-
-            // We're using black with 100% opacity for the clear color
-            .clearValueCount = 1,
-            .pClearValues = &clearColor
-        };
-        /* The final command specifies how the drawing commands within the render pass will be provided
-        - VK_SUBPASS_CONTENTS_INLINE: the render pass commands will be embedded in the primary command buffer itself and no secondary command buffer will be executed
-        - VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: the render pass commands will be executed from secondary command buffers
-        We're not using secondary command buffers right now, so we use the first option */
-        vkCmdBeginRenderPass(initInfo->commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    
-
-        vkCmdBindPipeline(initInfo->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, initInfo->graphicsPipeline);
-
-        // Tell Vulkan to draw us a triangle
-        vkCmdDraw(initInfo->commandBuffers[i], 3, 1, 0, 0);
-
-        
-        // --- End render pass ---
-        vkCmdEndRenderPass(initInfo->commandBuffers[i]);
-
-
-        // --- Finish recording the command buffer ---
-        if (vkEndCommandBuffer(initInfo->commandBuffers[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
-    }
-
     return EXIT_SUCCESS;
 }
 
 
 int createSyncObjects() {
-    initInfo->imageAvailableSemaphoresCount = MAX_FRAMES_IN_FLIGHT;
+    initInfo->imageAvailableSemaphoresCount = initInfo->maxFramesInFlight;
     initInfo->imageAvailableSemaphores = malloc(initInfo->imageAvailableSemaphoresCount * sizeof(VkSemaphore));
-    initInfo->renderFinishedSemaphoresCount = MAX_FRAMES_IN_FLIGHT;
+    initInfo->renderFinishedSemaphoresCount = initInfo->maxFramesInFlight;
     initInfo->renderFinishedSemaphores = malloc(initInfo->renderFinishedSemaphoresCount * sizeof(VkSemaphore));
 
-    initInfo->inFlightFencesCount = MAX_FRAMES_IN_FLIGHT;
+    initInfo->inFlightFencesCount = initInfo->maxFramesInFlight;
     initInfo->inFlightFences = malloc(initInfo->inFlightFencesCount * sizeof(VkFence));
+    // So cleanup() can destroy all of them even if creating one of them fails part way through
+    for (int i = 0; i < initInfo->inFlightFencesCount; i++) {
+        initInfo->imageAvailableSemaphores[i] = VK_NULL_HANDLE;
+        initInfo->renderFinishedSemaphores[i] = VK_NULL_HANDLE;
+        initInfo->inFlightFences[i] = VK_NULL_HANDLE;
+    }
 
     initInfo->imagesInFlightCount = initInfo->swapChainImagesCount;
     initInfo->imagesInFlight = malloc(initInfo->imagesInFlightCount * sizeof(VkFence));
-    for (int i = 0; i < initInfo->imagesInFlightCount; i++) { initInfo->imagesInFlight[i] = VK_NULL_HANDLE; }
+    initInfo->imagesInFlightValues = malloc(initInfo->imagesInFlightCount * sizeof(uint64_t));
+    for (int i = 0; i < initInfo->imagesInFlightCount; i++) {
+        initInfo->imagesInFlight[i] = VK_NULL_HANDLE;
+        initInfo->imagesInFlightValues[i] = 0;
+    }
+
+    initInfo->framesPendingCompletionCount = initInfo->maxFramesInFlight;
+    initInfo->framesPendingCompletion = malloc(initInfo->framesPendingCompletionCount * sizeof(bool));
+    for (int i = 0; i < initInfo->framesPendingCompletionCount; i++) { initInfo->framesPendingCompletion[i] = false; }
 
     VkSemaphoreCreateInfo semaphoreInfo = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
@@ -974,37 +886,89 @@ int createSyncObjects() {
         .flags = VK_FENCE_CREATE_SIGNALED_BIT
     };
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (int i = 0; i < initInfo->maxFramesInFlight; i++) {
         if (
             vkCreateSemaphore(initInfo->device, &semaphoreInfo, NULL, &initInfo->imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(initInfo->device, &semaphoreInfo, NULL, &initInfo->renderFinishedSemaphores[i]) != VK_SUCCESS ||
-
-            vkCreateFence(initInfo->device, &fenceInfo, NULL, &initInfo->inFlightFences[i]) != VK_SUCCESS
+            vkCreateSemaphore(initInfo->device, &semaphoreInfo, NULL, &initInfo->renderFinishedSemaphores[i]) != VK_SUCCESS
         ) { return EXIT_FAILURE; }
 
+        // With a timeline semaphore the frames track their progress through it instead, so the fences are never needed
+        if (!initInfo->useTimelineSemaphores && vkCreateFence(initInfo->device, &fenceInfo, NULL, &initInfo->inFlightFences[i]) != VK_SUCCESS) { return EXIT_FAILURE; }
+    }
+
+    if (initInfo->useTimelineSemaphores) {
+        // A timeline semaphore holds a 64 bit counter instead of a signaled/unsignaled state
+        // Frame n signals the value n + 1 when it finishes, so one semaphore can stand in for every one of the per frame fences
+        VkSemaphoreTypeCreateInfo timelineInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        };
+        VkSemaphoreCreateInfo timelineSemaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &timelineInfo
+        };
+
+        if (vkCreateSemaphore(initInfo->device, &timelineSemaphoreInfo, NULL, &initInfo->frameTimelineSemaphore) != VK_SUCCESS) { return EXIT_FAILURE; }
     }
 
     return EXIT_SUCCESS;
 }
 
 
-int initVulkan() {
+// Everything up to picking a device is allowed to fail, it just means this machine has no Vulkan driver or no GPU good enough for us
+int findVulkanDevice() {
     if (createInstance() == EXIT_FAILURE) { return EXIT_FAILURE; }
-    if (createSurface() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (!initInfo->headless && createSurface() == EXIT_FAILURE) { return EXIT_FAILURE; }
 
     if (pickPhysicalDevice() == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+// Undoes whatever findVulkanDevice() got through before it failed, and swaps the Vulkan window for one the software renderer can draw into
+int fallBackToSoftwareRenderer() {
+    printf("No usable Vulkan device, falling back to the software renderer\n");
+
+    if (initInfo->surface != VK_NULL_HANDLE) { vkDestroySurfaceKHR(initInfo->instance, initInfo->surface, NULL); }
+    if (initInfo->instance != VK_NULL_HANDLE) { vkDestroyInstance(initInfo->instance, NULL); }
+    initInfo->surface = VK_NULL_HANDLE;
+    initInfo->instance = VK_NULL_HANDLE;
+    initInfo->physicalDevice = VK_NULL_HANDLE;
+
+    initInfo->softwareRendering = true;
+    if (!initInfo->headless) {
+        SDL_DestroyWindow(initInfo->window);
+        if (initWindow() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int initVulkan() {
     if (createLogicalDevice() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createGpuAllocator(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
 
-    if (createSwapChain() == EXIT_FAILURE) { return EXIT_FAILURE; }
-    if (createImageViews() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (initInfo->headless) {
+        if (createOffscreenTargets() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    } else {
+        if (createSwapChain() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    }
     if (createRenderPass() == EXIT_FAILURE) { return EXIT_FAILURE; }
 
-    if (createGraphicsPipeline() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    // The bindless textures upload their white texel, and the sprite pipeline's layout is built from their set layout
+    if (createUploadManager(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createBindlessTextures(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
 
-    if (createFramebuffers() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (loadPipelineCache(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createSpriteBatcher(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    if (createCanvas(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
 
     if (createCommandPool() == EXIT_FAILURE) { return EXIT_FAILURE;}
     if (createCommandBuffers() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (initInfo->profiling && createProfiler(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
 
     if (createSyncObjects() == EXIT_FAILURE) { return EXIT_FAILURE; }
 
@@ -1012,13 +976,82 @@ int initVulkan() {
     return EXIT_SUCCESS;
 }
 
+// Everything initVulkan() makes that the CPU renderer still needs, the sprite batcher just keeps its sprites in ordinary memory
+int initSoftwareRenderer() {
+    // Every frame is finished by the time endFrame() returns, so there's never more than one to keep track of
+    initInfo->maxFramesInFlight = 1;
+    initInfo->useTimelineSemaphores = false;
+
+    if (createSoftwareRenderer(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createSpriteBatcher(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (initInfo->profiling && createProfiler(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+
+int recreateSwapChain(InitializingInfo *tInitInfo) {
+    initInfo = tInitInfo;
+
+    // A minimized window has a drawable size of 0, and we can't make a swap chain that size
+    // We leave the swap chain flagged as out of date so we try again once the window comes back
+    int width = 0, height = 0;
+    SDL_Vulkan_GetDrawableSize(initInfo->window, &width, &height);
+    if (width == 0 || height == 0) { return EXIT_SUCCESS; }
+
+    // We only keep track of one retired swap chain at a time, so if the last one still hasn't been destroyed we have to wait for the GPU to let go of it
+    // This only happens when the window gets resized several times within a couple of frames
+    if (initInfo->retiredSwapChain != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(initInfo->device);
+        destroyRetiredSwapChain(initInfo);
+    }
+
+    // Frames that are still in flight are blitting into the old swap chain's images, so we can't destroy it yet
+    // Instead it gets retired, and beginFrame() destroys it once every frame that could be using it has finished
+    initInfo->retiredSwapChain = initInfo->swapChain;
+    initInfo->retiredSwapChainFrameNumber = initInfo->frameNumber;
+    free(initInfo->swapChainImages);
+
+    // The scene is rendered into the canvas, which doesn't care about the window's size, so only the swap chain itself gets rebuilt
+    // The canvas, render pass and pipelines only care about the image format, which chooseSwapSurfaceFormat() will pick the same way as before
+    if (createSwapChain() == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    // We might get a different number of images this time, and none of the new ones are in use by a frame yet
+    initInfo->imagesInFlightCount = initInfo->swapChainImagesCount;
+    initInfo->imagesInFlight = realloc(initInfo->imagesInFlight, initInfo->imagesInFlightCount * sizeof(VkFence));
+    initInfo->imagesInFlightValues = realloc(initInfo->imagesInFlightValues, initInfo->imagesInFlightCount * sizeof(uint64_t));
+    for (int i = 0; i < initInfo->imagesInFlightCount; i++) {
+        initInfo->imagesInFlight[i] = VK_NULL_HANDLE;
+        initInfo->imagesInFlightValues[i] = 0;
+    }
+
+    initInfo->swapChainOutOfDate = false;
+
+    return EXIT_SUCCESS;
+}
+
 
 int initialize(InitializingInfo *tInitInfo) {
     initInfo = tInitInfo;
 
+    if (initInfo->maxFramesInFlight == 0) { initInfo->maxFramesInFlight = DEFAULT_FRAMES_IN_FLIGHT; }
+    selectCollisionMaskRoutines();
+
 
-    if (initWindow() == EXIT_FAILURE) { return EXIT_FAILURE; }
-    if (initVulkan() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (!initInfo->headless && initWindow() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    // Without a pack (like when trying out new assets) everything is read from loose files next to the executable instead
+    if (openAssetPack(initInfo, "assets.pack") == EXIT_FAILURE) { printf("No usable assets.pack, loading loose files\n"); }
+    if (!initInfo->softwareRendering && findVulkanDevice() == EXIT_FAILURE && fallBackToSoftwareRenderer() == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    if (initInfo->softwareRendering) {
+        if (initSoftwareRenderer() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    } else {
+        if (initVulkan() == EXIT_FAILURE) { return EXIT_FAILURE; }
+    }
+    if (createThreadPool(initInfo, initInfo->workerThreads) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    // Secondary command buffers are the only thing it hands out
+    if (!initInfo->softwareRendering && createCommandRecorder(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createWorld(initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
 
 
     return EXIT_SUCCESS;
@@ -8,6 +8,8 @@
 
 
 int initialize(InitializingInfo *tInitInfo);
+// Rebuilds the swap chain for when the window is resized or the swap chain goes out of date, the canvas is left alone
+int recreateSwapChain(InitializingInfo *tInitInfo);
 
 
 #endif
\ No newline at end of file
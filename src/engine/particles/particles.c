@@ -0,0 +1,587 @@
+#include "./particles.h"
+
+#include "../globals/globals.h"
+#include "../pipeline_cache/pipeline_cache.h"
+#include "../allocator/allocator.h"
+#include "../shaders/shaders.h"
+#include "../frame/frame.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*
+The particles are stored twice over as a structure of arrays, one buffer per attribute, and every step moves them from one side to the other
+- particle_update.comp runs one thread per living particle and appends the survivors to the other side, which drops the dead ones and keeps the rest packed
+- particle_emit.comp appends the new particles after them
+- particle_finalize.comp is a single thread that writes how many there are now into the draw's vertex count and the next update's group count
+The update is dispatched indirectly from that group count and the draw is indirect too, so the count only ever lives on the GPU
+Frames in flight all run on the graphics queue one after the other, so a single set of buffers is shared by every frame
+*/
+
+// Matches local_size_x in particle_update.comp and particle_emit.comp
+#define PARTICLE_GROUP_SIZE 64
+
+// Position, velocity, life and color, see particle_update.comp
+#define PARTICLE_ATTRIBUTES 4
+const VkDeviceSize PARTICLE_ATTRIBUTE_SIZES[PARTICLE_ATTRIBUTES] = { sizeof(float) * 2, sizeof(float) * 2, sizeof(float) * 2, sizeof(uint32_t) };
+
+// The Control block in the compute shaders, the draw and dispatch commands come first so they're at the offsets vkCmdDraw/DispatchIndirect read from
+typedef struct {
+    VkDrawIndirectCommand draw;
+    VkDispatchIndirectCommand dispatch;
+    uint32_t aliveCount[2];
+} ParticleControl;
+
+// Shared by all three compute passes, matches the PushConstants block in the .comp files
+typedef struct {
+    float emitterPosition[2];
+    float gravity[2];
+    float bounds[2];
+    float direction;
+    float spread;
+    float minSpeed;
+    float maxSpeed;
+    float minLifetime;
+    float maxLifetime;
+    float deltaTime;
+    uint32_t color;
+    uint32_t emitCount;
+    uint32_t seed;
+    uint32_t sourceSide;
+    uint32_t maxParticles;
+} ParticlePushConstants;
+
+struct ParticleSystem {
+    ParticleSystemInfo info;
+    ParticleEmitter emitter;
+
+    VkBuffer controlBuffer;
+    GpuAllocation controlMemory;
+    // Indexed by side and then attribute
+    VkBuffer buffers[2][PARTICLE_ATTRIBUTES];
+    GpuAllocation memory[2][PARTICLE_ATTRIBUTES];
+
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    // sets[side] reads from that side and writes to the other one, drawing uses the set whose destination is the current side
+    VkDescriptorSet sets[2];
+
+    VkPipelineLayout computeLayout;
+    VkPipeline updatePipeline;
+    VkPipeline emitPipeline;
+    VkPipeline finalizePipeline;
+    VkPipelineLayout drawLayout;
+    VkPipeline drawPipeline;
+
+    // The control buffer gets its starting values from the first frame's command buffer
+    bool controlInitialized;
+    // Which side holds the particles right now
+    uint32_t side;
+    float pendingSeconds;
+    // Fractions of a particle carried over, so slow rates still emit at the right average rate
+    float emitAccumulator;
+
+    ParticleStats stats;
+};
+
+
+int createParticleBuffer(InitializingInfo *initInfo, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer *buffer, GpuAllocation *memory) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    if (vkCreateBuffer(initInfo->device, &bufferInfo, NULL, buffer) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // Only ever touched by the GPU, so it can live wherever the GPU is fastest
+    return allocateBufferMemory(initInfo, *buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memory);
+}
+
+int createParticleDescriptorSets(InitializingInfo *initInfo, ParticleSystem *particles) {
+    // Binding 0 is the control buffer, 1 to 4 the side being read and 5 to 8 the side being written
+    // The vertex shader reads the written side, which is the newest one by the time anything is drawn
+    VkDescriptorSetLayoutBinding bindings[1 + PARTICLE_ATTRIBUTES * 2];
+    for (uint32_t i = 0; i < 1 + PARTICLE_ATTRIBUTES * 2; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = i > PARTICLE_ATTRIBUTES ? VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_COMPUTE_BIT
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+
+        .bindingCount = 1 + PARTICLE_ATTRIBUTES * 2,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(initInfo->device, &layoutInfo, NULL, &particles->setLayout) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = (1 + PARTICLE_ATTRIBUTES * 2) * 2
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+
+        .maxSets = 2,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
+    };
+    if (vkCreateDescriptorPool(initInfo->device, &poolInfo, NULL, &particles->descriptorPool) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkDescriptorSetLayout setLayouts[2] = { particles->setLayout, particles->setLayout };
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+
+        .descriptorPool = particles->descriptorPool,
+        .descriptorSetCount = 2,
+        .pSetLayouts = setLayouts
+    };
+    if (vkAllocateDescriptorSets(initInfo->device, &allocInfo, particles->sets) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // The sets never change after this, so there's nothing to update per frame
+    for (uint32_t side = 0; side < 2; side++) {
+        VkDescriptorBufferInfo bufferInfos[1 + PARTICLE_ATTRIBUTES * 2];
+        VkWriteDescriptorSet writes[1 + PARTICLE_ATTRIBUTES * 2];
+
+        bufferInfos[0] = (VkDescriptorBufferInfo){ .buffer = particles->controlBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+        for (uint32_t i = 0; i < PARTICLE_ATTRIBUTES; i++) {
+            bufferInfos[1 + i] = (VkDescriptorBufferInfo){ .buffer = particles->buffers[side][i], .offset = 0, .range = VK_WHOLE_SIZE };
+            bufferInfos[1 + PARTICLE_ATTRIBUTES + i] = (VkDescriptorBufferInfo){ .buffer = particles->buffers[1 - side][i], .offset = 0, .range = VK_WHOLE_SIZE };
+        }
+
+        for (uint32_t i = 0; i < 1 + PARTICLE_ATTRIBUTES * 2; i++) {
+            writes[i] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+
+                .dstSet = particles->sets[side],
+                .dstBinding = i,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &bufferInfos[i]
+            };
+        }
+
+        vkUpdateDescriptorSets(initInfo->device, 1 + PARTICLE_ATTRIBUTES * 2, writes, 0, NULL);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int createParticleComputePipeline(InitializingInfo *initInfo, ParticleSystem *particles, const char * name, VkPipeline *pipeline) {
+    VkShaderModule shaderModule = loadShaderModule(initInfo, name);
+    if (shaderModule == VK_NULL_HANDLE) { return EXIT_FAILURE; }
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shaderModule,
+            .pName = "main"
+        },
+        .layout = particles->computeLayout,
+
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+
+    VkResult result = createComputePipelineCached(initInfo, name, &pipelineInfo, pipeline);
+    vkDestroyShaderModule(initInfo->device, shaderModule, NULL);
+
+    return result == VK_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int createParticleComputePipelines(InitializingInfo *initInfo, ParticleSystem *particles) {
+    // The three passes share one layout, so the push constants only have to be pushed once per step
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(ParticlePushConstants)
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+
+        .setLayoutCount = 1,
+        .pSetLayouts = &particles->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    if (vkCreatePipelineLayout(initInfo->device, &pipelineLayoutInfo, NULL, &particles->computeLayout) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    if (createParticleComputePipeline(initInfo, particles, "particle_update.comp", &particles->updatePipeline) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createParticleComputePipeline(initInfo, particles, "particle_emit.comp", &particles->emitPipeline) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createParticleComputePipeline(initInfo, particles, "particle_finalize.comp", &particles->finalizePipeline) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+int createParticleDrawPipeline(InitializingInfo *initInfo, ParticleSystem *particles) {
+    VkShaderModule vertShaderModule = loadShaderModule(initInfo, "particle.vert");
+    VkShaderModule fragShaderModule = loadShaderModule(initInfo, "particle.frag");
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE) {
+        // Only one of them might have loaded, and destroying a null module does nothing
+        vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+        vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+        return EXIT_FAILURE;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertShaderModule,
+            .pName = "main"
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragShaderModule,
+            .pName = "main"
+        }
+    };
+
+    // The vertex shader reads the particle buffers itself using gl_VertexIndex, so there are no vertex attributes at all
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+
+        .vertexBindingDescriptionCount = 0,
+        .vertexAttributeDescriptionCount = 0
+    };
+
+    // A particle is one canvas pixel, and a 1 pixel point is exactly that without needing any extra features
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+
+        .topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+
+        .viewportCount = 1,
+        .scissorCount = 1
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .minSampleShading = 1.0f
+    };
+
+    // The same "over" blending as sprites, so fading particles blend into whatever is under them
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment
+    };
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
+    };
+
+    // Just the canvas size, the same as the first half of SpritePushConstants
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(float) * 2
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+
+        .setLayoutCount = 1,
+        .pSetLayouts = &particles->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    if (vkCreatePipelineLayout(initInfo->device, &pipelineLayoutInfo, NULL, &particles->drawLayout) != VK_SUCCESS) {
+        vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+        vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+        return EXIT_FAILURE;
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+
+        .stageCount = 2,
+        .pStages = shaderStages,
+
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = NULL,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+
+        .layout = particles->drawLayout,
+
+        .renderPass = initInfo->renderPass,
+        .subpass = 0,
+
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+
+    VkResult result = createGraphicsPipelineCached(initInfo, "particle", &pipelineInfo, &particles->drawPipeline);
+
+    vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+    vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+
+    if (result != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+
+int createParticleSystem(InitializingInfo *initInfo, const ParticleSystemInfo *info) {
+    // Everything about them happens in shaders, there's no CPU version to fall back to
+    if (initInfo->softwareRendering) {
+        printf("Particles are simulated on the GPU, the software renderer can't run them\n");
+        return EXIT_FAILURE;
+    }
+
+    ParticleSystem *particles = calloc(1, sizeof(ParticleSystem));
+    initInfo->particles = particles;
+
+    particles->info = *info;
+    if (particles->info.maxParticles == 0) { particles->info.maxParticles = DEFAULT_MAX_PARTICLES; }
+
+    // Emitting the whole buffer in one step has to fit in a single dispatch
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(initInfo->physicalDevice, &deviceProperties);
+    uint64_t dispatchLimit = (uint64_t)deviceProperties.limits.maxComputeWorkGroupCount[0] * PARTICLE_GROUP_SIZE;
+    if (particles->info.maxParticles > dispatchLimit) { particles->info.maxParticles = (uint32_t)dispatchLimit; }
+    particles->stats.maxParticles = particles->info.maxParticles;
+
+    VkBufferUsageFlags controlUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (createParticleBuffer(initInfo, sizeof(ParticleControl), controlUsage, &particles->controlBuffer, &particles->controlMemory) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    for (uint32_t side = 0; side < 2; side++) {
+        for (uint32_t i = 0; i < PARTICLE_ATTRIBUTES; i++) {
+            VkDeviceSize size = PARTICLE_ATTRIBUTE_SIZES[i] * particles->info.maxParticles;
+            if (createParticleBuffer(initInfo, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &particles->buffers[side][i], &particles->memory[side][i]) == EXIT_FAILURE) { return EXIT_FAILURE; }
+        }
+    }
+
+    if (createParticleDescriptorSets(initInfo, particles) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createParticleComputePipelines(initInfo, particles) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createParticleDrawPipeline(initInfo, particles) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    printf("Created a particle system for up to %u particles\n", particles->info.maxParticles);
+
+    return EXIT_SUCCESS;
+}
+
+void destroyParticleSystem(InitializingInfo *initInfo) {
+    ParticleSystem *particles = initInfo->particles;
+    if (particles == NULL) { return; }
+
+    vkDestroyPipeline(initInfo->device, particles->drawPipeline, NULL);
+    vkDestroyPipelineLayout(initInfo->device, particles->drawLayout, NULL);
+    vkDestroyPipeline(initInfo->device, particles->updatePipeline, NULL);
+    vkDestroyPipeline(initInfo->device, particles->emitPipeline, NULL);
+    vkDestroyPipeline(initInfo->device, particles->finalizePipeline, NULL);
+    vkDestroyPipelineLayout(initInfo->device, particles->computeLayout, NULL);
+
+    // Destroying the pool frees the sets allocated from it
+    vkDestroyDescriptorPool(initInfo->device, particles->descriptorPool, NULL);
+    vkDestroyDescriptorSetLayout(initInfo->device, particles->setLayout, NULL);
+
+    for (uint32_t side = 0; side < 2; side++) {
+        for (uint32_t i = 0; i < PARTICLE_ATTRIBUTES; i++) {
+            vkDestroyBuffer(initInfo->device, particles->buffers[side][i], NULL);
+            gpuFree(initInfo, &particles->memory[side][i]);
+        }
+    }
+    vkDestroyBuffer(initInfo->device, particles->controlBuffer, NULL);
+    gpuFree(initInfo, &particles->controlMemory);
+
+    free(particles);
+    initInfo->particles = NULL;
+}
+
+
+void setParticleEmitter(InitializingInfo *initInfo, const ParticleEmitter *emitter) {
+    initInfo->particles->emitter = *emitter;
+}
+
+void simulateParticles(InitializingInfo *initInfo, float deltaTime) {
+    ParticleSystem *particles = initInfo->particles;
+    if (deltaTime <= 0.0f) { return; }
+
+    particles->pendingSeconds += deltaTime;
+    // Moving particles are an animation, so they need drawing even with renderOnDemand
+    requestRedraw(initInfo);
+}
+
+
+void recordParticleBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+    // Everything is in buffers with no layouts to change, so a global memory barrier says it all
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+void recordParticleSimulation(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    ParticleSystem *particles = initInfo->particles;
+    if (particles == NULL) { return; }
+
+    // Nothing alive on either side, no groups to dispatch and a draw of nothing until the first step says otherwise
+    bool initializing = !particles->controlInitialized;
+    if (initializing) {
+        ParticleControl control = {
+            .draw = { .vertexCount = 0, .instanceCount = 1, .firstVertex = 0, .firstInstance = 0 },
+            .dispatch = { .x = 0, .y = 1, .z = 1 },
+            .aliveCount = { 0, 0 }
+        };
+        vkCmdUpdateBuffer(commandBuffer, particles->controlBuffer, 0, sizeof(control), &control);
+        particles->controlInitialized = true;
+    }
+
+    if (particles->pendingSeconds <= 0.0f) {
+        if (initializing) { recordParticleBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT); }
+        return;
+    }
+
+    float deltaTime = particles->pendingSeconds < MAX_PARTICLE_STEP_SECONDS ? particles->pendingSeconds : MAX_PARTICLE_STEP_SECONDS;
+    particles->pendingSeconds = 0.0f;
+
+    const ParticleEmitter *emitter = &particles->emitter;
+    particles->emitAccumulator += emitter->rate * deltaTime;
+    uint32_t emitCount = particles->info.maxParticles;
+    if (particles->emitAccumulator < (float)particles->info.maxParticles) {
+        emitCount = (uint32_t)particles->emitAccumulator;
+        particles->emitAccumulator -= (float)emitCount;
+    } else {
+        particles->emitAccumulator = 0.0f;
+    }
+
+    ParticlePushConstants pushConstants = {
+        .emitterPosition = { emitter->x, emitter->y },
+        .gravity = { particles->info.gravityX, particles->info.gravityY },
+        .bounds = { initInfo->canvasExtent.width, initInfo->canvasExtent.height },
+        .direction = emitter->direction,
+        .spread = emitter->spread,
+        .minSpeed = emitter->minSpeed,
+        .maxSpeed = emitter->maxSpeed,
+        .minLifetime = emitter->minLifetime,
+        .maxLifetime = emitter->maxLifetime > emitter->minLifetime ? emitter->maxLifetime : emitter->minLifetime,
+        .deltaTime = deltaTime,
+        .color = emitter->color,
+        .emitCount = emitCount,
+        // Different every step, otherwise every step would emit the exact same particles
+        .seed = (uint32_t)(particles->stats.steps * 0x9E3779B9u),
+        .sourceSide = particles->side,
+        .maxParticles = particles->info.maxParticles
+    };
+
+    // The previous frame's draw read the side this step writes to, and its compute passes wrote the control buffer this one reads
+    recordParticleBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles->computeLayout, 0, 1, &particles->sets[particles->side], 0, NULL);
+    vkCmdPushConstants(commandBuffer, particles->computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+    // As many groups as there were particles after the last step, which only the GPU knows
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles->updatePipeline);
+    vkCmdDispatchIndirect(commandBuffer, particles->controlBuffer, offsetof(ParticleControl, dispatch));
+    recordParticleBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (emitCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles->emitPipeline);
+        vkCmdDispatch(commandBuffer, (emitCount + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+        recordParticleBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles->finalizePipeline);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+    // The draw reads its vertex count out of the control buffer and the particles out of the side we just wrote
+    recordParticleBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+    particles->side = 1 - particles->side;
+    particles->stats.steps++;
+    particles->stats.emitted += emitCount;
+}
+
+void recordParticles(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    ParticleSystem *particles = initInfo->particles;
+
+    // Nothing here writes to the particle system, so it's safe from whichever thread records the last slice
+    float viewportSize[2] = { initInfo->canvasExtent.width, initInfo->canvasExtent.height };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particles->drawPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particles->drawLayout, 0, 1, &particles->sets[1 - particles->side], 0, NULL);
+    vkCmdPushConstants(commandBuffer, particles->drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(viewportSize), viewportSize);
+
+    // The vertex count was written by particle_finalize.comp
+    vkCmdDrawIndirect(commandBuffer, particles->controlBuffer, offsetof(ParticleControl, draw), 1, sizeof(VkDrawIndirectCommand));
+}
+
+ParticleStats getParticleStats(InitializingInfo *initInfo) {
+    return initInfo->particles->stats;
+}
@@ -0,0 +1,64 @@
+#ifndef PARTICLES
+#define PARTICLES
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+// Enough for a screen full of pixel particles, at 28 bytes each twice over (see particles.c) that's 56 MiB of device local memory
+#define DEFAULT_MAX_PARTICLES (1 << 20)
+// Steps longer than this (after a hitch, or a frame that never got drawn) are cut short so particles don't jump or burst out all at once
+#define MAX_PARTICLE_STEP_SECONDS 0.1f
+
+typedef struct {
+    uint32_t maxParticles; // 0 for DEFAULT_MAX_PARTICLES
+    float gravityX, gravityY; // Canvas pixels per second squared, positive y is down
+} ParticleSystemInfo;
+
+// Where new particles come from and what they start out like, everything is picked at random between the min and max
+typedef struct {
+    float x, y; // In canvas pixels
+    float direction; // Radians, 0 is right and pi / 2 is down
+    float spread; // Radians, particles leave within half of this either side of direction
+    float minSpeed, maxSpeed; // Canvas pixels per second
+    float minLifetime, maxLifetime; // Seconds
+    float rate; // Particles per second, 0 stops emitting
+    uint32_t color; // RGBA with 8 bits per channel, red in the lowest byte like SpriteInstance's tint
+} ParticleEmitter;
+
+typedef struct {
+    uint32_t maxParticles;
+    uint64_t steps; // Simulation steps recorded so far
+    uint64_t emitted; // Particles asked for so far, ones that didn't fit are dropped on the GPU and still counted here
+} ParticleStats;
+
+
+/*
+Particles live entirely on the GPU: emitting, moving, dropping the dead ones and drawing all happen in compute and vertex shaders
+The CPU only records a few dispatches and one indirect draw per frame, the same handful of commands for ten particles or a million
+The particle count never comes back to the CPU, the GPU writes the draw's vertex count (and the next update's group count) itself
+*/
+
+// Call it after initialize(), made with one emitter that isn't emitting. Fails with the software renderer
+int createParticleSystem(InitializingInfo *initInfo, const ParticleSystemInfo *info);
+// Called by cleanup(), only call it yourself after finishFrames()
+void destroyParticleSystem(InitializingInfo *initInfo);
+
+void setParticleEmitter(InitializingInfo *initInfo, const ParticleEmitter *emitter);
+
+// Advances the particles by deltaTime seconds with the next frame that gets drawn. Without a call they stay frozen, but are still drawn
+// Calls that happen while no frame is drawn add up, so it's fine to call this every time around the loop
+void simulateParticles(InitializingInfo *initInfo, float deltaTime);
+
+// Called by the frame's command buffer recording, before the render pass, records the compute passes for the pending step if there is one
+void recordParticleSimulation(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+// Called by the frame's command buffer recording, inside the render pass, one indirect draw of a point per particle
+void recordParticles(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+
+ParticleStats getParticleStats(InitializingInfo *initInfo);
+
+
+#endif
@@ -0,0 +1,209 @@
+#include "./pipeline_cache.h"
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+
+#define PIPELINE_CACHE_FILE_NAME "pipeline_cache.bin"
+
+
+uint32_t pipelineCacheHits = 0;
+uint32_t pipelineCacheMisses = 0;
+
+
+// The cache lives next to the executable rather than in the working directory, so it's found no matter where we're launched from
+char * getPipelineCachePath(const char * suffix) {
+    char * basePath = SDL_GetBasePath();
+    const char * directory = basePath != NULL ? basePath : "";
+
+    size_t length = strlen(directory) + strlen(PIPELINE_CACHE_FILE_NAME) + strlen(suffix) + 1;
+    char * path = malloc(length);
+    snprintf(path, length, "%s%s%s", directory, PIPELINE_CACHE_FILE_NAME, suffix);
+
+    SDL_free(basePath);
+    return path;
+}
+
+bool isPipelineCacheCompatible(InitializingInfo *initInfo, const void * data, size_t size) {
+    // Every pipeline cache starts with this header, and the driver will only accept data that was made by the same driver on the same device
+    // Drivers are supposed to reject mismatched data on their own, but plenty of them have crashed on it in the past, so we check it ourselves first
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header)) { return false; }
+    memcpy(&header, data, sizeof(header));
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(initInfo->physicalDevice, &deviceProperties);
+
+    if (header.headerSize < sizeof(header) || header.headerSize > size) { return false; }
+    if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) { return false; }
+    if (header.vendorID != deviceProperties.vendorID || header.deviceID != deviceProperties.deviceID) { return false; }
+    if (memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) { return false; }
+
+    return true;
+}
+
+int loadPipelineCache(InitializingInfo *initInfo) {
+    void * data = NULL;
+    size_t size = 0;
+
+    char * path = getPipelineCachePath("");
+    FILE *file = fopen(path, "rb");
+    if (file != NULL) {
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        rewind(file);
+
+        if (fileSize > 0) {
+            data = malloc(fileSize);
+            size = fread(data, 1, fileSize, file);
+        }
+        fclose(file);
+
+        if (!isPipelineCacheCompatible(initInfo, data, size)) {
+            printf("Pipeline cache at %s was made by a different driver or device, starting with an empty cache\n", path);
+            size = 0;
+        }
+    }
+    free(path);
+
+    // If we don't have any usable data we still create an empty cache, so every pipeline created this run can be saved for the next one
+    VkPipelineCacheCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+
+        .initialDataSize = size,
+        .pInitialData = size > 0 ? data : NULL
+    };
+
+    VkResult result = vkCreatePipelineCache(initInfo->device, &createInfo, NULL, &initInfo->pipelineCache);
+    free(data);
+
+    if (result != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+int savePipelineCache(InitializingInfo *initInfo) {
+    if (initInfo->pipelineCache == VK_NULL_HANDLE) { return EXIT_SUCCESS; }
+
+    printf("Pipeline cache: %u hits, %u misses this run\n", pipelineCacheHits, pipelineCacheMisses);
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(initInfo->device, initInfo->pipelineCache, &size, NULL) != VK_SUCCESS || size == 0) { return EXIT_FAILURE; }
+    void * data = malloc(size);
+    if (vkGetPipelineCacheData(initInfo->device, initInfo->pipelineCache, &size, data) != VK_SUCCESS) {
+        free(data);
+        return EXIT_FAILURE;
+    }
+
+    // We write to a temporary file first and then rename it over the real one
+    // That way if we crash or lose power halfway through writing, the old cache is still intact instead of being half overwritten
+    char * tempPath = getPipelineCachePath(".tmp");
+    char * path = getPipelineCachePath("");
+
+    int status = EXIT_FAILURE;
+    FILE *file = fopen(tempPath, "wb");
+    if (file != NULL) {
+        bool written = fwrite(data, 1, size, file) == size;
+        if (fclose(file) == 0 && written) {
+            // rename() replaces the old cache in one step on POSIX, but on Windows it won't replace an existing file at all
+            // MoveFileEx() can, without a moment where neither file is there, and write through makes sure it's on disk before it returns
+            #ifdef _WIN32
+                if (MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) { status = EXIT_SUCCESS; }
+            #else
+                if (rename(tempPath, path) == 0) { status = EXIT_SUCCESS; }
+            #endif
+        }
+        if (status == EXIT_FAILURE) { remove(tempPath); }
+    }
+
+    free(tempPath);
+    free(path);
+    free(data);
+
+    return status;
+}
+
+
+size_t getPipelineCacheSize(InitializingInfo *initInfo) {
+    size_t size = 0;
+    vkGetPipelineCacheData(initInfo->device, initInfo->pipelineCache, &size, NULL);
+
+    return size;
+}
+
+// Both kinds of pipeline go through here, create is whichever vkCreate*Pipelines call the pipeline needs with pNext chained onto its create info
+typedef VkResult (*PipelineCreateFunction)(InitializingInfo *initInfo, const void *pNext, const void *pipelineInfo, VkPipeline *pipeline);
+
+VkResult createPipelineCached(InitializingInfo *initInfo, const char * name, PipelineCreateFunction create, const void *pNext, const void *pipelineInfo, VkPipeline *pipeline) {
+    // VK_EXT_pipeline_creation_feedback lets the driver tell us directly whether the pipeline came out of the cache and how long it took
+    VkPipelineCreationFeedbackEXT feedback = {};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pNext = pNext,
+
+        .pPipelineCreationFeedback = &feedback,
+        .pipelineStageCreationFeedbackCount = 0,
+        .pPipelineStageCreationFeedbacks = NULL
+    };
+    if (initInfo->pipelineCreationFeedbackSupported) { pNext = &feedbackInfo; }
+
+    size_t cacheSizeBefore = getPipelineCacheSize(initInfo);
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    VkResult result = create(initInfo, pNext, pipelineInfo, pipeline);
+
+    double milliseconds = elapsedMilliseconds(start);
+    if (result != VK_SUCCESS) { return result; }
+
+    bool hit;
+    if (initInfo->pipelineCreationFeedbackSupported && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+        hit = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+        milliseconds = (double)feedback.duration / 1000000.0;
+    } else {
+        // Without the extension the best we can do is notice that nothing new was added to the cache
+        hit = getPipelineCacheSize(initInfo) == cacheSizeBefore;
+    }
+
+    if (hit) { pipelineCacheHits++; }
+    else { pipelineCacheMisses++; }
+
+    printf("Pipeline '%s': cache %s, created in %.3f ms\n", name, hit ? "hit" : "miss", milliseconds);
+
+    return VK_SUCCESS;
+}
+
+VkResult createGraphicsPipelineInCache(InitializingInfo *initInfo, const void *pNext, const void *pipelineInfo, VkPipeline *pipeline) {
+    VkGraphicsPipelineCreateInfo createInfo = *(const VkGraphicsPipelineCreateInfo *)pipelineInfo;
+    createInfo.pNext = pNext;
+
+    return vkCreateGraphicsPipelines(initInfo->device, initInfo->pipelineCache, 1, &createInfo, NULL, pipeline);
+}
+
+VkResult createComputePipelineInCache(InitializingInfo *initInfo, const void *pNext, const void *pipelineInfo, VkPipeline *pipeline) {
+    VkComputePipelineCreateInfo createInfo = *(const VkComputePipelineCreateInfo *)pipelineInfo;
+    createInfo.pNext = pNext;
+
+    return vkCreateComputePipelines(initInfo->device, initInfo->pipelineCache, 1, &createInfo, NULL, pipeline);
+}
+
+VkResult createGraphicsPipelineCached(InitializingInfo *initInfo, const char * name, const VkGraphicsPipelineCreateInfo *pipelineInfo, VkPipeline *pipeline) {
+    return createPipelineCached(initInfo, name, createGraphicsPipelineInCache, pipelineInfo->pNext, pipelineInfo, pipeline);
+}
+
+VkResult createComputePipelineCached(InitializingInfo *initInfo, const char * name, const VkComputePipelineCreateInfo *pipelineInfo, VkPipeline *pipeline) {
+    return createPipelineCached(initInfo, name, createComputePipelineInCache, pipelineInfo->pNext, pipelineInfo, pipeline);
+}
@@ -0,0 +1,17 @@
+#ifndef PIPELINE_CACHE
+#define PIPELINE_CACHE
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+
+int loadPipelineCache(InitializingInfo *initInfo);
+int savePipelineCache(InitializingInfo *initInfo);
+
+// Every pipeline should be created through this so they all share the cache and get reported on
+VkResult createGraphicsPipelineCached(InitializingInfo *initInfo, const char * name, const VkGraphicsPipelineCreateInfo *pipelineInfo, VkPipeline *pipeline);
+VkResult createComputePipelineCached(InitializingInfo *initInfo, const char * name, const VkComputePipelineCreateInfo *pipelineInfo, VkPipeline *pipeline);
+
+
+#endif
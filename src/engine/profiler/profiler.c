@@ -0,0 +1,472 @@
+#include "./profiler.h"
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+// The results come back in the order of the bits, lowest first
+#define PIPELINE_STATISTICS_COUNT 5
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+const char * PIPELINE_STATISTICS_NAMES[PIPELINE_STATISTICS_COUNT] = {
+    "vertices", "primitives", "vertex shader invocations", "primitives after clipping", "fragment shader invocations"
+};
+
+// How many different zone names printProfilerSummary() can tell apart
+#define MAX_SUMMARY_ZONES 64
+
+
+typedef enum {
+    PROFILER_TRACK_CPU,
+    PROFILER_TRACK_GPU
+} ProfilerTrack;
+
+typedef struct {
+    const char *name;
+    ProfilerTrack track;
+    uint64_t frameNumber;
+
+    // CPU zones are in microseconds since createProfiler()
+    // GPU zones are in microseconds of the GPU's own clock until exportProfilerTrace() shifts them onto the CPU's timeline
+    double startUs;
+    double durationUs;
+} ProfilerEvent;
+
+typedef struct {
+    uint64_t frameNumber;
+    double startUs; // On the GPU's clock, like the GPU zones
+    uint64_t values[PIPELINE_STATISTICS_COUNT];
+} ProfilerStatistics;
+
+// Everything a frame in flight needs to find its queries again once the GPU is done with them
+typedef struct {
+    VkQueryPool timestampPool; // Two timestamps per zone, the start and the end
+    VkQueryPool statisticsPool; // A single pipeline statistics query
+
+    bool recorded;
+    uint64_t frameNumber;
+    double submitUs;
+
+    const char *zoneNames[MAX_GPU_ZONES_PER_FRAME];
+    uint32_t zonesCount;
+    uint32_t openZones[MAX_PROFILER_ZONE_DEPTH];
+    uint32_t openZonesCount;
+
+    bool statisticsRecorded;
+} ProfilerFrame;
+
+struct Profiler {
+    Uint64 startCounter;
+
+    bool timestampsSupported;
+    double timestampPeriod; // Nanoseconds per timestamp tick
+    uint64_t timestampMask; // Only the low timestampValidBits bits of a timestamp mean anything
+    VkQueryPipelineStatisticFlags pipelineStatistics; // 0 when they aren't supported
+
+    ProfilerFrame *frames; // One per frame in flight
+
+    // The CPU zones that have been begun but not ended yet, innermost last
+    const char *cpuZoneNames[MAX_PROFILER_ZONE_DEPTH];
+    double cpuZoneStarts[MAX_PROFILER_ZONE_DEPTH];
+    uint32_t cpuZoneDepth;
+
+    ProfilerEvent *events;
+    uint32_t eventsCount;
+    uint32_t eventsCapacity;
+
+    ProfilerStatistics *statistics;
+    uint32_t statisticsCount;
+    uint32_t statisticsCapacity;
+
+    // The GPU can't start a frame before it's submitted, so submit time minus the GPU's start time is as low as the gap between the two clocks can be
+    // Taking the biggest one we've seen gets us the tightest estimate without needing VK_EXT_calibrated_timestamps
+    double gpuToCpuOffsetUs;
+    bool gpuToCpuOffsetKnown;
+
+    ProfiledGpuFrame lastGpuFrame;
+};
+
+
+double profilerNowUs(Profiler *profiler) {
+    return (double)(SDL_GetPerformanceCounter() - profiler->startCounter) * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+double timestampToUs(Profiler *profiler, uint64_t timestamp) {
+    return (double)(timestamp & profiler->timestampMask) * profiler->timestampPeriod / 1000.0;
+}
+
+void addProfilerEvent(Profiler *profiler, const char *name, ProfilerTrack track, uint64_t frameNumber, double startUs, double durationUs) {
+    if (profiler->eventsCount == profiler->eventsCapacity) {
+        if (profiler->eventsCapacity >= MAX_PROFILER_EVENTS) { return; }
+
+        profiler->eventsCapacity = profiler->eventsCapacity == 0 ? 4096 : profiler->eventsCapacity * 2;
+        profiler->events = realloc(profiler->events, profiler->eventsCapacity * sizeof(ProfilerEvent));
+    }
+
+    profiler->events[profiler->eventsCount++] = (ProfilerEvent){
+        .name = name,
+        .track = track,
+        .frameNumber = frameNumber,
+        .startUs = startUs,
+        .durationUs = durationUs
+    };
+}
+
+void addProfilerStatistics(Profiler *profiler, uint64_t frameNumber, double startUs, const uint64_t *values) {
+    if (profiler->statisticsCount == profiler->statisticsCapacity) {
+        if (profiler->statisticsCapacity >= MAX_PROFILER_EVENTS) { return; }
+
+        profiler->statisticsCapacity = profiler->statisticsCapacity == 0 ? 1024 : profiler->statisticsCapacity * 2;
+        profiler->statistics = realloc(profiler->statistics, profiler->statisticsCapacity * sizeof(ProfilerStatistics));
+    }
+
+    ProfilerStatistics *statistics = &profiler->statistics[profiler->statisticsCount++];
+    statistics->frameNumber = frameNumber;
+    statistics->startUs = startUs;
+    memcpy(statistics->values, values, sizeof(statistics->values));
+}
+
+
+int createProfiler(InitializingInfo *initInfo) {
+    Profiler *profiler = calloc(1, sizeof(Profiler));
+    initInfo->profiler = profiler;
+
+    profiler->startCounter = SDL_GetPerformanceCounter();
+    profiler->lastGpuFrame.frameNumber = UINT64_MAX;
+    profiler->frames = calloc(initInfo->maxFramesInFlight, sizeof(ProfilerFrame));
+
+    // There's no GPU to time with the software renderer, its work shows up in the CPU zones instead
+    if (initInfo->softwareRendering) { return EXIT_SUCCESS; }
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(initInfo->physicalDevice, &deviceProperties);
+
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(initInfo->physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties queueFamilies[queueFamilyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(initInfo->physicalDevice, &queueFamilyCount, queueFamilies);
+
+    // A queue family with 0 valid bits can't write timestamps at all
+    uint32_t timestampValidBits = queueFamilies[initInfo->graphicsQueueFamily].timestampValidBits;
+    profiler->timestampsSupported = timestampValidBits > 0 && deviceProperties.limits.timestampPeriod > 0.0f;
+    profiler->timestampPeriod = deviceProperties.limits.timestampPeriod;
+    profiler->timestampMask = timestampValidBits >= 64 ? UINT64_MAX : ((uint64_t)1 << timestampValidBits) - 1;
+    if (!profiler->timestampsSupported) { printf("The graphics queue doesn't support timestamps, only CPU zones will be profiled\n"); }
+
+    profiler->pipelineStatistics = initInfo->pipelineStatisticsSupported ? PIPELINE_STATISTICS : 0;
+
+    for (int i = 0; i < initInfo->maxFramesInFlight; i++) {
+        if (profiler->timestampsSupported) {
+            VkQueryPoolCreateInfo timestampPoolInfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+
+                .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = MAX_GPU_ZONES_PER_FRAME * 2
+            };
+            if (vkCreateQueryPool(initInfo->device, &timestampPoolInfo, NULL, &profiler->frames[i].timestampPool) != VK_SUCCESS) { return EXIT_FAILURE; }
+        }
+
+        if (profiler->pipelineStatistics != 0) {
+            VkQueryPoolCreateInfo statisticsPoolInfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+
+                .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                .queryCount = 1,
+                .pipelineStatistics = profiler->pipelineStatistics
+            };
+            if (vkCreateQueryPool(initInfo->device, &statisticsPoolInfo, NULL, &profiler->frames[i].statisticsPool) != VK_SUCCESS) { return EXIT_FAILURE; }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyProfiler(InitializingInfo *initInfo) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return; }
+
+    for (int i = 0; i < initInfo->maxFramesInFlight; i++) {
+        if (profiler->frames[i].timestampPool != VK_NULL_HANDLE) { vkDestroyQueryPool(initInfo->device, profiler->frames[i].timestampPool, NULL); }
+        if (profiler->frames[i].statisticsPool != VK_NULL_HANDLE) { vkDestroyQueryPool(initInfo->device, profiler->frames[i].statisticsPool, NULL); }
+    }
+
+    free(profiler->frames);
+    free(profiler->events);
+    free(profiler->statistics);
+    free(profiler);
+    initInfo->profiler = NULL;
+}
+
+
+void collectProfilerFrame(InitializingInfo *initInfo) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return; }
+
+    ProfilerFrame *frame = &profiler->frames[initInfo->currentFrame];
+    if (!frame->recorded) { return; }
+    frame->recorded = false;
+
+    // No VK_QUERY_RESULT_WAIT_BIT, the frame slot's fence or timeline value has already told us the GPU is done with these
+    // If something still isn't ready (like a zone that was never ended) we lose this frame's results rather than stalling
+    double frameStartUs = 0.0;
+    if (frame->zonesCount > 0) {
+        uint64_t timestamps[MAX_GPU_ZONES_PER_FRAME * 2];
+        VkResult result = vkGetQueryPoolResults(initInfo->device, frame->timestampPool, 0, frame->zonesCount * 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) {
+            frameStartUs = timestampToUs(profiler, timestamps[0]);
+
+            double offset = frame->submitUs - frameStartUs;
+            if (!profiler->gpuToCpuOffsetKnown || offset > profiler->gpuToCpuOffsetUs) {
+                profiler->gpuToCpuOffsetUs = offset;
+                profiler->gpuToCpuOffsetKnown = true;
+            }
+
+            double frameEndUs = frameStartUs;
+            for (uint32_t i = 0; i < frame->zonesCount; i++) {
+                double startUs = timestampToUs(profiler, timestamps[i * 2]);
+                double endUs = timestampToUs(profiler, timestamps[i * 2 + 1]);
+                // The counter can wrap around inside a zone when it has only a few valid bits, which would give a nonsense duration
+                if (endUs < startUs) { continue; }
+
+                addProfilerEvent(profiler, frame->zoneNames[i], PROFILER_TRACK_GPU, frame->frameNumber, startUs, endUs - startUs);
+                if (endUs > frameEndUs) { frameEndUs = endUs; }
+            }
+
+            profiler->lastGpuFrame = (ProfiledGpuFrame){ .frameNumber = frame->frameNumber, .gpuMs = (frameEndUs - frameStartUs) / 1000.0 };
+        }
+    }
+
+    if (frame->statisticsRecorded) {
+        uint64_t values[PIPELINE_STATISTICS_COUNT];
+        VkResult result = vkGetQueryPoolResults(initInfo->device, frame->statisticsPool, 0, 1, sizeof(values), values, sizeof(values), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) { addProfilerStatistics(profiler, frame->frameNumber, frameStartUs, values); }
+    }
+}
+
+void beginProfilerFrame(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return; }
+
+    ProfilerFrame *frame = &profiler->frames[initInfo->currentFrame];
+    frame->recorded = true;
+    frame->frameNumber = initInfo->frameNumber;
+    frame->zonesCount = 0;
+    frame->openZonesCount = 0;
+    frame->statisticsRecorded = false;
+
+    // Queries have to be reset before they can be written again, and the reset has to happen outside of a render pass
+    if (frame->timestampPool != VK_NULL_HANDLE) { vkCmdResetQueryPool(commandBuffer, frame->timestampPool, 0, MAX_GPU_ZONES_PER_FRAME * 2); }
+    if (frame->statisticsPool != VK_NULL_HANDLE) { vkCmdResetQueryPool(commandBuffer, frame->statisticsPool, 0, 1); }
+}
+
+void markProfilerSubmit(InitializingInfo *initInfo) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return; }
+
+    profiler->frames[initInfo->currentFrame].submitUs = profilerNowUs(profiler);
+}
+
+
+void beginCpuZone(InitializingInfo *initInfo, const char *name) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return; }
+
+    if (profiler->cpuZoneDepth < MAX_PROFILER_ZONE_DEPTH) {
+        profiler->cpuZoneNames[profiler->cpuZoneDepth] = name;
+        profiler->cpuZoneStarts[profiler->cpuZoneDepth] = profilerNowUs(profiler);
+    }
+    // Still counted when it's too deep, so the matching endCpuZone() doesn't end the wrong zone
+    profiler->cpuZoneDepth++;
+}
+
+void endCpuZone(InitializingInfo *initInfo) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL || profiler->cpuZoneDepth == 0) { return; }
+
+    profiler->cpuZoneDepth--;
+    if (profiler->cpuZoneDepth >= MAX_PROFILER_ZONE_DEPTH) { return; }
+
+    double startUs = profiler->cpuZoneStarts[profiler->cpuZoneDepth];
+    addProfilerEvent(profiler, profiler->cpuZoneNames[profiler->cpuZoneDepth], PROFILER_TRACK_CPU, initInfo->frameNumber, startUs, profilerNowUs(profiler) - startUs);
+}
+
+void beginGpuZone(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, const char *name) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL || !profiler->timestampsSupported) { return; }
+
+    ProfilerFrame *frame = &profiler->frames[initInfo->currentFrame];
+    if (frame->openZonesCount == MAX_PROFILER_ZONE_DEPTH) { return; }
+
+    // A full frame still pushes the zone so endGpuZone() stays balanced, it just doesn't get a query
+    uint32_t zone = frame->zonesCount < MAX_GPU_ZONES_PER_FRAME ? frame->zonesCount++ : UINT32_MAX;
+    frame->openZones[frame->openZonesCount++] = zone;
+    if (zone == UINT32_MAX) { return; }
+
+    frame->zoneNames[zone] = name;
+    // TOP_OF_PIPE is written as soon as the GPU reaches this point in the command buffer, before any of the zone's work starts
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestampPool, zone * 2);
+}
+
+void endGpuZone(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL || !profiler->timestampsSupported) { return; }
+
+    ProfilerFrame *frame = &profiler->frames[initInfo->currentFrame];
+    if (frame->openZonesCount == 0) { return; }
+
+    uint32_t zone = frame->openZones[--frame->openZonesCount];
+    if (zone == UINT32_MAX) { return; }
+
+    // BOTTOM_OF_PIPE waits for everything recorded before it to completely finish
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->timestampPool, zone * 2 + 1);
+}
+
+
+void beginPipelineStatistics(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL || profiler->pipelineStatistics == 0) { return; }
+
+    ProfilerFrame *frame = &profiler->frames[initInfo->currentFrame];
+    if (frame->statisticsRecorded) { return; }
+
+    vkCmdBeginQuery(commandBuffer, frame->statisticsPool, 0, 0);
+    frame->statisticsRecorded = true;
+}
+
+void endPipelineStatistics(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL || profiler->pipelineStatistics == 0) { return; }
+
+    ProfilerFrame *frame = &profiler->frames[initInfo->currentFrame];
+    if (!frame->statisticsRecorded) { return; }
+
+    vkCmdEndQuery(commandBuffer, frame->statisticsPool, 0);
+}
+
+ProfiledGpuFrame getLastProfiledGpuFrame(InitializingInfo *initInfo) {
+    if (initInfo->profiler == NULL) { return (ProfiledGpuFrame){ .frameNumber = UINT64_MAX }; }
+
+    return initInfo->profiler->lastGpuFrame;
+}
+
+VkQueryPipelineStatisticFlags getProfilerPipelineStatistics(InitializingInfo *initInfo) {
+    return initInfo->profiler != NULL ? initInfo->profiler->pipelineStatistics : 0;
+}
+
+
+// Zone names are string literals from our own code, but a stray quote or backslash would still break the whole file
+void writeJsonString(FILE *file, const char *string) {
+    fputc('"', file);
+    for (const char *c = string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') { fputc('\\', file); }
+        if ((unsigned char)*c < 0x20) { continue; }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+int exportProfilerTrace(InitializingInfo *initInfo, const char *path) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return EXIT_FAILURE; }
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Couldn't open %s to write the trace to\n", path);
+        return EXIT_FAILURE;
+    }
+
+    // Each track is shown as a thread of the same process, the metadata events just give them readable names
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+    for (uint32_t i = 0; i < profiler->eventsCount; i++) {
+        ProfilerEvent *event = &profiler->events[i];
+        bool gpu = event->track == PROFILER_TRACK_GPU;
+
+        // "X" events are complete zones with a start and a duration, in microseconds
+        fprintf(file, ",\n{\"name\":");
+        writeJsonString(file, event->name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%llu}}",
+            gpu ? "gpu" : "cpu", gpu ? event->startUs + profiler->gpuToCpuOffsetUs : event->startUs, event->durationUs, gpu ? 2 : 1,
+            (unsigned long long)event->frameNumber);
+    }
+
+    for (uint32_t i = 0; i < profiler->statisticsCount; i++) {
+        ProfilerStatistics *statistics = &profiler->statistics[i];
+
+        // "C" events are counters, every arg gets drawn as its own line over time
+        fprintf(file, ",\n{\"name\":\"pipeline statistics\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{", statistics->startUs + profiler->gpuToCpuOffsetUs);
+        for (int j = 0; j < PIPELINE_STATISTICS_COUNT; j++) {
+            fprintf(file, "%s\"%s\":%llu", j == 0 ? "" : ",", PIPELINE_STATISTICS_NAMES[j], (unsigned long long)statistics->values[j]);
+        }
+        fprintf(file, "}}");
+    }
+
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) { return EXIT_FAILURE; }
+    printf("Wrote %u zones and %u pipeline statistics samples to %s\n", profiler->eventsCount, profiler->statisticsCount, path);
+
+    return EXIT_SUCCESS;
+}
+
+void printProfilerSummary(InitializingInfo *initInfo) {
+    Profiler *profiler = initInfo->profiler;
+    if (profiler == NULL) { return; }
+
+    typedef struct {
+        const char *name;
+        ProfilerTrack track;
+        double totalUs;
+        double maxUs;
+        uint32_t count;
+    } ZoneSummary;
+
+    // The names are string literals, so comparing the pointers is enough to group them
+    ZoneSummary zones[MAX_SUMMARY_ZONES];
+    uint32_t zonesCount = 0;
+    for (uint32_t i = 0; i < profiler->eventsCount; i++) {
+        ProfilerEvent *event = &profiler->events[i];
+
+        uint32_t zone = 0;
+        while (zone < zonesCount && (zones[zone].name != event->name || zones[zone].track != event->track)) { zone++; }
+        if (zone == zonesCount) {
+            if (zonesCount == MAX_SUMMARY_ZONES) { continue; }
+            zones[zonesCount++] = (ZoneSummary){ .name = event->name, .track = event->track };
+        }
+
+        zones[zone].totalUs += event->durationUs;
+        if (event->durationUs > zones[zone].maxUs) { zones[zone].maxUs = event->durationUs; }
+        zones[zone].count++;
+    }
+
+    for (uint32_t i = 0; i < zonesCount; i++) {
+        printf("%s %-24s avg %8.3f ms, max %8.3f ms over %u samples\n",
+            zones[i].track == PROFILER_TRACK_GPU ? "GPU" : "CPU", zones[i].name, zones[i].totalUs / zones[i].count / 1000.0, zones[i].maxUs / 1000.0, zones[i].count);
+    }
+
+    if (profiler->statisticsCount > 0) {
+        printf("Pipeline statistics, avg per frame:");
+        for (int j = 0; j < PIPELINE_STATISTICS_COUNT; j++) {
+            double total = 0.0;
+            for (uint32_t i = 0; i < profiler->statisticsCount; i++) { total += profiler->statistics[i].values[j]; }
+            printf("%s %.0f %s", j == 0 ? "" : ",", total / profiler->statisticsCount, PIPELINE_STATISTICS_NAMES[j]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILER
+#define PROFILER
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+typedef struct {
+    uint64_t frameNumber; // UINT64_MAX until a frame has been read back
+    double gpuMs; // From the start of the frame's first GPU zone to the end of its last one
+} ProfiledGpuFrame;
+
+
+// How many GPU zones one frame can have, any past this are ignored
+#define MAX_GPU_ZONES_PER_FRAME 32
+// How deep CPU and GPU zones can be nested inside each other
+#define MAX_PROFILER_ZONE_DEPTH 16
+// Events past this are dropped instead of growing the trace forever on long runs
+#define MAX_PROFILER_EVENTS (1 << 20)
+
+
+// Only created when initInfo->profiling is set before initialize(), every other function here does nothing without it
+// That way zones can be left in the code for good and cost next to nothing when nobody is looking
+int createProfiler(InitializingInfo *initInfo);
+void destroyProfiler(InitializingInfo *initInfo);
+
+// Called by beginFrame() once the GPU is done with this frame slot
+// The slot's queries were written maxFramesInFlight frames ago and have finished by now, so reading them back never stalls
+void collectProfilerFrame(InitializingInfo *initInfo);
+// Called first thing after beginning the frame's command buffer, resets this slot's queries for the new frame
+void beginProfilerFrame(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+// Called right before the frame is submitted, it's what lines the GPU's clock up with the CPU's
+void markProfilerSubmit(InitializingInfo *initInfo);
+
+// Zones are named with string literals (the profiler keeps the pointer) and have to be ended in the opposite order they're begun
+// CPU zones are timed on the calling thread, which has to be the main thread
+void beginCpuZone(InitializingInfo *initInfo, const char *name);
+void endCpuZone(InitializingInfo *initInfo);
+// GPU zones write a timestamp into commandBuffer at the start and end, they have to be outside of a render pass that uses secondary command buffers
+void beginGpuZone(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, const char *name);
+void endGpuZone(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+
+// Counts vertices, primitives and shader invocations for everything recorded in between, once per frame
+// Does nothing if the device doesn't support pipeline statistics queries
+void beginPipelineStatistics(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+void endPipelineStatistics(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+// Secondary command buffers recorded while the statistics query is running have to say so in their inheritance info
+VkQueryPipelineStatisticFlags getProfilerPipelineStatistics(InitializingInfo *initInfo);
+
+// The newest frame collectProfilerFrame() has read back, which is usually maxFramesInFlight frames behind the one being recorded
+ProfiledGpuFrame getLastProfiledGpuFrame(InitializingInfo *initInfo);
+
+// Writes every zone recorded so far as Chrome trace JSON, open it in chrome://tracing or https://ui.perfetto.dev
+// CPU zones end up on one track and GPU zones on another, with the pipeline statistics as counters
+int exportProfilerTrace(InitializingInfo *initInfo, const char *path);
+// Prints the average time per frame of every zone
+void printProfilerSummary(InitializingInfo *initInfo);
+
+
+#endif
@@ -1,2 +0,0 @@
-glslc ./shader.vert -o ./compiled/vert.spv
-glslc ./shader.frag -o ./compiled/frag.spv
\ No newline at end of file
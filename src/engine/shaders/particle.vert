@@ -0,0 +1,26 @@
+#version 450
+
+// One point per particle, read straight out of the buffers the compute passes wrote, so the CPU never touches them
+layout(std430, set = 0, binding = 5) readonly buffer Positions { vec2 positions[]; };
+layout(std430, set = 0, binding = 7) readonly buffer Lives { vec2 lives[]; };
+layout(std430, set = 0, binding = 8) readonly buffer Colors { uint colors[]; };
+
+layout(push_constant) uniform PushConstants {
+    vec2 viewportSize;
+} pushConstants;
+
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+    // Snapped to the middle of the canvas pixel it's in, so every particle lights up exactly one pixel
+    vec2 position = floor(positions[gl_VertexIndex]) + 0.5;
+
+    gl_Position = vec4(position / pushConstants.viewportSize * 2.0 - 1.0, 0.0, 1.0);
+    gl_PointSize = 1.0;
+
+    // Red in the lowest byte like sprite tints, fading out over the last quarter of its life
+    vec4 color = unpackUnorm4x8(colors[gl_VertexIndex]);
+    vec2 life = lives[gl_VertexIndex];
+    color.a *= clamp(life.x * life.y * 4.0, 0.0, 1.0);
+    fragColor = color;
+}
@@ -0,0 +1,31 @@
+#version 450
+
+// One texel per cell, the material in the low 6 bits and a shade in the top 2, see falling_sand.c
+layout(set = 0, binding = 0) uniform usampler2D cells;
+
+layout(push_constant) uniform PushConstants {
+    ivec2 camera; // The top left corner of the view in cells
+} pushConstants;
+
+layout(location = 0) out vec4 outColor;
+
+// Indexed by SandMaterial
+const vec4 MATERIAL_COLORS[4] = vec4[](
+    vec4(0.0, 0.0, 0.0, 0.0), // SAND_EMPTY
+    vec4(0.38, 0.36, 0.35, 1.0), // SAND_STONE
+    vec4(0.87, 0.73, 0.45, 1.0), // SAND_SAND
+    vec4(0.20, 0.42, 0.86, 0.75) // SAND_WATER
+);
+
+void main() {
+    // Every canvas pixel is one cell, so there's nothing to filter and no texture coordinates to work out
+    ivec2 cell = ivec2(gl_FragCoord.xy) + pushConstants.camera;
+    if (any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, textureSize(cells, 0)))) { discard; }
+
+    uint value = texelFetch(cells, cell, 0).r;
+    uint material = min(value & 63u, 3u);
+    if (material == 0u) { discard; }
+
+    float shade = 1.0 - float(value >> 6) * 0.06;
+    outColor = vec4(MATERIAL_COLORS[material].rgb * shade, MATERIAL_COLORS[material].a);
+}
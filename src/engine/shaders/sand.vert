@@ -0,0 +1,8 @@
+#version 450
+
+// One triangle twice the size of the screen, the part of it on screen covers every canvas pixel exactly once
+void main() {
+    vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
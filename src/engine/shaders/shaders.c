@@ -0,0 +1,46 @@
+#include "./shaders.h"
+
+#include "../globals/globals.h"
+#include "../asset_pack/asset_pack.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <string.h>
+
+
+const EmbeddedShader *findEmbeddedShader(const char * name) {
+    // There's only a handful of shaders, a linear search is plenty
+    for (uint32_t i = 0; i < EMBEDDED_SHADER_COUNT; i++) {
+        if (strcmp(EMBEDDED_SHADERS[i].name, name) == 0) { return &EMBEDDED_SHADERS[i]; }
+    }
+
+    return NULL;
+}
+
+VkShaderModule loadShaderModule(InitializingInfo *initInfo, const char * name) {
+    #ifdef SHADERS_FROM_DISK
+        char assetName[256];
+        snprintf(assetName, sizeof(assetName), "shaders/%s.spv", name);
+
+        Asset asset;
+        if (!loadAsset(initInfo, assetName, &asset)) { return VK_NULL_HANDLE; }
+
+        // Vulkan copies the code while creating the module, so the asset can be released right after
+        VkShaderModule shaderModule = createShaderModule(initInfo->device, asset.data, asset.size);
+        releaseAsset(&asset);
+
+        return shaderModule;
+    #else
+        const EmbeddedShader *shader = findEmbeddedShader(name);
+        if (shader == NULL) {
+            printf("No shader called %s was compiled in\n", name);
+            return VK_NULL_HANDLE;
+        }
+
+        return createShaderModule(initInfo->device, shader->code, shader->size);
+    #endif
+}
@@ -0,0 +1,34 @@
+#ifndef SHADERS
+#define SHADERS
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// The build compiles every .vert/.frag/.comp in this directory and embeds the SPIR-V, see cmake/embed_spirv.cmake
+// name is the source file's name, like "sprite.vert"
+typedef struct {
+    const char * name;
+    const uint32_t *code;
+    size_t size; // In bytes
+} EmbeddedShader;
+
+// Both defined in the generated embedded_shaders.c
+extern const EmbeddedShader EMBEDDED_SHADERS[];
+extern const uint32_t EMBEDDED_SHADER_COUNT;
+
+
+// Returns NULL if nothing called name was compiled into the binary
+const EmbeddedShader *findEmbeddedShader(const char * name);
+
+// Creates a module from the embedded SPIR-V, so no files are touched
+// Configuring with -DPIXEL_ENGINE_SHADERS_FROM_DISK=ON loads "shaders/<name>.spv" through loadAsset() instead,
+// which lets you rebuild just the shaders target and restart without relinking
+VkShaderModule loadShaderModule(InitializingInfo *initInfo, const char * name);
+
+
+#endif
@@ -0,0 +1,17 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec4 fragTint;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTextureId;
+
+// Every registered texture, see bindless_textures.h. Slot 0 is a single white texel
+layout(set = 0, binding = 0) uniform sampler textureSampler;
+layout(set = 0, binding = 1) uniform texture2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // One draw call can cover sprites with any number of textures, so the index isn't the same across an invocation group
+    outColor = fragTint * texture(sampler2D(textures[nonuniformEXT(fragTextureId)], textureSampler), fragUV);
+}
@@ -0,0 +1,27 @@
+#version 450
+
+// Every sprite is one instance, and its four corners come from gl_VertexIndex drawn as a triangle strip
+layout(location = 0) in vec4 inRect; // x, y, width, height in pixels
+layout(location = 1) in vec4 inUV; // u0, v0, u1, v1
+layout(location = 2) in vec4 inTint;
+layout(location = 3) in float inLayer;
+layout(location = 4) in uint inTextureId;
+
+layout(push_constant) uniform PushConstants {
+    vec2 viewportSize;
+    vec2 offset; // Added to every sprite's position, the tilemap uses it to place chunks relative to the camera
+} pushConstants;
+
+layout(location = 0) out vec4 fragTint;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTextureId;
+
+void main() {
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 position = inRect.xy + corner * inRect.zw + pushConstants.offset;
+
+    gl_Position = vec4(position / pushConstants.viewportSize * 2.0 - 1.0, inLayer, 1.0);
+    fragTint = inTint;
+    fragUV = mix(inUV.xy, inUV.zw, corner);
+    fragTextureId = inTextureId;
+}
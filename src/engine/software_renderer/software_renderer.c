@@ -0,0 +1,817 @@
+#include "./software_renderer.h"
+
+#include "../globals/globals.h"
+#include "../sprite_batch/sprite_batch.h"
+#include "../canvas/canvas.h"
+#include "../thread_pool/thread_pool.h"
+#include "../bindless_textures/bindless_textures.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <string.h>
+
+// Same setup as the collision masks: SSE2 is part of x86-64 so it's always there, AVX2 is compiled in for just the kernels that use it
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SOFTWARE_RENDERER_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(SOFTWARE_RENDERER_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define SOFTWARE_RENDERER_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+
+// The canvas is always opaque, so blending only works out the color channels and every pixel's alpha stays at this
+#define SOFTWARE_OPAQUE 0xFF000000u
+// Canvas pixels are cleared to opaque black, the same as the render pass's clear color
+#define SOFTWARE_CLEAR_COLOR 0xFF000000u
+// The integer scale kernels only unroll up to this
+#define MAX_SOFTWARE_SCALE_UNROLL 8
+
+typedef enum {
+    SOFTWARE_DRAW_SPRITES,
+    SOFTWARE_DRAW_IMAGE
+} SoftwareDrawType;
+
+// What a command buffer would hold on the GPU path, filled in on the main thread and only read by the band jobs
+typedef struct {
+    SoftwareDrawType type;
+
+    const SpriteInstance *sprites;
+    uint32_t spriteCount;
+    float offsetX, offsetY;
+
+    const uint8_t *indices;
+    uint32_t stride;
+    int32_t x, y;
+    uint32_t width, height;
+    const uint32_t *palette;
+} SoftwareDraw;
+
+// What registerSoftwareTexture() keeps, in the canvas's 0xAARRGGBB order so sampling never has to swap channels
+typedef struct {
+    uint32_t *pixels;
+    uint32_t width, height;
+} SoftwareTexture;
+
+// Blends color over count pixels, or just writes it when it's opaque
+typedef void (*BlendRowFunction)(uint32_t *row, uint32_t count, uint32_t color);
+// Looks every index up in palette and blends the result over the pixel under it
+typedef void (*PaletteRowFunction)(uint32_t *row, const uint8_t *indices, uint32_t count, const uint32_t *palette);
+// Writes every source pixel scale times in a row, count * scale pixels in all
+typedef void (*ScaleRowFunction)(uint32_t *destination, const uint32_t *source, uint32_t count, uint32_t scale);
+// Pixel i gets the texel at u + step * i out of one row of a texture, picked and clamped to the edge like the sprite shader's sampler
+// Each texel is multiplied by color and then blended over the pixel under it by its own alpha
+typedef void (*TextureRowFunction)(uint32_t *row, const uint32_t *texels, uint32_t textureWidth, float u, float step, uint32_t count, uint32_t color);
+
+struct SoftwareRenderer {
+    uint32_t *pixels;
+
+    SoftwareDraw *draws;
+    uint32_t drawsCount;
+    uint32_t drawsCapacity;
+    uint32_t spritesAdded;
+
+    // Indexed by textureId like the bindless array, slot WHITE_TEXTURE_ID is never filled since those sprites are drawn as flat rectangles
+    SoftwareTexture *textures;
+    uint32_t texturesCount;
+
+    // Where this frame's bands get scaled to, set up on the main thread before the bands are drawn
+    // presentPixels is NULL when the window surface isn't a format we can write straight into, then SDL does the scaling afterwards
+    uint8_t *presentPixels;
+    int presentPitch;
+    SDL_Rect presentRect;
+    uint32_t presentScale;
+
+    // The canvas wrapped up as a surface, for when SDL does the scaling
+    SDL_Surface *canvasSurface;
+    // The window surface changes when the window is resized, the black bars around the canvas only get filled in when it does
+    SDL_Surface *lastWindowSurface;
+    int lastWindowWidth, lastWindowHeight;
+
+    SoftwareRendererStats stats;
+};
+
+
+BlendRowFunction blendSoftwareRow;
+PaletteRowFunction blendSoftwarePaletteRow;
+ScaleRowFunction scaleSoftwareRow;
+TextureRowFunction blendSoftwareTextureRow;
+
+
+// Exact rounding of t / 255 for anything up to 255 * 255, the same shifts and adds work 8 or 16 lanes at a time below
+uint32_t divideBy255(uint32_t t) {
+    t += 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// The sprite pipeline's blend: source * alpha + destination * (1 - alpha) for the colors, and the canvas stays opaque
+uint32_t blendSoftwarePixel(uint32_t source, uint32_t destination) {
+    uint32_t alpha = source >> 24;
+    uint32_t inverse = 255 - alpha;
+
+    uint32_t red = divideBy255(((source >> 16) & 0xFF) * alpha + ((destination >> 16) & 0xFF) * inverse);
+    uint32_t green = divideBy255(((source >> 8) & 0xFF) * alpha + ((destination >> 8) & 0xFF) * inverse);
+    uint32_t blue = divideBy255((source & 0xFF) * alpha + (destination & 0xFF) * inverse);
+
+    return SOFTWARE_OPAQUE | red << 16 | green << 8 | blue;
+}
+
+// SpriteInstance tints are RGBA with red in the lowest byte, the canvas has blue there instead
+uint32_t softwareColorFromTint(uint32_t tint) {
+    return (tint & 0xFF00FF00u) | (tint & 0xFF) << 16 | (tint >> 16 & 0xFF);
+}
+
+// Every channel of texel times the same channel of color, what the sprite shader's fragTint * texture() does
+uint32_t modulateSoftwarePixel(uint32_t texel, uint32_t color) {
+    uint32_t alpha = divideBy255((texel >> 24) * (color >> 24));
+    uint32_t red = divideBy255(((texel >> 16) & 0xFF) * ((color >> 16) & 0xFF));
+    uint32_t green = divideBy255(((texel >> 8) & 0xFF) * ((color >> 8) & 0xFF));
+    uint32_t blue = divideBy255((texel & 0xFF) * (color & 0xFF));
+
+    return alpha << 24 | red << 16 | green << 8 | blue;
+}
+
+// The nearest texel to coordinate position, clamped to [0, size - 1] like a CLAMP_TO_EDGE sampler
+// Written to give the same answer as the min and max instructions the row kernels use, NaN included
+uint32_t softwareTexelIndex(float position, uint32_t size) {
+    float last = (float)(size - 1);
+    position = position > 0.0f ? position : 0.0f;
+    position = position < last ? position : last;
+
+    return (uint32_t)position;
+}
+
+
+void fillSoftwareRow(uint32_t *row, uint32_t count, uint32_t color) {
+    // Simple enough that the compiler turns it into wide stores on its own
+    for (uint32_t i = 0; i < count; i++) { row[i] = color; }
+}
+
+void blendSoftwareRowScalar(uint32_t *row, uint32_t count, uint32_t color) {
+    if (color >> 24 == 0xFF) {
+        fillSoftwareRow(row, count, color);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) { row[i] = blendSoftwarePixel(color, row[i]); }
+}
+
+void blendSoftwarePaletteRowScalar(uint32_t *row, const uint8_t *indices, uint32_t count, const uint32_t *palette) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t color = palette[indices[i]];
+        if (color >> 24 == 0) { continue; }
+
+        row[i] = blendSoftwarePixel(color, row[i]);
+    }
+}
+
+void scaleSoftwareRowScalar(uint32_t *destination, const uint32_t *source, uint32_t count, uint32_t scale) {
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t k = 0; k < scale; k++) { *destination++ = source[i]; }
+    }
+}
+
+// Pixels first to end - 1 of the row, so the wide kernels can finish their leftovers with exactly the same positions they'd have worked out
+void blendSoftwareTextureRangeScalar(uint32_t *row, const uint32_t *texels, uint32_t textureWidth, float u, float step, uint32_t first, uint32_t end, uint32_t color) {
+    for (uint32_t i = first; i < end; i++) {
+        uint32_t texel = texels[softwareTexelIndex(u + step * (float)i, textureWidth)];
+        if (color != 0xFFFFFFFFu) { texel = modulateSoftwarePixel(texel, color); }
+        if (texel >> 24 == 0) { continue; }
+
+        row[i] = blendSoftwarePixel(texel, row[i]);
+    }
+}
+
+void blendSoftwareTextureRowScalar(uint32_t *row, const uint32_t *texels, uint32_t textureWidth, float u, float step, uint32_t count, uint32_t color) {
+    blendSoftwareTextureRangeScalar(row, texels, textureWidth, u, step, 0, count, color);
+}
+
+
+#ifdef SOFTWARE_RENDERER_SSE2
+// Each pixel's four channels are widened to 16 bits, so t = source * alpha + destination * (255 - alpha) + 128 fits in a lane and divideBy255() is two shifts and an add
+__m128i blendChannelsSSE2(__m128i destination, __m128i inverse, __m128i sourceTerm) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(destination, inverse), sourceTerm);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+void blendSoftwareRowSSE2(uint32_t *row, uint32_t count, uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if (alpha == 0xFF) {
+        fillSoftwareRow(row, count, color);
+        return;
+    }
+
+    // The source's share is the same for every pixel, so it's worked out once
+    __m128i zero = _mm_setzero_si128();
+    __m128i inverse = _mm_set1_epi16((short)(255 - alpha));
+    __m128i sourceTerm = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero), _mm_set1_epi16((short)alpha)), _mm_set1_epi16(128));
+    __m128i opaque = _mm_set1_epi32((int)SOFTWARE_OPAQUE);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i destination = _mm_loadu_si128((const __m128i *)(row + i));
+        __m128i low = blendChannelsSSE2(_mm_unpacklo_epi8(destination, zero), inverse, sourceTerm);
+        __m128i high = blendChannelsSSE2(_mm_unpackhi_epi8(destination, zero), inverse, sourceTerm);
+
+        _mm_storeu_si128((__m128i *)(row + i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+    }
+
+    blendSoftwareRowScalar(row + i, count - i, color);
+}
+
+// Two pixels' worth of 16 bit channels, blended by each pixel's own alpha
+__m128i blendPixelsSSE2(__m128i source, __m128i destination) {
+    // Copies each pixel's alpha into all four of its lanes
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, 0xFF), 0xFF);
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    __m128i sourceTerm = _mm_add_epi16(_mm_mullo_epi16(source, alpha), _mm_set1_epi16(128));
+
+    return blendChannelsSSE2(destination, inverse, sourceTerm);
+}
+
+void blendSoftwarePaletteRowSSE2(uint32_t *row, const uint8_t *indices, uint32_t count, const uint32_t *palette) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i opaque = _mm_set1_epi32((int)SOFTWARE_OPAQUE);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // No gathers before AVX2, so the lookups are plain loads
+        __m128i source = _mm_setr_epi32((int)palette[indices[i]], (int)palette[indices[i + 1]], (int)palette[indices[i + 2]], (int)palette[indices[i + 3]]);
+        // Four see-through pixels in a row (like the empty cells of a sand world) leave the canvas as it is
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(source, opaque), zero)) == 0xFFFF) { continue; }
+
+        __m128i destination = _mm_loadu_si128((const __m128i *)(row + i));
+        __m128i low = blendPixelsSSE2(_mm_unpacklo_epi8(source, zero), _mm_unpacklo_epi8(destination, zero));
+        __m128i high = blendPixelsSSE2(_mm_unpackhi_epi8(source, zero), _mm_unpackhi_epi8(destination, zero));
+
+        _mm_storeu_si128((__m128i *)(row + i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+    }
+
+    blendSoftwarePaletteRowScalar(row + i, indices + i, count - i, palette);
+}
+
+void blendSoftwareTextureRowSSE2(uint32_t *row, const uint32_t *texels, uint32_t textureWidth, float u, float step, uint32_t count, uint32_t color) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i opaque = _mm_set1_epi32((int)SOFTWARE_OPAQUE);
+    // Multiplying by the tint is a blend with no destination, rounded the same way
+    __m128i tint = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    __m128i rounding = _mm_set1_epi16(128);
+    bool tinted = color != 0xFFFFFFFFu;
+
+    __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 last = _mm_set1_ps((float)(textureWidth - 1));
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 positions = _mm_add_ps(_mm_set1_ps(u), _mm_mul_ps(_mm_set1_ps(step), _mm_add_ps(_mm_set1_ps((float)i), lanes)));
+        uint32_t lookups[4];
+        _mm_storeu_si128((__m128i *)lookups, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(positions, _mm_setzero_ps()), last)));
+
+        __m128i source = _mm_setr_epi32((int)texels[lookups[0]], (int)texels[lookups[1]], (int)texels[lookups[2]], (int)texels[lookups[3]]);
+        if (tinted) {
+            source = _mm_packus_epi16(blendChannelsSSE2(_mm_unpacklo_epi8(source, zero), tint, rounding), blendChannelsSSE2(_mm_unpackhi_epi8(source, zero), tint, rounding));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(source, opaque), zero)) == 0xFFFF) { continue; }
+
+        __m128i destination = _mm_loadu_si128((const __m128i *)(row + i));
+        __m128i low = blendPixelsSSE2(_mm_unpacklo_epi8(source, zero), _mm_unpacklo_epi8(destination, zero));
+        __m128i high = blendPixelsSSE2(_mm_unpackhi_epi8(source, zero), _mm_unpackhi_epi8(destination, zero));
+
+        _mm_storeu_si128((__m128i *)(row + i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+    }
+
+    blendSoftwareTextureRangeScalar(row, texels, textureWidth, u, step, i, count, color);
+}
+
+// Four source pixels become scale stores of four, the shuffles need their patterns at compile time so only the common scales get one
+void scaleSoftwareRowSSE2(uint32_t *destination, const uint32_t *source, uint32_t count, uint32_t scale) {
+    if (scale == 1) {
+        memcpy(destination, source, count * sizeof(uint32_t));
+        return;
+    }
+    if (scale > 4) {
+        scaleSoftwareRowScalar(destination, source, count, scale);
+        return;
+    }
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(source + i));
+        __m128i *out = (__m128i *)(destination + i * scale);
+
+        if (scale == 2) {
+            _mm_storeu_si128(out, _mm_unpacklo_epi32(pixels, pixels));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(pixels, pixels));
+        } else if (scale == 3) {
+            _mm_storeu_si128(out, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 0, 0, 0)));
+            _mm_storeu_si128(out + 1, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 1, 1)));
+            _mm_storeu_si128(out + 2, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 2)));
+        } else {
+            _mm_storeu_si128(out, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 0, 0, 0)));
+            _mm_storeu_si128(out + 1, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 1, 1, 1)));
+            _mm_storeu_si128(out + 2, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 2, 2)));
+            _mm_storeu_si128(out + 3, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+    }
+
+    scaleSoftwareRowScalar(destination + i * scale, source + i, count - i, scale);
+}
+#endif
+
+
+#ifdef SOFTWARE_RENDERER_AVX2
+// Unpacking and packing both stay inside each 128 bit half, so the pixels come back out in the order they went in
+TARGET_AVX2 __m256i blendChannelsAVX2(__m256i destination, __m256i inverse, __m256i sourceTerm) {
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(destination, inverse), sourceTerm);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+TARGET_AVX2 void blendSoftwareRowAVX2(uint32_t *row, uint32_t count, uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if (alpha == 0xFF) {
+        fillSoftwareRow(row, count, color);
+        return;
+    }
+
+    __m256i zero = _mm256_setzero_si256();
+    __m256i inverse = _mm256_set1_epi16((short)(255 - alpha));
+    __m256i sourceTerm = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero), _mm256_set1_epi16((short)alpha)), _mm256_set1_epi16(128));
+    __m256i opaque = _mm256_set1_epi32((int)SOFTWARE_OPAQUE);
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i destination = _mm256_loadu_si256((const __m256i *)(row + i));
+        __m256i low = blendChannelsAVX2(_mm256_unpacklo_epi8(destination, zero), inverse, sourceTerm);
+        __m256i high = blendChannelsAVX2(_mm256_unpackhi_epi8(destination, zero), inverse, sourceTerm);
+
+        _mm256_storeu_si256((__m256i *)(row + i), _mm256_or_si256(_mm256_packus_epi16(low, high), opaque));
+    }
+
+    blendSoftwareRowScalar(row + i, count - i, color);
+}
+
+TARGET_AVX2 __m256i blendPixelsAVX2(__m256i source, __m256i destination) {
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source, 0xFF), 0xFF);
+    __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+    __m256i sourceTerm = _mm256_add_epi16(_mm256_mullo_epi16(source, alpha), _mm256_set1_epi16(128));
+
+    return blendChannelsAVX2(destination, inverse, sourceTerm);
+}
+
+TARGET_AVX2 void blendSoftwarePaletteRowAVX2(uint32_t *row, const uint8_t *indices, uint32_t count, const uint32_t *palette) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i opaque = _mm256_set1_epi32((int)SOFTWARE_OPAQUE);
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Eight indices widened to 32 bits and looked up with one gather
+        __m256i lookups = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indices + i)));
+        __m256i source = _mm256_i32gather_epi32((const int *)palette, lookups, 4);
+        if (_mm256_testz_si256(source, opaque)) { continue; }
+
+        __m256i destination = _mm256_loadu_si256((const __m256i *)(row + i));
+        __m256i low = blendPixelsAVX2(_mm256_unpacklo_epi8(source, zero), _mm256_unpacklo_epi8(destination, zero));
+        __m256i high = blendPixelsAVX2(_mm256_unpackhi_epi8(source, zero), _mm256_unpackhi_epi8(destination, zero));
+
+        _mm256_storeu_si256((__m256i *)(row + i), _mm256_or_si256(_mm256_packus_epi16(low, high), opaque));
+    }
+
+    blendSoftwarePaletteRowScalar(row + i, indices + i, count - i, palette);
+}
+
+TARGET_AVX2 void blendSoftwareTextureRowAVX2(uint32_t *row, const uint32_t *texels, uint32_t textureWidth, float u, float step, uint32_t count, uint32_t color) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i opaque = _mm256_set1_epi32((int)SOFTWARE_OPAQUE);
+    __m256i tint = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero);
+    __m256i rounding = _mm256_set1_epi16(128);
+    bool tinted = color != 0xFFFFFFFFu;
+
+    __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 last = _mm256_set1_ps((float)(textureWidth - 1));
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Eight texel positions worked out at once and fetched with one gather
+        __m256 positions = _mm256_add_ps(_mm256_set1_ps(u), _mm256_mul_ps(_mm256_set1_ps(step), _mm256_add_ps(_mm256_set1_ps((float)i), lanes)));
+        __m256i lookups = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(positions, _mm256_setzero_ps()), last));
+
+        __m256i source = _mm256_i32gather_epi32((const int *)texels, lookups, 4);
+        if (tinted) {
+            source = _mm256_packus_epi16(blendChannelsAVX2(_mm256_unpacklo_epi8(source, zero), tint, rounding), blendChannelsAVX2(_mm256_unpackhi_epi8(source, zero), tint, rounding));
+        }
+        if (_mm256_testz_si256(source, opaque)) { continue; }
+
+        __m256i destination = _mm256_loadu_si256((const __m256i *)(row + i));
+        __m256i low = blendPixelsAVX2(_mm256_unpacklo_epi8(source, zero), _mm256_unpacklo_epi8(destination, zero));
+        __m256i high = blendPixelsAVX2(_mm256_unpackhi_epi8(source, zero), _mm256_unpackhi_epi8(destination, zero));
+
+        _mm256_storeu_si256((__m256i *)(row + i), _mm256_or_si256(_mm256_packus_epi16(low, high), opaque));
+    }
+
+    blendSoftwareTextureRangeScalar(row, texels, textureWidth, u, step, i, count, color);
+}
+
+// A cross lane permute can put any of the eight source pixels anywhere, so one table of indices per output vector covers every scale up to the unroll
+TARGET_AVX2 void scaleSoftwareRowAVX2(uint32_t *destination, const uint32_t *source, uint32_t count, uint32_t scale) {
+    if (scale == 1) {
+        memcpy(destination, source, count * sizeof(uint32_t));
+        return;
+    }
+    if (scale > MAX_SOFTWARE_SCALE_UNROLL) {
+        scaleSoftwareRowScalar(destination, source, count, scale);
+        return;
+    }
+
+    __m256i permutes[MAX_SOFTWARE_SCALE_UNROLL];
+    for (uint32_t k = 0; k < scale; k++) {
+        int32_t lanes[8];
+        for (uint32_t j = 0; j < 8; j++) { lanes[j] = (int32_t)((k * 8 + j) / scale); }
+        permutes[k] = _mm256_loadu_si256((const __m256i *)lanes);
+    }
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *)(source + i));
+        __m256i *out = (__m256i *)(destination + i * scale);
+
+        for (uint32_t k = 0; k < scale; k++) { _mm256_storeu_si256(out + k, _mm256_permutevar8x32_epi32(pixels, permutes[k])); }
+    }
+
+    scaleSoftwareRowScalar(destination + i * scale, source + i, count - i, scale);
+}
+#endif
+
+
+void selectSoftwareRendererRoutines(SoftwareRenderer *renderer) {
+    blendSoftwareRow = blendSoftwareRowScalar;
+    blendSoftwarePaletteRow = blendSoftwarePaletteRowScalar;
+    scaleSoftwareRow = scaleSoftwareRowScalar;
+    blendSoftwareTextureRow = blendSoftwareTextureRowScalar;
+    renderer->stats.kernels = "plain C";
+
+#ifdef SOFTWARE_RENDERER_SSE2
+    if (SDL_HasSSE2()) {
+        blendSoftwareRow = blendSoftwareRowSSE2;
+        blendSoftwarePaletteRow = blendSoftwarePaletteRowSSE2;
+        scaleSoftwareRow = scaleSoftwareRowSSE2;
+        blendSoftwareTextureRow = blendSoftwareTextureRowSSE2;
+        renderer->stats.kernels = "SSE2";
+    }
+#endif
+#ifdef SOFTWARE_RENDERER_AVX2
+    if (SDL_HasAVX2()) {
+        blendSoftwareRow = blendSoftwareRowAVX2;
+        blendSoftwarePaletteRow = blendSoftwarePaletteRowAVX2;
+        scaleSoftwareRow = scaleSoftwareRowAVX2;
+        blendSoftwareTextureRow = blendSoftwareTextureRowAVX2;
+        renderer->stats.kernels = "AVX2";
+    }
+#endif
+}
+
+
+int createSoftwareCanvas(InitializingInfo *initInfo, SoftwareRenderer *renderer) {
+    uint32_t width = initInfo->canvasExtent.width;
+    uint32_t height = initInfo->canvasExtent.height;
+
+    renderer->pixels = malloc((size_t)width * height * sizeof(uint32_t));
+    if (renderer->pixels == NULL) { return EXIT_FAILURE; }
+    fillSoftwareRow(renderer->pixels, width * height, SOFTWARE_CLEAR_COLOR);
+
+    // Shares the pixels rather than copying them, so it never needs updating
+    renderer->canvasSurface = SDL_CreateRGBSurfaceWithFormatFrom(renderer->pixels, (int)width, (int)height, 32, (int)(width * sizeof(uint32_t)), SDL_PIXELFORMAT_ARGB8888);
+    if (renderer->canvasSurface == NULL) { return EXIT_FAILURE; }
+
+    // A different canvas size means different bars around it
+    renderer->lastWindowSurface = NULL;
+
+    return EXIT_SUCCESS;
+}
+
+void destroySoftwareCanvas(SoftwareRenderer *renderer) {
+    if (renderer->canvasSurface != NULL) { SDL_FreeSurface(renderer->canvasSurface); }
+    free(renderer->pixels);
+
+    renderer->canvasSurface = NULL;
+    renderer->pixels = NULL;
+}
+
+int createSoftwareRenderer(InitializingInfo *initInfo) {
+    if (initInfo->canvasExtent.width == 0 || initInfo->canvasExtent.height == 0) {
+        initInfo->canvasExtent = (VkExtent2D){ .width = DEFAULT_CANVAS_WIDTH, .height = DEFAULT_CANVAS_HEIGHT };
+    }
+
+    SoftwareRenderer *renderer = calloc(1, sizeof(SoftwareRenderer));
+    initInfo->softwareRenderer = renderer;
+
+    selectSoftwareRendererRoutines(renderer);
+    if (createSoftwareCanvas(initInfo, renderer) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    // Registered textures start after the white one, the same as on the GPU
+    renderer->texturesCount = WHITE_TEXTURE_ID + 1;
+    renderer->textures = calloc(renderer->texturesCount, sizeof(SoftwareTexture));
+    if (renderer->textures == NULL) { return EXIT_FAILURE; }
+
+    printf("Rendering on the CPU into a %ux%u canvas with the %s kernels\n", initInfo->canvasExtent.width, initInfo->canvasExtent.height, renderer->stats.kernels);
+
+    return EXIT_SUCCESS;
+}
+
+void destroySoftwareRenderer(InitializingInfo *initInfo) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    if (renderer == NULL) { return; }
+
+    destroySoftwareCanvas(renderer);
+    for (uint32_t i = 0; i < renderer->texturesCount; i++) { free(renderer->textures[i].pixels); }
+    free(renderer->textures);
+    free(renderer->draws);
+    free(renderer);
+    initInfo->softwareRenderer = NULL;
+}
+
+int resizeSoftwareCanvas(InitializingInfo *initInfo, uint32_t width, uint32_t height) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+
+    // Frames are finished by the time endFrame() returns, so there's nothing to wait for
+    destroySoftwareCanvas(renderer);
+    initInfo->canvasExtent = (VkExtent2D){ .width = width, .height = height };
+
+    return createSoftwareCanvas(initInfo, renderer);
+}
+
+
+uint32_t registerSoftwareTexture(InitializingInfo *initInfo, uint32_t *pixels, uint32_t width, uint32_t height) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    if (pixels == NULL || width == 0 || height == 0) { return UINT32_MAX; }
+
+    // Textures only come and go while loading, so a search for a free slot is cheap enough
+    uint32_t textureId = WHITE_TEXTURE_ID + 1;
+    while (textureId < renderer->texturesCount && renderer->textures[textureId].pixels != NULL) { textureId++; }
+
+    if (textureId == renderer->texturesCount) {
+        SoftwareTexture *textures = realloc(renderer->textures, (renderer->texturesCount + 1) * sizeof(SoftwareTexture));
+        if (textures == NULL) { return UINT32_MAX; }
+
+        renderer->textures = textures;
+        renderer->texturesCount++;
+    }
+
+    renderer->textures[textureId] = (SoftwareTexture){ .pixels = pixels, .width = width, .height = height };
+
+    return textureId;
+}
+
+void unregisterSoftwareTexture(InitializingInfo *initInfo, uint32_t textureId) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    if (renderer == NULL || textureId == WHITE_TEXTURE_ID || textureId >= renderer->texturesCount) { return; }
+
+    // Every frame is finished before endFrame() returns, so nothing can still be drawing with it
+    free(renderer->textures[textureId].pixels);
+    renderer->textures[textureId] = (SoftwareTexture){  };
+}
+
+
+SoftwareDraw *addSoftwareDraw(SoftwareRenderer *renderer) {
+    if (renderer->drawsCount == renderer->drawsCapacity) {
+        renderer->drawsCapacity = renderer->drawsCapacity == 0 ? 64 : renderer->drawsCapacity * 2;
+        renderer->draws = realloc(renderer->draws, renderer->drawsCapacity * sizeof(SoftwareDraw));
+    }
+
+    return &renderer->draws[renderer->drawsCount++];
+}
+
+void addSoftwareSprites(InitializingInfo *initInfo, const SpriteInstance *sprites, uint32_t count, float offsetX, float offsetY) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    if (count == 0) { return; }
+
+    *addSoftwareDraw(renderer) = (SoftwareDraw){
+        .type = SOFTWARE_DRAW_SPRITES,
+        .sprites = sprites,
+        .spriteCount = count,
+        .offsetX = offsetX,
+        .offsetY = offsetY
+    };
+    renderer->spritesAdded += count;
+}
+
+void addSoftwareImage(InitializingInfo *initInfo, const uint8_t *indices, uint32_t stride, int32_t x, int32_t y, uint32_t width, uint32_t height, const uint32_t *palette) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    if (width == 0 || height == 0) { return; }
+
+    *addSoftwareDraw(renderer) = (SoftwareDraw){
+        .type = SOFTWARE_DRAW_IMAGE,
+        .indices = indices,
+        .stride = stride,
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+        .palette = palette
+    };
+}
+
+
+// Which of a span's pixels have their centers inside it, the same rule the GPU uses, clamped to [0, limit)
+// Sprites can have a negative size to flip them, so either end can be the left one
+bool softwareCoverage(float start, float size, uint32_t limit, int32_t *first, int32_t *end) {
+    float low = size < 0.0f ? start + size : start;
+    float high = size < 0.0f ? start : start + size;
+
+    float firstPixel = ceilf(low - 0.5f);
+    float endPixel = ceilf(high - 0.5f);
+    firstPixel = CLAMP(firstPixel, 0.0f, (float)limit);
+    endPixel = CLAMP(endPixel, 0.0f, (float)limit);
+
+    *first = (int32_t)firstPixel;
+    *end = (int32_t)endPixel;
+
+    return *first < *end;
+}
+
+// NULL for WHITE_TEXTURE_ID and anything that isn't registered, which the GPU would draw white too
+const SoftwareTexture *getSoftwareTexture(SoftwareRenderer *renderer, uint32_t textureId) {
+    if (textureId == WHITE_TEXTURE_ID || textureId >= renderer->texturesCount) { return NULL; }
+
+    return renderer->textures[textureId].pixels != NULL ? &renderer->textures[textureId] : NULL;
+}
+
+void drawSoftwareSprites(InitializingInfo *initInfo, const SoftwareDraw *draw, uint32_t firstRow, uint32_t endRow) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    uint32_t width = initInfo->canvasExtent.width;
+
+    for (uint32_t i = 0; i < draw->spriteCount; i++) {
+        const SpriteInstance *sprite = &draw->sprites[i];
+        if (sprite->tint >> 24 == 0) { continue; }
+
+        float left = sprite->x + draw->offsetX;
+        float top = sprite->y + draw->offsetY;
+
+        int32_t firstX, endX, firstY, endY;
+        if (!softwareCoverage(top, sprite->height, endRow, &firstY, &endY)) { continue; }
+        if (endY <= (int32_t)firstRow) { continue; }
+        if (!softwareCoverage(left, sprite->width, width, &firstX, &endX)) { continue; }
+        if (firstY < (int32_t)firstRow) { firstY = (int32_t)firstRow; }
+
+        uint32_t color = softwareColorFromTint(sprite->tint);
+        const SoftwareTexture *texture = getSoftwareTexture(renderer, sprite->textureId);
+
+        // White times the tint is just the tint, so there's nothing to sample
+        if (texture == NULL) {
+            for (int32_t y = firstY; y < endY; y++) {
+                blendSoftwareRow(renderer->pixels + (size_t)y * width + firstX, (uint32_t)(endX - firstX), color);
+            }
+            continue;
+        }
+
+        // The UVs go from u0, v0 at the top left corner to u1, v1 at the bottom right, sampled at each pixel's center like the GPU interpolates them
+        // Across a row only u changes, so each row is one run of texels with a fixed step in between
+        float uStep = (sprite->u1 - sprite->u0) / sprite->width * (float)texture->width;
+        float u = (sprite->u0 + (sprite->u1 - sprite->u0) * (((float)firstX + 0.5f - left) / sprite->width)) * (float)texture->width;
+
+        for (int32_t y = firstY; y < endY; y++) {
+            float v = (sprite->v0 + (sprite->v1 - sprite->v0) * (((float)y + 0.5f - top) / sprite->height)) * (float)texture->height;
+            const uint32_t *texels = texture->pixels + (size_t)softwareTexelIndex(v, texture->height) * texture->width;
+
+            blendSoftwareTextureRow(renderer->pixels + (size_t)y * width + firstX, texels, texture->width, u, uStep, (uint32_t)(endX - firstX), color);
+        }
+    }
+}
+
+void drawSoftwareImage(InitializingInfo *initInfo, const SoftwareDraw *draw, uint32_t firstRow, uint32_t endRow) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    uint32_t width = initInfo->canvasExtent.width;
+
+    // Worked out in 64 bits so images hanging far off the canvas can't overflow
+    int64_t firstX = draw->x > 0 ? draw->x : 0;
+    int64_t endX = (int64_t)draw->x + draw->width < width ? (int64_t)draw->x + draw->width : width;
+    int64_t firstY = draw->y > (int64_t)firstRow ? draw->y : firstRow;
+    int64_t endY = (int64_t)draw->y + draw->height < endRow ? (int64_t)draw->y + draw->height : endRow;
+    if (firstX >= endX || firstY >= endY) { return; }
+
+    for (int64_t y = firstY; y < endY; y++) {
+        const uint8_t *indices = draw->indices + (size_t)(y - draw->y) * draw->stride + (firstX - draw->x);
+        blendSoftwarePaletteRow(renderer->pixels + (size_t)y * width + firstX, indices, (uint32_t)(endX - firstX), draw->palette);
+    }
+}
+
+// Runs on the thread pool, every band only ever writes its own rows of the canvas and of the window surface
+void drawSoftwareBands(uint32_t first, uint32_t count, void *data) {
+    InitializingInfo *initInfo = data;
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    uint32_t width = initInfo->canvasExtent.width;
+    uint32_t height = initInfo->canvasExtent.height;
+
+    for (uint32_t band = first; band < first + count; band++) {
+        uint32_t firstRow = band * SOFTWARE_BAND_HEIGHT;
+        uint32_t endRow = firstRow + SOFTWARE_BAND_HEIGHT < height ? firstRow + SOFTWARE_BAND_HEIGHT : height;
+
+        fillSoftwareRow(renderer->pixels + (size_t)firstRow * width, (endRow - firstRow) * width, SOFTWARE_CLEAR_COLOR);
+
+        for (uint32_t i = 0; i < renderer->drawsCount; i++) {
+            const SoftwareDraw *draw = &renderer->draws[i];
+
+            if (draw->type == SOFTWARE_DRAW_SPRITES) { drawSoftwareSprites(initInfo, draw, firstRow, endRow); }
+            else { drawSoftwareImage(initInfo, draw, firstRow, endRow); }
+        }
+
+        if (renderer->presentPixels == NULL) { continue; }
+
+        // Each canvas row is scaled once, and the copies below it are straight memcpys of that
+        uint32_t scale = renderer->presentScale;
+        size_t scaledBytes = (size_t)width * scale * sizeof(uint32_t);
+        for (uint32_t y = firstRow; y < endRow; y++) {
+            uint8_t *destination = renderer->presentPixels + (size_t)(renderer->presentRect.y + y * scale) * renderer->presentPitch + (size_t)renderer->presentRect.x * sizeof(uint32_t);
+            scaleSoftwareRow((uint32_t *)destination, renderer->pixels + (size_t)y * width, width, scale);
+
+            for (uint32_t k = 1; k < scale; k++) { memcpy(destination + (size_t)k * renderer->presentPitch, destination, scaledBytes); }
+        }
+    }
+}
+
+
+// Can the bands write straight into this surface, 4 bytes a pixel with the channels where the canvas has them (alpha, if any, is ignored)
+bool isSoftwareSurfaceCompatible(const SDL_Surface *surface) {
+    const SDL_PixelFormat *format = surface->format;
+    return format->BytesPerPixel == 4 && format->Rmask == 0x00FF0000 && format->Gmask == 0x0000FF00 && format->Bmask == 0x000000FF;
+}
+
+int drawSoftwareFrame(InitializingInfo *initInfo) {
+    SoftwareRenderer *renderer = initInfo->softwareRenderer;
+    uint32_t bands = (initInfo->canvasExtent.height + SOFTWARE_BAND_HEIGHT - 1) / SOFTWARE_BAND_HEIGHT;
+
+    SDL_Surface *windowSurface = NULL;
+    renderer->presentPixels = NULL;
+    if (!initInfo->headless) {
+        // SDL hands back a new surface after the window is resized, the old one is gone by then
+        windowSurface = SDL_GetWindowSurface(initInfo->window);
+        if (windowSurface == NULL) {
+            printf("Couldn't get the window's surface: %s\n", SDL_GetError());
+            return EXIT_FAILURE;
+        }
+
+        // The window surface stands in for the swap chain, so getCanvasScreenRect() works the same as with Vulkan
+        initInfo->swapChainExtent = (VkExtent2D){ .width = (uint32_t)windowSurface->w, .height = (uint32_t)windowSurface->h };
+        VkRect2D screenRect = getCanvasScreenRect(initInfo);
+        renderer->presentRect = (SDL_Rect){ .x = screenRect.offset.x, .y = screenRect.offset.y, .w = (int)screenRect.extent.width, .h = (int)screenRect.extent.height };
+
+        if (windowSurface != renderer->lastWindowSurface || windowSurface->w != renderer->lastWindowWidth || windowSurface->h != renderer->lastWindowHeight) {
+            SDL_FillRect(windowSurface, NULL, SDL_MapRGB(windowSurface->format, 0, 0, 0));
+            renderer->lastWindowSurface = windowSurface;
+            renderer->lastWindowWidth = windowSurface->w;
+            renderer->lastWindowHeight = windowSurface->h;
+        }
+
+        // Whole number scales of a matching format get written straight into the window by the bands, anything else is left to SDL afterwards
+        renderer->presentScale = (uint32_t)renderer->presentRect.w / initInfo->canvasExtent.width;
+        if (renderer->presentScale >= 1 && isSoftwareSurfaceCompatible(windowSurface) && SDL_LockSurface(windowSurface) == 0) {
+            renderer->presentPixels = windowSurface->pixels;
+            renderer->presentPitch = windowSurface->pitch;
+        }
+    }
+
+    Uint64 rasterStart = SDL_GetPerformanceCounter();
+    parallelFor(initInfo, bands, 1, drawSoftwareBands, initInfo);
+    renderer->stats.rasterMs = elapsedMilliseconds(rasterStart);
+
+    renderer->stats.bands = bands;
+    renderer->stats.draws = renderer->drawsCount;
+    renderer->stats.spritesDrawn = renderer->spritesAdded;
+    renderer->drawsCount = 0;
+    renderer->spritesAdded = 0;
+
+    renderer->stats.presentMs = 0.0;
+    if (windowSurface == NULL) { return EXIT_SUCCESS; }
+
+    Uint64 presentStart = SDL_GetPerformanceCounter();
+    if (renderer->presentPixels != NULL) {
+        SDL_UnlockSurface(windowSurface);
+    } else if (renderer->presentRect.w > 0 && renderer->presentRect.h > 0) {
+        if (SDL_BlitScaled(renderer->canvasSurface, NULL, windowSurface, &renderer->presentRect) != 0) { return EXIT_FAILURE; }
+    }
+    if (SDL_UpdateWindowSurface(initInfo->window) != 0) { return EXIT_FAILURE; }
+    renderer->stats.presentMs = elapsedMilliseconds(presentStart);
+
+    return EXIT_SUCCESS;
+}
+
+
+const uint32_t *getSoftwarePixels(InitializingInfo *initInfo) {
+    return initInfo->softwareRenderer->pixels;
+}
+
+SoftwareRendererStats getSoftwareRendererStats(InitializingInfo *initInfo) {
+    return initInfo->softwareRenderer->stats;
+}
@@ -0,0 +1,64 @@
+#ifndef SOFTWARE_RENDERER
+#define SOFTWARE_RENDERER
+
+#include "../globals/globals.h"
+#include "../sprite_batch/sprite_batch.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdint.h>
+
+
+// How many canvas rows one job rasterizes, small enough that every thread gets a few bands and a band's rows stay in cache
+#define SOFTWARE_BAND_HEIGHT 16
+
+typedef struct {
+    const char *kernels; // Which row kernels this CPU got, "AVX2", "SSE2" or "plain C"
+    // For the last frame that was drawn
+    uint32_t bands;
+    uint32_t draws; // Runs of sprites and images, the software version of draw calls
+    uint32_t spritesDrawn;
+    double rasterMs; // Clearing, drawing and scaling onto the window surface, across the thread pool
+    double presentMs; // Handing the window surface over to SDL
+} SoftwareRendererStats;
+
+
+/*
+The CPU renderer, used when there's no usable Vulkan device (or softwareRendering is set before initialize())
+It draws the same scene as the GPU path, sand world then tilemap then sprites, into a canvas of 0xAARRGGBB pixels in ordinary memory
+The canvas is split into bands of rows and each band is cleared, drawn and scaled onto the window surface by one job on the thread pool
+Every pixel goes through the AVX2, SSE2 or plain C row kernels, which all give exactly the same result
+Sprites sample their texture the way the sprite shader does (nearest texel, clamped to the edge) and multiply it by their tint
+Colors are multiplied and blended as they're stored rather than in linear light, so translucent pixels can come out a little different from an sRGB swap chain
+*/
+
+// Called by initialize() in place of everything Vulkan
+int createSoftwareRenderer(InitializingInfo *initInfo);
+// Called by cleanup()
+void destroySoftwareRenderer(InitializingInfo *initInfo);
+// Called by setCanvasSize()
+int resizeSoftwareCanvas(InitializingInfo *initInfo, uint32_t width, uint32_t height);
+
+// The software version of registerTexture(), called by loadImages(): takes over pixels (width * height 0xAARRGGBB from malloc, row by row)
+// Returns the textureId for sprites to use, or UINT32_MAX without taking pixels if there's no room
+uint32_t registerSoftwareTexture(InitializingInfo *initInfo, uint32_t *pixels, uint32_t width, uint32_t height);
+// Frees the texture's pixels, sprites still using textureId draw white. WHITE_TEXTURE_ID and ids that aren't registered are ignored
+void unregisterSoftwareTexture(InitializingInfo *initInfo, uint32_t textureId);
+
+// Only call these from the main thread between beginFrame() and endFrame(), everything is drawn in the order it was added
+// Nothing is copied, so whatever they point at has to stay the same until endFrame() returns
+void addSoftwareSprites(InitializingInfo *initInfo, const SpriteInstance *sprites, uint32_t count, float offsetX, float offsetY);
+// width * height bytes with stride bytes from one row to the next, every byte is looked up in palette (256 0xAARRGGBB colors) and blended by its alpha
+void addSoftwareImage(InitializingInfo *initInfo, const uint8_t *indices, uint32_t stride, int32_t x, int32_t y, uint32_t width, uint32_t height, const uint32_t *palette);
+
+// Called by endFrame(), draws everything added this frame and shows it in the window
+int drawSoftwareFrame(InitializingInfo *initInfo);
+
+// The last frame drawn, canvasExtent.width * canvasExtent.height pixels of 0xAARRGGBB row by row
+// This is what headless runs read from frameCompleteCallback
+const uint32_t *getSoftwarePixels(InitializingInfo *initInfo);
+
+SoftwareRendererStats getSoftwareRendererStats(InitializingInfo *initInfo);
+
+
+#endif
@@ -0,0 +1,528 @@
+#include "./spatial_hash.h"
+
+#include "../globals/globals.h"
+#include "../ecs/ecs.h"
+#include "../thread_pool/thread_pool.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+
+// Below this many entities per block the counting sort isn't worth splitting up any further
+#define SPATIAL_ENTRIES_PER_BLOCK 1024
+
+struct SpatialHash {
+    SpatialHashInfo info;
+    float inverseCellSize;
+    uint32_t cellsX, cellsY;
+    uint32_t cellCount;
+
+    // cellStart[cell] to cellStart[cell + 1] is where the cell's entities are in entries
+    uint32_t *cellStart;
+    SpatialEntry *entries;
+    uint32_t entryCount;
+    // The largest half width or height of any entity, how far past its cell an entity can reach
+    float maxHalfExtent;
+
+    // Scratch for the rebuild, the entries in ECS order and the cell each one goes in
+    SpatialEntry *unsorted;
+    uint32_t *entryCells;
+    uint32_t entriesCapacity;
+
+    // Every block of entries counts its cells on its own, then the same array holds where each block writes into each cell
+    // blockCount * cellCount of them, so no two threads ever touch the same counter
+    uint32_t *blockOffsets;
+    uint32_t maxBlocks;
+    uint32_t blockCount;
+
+    EcsChunkView *views;
+    uint32_t *viewFirstEntry;
+    float *viewMaxHalfExtents;
+    uint32_t viewsCapacity;
+
+    // One per thread indexed by getWorkerIndex(), summed up by getSpatialHashStats()
+    uint64_t *pairTests;
+    uint64_t *pairsFound;
+    uint64_t *queryTests;
+
+    SpatialHashStats stats;
+};
+
+
+int createSpatialHash(InitializingInfo *initInfo, const SpatialHashInfo *info) {
+    SpatialHash *hash = calloc(1, sizeof(SpatialHash));
+    initInfo->spatialHash = hash;
+
+    hash->info = *info;
+    if (hash->info.cellSize <= 0.0f) { hash->info.cellSize = DEFAULT_SPATIAL_CELL_SIZE; }
+    hash->inverseCellSize = 1.0f / hash->info.cellSize;
+
+    hash->cellsX = (uint32_t)ceilf(info->width * hash->inverseCellSize);
+    hash->cellsY = (uint32_t)ceilf(info->height * hash->inverseCellSize);
+    if (hash->cellsX == 0) { hash->cellsX = 1; }
+    if (hash->cellsY == 0) { hash->cellsY = 1; }
+    if ((uint64_t)hash->cellsX * hash->cellsY > MAX_SPATIAL_CELLS) {
+        printf("A %.0fx%.0f spatial hash with %.1f pixel cells would need more than %u cells\n", info->width, info->height, hash->info.cellSize, MAX_SPATIAL_CELLS);
+        return EXIT_FAILURE;
+    }
+    hash->cellCount = hash->cellsX * hash->cellsY;
+
+    hash->cellStart = calloc(hash->cellCount + 1, sizeof(uint32_t));
+
+    uint32_t threadCount = getThreadPoolSize(initInfo) + 1;
+    hash->maxBlocks = threadCount;
+    hash->blockOffsets = malloc((size_t)hash->maxBlocks * hash->cellCount * sizeof(uint32_t));
+
+    hash->pairTests = calloc(threadCount, sizeof(uint64_t));
+    hash->pairsFound = calloc(threadCount, sizeof(uint64_t));
+    hash->queryTests = calloc(threadCount, sizeof(uint64_t));
+
+    hash->stats.cellCount = hash->cellCount;
+
+    return EXIT_SUCCESS;
+}
+
+void destroySpatialHash(InitializingInfo *initInfo) {
+    SpatialHash *hash = initInfo->spatialHash;
+    if (hash == NULL) { return; }
+
+    free(hash->cellStart);
+    free(hash->entries);
+    free(hash->unsorted);
+    free(hash->entryCells);
+    free(hash->blockOffsets);
+    free(hash->views);
+    free(hash->viewFirstEntry);
+    free(hash->viewMaxHalfExtents);
+    free(hash->pairTests);
+    free(hash->pairsFound);
+    free(hash->queryTests);
+    free(hash);
+    initInfo->spatialHash = NULL;
+}
+
+
+// Anything outside the grid (or NaN) ends up in the nearest edge cell
+uint32_t spatialCellCoordinate(float value, float min, float inverseCellSize, uint32_t cells) {
+    float cell = (value - min) * inverseCellSize;
+    if (!(cell >= 0.0f)) { return 0; }
+    if (cell >= (float)cells) { return cells - 1; }
+
+    return (uint32_t)cell;
+}
+
+uint32_t spatialCellX(const SpatialHash *hash, float x) {
+    return spatialCellCoordinate(x, hash->info.minX, hash->inverseCellSize, hash->cellsX);
+}
+
+uint32_t spatialCellY(const SpatialHash *hash, float y) {
+    return spatialCellCoordinate(y, hash->info.minY, hash->inverseCellSize, hash->cellsY);
+}
+
+// How many cells away from its own cell an entity's bounding box can reach
+uint32_t spatialReach(const SpatialHash *hash, float distance) {
+    return (uint32_t)ceilf(distance * hash->inverseCellSize);
+}
+
+bool spatialEntriesOverlap(const SpatialEntry *a, const SpatialEntry *b) {
+    return a->minX < b->maxX && b->minX < a->maxX && a->minY < b->maxY && b->minY < a->maxY;
+}
+
+
+// Runs on the thread pool, one range of chunks at a time
+void gatherSpatialEntries(uint32_t first, uint32_t count, void *data) {
+    SpatialHash *hash = data;
+
+    for (uint32_t v = first; v < first + count; v++) {
+        const EcsChunkView *view = &hash->views[v];
+        const PositionComponent *positions = view->columns[0];
+        const SpriteComponent *sprites = view->columns[1];
+
+        SpatialEntry *entries = hash->unsorted + hash->viewFirstEntry[v];
+        uint32_t *cells = hash->entryCells + hash->viewFirstEntry[v];
+        float maxHalfExtent = 0.0f;
+
+        for (uint32_t i = 0; i < view->count; i++) {
+            float width = sprites[i].width;
+            float height = sprites[i].height;
+
+            entries[i] = (SpatialEntry){
+                .entity = view->entities[i],
+                .minX = positions[i].x,
+                .minY = positions[i].y,
+                .maxX = positions[i].x + width,
+                .maxY = positions[i].y + height
+            };
+            cells[i] = spatialCellY(hash, positions[i].y + height * 0.5f) * hash->cellsX + spatialCellX(hash, positions[i].x + width * 0.5f);
+
+            float halfExtent = (width > height ? width : height) * 0.5f;
+            if (halfExtent > maxHalfExtent) { maxHalfExtent = halfExtent; }
+        }
+
+        hash->viewMaxHalfExtents[v] = maxHalfExtent;
+    }
+}
+
+void countSpatialBlocks(uint32_t first, uint32_t count, void *data) {
+    SpatialHash *hash = data;
+
+    for (uint32_t block = first; block < first + count; block++) {
+        uint32_t *counts = hash->blockOffsets + (size_t)block * hash->cellCount;
+        memset(counts, 0, hash->cellCount * sizeof(uint32_t));
+
+        uint32_t begin = (uint64_t)hash->entryCount * block / hash->blockCount;
+        uint32_t end = (uint64_t)hash->entryCount * (block + 1) / hash->blockCount;
+        for (uint32_t i = begin; i < end; i++) { counts[hash->entryCells[i]]++; }
+    }
+}
+
+void scatterSpatialBlocks(uint32_t first, uint32_t count, void *data) {
+    SpatialHash *hash = data;
+
+    for (uint32_t block = first; block < first + count; block++) {
+        uint32_t *offsets = hash->blockOffsets + (size_t)block * hash->cellCount;
+
+        // Blocks write in order within each cell, so the layout comes out the same no matter how the threads got scheduled
+        uint32_t begin = (uint64_t)hash->entryCount * block / hash->blockCount;
+        uint32_t end = (uint64_t)hash->entryCount * (block + 1) / hash->blockCount;
+        for (uint32_t i = begin; i < end; i++) { hash->entries[offsets[hash->entryCells[i]]++] = hash->unsorted[i]; }
+    }
+}
+
+void rebuildSpatialHash(InitializingInfo *initInfo) {
+    SpatialHash *hash = initInfo->spatialHash;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // Find every chunk with something to put in the grid, and where its entries start once they're all laid end to end
+    EcsQuery query = {
+        .components = { POSITION_COMPONENT, SPRITE_COMPONENT },
+        .componentsCount = 2
+    };
+    uint32_t viewsCount = 0;
+    uint32_t entryCount = 0;
+    EcsChunkView view = beginQuery(initInfo, &query);
+    while (nextQueryChunk(&view)) {
+        if (viewsCount == hash->viewsCapacity) {
+            hash->viewsCapacity = hash->viewsCapacity == 0 ? 256 : hash->viewsCapacity * 2;
+            hash->views = realloc(hash->views, hash->viewsCapacity * sizeof(EcsChunkView));
+            hash->viewFirstEntry = realloc(hash->viewFirstEntry, hash->viewsCapacity * sizeof(uint32_t));
+            hash->viewMaxHalfExtents = realloc(hash->viewMaxHalfExtents, hash->viewsCapacity * sizeof(float));
+        }
+
+        hash->views[viewsCount] = view;
+        hash->viewFirstEntry[viewsCount] = entryCount;
+        entryCount += view.count;
+        viewsCount++;
+    }
+
+    if (entryCount > hash->entriesCapacity) {
+        hash->entriesCapacity = entryCount + entryCount / 2;
+        free(hash->entries);
+        free(hash->unsorted);
+        free(hash->entryCells);
+        hash->entries = malloc(hash->entriesCapacity * sizeof(SpatialEntry));
+        hash->unsorted = malloc(hash->entriesCapacity * sizeof(SpatialEntry));
+        hash->entryCells = malloc(hash->entriesCapacity * sizeof(uint32_t));
+    }
+    hash->entryCount = entryCount;
+
+    // Copy out every bounding box and work out its cell
+    parallelFor(initInfo, viewsCount, 0, gatherSpatialEntries, hash);
+
+    hash->maxHalfExtent = 0.0f;
+    for (uint32_t v = 0; v < viewsCount; v++) {
+        if (hash->viewMaxHalfExtents[v] > hash->maxHalfExtent) { hash->maxHalfExtent = hash->viewMaxHalfExtents[v]; }
+    }
+
+    // Count how many entities each block puts in each cell
+    hash->blockCount = entryCount / SPATIAL_ENTRIES_PER_BLOCK;
+    if (hash->blockCount > hash->maxBlocks) { hash->blockCount = hash->maxBlocks; }
+    if (hash->blockCount == 0) { hash->blockCount = 1; }
+    parallelFor(initInfo, hash->blockCount, 1, countSpatialBlocks, hash);
+
+    // Turn the counts into where each block starts writing in each cell, this one pass over the cells is the only part that doesn't run in parallel
+    uint32_t running = 0;
+    hash->stats.occupiedCells = 0;
+    hash->stats.maxEntitiesPerCell = 0;
+    for (uint32_t cell = 0; cell < hash->cellCount; cell++) {
+        hash->cellStart[cell] = running;
+
+        for (uint32_t block = 0; block < hash->blockCount; block++) {
+            uint32_t *offset = &hash->blockOffsets[(size_t)block * hash->cellCount + cell];
+            uint32_t count = *offset;
+            *offset = running;
+            running += count;
+        }
+
+        uint32_t inCell = running - hash->cellStart[cell];
+        if (inCell > 0) { hash->stats.occupiedCells++; }
+        if (inCell > hash->stats.maxEntitiesPerCell) { hash->stats.maxEntitiesPerCell = inCell; }
+    }
+    hash->cellStart[hash->cellCount] = running;
+
+    // And move every entry into place
+    parallelFor(initInfo, hash->blockCount, 1, scatterSpatialBlocks, hash);
+
+    uint32_t threadCount = getThreadPoolSize(initInfo) + 1;
+    memset(hash->pairTests, 0, threadCount * sizeof(uint64_t));
+    memset(hash->pairsFound, 0, threadCount * sizeof(uint64_t));
+    memset(hash->queryTests, 0, threadCount * sizeof(uint64_t));
+
+    hash->stats.entityCount = entryCount;
+    hash->stats.rebuildMs = elapsedMilliseconds(start);
+}
+
+
+uint32_t querySpatialRect(InitializingInfo *initInfo, float minX, float minY, float maxX, float maxY, Entity *results, uint32_t maxResults) {
+    SpatialHash *hash = initInfo->spatialHash;
+    SpatialEntry area = { .minX = minX, .minY = minY, .maxX = maxX, .maxY = maxY };
+
+    // Entities are filed under their center, so anything that overlaps the rectangle has its center at most maxHalfExtent outside of it
+    uint32_t firstX = spatialCellX(hash, minX - hash->maxHalfExtent);
+    uint32_t lastX = spatialCellX(hash, maxX + hash->maxHalfExtent);
+    uint32_t firstY = spatialCellY(hash, minY - hash->maxHalfExtent);
+    uint32_t lastY = spatialCellY(hash, maxY + hash->maxHalfExtent);
+
+    uint32_t found = 0;
+    uint64_t tests = 0;
+    for (uint32_t y = firstY; y <= lastY; y++) {
+        // A row of cells is one contiguous run of entries
+        uint32_t begin = hash->cellStart[y * hash->cellsX + firstX];
+        uint32_t end = hash->cellStart[y * hash->cellsX + lastX + 1];
+
+        for (uint32_t i = begin; i < end; i++) {
+            if (!spatialEntriesOverlap(&hash->entries[i], &area)) { continue; }
+
+            if (found < maxResults) { results[found] = hash->entries[i].entity; }
+            found++;
+        }
+        tests += end - begin;
+    }
+
+    hash->queryTests[getWorkerIndex(initInfo)] += tests;
+    return found;
+}
+
+uint32_t querySpatialRadius(InitializingInfo *initInfo, float x, float y, float radius, Entity *results, uint32_t maxResults) {
+    SpatialHash *hash = initInfo->spatialHash;
+
+    uint32_t firstX = spatialCellX(hash, x - radius - hash->maxHalfExtent);
+    uint32_t lastX = spatialCellX(hash, x + radius + hash->maxHalfExtent);
+    uint32_t firstY = spatialCellY(hash, y - radius - hash->maxHalfExtent);
+    uint32_t lastY = spatialCellY(hash, y + radius + hash->maxHalfExtent);
+    float radiusSquared = radius * radius;
+
+    uint32_t found = 0;
+    uint64_t tests = 0;
+    for (uint32_t cellY = firstY; cellY <= lastY; cellY++) {
+        uint32_t begin = hash->cellStart[cellY * hash->cellsX + firstX];
+        uint32_t end = hash->cellStart[cellY * hash->cellsX + lastX + 1];
+
+        for (uint32_t i = begin; i < end; i++) {
+            const SpatialEntry *entry = &hash->entries[i];
+
+            // The closest point of the box to the center of the circle
+            float closestX = x < entry->minX ? entry->minX : (x > entry->maxX ? entry->maxX : x);
+            float closestY = y < entry->minY ? entry->minY : (y > entry->maxY ? entry->maxY : y);
+            float dx = closestX - x;
+            float dy = closestY - y;
+            if (dx * dx + dy * dy > radiusSquared) { continue; }
+
+            if (found < maxResults) { results[found] = entry->entity; }
+            found++;
+        }
+        tests += end - begin;
+    }
+
+    hash->queryTests[getWorkerIndex(initInfo)] += tests;
+    return found;
+}
+
+// The slab test, returns where along the ray it enters the box, or false if it misses it within [0, maxDistance]
+bool raySpatialEntry(float originX, float originY, float inverseX, float inverseY, float maxDistance, const SpatialEntry *entry, float *distance) {
+    float t1 = (entry->minX - originX) * inverseX;
+    float t2 = (entry->maxX - originX) * inverseX;
+    float t3 = (entry->minY - originY) * inverseY;
+    float t4 = (entry->maxY - originY) * inverseY;
+
+    float tNear = fmaxf(fminf(t1, t2), fminf(t3, t4));
+    float tFar = fminf(fmaxf(t1, t2), fmaxf(t3, t4));
+    if (tFar < 0.0f || tNear > tFar || tNear > maxDistance) { return false; }
+
+    *distance = tNear > 0.0f ? tNear : 0.0f;
+    return true;
+}
+
+bool raycastSpatial(InitializingInfo *initInfo, float originX, float originY, float directionX, float directionY, float maxDistance, SpatialRayHit *hit) {
+    SpatialHash *hash = initInfo->spatialHash;
+
+    float length = sqrtf(directionX * directionX + directionY * directionY);
+    if (length == 0.0f || hash->entryCount == 0) { return false; }
+    directionX /= length;
+    directionY /= length;
+    // Dividing by 0 gives infinity, which is exactly what the slab test and the grid walk want for a ray parallel to an axis
+    float inverseX = 1.0f / directionX;
+    float inverseY = 1.0f / directionY;
+
+    // Clip the ray to the grid first, so the walk below only ever visits cells that exist
+    SpatialEntry grid = {
+        .minX = hash->info.minX, .minY = hash->info.minY,
+        .maxX = hash->info.minX + hash->cellsX * hash->info.cellSize, .maxY = hash->info.minY + hash->cellsY * hash->info.cellSize
+    };
+    float t;
+    if (!raySpatialEntry(originX, originY, inverseX, inverseY, maxDistance, &grid, &t)) { return false; }
+
+    // And stop where it leaves the grid, the edge cells also hold whatever is outside it and we don't want to hit those from the inside
+    float exitX = directionX != 0.0f ? ((directionX > 0.0f ? grid.maxX : grid.minX) - originX) * inverseX : INFINITY;
+    float exitY = directionY != 0.0f ? ((directionY > 0.0f ? grid.maxY : grid.minY) - originY) * inverseY : INFINITY;
+    float exit = fminf(exitX, exitY);
+    if (exit < maxDistance) { maxDistance = exit; }
+
+    int32_t cellX = spatialCellX(hash, originX + directionX * t);
+    int32_t cellY = spatialCellY(hash, originY + directionY * t);
+    int32_t stepX = directionX > 0.0f ? 1 : -1;
+    int32_t stepY = directionY > 0.0f ? 1 : -1;
+
+    // How far along the ray the next cell boundary is on each axis, and how far apart the boundaries are
+    float nextBoundaryX = hash->info.minX + (cellX + (stepX > 0 ? 1 : 0)) * hash->info.cellSize;
+    float nextBoundaryY = hash->info.minY + (cellY + (stepY > 0 ? 1 : 0)) * hash->info.cellSize;
+    float tMaxX = directionX != 0.0f ? (nextBoundaryX - originX) * inverseX : INFINITY;
+    float tMaxY = directionY != 0.0f ? (nextBoundaryY - originY) * inverseY : INFINITY;
+    float tDeltaX = directionX != 0.0f ? hash->info.cellSize * fabsf(inverseX) : INFINITY;
+    float tDeltaY = directionY != 0.0f ? hash->info.cellSize * fabsf(inverseY) : INFINITY;
+
+    // A box the ray hits has its center at most this many cells from the cell the hit is in
+    int32_t reach = spatialReach(hash, hash->maxHalfExtent);
+
+    bool found = false;
+    float tEnter = t;
+    uint64_t tests = 0;
+    // Anything hit closer than the best hit so far was hit in a cell the walk has already been through, so we can stop once we're past it
+    while (tEnter <= maxDistance && (!found || tEnter <= hit->distance)) {
+        int32_t firstX = cellX - reach > 0 ? cellX - reach : 0;
+        int32_t lastX = cellX + reach < (int32_t)hash->cellsX - 1 ? cellX + reach : (int32_t)hash->cellsX - 1;
+        int32_t firstY = cellY - reach > 0 ? cellY - reach : 0;
+        int32_t lastY = cellY + reach < (int32_t)hash->cellsY - 1 ? cellY + reach : (int32_t)hash->cellsY - 1;
+
+        for (int32_t y = firstY; y <= lastY; y++) {
+            uint32_t begin = hash->cellStart[y * hash->cellsX + firstX];
+            uint32_t end = hash->cellStart[y * hash->cellsX + lastX + 1];
+
+            for (uint32_t i = begin; i < end; i++) {
+                float distance;
+                if (!raySpatialEntry(originX, originY, inverseX, inverseY, maxDistance, &hash->entries[i], &distance)) { continue; }
+                if (found && distance >= hit->distance) { continue; }
+
+                *hit = (SpatialRayHit){ .entity = hash->entries[i].entity, .distance = distance };
+                found = true;
+            }
+            tests += end - begin;
+        }
+
+        // Step into whichever neighbouring cell the ray reaches first
+        if (tMaxX < tMaxY) {
+            tEnter = tMaxX;
+            tMaxX += tDeltaX;
+            cellX += stepX;
+        } else {
+            tEnter = tMaxY;
+            tMaxY += tDeltaY;
+            cellY += stepY;
+        }
+        if (cellX < 0 || cellY < 0 || cellX >= (int32_t)hash->cellsX || cellY >= (int32_t)hash->cellsY) { break; }
+    }
+
+    hash->queryTests[getWorkerIndex(initInfo)] += tests;
+    return found;
+}
+
+
+typedef struct {
+    InitializingInfo *initInfo;
+    SpatialPairFunction function;
+    void *userData;
+    int32_t reach;
+} SpatialPairJob;
+
+// Runs on the thread pool, one range of rows at a time
+void findSpatialPairs(uint32_t firstRow, uint32_t rowCount, void *data) {
+    const SpatialPairJob *job = data;
+    SpatialHash *hash = job->initInfo->spatialHash;
+    int32_t reach = job->reach;
+
+    uint64_t tests = 0;
+    uint64_t found = 0;
+    for (int32_t y = firstRow; y < (int32_t)(firstRow + rowCount); y++) {
+        for (int32_t x = 0; x < (int32_t)hash->cellsX; x++) {
+            uint32_t cell = y * hash->cellsX + x;
+            uint32_t begin = hash->cellStart[cell];
+            uint32_t end = hash->cellStart[cell + 1];
+            if (begin == end) { continue; }
+
+            // Every cell only looks at the neighbours after it (the rest of its own row, then the rows below)
+            // so each pair of cells, and with that each pair of entities, is only ever tested once
+            int32_t lastY = y + reach < (int32_t)hash->cellsY - 1 ? y + reach : (int32_t)hash->cellsY - 1;
+            for (int32_t neighbourY = y; neighbourY <= lastY; neighbourY++) {
+                int32_t firstX = neighbourY == y ? x : (x - reach > 0 ? x - reach : 0);
+                int32_t lastX = x + reach < (int32_t)hash->cellsX - 1 ? x + reach : (int32_t)hash->cellsX - 1;
+
+                // Like the queries, a row of neighbours is one contiguous run of entries
+                uint32_t neighbourBegin = hash->cellStart[neighbourY * hash->cellsX + firstX];
+                uint32_t neighbourEnd = hash->cellStart[neighbourY * hash->cellsX + lastX + 1];
+
+                for (uint32_t i = begin; i < end; i++) {
+                    const SpatialEntry *a = &hash->entries[i];
+
+                    // Within the cell itself only the entries after this one, otherwise the pair would come up twice
+                    uint32_t j = neighbourY == y ? i + 1 : neighbourBegin;
+                    for (; j < neighbourEnd; j++) {
+                        const SpatialEntry *b = &hash->entries[j];
+                        tests++;
+                        if (!spatialEntriesOverlap(a, b)) { continue; }
+
+                        found++;
+                        if (job->function != NULL) { job->function(a, b, job->userData); }
+                    }
+                }
+            }
+        }
+    }
+
+    uint32_t worker = getWorkerIndex(job->initInfo);
+    hash->pairTests[worker] += tests;
+    hash->pairsFound[worker] += found;
+}
+
+void forEachSpatialPair(InitializingInfo *initInfo, SpatialPairFunction function, void *userData) {
+    SpatialHash *hash = initInfo->spatialHash;
+
+    // Two boxes can only overlap if their centers are closer than both their half sizes put together
+    SpatialPairJob job = {
+        .initInfo = initInfo,
+        .function = function,
+        .userData = userData,
+        .reach = spatialReach(hash, hash->maxHalfExtent * 2.0f)
+    };
+
+    // Whole rows at a time, since a row's cells are next to each other in memory
+    parallelFor(initInfo, hash->cellsY, 0, findSpatialPairs, &job);
+}
+
+SpatialHashStats getSpatialHashStats(InitializingInfo *initInfo) {
+    SpatialHash *hash = initInfo->spatialHash;
+    SpatialHashStats stats = hash->stats;
+
+    for (uint32_t i = 0; i < getThreadPoolSize(initInfo) + 1; i++) {
+        stats.pairTests += hash->pairTests[i];
+        stats.pairsFound += hash->pairsFound[i];
+        stats.queryTests += hash->queryTests[i];
+    }
+
+    return stats;
+}
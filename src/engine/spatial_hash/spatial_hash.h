@@ -0,0 +1,78 @@
+#ifndef SPATIAL_HASH
+#define SPATIAL_HASH
+
+#include "../globals/globals.h"
+#include "../ecs/ecs.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Roughly twice the size of a typical entity works well, too small and every entity spans a bunch of cells worth of neighbours,
+// too big and every cell holds more entities than it needs to
+#define DEFAULT_SPATIAL_CELL_SIZE 16.0f
+// A grid bigger than this is almost certainly a cell size that's too small for the area
+#define MAX_SPATIAL_CELLS (1 << 22)
+
+typedef struct {
+    // The area the grid covers in canvas pixels, entities outside it are kept in the nearest edge cell
+    // so they're still found by rectangle, radius and pair queries, just less efficiently
+    float minX, minY;
+    float width, height;
+    float cellSize; // 0 for DEFAULT_SPATIAL_CELL_SIZE
+} SpatialHashInfo;
+
+// An entity's bounding box as of the last rebuildSpatialHash()
+typedef struct {
+    Entity entity;
+    float minX, minY, maxX, maxY;
+} SpatialEntry;
+
+typedef struct {
+    Entity entity;
+    float distance; // Along the ray, in the same units as maxDistance
+} SpatialRayHit;
+
+typedef struct {
+    uint32_t entityCount;
+    uint32_t cellCount;
+    uint32_t occupiedCells;
+    uint32_t maxEntitiesPerCell;
+    double rebuildMs;
+
+    // Bounding box tests done since the last rebuild, the number to watch when tuning the cell size
+    uint64_t pairTests;
+    uint64_t pairsFound;
+    uint64_t queryTests;
+} SpatialHashStats;
+
+// Called once for every overlapping pair, from whichever thread found it
+typedef void (*SpatialPairFunction)(const SpatialEntry *a, const SpatialEntry *b, void *userData);
+
+
+// Call it after initialize(), it's sized for the thread pool
+int createSpatialHash(InitializingInfo *initInfo, const SpatialHashInfo *info);
+// Called by cleanup()
+void destroySpatialHash(InitializingInfo *initInfo);
+
+// Sorts every entity with a PositionComponent and a SpriteComponent into the grid, the sprite's rectangle is its bounding box
+// Call it once per tick after syncWorld(), the queries keep seeing this snapshot until the next rebuild
+// Each entity goes in the one cell its center is in, laid out as a counting sort: cell offsets plus one packed array of entries,
+// so a cell's entities are always next to each other in memory and nothing is allocated per cell
+void rebuildSpatialHash(InitializingInfo *initInfo);
+
+// These write up to maxResults entities into results and return how many there were in total, which can be more than maxResults
+// They only read the grid, so any number of threads can run them at once
+uint32_t querySpatialRect(InitializingInfo *initInfo, float minX, float minY, float maxX, float maxY, Entity *results, uint32_t maxResults);
+uint32_t querySpatialRadius(InitializingInfo *initInfo, float x, float y, float radius, Entity *results, uint32_t maxResults);
+// The closest entity the ray hits within maxDistance, the direction doesn't need to be normalized. Only finds hits inside the grid's area
+bool raycastSpatial(InitializingInfo *initInfo, float originX, float originY, float directionX, float directionY, float maxDistance, SpatialRayHit *hit);
+
+// Finds every pair of overlapping entities, each pair once. The cells are spread over the thread pool
+// function can be NULL to only count them
+void forEachSpatialPair(InitializingInfo *initInfo, SpatialPairFunction function, void *userData);
+
+SpatialHashStats getSpatialHashStats(InitializingInfo *initInfo);
+
+
+#endif
@@ -0,0 +1,516 @@
+#include "./sprite_batch.h"
+
+#include "../globals/globals.h"
+#include "../pipeline_cache/pipeline_cache.h"
+#include "../allocator/allocator.h"
+#include "../shaders/shaders.h"
+#include "../ecs/ecs.h"
+#include "../thread_pool/thread_pool.h"
+#include "../bindless_textures/bindless_textures.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <string.h>
+
+
+// The sprites out of one chunk, and where in the ring buffer they go
+typedef struct {
+    SpriteInstance *instances;
+    const PositionComponent *positions;
+    const PreviousPositionComponent *previous;
+    const SpriteComponent *sprites;
+    uint32_t count;
+} SpriteRun;
+
+struct SpriteBatcher {
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+
+    // One buffer split into a region per frame in flight
+    // It stays mapped for the whole run, so adding a sprite is just a write into memory the GPU can read directly
+    VkBuffer instanceBuffer;
+    GpuAllocation instanceMemory;
+    SpriteInstance *mappedInstances;
+    uint32_t maxSprites; // Per frame
+
+    // This frame's sprites are written here first, so sortSpritesByLayer() can put them in order before the GPU (or the software renderer) sees them
+    // Reading back out of the mapped buffer would be slow, it's often write combined memory
+    SpriteInstance *instances;
+    SpriteInstance *sortScratch;
+
+    // Where this frame's region starts, and how much of it has been filled so far
+    uint32_t frameBase;
+    uint32_t spriteCount;
+
+    // addSpriteComponents() reserves these on the main thread, so the batches come out in order, then fills them in on the thread pool
+    SpriteRun *runs;
+    uint32_t runsCount;
+    uint32_t runsCapacity;
+};
+
+
+int createSpritePipeline(InitializingInfo *initInfo, SpriteBatcher *batcher) {
+    VkShaderModule vertShaderModule = loadShaderModule(initInfo, "sprite.vert");
+    VkShaderModule fragShaderModule = loadShaderModule(initInfo, "sprite.frag");
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE) {
+        // Only one of them might have loaded, and destroying a null module does nothing
+        vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+        vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+        return EXIT_FAILURE;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertShaderModule,
+            .pName = "main"
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragShaderModule,
+            .pName = "main"
+        }
+    };
+
+
+    // There's no per vertex data at all, the vertex shader builds each corner from gl_VertexIndex
+    // Everything else advances once per instance, so one draw call covers a whole batch of sprites
+    VkVertexInputBindingDescription bindingDescription = {
+        .binding = 0,
+        .stride = sizeof(SpriteInstance),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+    };
+
+    VkVertexInputAttributeDescription attributeDescriptions[] = {
+        { .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(SpriteInstance, x) },
+        { .location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(SpriteInstance, u0) },
+        { .location = 2, .binding = 0, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(SpriteInstance, tint) },
+        { .location = 3, .binding = 0, .format = VK_FORMAT_R32_SFLOAT, .offset = offsetof(SpriteInstance, layer) },
+        { .location = 4, .binding = 0, .format = VK_FORMAT_R32_UINT, .offset = offsetof(SpriteInstance, textureId) }
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &bindingDescription,
+        .vertexAttributeDescriptionCount = sizeof(attributeDescriptions) / sizeof(VkVertexInputAttributeDescription),
+        .pVertexAttributeDescriptions = attributeDescriptions
+    };
+
+    // Four vertices drawn as a strip make a quad, and every instance starts a new strip
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+
+        .viewportCount = 1,
+        .scissorCount = 1
+    };
+
+    // Sprites can be flipped by giving them a negative size, so we can't cull either face
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .minSampleShading = 1.0f
+    };
+
+    // Regular "over" alpha blending, so sprites drawn later end up on top of the ones drawn before them
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment
+    };
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
+    };
+
+
+    // The viewport size is all the vertex shader needs to turn pixel positions into clip space, and it's small enough to push every frame
+    // The offset lets other buffers of sprites (like tilemap chunks) be stored relative to their own origin
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(SpritePushConstants)
+    };
+
+    // Set 0 is every texture there is, the fragment shader picks one per sprite with its textureId
+    VkDescriptorSetLayout setLayout = getBindlessSetLayout(initInfo);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+
+    if (vkCreatePipelineLayout(initInfo->device, &pipelineLayoutInfo, NULL, &batcher->pipelineLayout) != VK_SUCCESS) {
+        vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+        vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+        return EXIT_FAILURE;
+    }
+
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+
+        .stageCount = 2,
+        .pStages = shaderStages,
+
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = NULL,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+
+        .layout = batcher->pipelineLayout,
+
+        .renderPass = initInfo->renderPass,
+        .subpass = 0,
+
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+
+    VkResult result = createGraphicsPipelineCached(initInfo, "sprite", &pipelineInfo, &batcher->pipeline);
+
+    vkDestroyShaderModule(initInfo->device, vertShaderModule, NULL);
+    vkDestroyShaderModule(initInfo->device, fragShaderModule, NULL);
+
+    if (result != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+int createInstanceRingBuffer(InitializingInfo *initInfo, SpriteBatcher *batcher) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+
+        .size = (VkDeviceSize)batcher->maxSprites * initInfo->maxFramesInFlight * sizeof(SpriteInstance),
+        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    if (vkCreateBuffer(initInfo->device, &bufferInfo, NULL, &batcher->instanceBuffer) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // Memory that is both device local and host visible is the best case, since the GPU reads it at full speed and we never need a staging copy
+    // Not everything has it, so otherwise we settle for regular host visible memory which the GPU reads over the bus
+    // Coherent memory means our writes show up on the GPU without having to flush them
+    VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (allocateBufferMemory(initInfo, batcher->instanceBuffer, hostFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &batcher->instanceMemory) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    // The allocator keeps host visible memory mapped until cleanup
+    batcher->mappedInstances = batcher->instanceMemory.mapped;
+    if (batcher->mappedInstances == NULL) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+int createSpriteBatcher(InitializingInfo *initInfo) {
+    SpriteBatcher *batcher = calloc(1, sizeof(struct SpriteBatcher));
+    initInfo->spriteBatcher = batcher;
+
+    batcher->maxSprites = initInfo->maxSprites > 0 ? initInfo->maxSprites : DEFAULT_MAX_SPRITES;
+
+    batcher->instances = malloc((size_t)batcher->maxSprites * sizeof(SpriteInstance));
+    batcher->sortScratch = malloc((size_t)batcher->maxSprites * sizeof(SpriteInstance));
+    if (batcher->instances == NULL || batcher->sortScratch == NULL) { return EXIT_FAILURE; }
+
+    // The software renderer draws straight out of the sorted instances, so there's no pipeline and nothing for the GPU to see
+    if (initInfo->softwareRendering) { return EXIT_SUCCESS; }
+
+    if (createSpritePipeline(initInfo, batcher) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (createInstanceRingBuffer(initInfo, batcher) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+void destroySpriteBatcher(InitializingInfo *initInfo) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+    if (batcher == NULL) { return; }
+
+    free(batcher->instances);
+    free(batcher->sortScratch);
+
+    if (!initInfo->softwareRendering) {
+        vkDestroyBuffer(initInfo->device, batcher->instanceBuffer, NULL);
+        gpuFree(initInfo, &batcher->instanceMemory);
+
+        vkDestroyPipeline(initInfo->device, batcher->pipeline, NULL);
+        vkDestroyPipelineLayout(initInfo->device, batcher->pipelineLayout, NULL);
+    }
+
+    free(batcher->runs);
+    free(batcher);
+    initInfo->spriteBatcher = NULL;
+}
+
+
+void beginSpriteBatch(InitializingInfo *initInfo) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+
+    // Each frame in flight writes into its own region, so we never touch sprites the GPU might still be drawing from an earlier frame
+    batcher->frameBase = initInfo->currentFrame * batcher->maxSprites;
+    batcher->spriteCount = 0;
+}
+
+SpriteInstance *reserveSprites(InitializingInfo *initInfo, uint32_t count) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+    if (count == 0 || batcher->spriteCount + count > batcher->maxSprites) { return NULL; }
+
+    // Every sprite reads its own texture out of the bindless array, so the whole frame's sprites stay one contiguous run of instances
+    SpriteInstance *sprites = &batcher->instances[batcher->spriteCount];
+    batcher->spriteCount += count;
+
+    return sprites;
+}
+
+bool addSprite(InitializingInfo *initInfo, const SpriteInstance *sprite) {
+    SpriteInstance *destination = reserveSprites(initInfo, 1);
+    if (destination == NULL) { return false; }
+
+    *destination = *sprite;
+
+    return true;
+}
+
+// previous can be NULL, otherwise each sprite goes alpha of the way from previous to positions
+bool reserveSpriteRun(InitializingInfo *initInfo, uint32_t count, const PositionComponent *positions, const PreviousPositionComponent *previous, const SpriteComponent *sprites) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+    if (count == 0) { return true; }
+
+    // The whole chunk is reserved in one go whatever textures its sprites use
+    SpriteInstance *instances = reserveSprites(initInfo, count);
+    if (instances == NULL) { return false; }
+
+    if (batcher->runsCount == batcher->runsCapacity) {
+        batcher->runsCapacity = batcher->runsCapacity == 0 ? 256 : batcher->runsCapacity * 2;
+        batcher->runs = realloc(batcher->runs, batcher->runsCapacity * sizeof(SpriteRun));
+    }
+    batcher->runs[batcher->runsCount++] = (SpriteRun){
+        .instances = instances,
+        .positions = positions,
+        .previous = previous,
+        .sprites = sprites,
+        .count = count
+    };
+
+    return true;
+}
+
+// Runs on the thread pool, every run writes to its own piece of the frame's instances so they don't need to coordinate
+void fillSpriteRuns(uint32_t first, uint32_t count, void *data) {
+    InitializingInfo *initInfo = data;
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+    float alpha = initInfo->interpolationAlpha;
+
+    for (uint32_t run = first; run < first + count; run++) {
+        const SpriteRun *spriteRun = &batcher->runs[run];
+        const PositionComponent *positions = spriteRun->positions;
+        const PreviousPositionComponent *previous = spriteRun->previous;
+        const SpriteComponent *sprites = spriteRun->sprites;
+
+        for (uint32_t i = 0; i < spriteRun->count; i++) {
+            float x = positions[i].x;
+            float y = positions[i].y;
+            if (previous != NULL) {
+                x = previous[i].x + (x - previous[i].x) * alpha;
+                y = previous[i].y + (y - previous[i].y) * alpha;
+            }
+
+            spriteRun->instances[i] = (SpriteInstance){
+                .x = x,
+                .y = y,
+                .width = sprites[i].width,
+                .height = sprites[i].height,
+                .u0 = sprites[i].u0, .v0 = sprites[i].v0, .u1 = sprites[i].u1, .v1 = sprites[i].v1,
+                .tint = sprites[i].tint,
+                .layer = sprites[i].layer,
+                .textureId = sprites[i].textureId
+            };
+        }
+    }
+}
+
+void addSpriteComponents(InitializingInfo *initInfo) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+    if (initInfo->world == NULL) { return; }
+
+    batcher->runsCount = 0;
+    bool full = false;
+
+    EcsQuery staticQuery = {
+        .components = { POSITION_COMPONENT, SPRITE_COMPONENT },
+        .componentsCount = 2,
+        .without = COMPONENT_BIT(PREVIOUS_POSITION_COMPONENT)
+    };
+    EcsChunkView view = beginQuery(initInfo, &staticQuery);
+    while (!full && nextQueryChunk(&view)) {
+        full = !reserveSpriteRun(initInfo, view.count, view.columns[0], NULL, view.columns[1]);
+    }
+
+    EcsQuery interpolatedQuery = {
+        .components = { POSITION_COMPONENT, SPRITE_COMPONENT, PREVIOUS_POSITION_COMPONENT },
+        .componentsCount = 3
+    };
+    view = beginQuery(initInfo, &interpolatedQuery);
+    while (!full && nextQueryChunk(&view)) {
+        full = !reserveSpriteRun(initInfo, view.count, view.columns[0], view.columns[2], view.columns[1]);
+    }
+
+    // Even if we ran out of room, whatever did get reserved has to be filled in or it would draw garbage
+    // A chunk's worth of sprites is too little work for a job of its own, so each job takes a few
+    parallelFor(initInfo, batcher->runsCount, 4, fillSpriteRuns, initInfo);
+}
+
+void recordSpriteBatches(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+    if (batcher->spriteCount == 0) { return; }
+
+    // Nothing here writes to the batcher, so any thread can record it
+    bindSpritePipeline(initInfo, commandBuffer);
+
+    // The whole ring is bound once, and firstInstance picks out where this frame's region starts
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &batcher->instanceBuffer, &offset);
+
+    vkCmdDraw(commandBuffer, 4, batcher->spriteCount, 0, batcher->frameBase);
+}
+
+const SpriteInstance *getSpriteInstances(InitializingInfo *initInfo) {
+    return initInfo->spriteBatcher->instances;
+}
+
+// The layer squeezed into 16 bits and flipped, so the sprites furthest back sort first
+uint16_t spriteSortKey(const SpriteInstance *sprite) {
+    float layer = sprite->layer < 0.0f ? 0.0f : (sprite->layer > 1.0f ? 1.0f : sprite->layer);
+    return (uint16_t)(65535 - (uint32_t)(layer * 65535.0f + 0.5f));
+}
+
+void radixSortSprites(SpriteBatcher *batcher) {
+    // A least significant byte first radix sort, two passes of 8 bits each
+    // Every pass is stable, so sprites on the same layer stay in the order they were added and later ones end up on top
+    SpriteInstance *source = batcher->instances;
+    SpriteInstance *destination = batcher->sortScratch;
+
+    for (uint32_t shift = 0; shift < 16; shift += 8) {
+        uint32_t offsets[256] = { 0 };
+        for (uint32_t i = 0; i < batcher->spriteCount; i++) { offsets[(spriteSortKey(&source[i]) >> shift) & 0xFF]++; }
+
+        uint32_t total = 0;
+        for (uint32_t bucket = 0; bucket < 256; bucket++) {
+            uint32_t count = offsets[bucket];
+            offsets[bucket] = total;
+            total += count;
+        }
+
+        for (uint32_t i = 0; i < batcher->spriteCount; i++) {
+            destination[offsets[(spriteSortKey(&source[i]) >> shift) & 0xFF]++] = source[i];
+        }
+
+        SpriteInstance *swap = source;
+        source = destination;
+        destination = swap;
+    }
+    // An even number of passes, so the sorted sprites are back in instances
+}
+
+void sortSpritesByLayer(InitializingInfo *initInfo) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+
+    // Most frames add their sprites back to front already (or all on one layer), and then there's nothing to move
+    bool sorted = true;
+    for (uint32_t i = 1; i < batcher->spriteCount && sorted; i++) {
+        sorted = spriteSortKey(&batcher->instances[i - 1]) <= spriteSortKey(&batcher->instances[i]);
+    }
+    if (!sorted) { radixSortSprites(batcher); }
+
+    // The mapped buffer only ever gets one straight copy, which is what write combined memory is best at
+    if (!initInfo->softwareRendering && batcher->spriteCount > 0) {
+        memcpy(&batcher->mappedInstances[batcher->frameBase], batcher->instances, (size_t)batcher->spriteCount * sizeof(SpriteInstance));
+    }
+}
+
+SpriteBatchStats getSpriteBatchStats(InitializingInfo *initInfo) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+
+    return (SpriteBatchStats){
+        .spriteCount = batcher->spriteCount,
+        .bytesUploaded = (uint64_t)batcher->spriteCount * sizeof(SpriteInstance)
+    };
+}
+
+
+void bindSpritePipeline(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    SpriteBatcher *batcher = initInfo->spriteBatcher;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batcher->pipeline);
+    // The same set for every pipeline bind, so it's the only descriptor bind a frame of sprites ever needs
+    bindBindlessTextures(initInfo, commandBuffer, batcher->pipelineLayout);
+    setSpriteOffset(initInfo, commandBuffer, 0.0f, 0.0f);
+}
+
+void setSpriteOffset(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, float x, float y) {
+    SpritePushConstants pushConstants = {
+        .viewportSize = { initInfo->canvasExtent.width, initInfo->canvasExtent.height },
+        .offset = { x, y }
+    };
+
+    vkCmdPushConstants(commandBuffer, initInfo->spriteBatcher->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+}
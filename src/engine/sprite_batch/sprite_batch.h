@@ -0,0 +1,73 @@
+#ifndef SPRITE_BATCH
+#define SPRITE_BATCH
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// This is exactly what gets written into the instance buffer, one per sprite
+typedef struct {
+    float x, y; // Top left corner in pixels
+    float width, height;
+
+    float u0, v0, u1, v1; // The part of the texture this sprite shows
+
+    uint32_t tint; // RGBA with 8 bits per channel, red in the lowest byte
+    float layer; // Between 0 and 1, 0 is in front. Sprites on the same layer are drawn in the order they're added
+    uint32_t textureId; // From registerTexture(), WHITE_TEXTURE_ID draws just the tint
+    uint32_t padding;
+} SpriteInstance;
+
+// Pushed to the sprite vertex shader, both in canvas pixels
+typedef struct {
+    float viewportSize[2];
+    float offset[2];
+} SpritePushConstants;
+
+typedef struct {
+    uint32_t spriteCount;
+    uint64_t bytesUploaded;
+} SpriteBatchStats;
+
+
+int createSpriteBatcher(InitializingInfo *initInfo);
+void destroySpriteBatcher(InitializingInfo *initInfo);
+
+// Called by beginFrame() once this frame's part of the ring buffer is free again
+void beginSpriteBatch(InitializingInfo *initInfo);
+// Called by the frame's command buffer recording, inside the render pass, all of this frame's sprites as one instanced draw
+void recordSpriteBatches(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+
+// Sprites are drawn by layer and then in the order they're added, all in one batch since each one picks its own texture out of the bindless array
+bool addSprite(InitializingInfo *initInfo, const SpriteInstance *sprite);
+// Hands back room for count sprites, so they can be written in place
+// Returns NULL if there isn't enough room left this frame
+SpriteInstance *reserveSprites(InitializingInfo *initInfo, uint32_t count);
+
+// Adds a sprite for every entity with both a PositionComponent and a SpriteComponent, straight out of the ECS's component arrays
+// Entities that also have a PreviousPositionComponent are drawn interpolationAlpha of the way from there to their position
+// Called by endFrame(), so they're drawn on top of anything added by hand that frame
+// Textures don't matter to the batching, so every entity ends up in the same draw call
+// Each chunk's sprites are reserved in order on the calling thread and then filled in across the thread pool
+void addSpriteComponents(InitializingInfo *initInfo);
+
+// Every sprite added this frame so far in the order they're drawn, getSpriteBatchStats().spriteCount of them. The software renderer draws from this
+const SpriteInstance *getSpriteInstances(InitializingInfo *initInfo);
+
+// Reorders this frame's sprites back to front, so blending comes out the same on the GPU and in the software renderer
+// Called by endFrame() once every sprite is in, it's also what copies them into the ring buffer for the GPU
+void sortSpritesByLayer(InitializingInfo *initInfo);
+
+SpriteBatchStats getSpriteBatchStats(InitializingInfo *initInfo);
+
+// For anything else that keeps SpriteInstances in its own vertex buffers (like the tilemap) and wants to draw them the same way
+// Binding resets the offset to 0, setSpriteOffset() moves everything drawn after it
+void bindSpritePipeline(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+void setSpriteOffset(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, float x, float y);
+
+
+#endif
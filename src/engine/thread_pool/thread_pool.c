@@ -0,0 +1,424 @@
+#include "./thread_pool.h"
+
+#include "../globals/globals.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// We use SDL's threads since we already depend on SDL, and it means we don't have to deal with pthreads and Windows threads separately
+typedef struct {
+    JobFunction function;
+    void *data;
+    JobCounter *counter;
+} Job;
+
+// Every worker has one of these, and there's one more shared by every thread that isn't a worker
+// Each queue only ever sees its owner and the occasional thief, so its spin lock is almost never contended
+typedef struct {
+    SDL_SpinLock lock;
+
+    // A ring of jobs that grows when it's full
+    // The owner pushes and pops at the back so it keeps working on whatever it just submitted while that's still in cache
+    // Thieves take from the front, which is the oldest and usually the biggest piece of work left
+    Job *jobs;
+    uint32_t jobsCapacity;
+    uint32_t jobsHead;
+    uint32_t jobsCount;
+
+    // Only ever added to by the owning thread, getWorkerStats() reports them relative to the baselines resetWorkerStats() took
+    uint64_t jobsRun;
+    uint64_t jobsStolen;
+    Uint64 busyCounter;
+    uint64_t jobsRunBaseline;
+    uint64_t jobsStolenBaseline;
+    Uint64 busyCounterBaseline;
+
+    // Keeps the next queue's lock and counters off this one's cache line, otherwise threads would slow each other down just by counting
+    uint8_t padding[64];
+} JobQueue;
+
+struct ThreadPool {
+    SDL_Thread **threads;
+    uint32_t threadCount;
+
+    // threadCount + 1 of them, indexed by getWorkerIndex()
+    JobQueue *queues;
+
+    // Goes up before a job is queued and down after it's taken, so it's never lower than what's actually in the queues
+    // which lets threads skip looking through every queue when there's nothing to find
+    SDL_atomic_t queuedJobs;
+
+    // Threads with nothing to do sleep on wake instead of spinning
+    // sleepingThreads lets submitting and finishing jobs skip the mutex entirely while everyone is busy
+    SDL_mutex *mutex;
+    SDL_cond *wake;
+    SDL_atomic_t sleepingThreads;
+    bool shuttingDown;
+
+    // What submitJob() and waitForJobs() use
+    JobCounter counter;
+
+    Uint64 statsResetCounter;
+    uint32_t nextWorkerIndex;
+};
+
+// Set once by each worker when it starts, so a job can tell which worker it's running on
+_Thread_local uint32_t currentWorkerIndex = UINT32_MAX;
+// How many jobs deep the calling thread is, a job waiting on its children runs them itself and that time is already counted
+_Thread_local uint32_t currentJobDepth = 0;
+// Picks which queue to start stealing from, so thieves don't all pile onto the same one
+_Thread_local uint32_t stealSeed = 0;
+
+
+void pushJobs(JobQueue *queue, const Job *jobs, uint32_t count) {
+    SDL_AtomicLock(&queue->lock);
+
+    if (queue->jobsCount + count > queue->jobsCapacity) {
+        uint32_t capacity = queue->jobsCapacity;
+        while (queue->jobsCount + count > capacity) { capacity *= 2; }
+
+        // Unwrap the ring into a bigger array so the oldest job ends up first again
+        Job *grown = malloc(capacity * sizeof(Job));
+        for (uint32_t i = 0; i < queue->jobsCount; i++) {
+            grown[i] = queue->jobs[(queue->jobsHead + i) % queue->jobsCapacity];
+        }
+
+        free(queue->jobs);
+        queue->jobs = grown;
+        queue->jobsHead = 0;
+        queue->jobsCapacity = capacity;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        queue->jobs[(queue->jobsHead + queue->jobsCount) % queue->jobsCapacity] = jobs[i];
+        queue->jobsCount++;
+    }
+
+    SDL_AtomicUnlock(&queue->lock);
+}
+
+// The owner takes the newest job
+bool popJob(JobQueue *queue, Job *job) {
+    SDL_AtomicLock(&queue->lock);
+
+    bool found = queue->jobsCount > 0;
+    if (found) {
+        queue->jobsCount--;
+        *job = queue->jobs[(queue->jobsHead + queue->jobsCount) % queue->jobsCapacity];
+    }
+
+    SDL_AtomicUnlock(&queue->lock);
+    return found;
+}
+
+// Everyone else takes the oldest
+bool stealJob(JobQueue *queue, Job *job) {
+    SDL_AtomicLock(&queue->lock);
+
+    bool found = queue->jobsCount > 0;
+    if (found) {
+        *job = queue->jobs[queue->jobsHead];
+        queue->jobsHead = (queue->jobsHead + 1) % queue->jobsCapacity;
+        queue->jobsCount--;
+    }
+
+    SDL_AtomicUnlock(&queue->lock);
+    return found;
+}
+
+bool takeJob(ThreadPool *pool, uint32_t self, Job *job) {
+    if (SDL_AtomicGet(&pool->queuedJobs) <= 0) { return false; }
+
+    bool found = popJob(&pool->queues[self], job);
+
+    uint32_t queuesCount = pool->threadCount + 1;
+    if (!found) {
+        // A cheap xorshift is plenty to spread the thieves out
+        stealSeed ^= stealSeed << 13;
+        stealSeed ^= stealSeed >> 17;
+        stealSeed ^= stealSeed << 5;
+        uint32_t start = stealSeed % queuesCount;
+
+        for (uint32_t i = 0; i < queuesCount && !found; i++) {
+            uint32_t victim = (start + i) % queuesCount;
+            if (victim == self) { continue; }
+
+            found = stealJob(&pool->queues[victim], job);
+        }
+        if (found) { pool->queues[self].jobsStolen++; }
+    }
+
+    if (found) { SDL_AtomicAdd(&pool->queuedJobs, -1); }
+    return found;
+}
+
+void wakeThreads(ThreadPool *pool, uint32_t count) {
+    if (SDL_AtomicGet(&pool->sleepingThreads) == 0) { return; }
+
+    SDL_LockMutex(pool->mutex);
+    if (count == 1) { SDL_CondSignal(pool->wake); }
+    else { SDL_CondBroadcast(pool->wake); }
+    SDL_UnlockMutex(pool->mutex);
+}
+
+void runJob(ThreadPool *pool, uint32_t self, const Job *job) {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    currentJobDepth++;
+    job->function(job->data);
+    currentJobDepth--;
+
+    JobQueue *queue = &pool->queues[self];
+    queue->jobsRun++;
+    if (currentJobDepth == 0) { queue->busyCounter += SDL_GetPerformanceCounter() - start; }
+
+    // Whoever is waiting on the counter might be asleep, and this could be the job that lets them go
+    // The counter can go out of scope as soon as it hits 0, so it's not touched after that
+    if (SDL_AtomicDecRef(&job->counter->pending)) { wakeThreads(pool, UINT32_MAX); }
+}
+
+
+int workerThread(void *data) {
+    ThreadPool *pool = data;
+
+    SDL_LockMutex(pool->mutex);
+    currentWorkerIndex = pool->nextWorkerIndex++;
+    SDL_UnlockMutex(pool->mutex);
+
+    uint32_t self = currentWorkerIndex;
+    stealSeed = self * 0x9E3779B9u + 1;
+
+    while (true) {
+        Job job;
+        if (takeJob(pool, self, &job)) {
+            runJob(pool, self, &job);
+            continue;
+        }
+
+        // Nothing to run or steal, so sleep until somebody queues something
+        SDL_LockMutex(pool->mutex);
+        SDL_AtomicIncRef(&pool->sleepingThreads);
+        while (SDL_AtomicGet(&pool->queuedJobs) <= 0 && !pool->shuttingDown) { SDL_CondWait(pool->wake, pool->mutex); }
+        SDL_AtomicAdd(&pool->sleepingThreads, -1);
+
+        // Workers finish whatever is still queued before they exit
+        bool exiting = pool->shuttingDown && SDL_AtomicGet(&pool->queuedJobs) <= 0;
+        SDL_UnlockMutex(pool->mutex);
+
+        if (exiting) { break; }
+    }
+
+    return 0;
+}
+
+
+int createThreadPool(InitializingInfo *initInfo, uint32_t threadCount) {
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    initInfo->threadPool = pool;
+
+    if (threadCount == 0) {
+        int cpuCount = SDL_GetCPUCount();
+        threadCount = cpuCount > 1 ? cpuCount - 1 : 1;
+    }
+
+    pool->mutex = SDL_CreateMutex();
+    pool->wake = SDL_CreateCond();
+    if (pool->mutex == NULL || pool->wake == NULL) { return EXIT_FAILURE; }
+
+    // The queues have to exist before any worker starts looking through them
+    pool->queues = calloc(threadCount + 1, sizeof(JobQueue));
+    for (uint32_t i = 0; i < threadCount + 1; i++) {
+        pool->queues[i].jobsCapacity = 64;
+        pool->queues[i].jobs = malloc(pool->queues[i].jobsCapacity * sizeof(Job));
+    }
+    pool->statsResetCounter = SDL_GetPerformanceCounter();
+    // Only needed to spread out the main thread's steals, the workers seed their own
+    stealSeed = 0x2545F491u;
+
+    pool->threads = malloc(threadCount * sizeof(SDL_Thread *));
+    for (int i = 0; i < threadCount; i++) {
+        pool->threads[i] = SDL_CreateThread(workerThread, "worker", pool);
+        if (pool->threads[i] == NULL) { return EXIT_FAILURE; }
+
+        pool->threadCount++;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyThreadPool(InitializingInfo *initInfo) {
+    ThreadPool *pool = initInfo->threadPool;
+    if (pool == NULL) { return; }
+
+    if (pool->mutex != NULL && pool->wake != NULL) {
+        SDL_LockMutex(pool->mutex);
+        pool->shuttingDown = true;
+        SDL_CondBroadcast(pool->wake);
+        SDL_UnlockMutex(pool->mutex);
+    }
+
+    for (int i = 0; i < pool->threadCount; i++) {
+        SDL_WaitThread(pool->threads[i], NULL);
+    }
+
+    if (pool->wake != NULL) { SDL_DestroyCond(pool->wake); }
+    if (pool->mutex != NULL) { SDL_DestroyMutex(pool->mutex); }
+
+    // Every worker was created with a queue, plus the one the other threads share
+    if (pool->queues != NULL) {
+        for (uint32_t i = 0; i < pool->threadCount + 1; i++) { free(pool->queues[i].jobs); }
+    }
+
+    free(pool->threads);
+    free(pool->queues);
+    free(pool);
+    initInfo->threadPool = NULL;
+}
+
+
+void submitJob(InitializingInfo *initInfo, JobFunction function, void *data) {
+    submitCountedJob(initInfo, &initInfo->threadPool->counter, function, data);
+}
+
+void waitForJobs(InitializingInfo *initInfo) {
+    waitForCounter(initInfo, &initInfo->threadPool->counter);
+}
+
+void submitCountedJob(InitializingInfo *initInfo, JobCounter *counter, JobFunction function, void *data) {
+    ThreadPool *pool = initInfo->threadPool;
+    Job job = { .function = function, .data = data, .counter = counter };
+
+    // Both counts have to go up before the job can be seen, or it could finish before they do
+    SDL_AtomicIncRef(&counter->pending);
+    SDL_AtomicIncRef(&pool->queuedJobs);
+    pushJobs(&pool->queues[getWorkerIndex(initInfo)], &job, 1);
+
+    wakeThreads(pool, 1);
+}
+
+void waitForCounter(InitializingInfo *initInfo, JobCounter *counter) {
+    ThreadPool *pool = initInfo->threadPool;
+    uint32_t self = getWorkerIndex(initInfo);
+
+    // Rather than sitting idle the waiting thread helps out, which is also what keeps a job waiting on its children from deadlocking
+    while (SDL_AtomicGet(&counter->pending) > 0) {
+        Job job;
+        if (takeJob(pool, self, &job)) {
+            runJob(pool, self, &job);
+            continue;
+        }
+
+        // Everything left is already running on other threads, so sleep until one of them finishes or queues more
+        SDL_LockMutex(pool->mutex);
+        SDL_AtomicIncRef(&pool->sleepingThreads);
+        while (SDL_AtomicGet(&counter->pending) > 0 && SDL_AtomicGet(&pool->queuedJobs) <= 0) { SDL_CondWait(pool->wake, pool->mutex); }
+        SDL_AtomicAdd(&pool->sleepingThreads, -1);
+
+        // The wake up we got might have been meant for a queued job, and we're about to leave without running it, so pass it on
+        if (SDL_AtomicGet(&counter->pending) <= 0 && SDL_AtomicGet(&pool->queuedJobs) > 0) { SDL_CondSignal(pool->wake); }
+        SDL_UnlockMutex(pool->mutex);
+    }
+}
+
+
+typedef struct {
+    ParallelForFunction function;
+    void *data;
+    uint32_t first;
+    uint32_t count;
+} ParallelForJob;
+
+void runParallelForJob(void *data) {
+    ParallelForJob *job = data;
+    job->function(job->first, job->count, job->data);
+}
+
+void parallelFor(InitializingInfo *initInfo, uint32_t count, uint32_t grainSize, ParallelForFunction function, void *data) {
+    ThreadPool *pool = initInfo->threadPool;
+    if (count == 0) { return; }
+
+    // A few pieces per thread evens things out when some take longer than others, stealing takes care of the rest
+    uint32_t threads = pool->threadCount + 1;
+    if (grainSize == 0) { grainSize = (count + threads * 4 - 1) / (threads * 4); }
+
+    uint32_t jobsCount = (count + grainSize - 1) / grainSize;
+    if (jobsCount > MAX_PARALLEL_FOR_JOBS) { jobsCount = MAX_PARALLEL_FOR_JOBS; }
+
+    // Not worth handing out
+    if (jobsCount <= 1) {
+        function(0, count, data);
+        return;
+    }
+
+    // Both arrays live on this stack frame, which is fine since we don't return until every job is done
+    ParallelForJob ranges[MAX_PARALLEL_FOR_JOBS];
+    Job jobs[MAX_PARALLEL_FOR_JOBS];
+    JobCounter counter = {  };
+
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < jobsCount; i++) {
+        uint32_t rangeCount = count / jobsCount + (i < count % jobsCount ? 1 : 0);
+
+        ranges[i] = (ParallelForJob){ .function = function, .data = data, .first = first, .count = rangeCount };
+        jobs[i] = (Job){ .function = runParallelForJob, .data = &ranges[i], .counter = &counter };
+        first += rangeCount;
+    }
+
+    // Everything but the first piece goes on the queue in one go, which is only one lock and one wake up for the lot
+    SDL_AtomicAdd(&counter.pending, jobsCount - 1);
+    SDL_AtomicAdd(&pool->queuedJobs, jobsCount - 1);
+    pushJobs(&pool->queues[getWorkerIndex(initInfo)], &jobs[1], jobsCount - 1);
+    wakeThreads(pool, jobsCount - 1);
+
+    // The calling thread takes the first piece instead of sitting idle, then helps with the rest
+    runParallelForJob(&ranges[0]);
+    waitForCounter(initInfo, &counter);
+}
+
+
+uint32_t getThreadPoolSize(InitializingInfo *initInfo) {
+    return initInfo->threadPool->threadCount;
+}
+
+uint32_t getWorkerIndex(InitializingInfo *initInfo) {
+    return currentWorkerIndex < initInfo->threadPool->threadCount ? currentWorkerIndex : initInfo->threadPool->threadCount;
+}
+
+
+void getWorkerStats(InitializingInfo *initInfo, WorkerStats *stats) {
+    ThreadPool *pool = initInfo->threadPool;
+
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    double elapsedMs = elapsedMilliseconds(pool->statsResetCounter);
+
+    for (uint32_t i = 0; i < pool->threadCount + 1; i++) {
+        JobQueue *queue = &pool->queues[i];
+        double busyMs = (double)(queue->busyCounter - queue->busyCounterBaseline) * 1000.0 / frequency;
+
+        stats[i] = (WorkerStats){
+            .jobsRun = queue->jobsRun - queue->jobsRunBaseline,
+            .jobsStolen = queue->jobsStolen - queue->jobsStolenBaseline,
+            .busyMs = busyMs,
+            .utilization = elapsedMs > 0.0 ? busyMs / elapsedMs : 0.0
+        };
+    }
+}
+
+void resetWorkerStats(InitializingInfo *initInfo) {
+    ThreadPool *pool = initInfo->threadPool;
+
+    // The workers keep counting the whole time, so this just remembers where they were instead of zeroing anything under them
+    for (uint32_t i = 0; i < pool->threadCount + 1; i++) {
+        JobQueue *queue = &pool->queues[i];
+
+        queue->jobsRunBaseline = queue->jobsRun;
+        queue->jobsStolenBaseline = queue->jobsStolen;
+        queue->busyCounterBaseline = queue->busyCounter;
+    }
+    pool->statsResetCounter = SDL_GetPerformanceCounter();
+}
@@ -0,0 +1,66 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include "../globals/globals.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdint.h>
+
+
+// parallelFor() never splits a range into more jobs than this
+#define MAX_PARALLEL_FOR_JOBS 256
+
+typedef void (*JobFunction)(void *data);
+// Called with a piece of the range, [first, first + count)
+typedef void (*ParallelForFunction)(uint32_t first, uint32_t count, void *data);
+
+// Counts how many jobs submitted against it haven't finished yet, so a job can wait on just its own children
+// Zero it before submitting anything against it, and keep it alive until waitForCounter() returns
+typedef struct {
+    SDL_atomic_t pending;
+} JobCounter;
+
+// How busy one thread has been since the last resetWorkerStats()
+typedef struct {
+    uint64_t jobsRun;
+    // How many of those were taken from another thread's queue instead of its own
+    uint64_t jobsStolen;
+    double busyMs;
+    // busyMs as a fraction of the time since the reset, from 0 to 1
+    double utilization;
+} WorkerStats;
+
+
+// threadCount 0 means one worker per CPU core minus the main thread
+int createThreadPool(InitializingInfo *initInfo, uint32_t threadCount);
+void destroyThreadPool(InitializingInfo *initInfo);
+
+// Every thread has its own queue and jobs go on the submitting thread's one, which it works through newest first
+// Idle workers steal the oldest jobs from the other queues, so there's no order jobs are guaranteed to start or finish in
+void submitJob(InitializingInfo *initInfo, JobFunction function, void *data);
+// Blocks until every job submitted with submitJob() has finished, running queued jobs itself in the meantime
+// Don't call it from inside a job, it would end up waiting on itself
+void waitForJobs(InitializingInfo *initInfo);
+
+// Same thing, but only tracked by counter, which is safe to wait on from inside a job
+// That's how a job splits itself into children: submit them against a counter of its own, then wait on it
+void submitCountedJob(InitializingInfo *initInfo, JobCounter *counter, JobFunction function, void *data);
+void waitForCounter(InitializingInfo *initInfo, JobCounter *counter);
+
+// Splits [0, count) into pieces of at least grainSize and spreads them over every thread, the calling one included
+// grainSize 0 picks one that gives each thread a few pieces to balance things out. Returns once the whole range is done
+void parallelFor(InitializingInfo *initInfo, uint32_t count, uint32_t grainSize, ParallelForFunction function, void *data);
+
+uint32_t getThreadPoolSize(InitializingInfo *initInfo);
+// Which worker the calling thread is, from 0 to getThreadPoolSize() - 1
+// Any thread that isn't a worker (like the main thread) gets getThreadPoolSize(), so per thread arrays can be sized getThreadPoolSize() + 1
+uint32_t getWorkerIndex(InitializingInfo *initInfo);
+
+// Fills in getThreadPoolSize() + 1 entries indexed like getWorkerIndex(), so the last one is the main thread
+// Only exact while nothing is running, like right after waitForJobs()
+void getWorkerStats(InitializingInfo *initInfo, WorkerStats *stats);
+void resetWorkerStats(InitializingInfo *initInfo);
+
+
+#endif
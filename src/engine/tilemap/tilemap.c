@@ -0,0 +1,477 @@
+#include "./tilemap.h"
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+#include "../upload/upload.h"
+#include "../sprite_batch/sprite_batch.h"
+#include "../frame/frame.h"
+#include "../software_renderer/software_renderer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+
+/*
+Each chunk's tiles live on the GPU as SpriteInstances in a device local buffer, positioned relative to the chunk's corner
+Drawing a chunk is one instanced draw with the sprite pipeline, with the push constant offset moving it into place under the camera
+Frames in flight may still be drawing from a chunk's buffer when its tiles change, so an edit never writes into it
+Instead the chunk is rebuilt into a new buffer, which only replaces the old one once its upload has finished,
+and the old one is destroyed once every frame that could have drawn from it is done
+With the software renderer the sprites stay in ordinary memory instead, and a rebuilt chunk simply replaces them
+*/
+
+
+typedef struct {
+    VkBuffer buffer;
+    GpuAllocation memory;
+    uint32_t instanceCount;
+
+    // A rebuilt buffer that's still uploading, there's only ever one at a time
+    bool pending;
+    VkBuffer pendingBuffer;
+    GpuAllocation pendingMemory;
+    uint32_t pendingInstanceCount;
+    UploadTicket pendingTicket;
+
+    bool dirty;
+
+    // Software renderer only, what it draws from in place of the buffer
+    SpriteInstance *instances;
+} TilemapChunk;
+
+typedef struct {
+    VkBuffer buffer;
+    GpuAllocation memory;
+    uint64_t frameNumber; // The first frame that no longer draws from it
+} RetiredChunkBuffer;
+
+struct Tilemap {
+    TilemapInfo info;
+    TileId *tiles;
+
+    uint32_t chunksX, chunksY;
+    TilemapChunk *chunks;
+    // How many chunks have a buffer with tiles in it, for counting how many got culled without looking at them
+    uint32_t filledChunkCount;
+
+    // Only chunks in these lists get looked at in updateTilemap(), so the cost scales with how much changed rather than how big the map is
+    uint32_t *dirtyChunks;
+    uint32_t dirtyChunksCount;
+    uint32_t *pendingChunks;
+    uint32_t pendingChunksCount;
+
+    // The chunks with tiles in them under the camera this frame, in the order they're drawn
+    // Filled in once by findTilemapDraws() so the draws can be split up between threads without anyone writing to the tilemap
+    uint32_t *visibleChunks;
+    uint32_t visibleChunksCount;
+
+    RetiredChunkBuffer *retiredBuffers;
+    uint32_t retiredBuffersCount;
+    uint32_t retiredBuffersCapacity;
+
+    int32_t cameraX, cameraY;
+
+    TilemapStats stats;
+};
+
+
+void markChunkDirty(Tilemap *tilemap, uint32_t chunkIndex) {
+    if (tilemap->chunks[chunkIndex].dirty) { return; }
+
+    tilemap->chunks[chunkIndex].dirty = true;
+    tilemap->dirtyChunks[tilemap->dirtyChunksCount++] = chunkIndex;
+}
+
+void retireChunkBuffer(InitializingInfo *initInfo, VkBuffer buffer, GpuAllocation *memory) {
+    Tilemap *tilemap = initInfo->tilemap;
+    if (buffer == VK_NULL_HANDLE) { return; }
+
+    if (tilemap->retiredBuffersCount == tilemap->retiredBuffersCapacity) {
+        tilemap->retiredBuffersCapacity = tilemap->retiredBuffersCapacity == 0 ? 16 : tilemap->retiredBuffersCapacity * 2;
+        tilemap->retiredBuffers = realloc(tilemap->retiredBuffers, tilemap->retiredBuffersCapacity * sizeof(RetiredChunkBuffer));
+    }
+
+    // This is called before the current frame is recorded, so the current frame is the first one that won't use it
+    tilemap->retiredBuffers[tilemap->retiredBuffersCount++] = (RetiredChunkBuffer){
+        .buffer = buffer,
+        .memory = *memory,
+        .frameNumber = initInfo->frameNumber
+    };
+}
+
+void destroyRetiredChunkBuffers(InitializingInfo *initInfo) {
+    Tilemap *tilemap = initInfo->tilemap;
+
+    // beginFrame() has already waited for frame frameNumber - maxFramesInFlight, the same rule the retired swap chain uses
+    uint32_t kept = 0;
+    for (int i = 0; i < tilemap->retiredBuffersCount; i++) {
+        RetiredChunkBuffer *retired = &tilemap->retiredBuffers[i];
+
+        if (initInfo->frameNumber >= retired->frameNumber + initInfo->maxFramesInFlight) {
+            vkDestroyBuffer(initInfo->device, retired->buffer, NULL);
+            gpuFree(initInfo, &retired->memory);
+        } else {
+            tilemap->retiredBuffers[kept++] = *retired;
+        }
+    }
+    tilemap->retiredBuffersCount = kept;
+}
+
+
+void setChunkContents(Tilemap *tilemap, TilemapChunk *chunk, VkBuffer buffer, GpuAllocation memory, uint32_t instanceCount) {
+    if (chunk->instanceCount > 0) { tilemap->filledChunkCount--; }
+    if (instanceCount > 0) { tilemap->filledChunkCount++; }
+
+    chunk->buffer = buffer;
+    chunk->memory = memory;
+    chunk->instanceCount = instanceCount;
+}
+
+// One sprite per tile that isn't empty, positioned relative to the chunk's corner
+void writeChunkSprites(Tilemap *tilemap, uint32_t chunkIndex, SpriteInstance *instances) {
+    const TilemapInfo *info = &tilemap->info;
+
+    uint32_t firstX = (chunkIndex % tilemap->chunksX) * TILEMAP_CHUNK_SIZE;
+    uint32_t firstY = (chunkIndex / tilemap->chunksX) * TILEMAP_CHUNK_SIZE;
+    uint32_t endX = firstX + TILEMAP_CHUNK_SIZE < info->width ? firstX + TILEMAP_CHUNK_SIZE : info->width;
+    uint32_t endY = firstY + TILEMAP_CHUNK_SIZE < info->height ? firstY + TILEMAP_CHUNK_SIZE : info->height;
+
+    uint32_t written = 0;
+    float tileSize = (float)info->tileSize;
+    float tileU = 1.0f / info->tilesetColumns;
+    float tileV = 1.0f / info->tilesetRows;
+
+    for (uint32_t y = firstY; y < endY; y++) {
+        for (uint32_t x = firstX; x < endX; x++) {
+            TileId tile = tilemap->tiles[y * info->width + x];
+            if (tile == 0) { continue; }
+
+            uint32_t column = (tile - 1) % info->tilesetColumns;
+            uint32_t row = (tile - 1) / info->tilesetColumns;
+
+            instances[written++] = (SpriteInstance){
+                .x = (x - firstX) * tileSize,
+                .y = (y - firstY) * tileSize,
+                .width = tileSize,
+                .height = tileSize,
+                .u0 = column * tileU, .v0 = row * tileV, .u1 = (column + 1) * tileU, .v1 = (row + 1) * tileV,
+                .tint = 0xFFFFFFFF,
+                .layer = info->layer,
+                .textureId = info->textureId
+            };
+        }
+    }
+}
+
+// Returns false if the chunk couldn't be rebuilt this frame, it stays dirty and gets tried again next frame
+bool rebuildChunk(InitializingInfo *initInfo, uint32_t chunkIndex) {
+    Tilemap *tilemap = initInfo->tilemap;
+    TilemapChunk *chunk = &tilemap->chunks[chunkIndex];
+    const TilemapInfo *info = &tilemap->info;
+
+    uint32_t firstX = (chunkIndex % tilemap->chunksX) * TILEMAP_CHUNK_SIZE;
+    uint32_t firstY = (chunkIndex / tilemap->chunksX) * TILEMAP_CHUNK_SIZE;
+    uint32_t endX = firstX + TILEMAP_CHUNK_SIZE < info->width ? firstX + TILEMAP_CHUNK_SIZE : info->width;
+    uint32_t endY = firstY + TILEMAP_CHUNK_SIZE < info->height ? firstY + TILEMAP_CHUNK_SIZE : info->height;
+
+    uint32_t instanceCount = 0;
+    for (uint32_t y = firstY; y < endY; y++) {
+        for (uint32_t x = firstX; x < endX; x++) {
+            if (tilemap->tiles[y * info->width + x] != 0) { instanceCount++; }
+        }
+    }
+
+    // Nothing left to draw, so there's nothing to upload either
+    if (instanceCount == 0) {
+        retireChunkBuffer(initInfo, chunk->buffer, &chunk->memory);
+        setChunkContents(tilemap, chunk, VK_NULL_HANDLE, (GpuAllocation){  }, 0);
+        free(chunk->instances);
+        chunk->instances = NULL;
+        return true;
+    }
+
+    // Nothing can still be drawing from the old sprites once endFrame() has returned, so there's nothing to wait for
+    if (initInfo->softwareRendering) {
+        SpriteInstance *instances = malloc(instanceCount * sizeof(SpriteInstance));
+        if (instances == NULL) { return false; }
+
+        writeChunkSprites(tilemap, chunkIndex, instances);
+        free(chunk->instances);
+        chunk->instances = instances;
+        setChunkContents(tilemap, chunk, VK_NULL_HANDLE, (GpuAllocation){  }, instanceCount);
+        return true;
+    }
+
+    // The sprites get written straight into the staging ring, so they're never copied on the CPU
+    VkDeviceSize size = (VkDeviceSize)instanceCount * sizeof(SpriteInstance);
+    UploadReservation reservation;
+    if (!reserveUpload(initInfo, size, &reservation)) { return false; }
+
+    writeChunkSprites(tilemap, chunkIndex, reservation.data);
+
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+
+        .size = size,
+        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    VkBuffer buffer;
+    GpuAllocation memory = {  };
+    if (vkCreateBuffer(initInfo->device, &bufferInfo, NULL, &buffer) != VK_SUCCESS) {
+        cancelUploadReservation(initInfo, &reservation);
+        return false;
+    }
+    if (allocateBufferMemory(initInfo, buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &memory) == EXIT_FAILURE) {
+        vkDestroyBuffer(initInfo->device, buffer, NULL);
+        cancelUploadReservation(initInfo, &reservation);
+        return false;
+    }
+
+    UploadTicket ticket = commitBufferUpload(initInfo, &reservation, buffer, 0);
+    if (ticket == 0) {
+        vkDestroyBuffer(initInfo->device, buffer, NULL);
+        gpuFree(initInfo, &memory);
+        return false;
+    }
+
+    chunk->pending = true;
+    chunk->pendingBuffer = buffer;
+    chunk->pendingMemory = memory;
+    chunk->pendingInstanceCount = instanceCount;
+    chunk->pendingTicket = ticket;
+    tilemap->pendingChunks[tilemap->pendingChunksCount++] = chunkIndex;
+
+    return true;
+}
+
+
+int createTilemap(InitializingInfo *initInfo, const TilemapInfo *info, const TileId *tiles) {
+    if (info->width == 0 || info->height == 0 || info->tileSize == 0) { return EXIT_FAILURE; }
+
+    Tilemap *tilemap = calloc(1, sizeof(Tilemap));
+    initInfo->tilemap = tilemap;
+
+    tilemap->info = *info;
+    if (tilemap->info.tilesetColumns == 0) { tilemap->info.tilesetColumns = 1; }
+    if (tilemap->info.tilesetRows == 0) { tilemap->info.tilesetRows = 1; }
+
+    size_t tileCount = (size_t)info->width * info->height;
+    tilemap->tiles = calloc(tileCount, sizeof(TileId));
+    if (tiles != NULL) { memcpy(tilemap->tiles, tiles, tileCount * sizeof(TileId)); }
+
+    tilemap->chunksX = (info->width + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    tilemap->chunksY = (info->height + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    uint32_t chunkCount = tilemap->chunksX * tilemap->chunksY;
+
+    tilemap->chunks = calloc(chunkCount, sizeof(TilemapChunk));
+    tilemap->dirtyChunks = malloc(chunkCount * sizeof(uint32_t));
+    tilemap->pendingChunks = malloc(chunkCount * sizeof(uint32_t));
+    tilemap->visibleChunks = malloc(chunkCount * sizeof(uint32_t));
+
+    // Every chunk with something in it gets built by the first updateTilemap(), after that only edits cause uploads
+    for (uint32_t y = 0; y < info->height; y++) {
+        for (uint32_t x = 0; x < info->width; x++) {
+            if (tilemap->tiles[y * info->width + x] != 0) { markChunkDirty(tilemap, (y / TILEMAP_CHUNK_SIZE) * tilemap->chunksX + x / TILEMAP_CHUNK_SIZE); }
+        }
+    }
+
+    printf("Created a %ux%u tilemap in %u chunks\n", info->width, info->height, chunkCount);
+
+    return EXIT_SUCCESS;
+}
+
+void destroyTilemap(InitializingInfo *initInfo) {
+    Tilemap *tilemap = initInfo->tilemap;
+    if (tilemap == NULL) { return; }
+
+    for (int i = 0; i < tilemap->chunksX * tilemap->chunksY; i++) {
+        TilemapChunk *chunk = &tilemap->chunks[i];
+
+        free(chunk->instances);
+        if (initInfo->softwareRendering) { continue; }
+
+        vkDestroyBuffer(initInfo->device, chunk->buffer, NULL);
+        gpuFree(initInfo, &chunk->memory);
+        if (chunk->pending) {
+            vkDestroyBuffer(initInfo->device, chunk->pendingBuffer, NULL);
+            gpuFree(initInfo, &chunk->pendingMemory);
+        }
+    }
+    for (int i = 0; i < tilemap->retiredBuffersCount; i++) {
+        vkDestroyBuffer(initInfo->device, tilemap->retiredBuffers[i].buffer, NULL);
+        gpuFree(initInfo, &tilemap->retiredBuffers[i].memory);
+    }
+
+    free(tilemap->tiles);
+    free(tilemap->chunks);
+    free(tilemap->dirtyChunks);
+    free(tilemap->pendingChunks);
+    free(tilemap->visibleChunks);
+    free(tilemap->retiredBuffers);
+    free(tilemap);
+    initInfo->tilemap = NULL;
+}
+
+
+TileId getTile(InitializingInfo *initInfo, uint32_t x, uint32_t y) {
+    Tilemap *tilemap = initInfo->tilemap;
+    if (x >= tilemap->info.width || y >= tilemap->info.height) { return 0; }
+
+    return tilemap->tiles[y * tilemap->info.width + x];
+}
+
+void setTile(InitializingInfo *initInfo, uint32_t x, uint32_t y, TileId tile) {
+    Tilemap *tilemap = initInfo->tilemap;
+    if (x >= tilemap->info.width || y >= tilemap->info.height) { return; }
+
+    TileId *destination = &tilemap->tiles[y * tilemap->info.width + x];
+    if (*destination == tile) { return; }
+
+    *destination = tile;
+    markChunkDirty(tilemap, (y / TILEMAP_CHUNK_SIZE) * tilemap->chunksX + x / TILEMAP_CHUNK_SIZE);
+    requestRedraw(initInfo);
+}
+
+void setTilemapCamera(InitializingInfo *initInfo, int32_t x, int32_t y) {
+    if (initInfo->tilemap->cameraX == x && initInfo->tilemap->cameraY == y) { return; }
+
+    initInfo->tilemap->cameraX = x;
+    initInfo->tilemap->cameraY = y;
+    requestRedraw(initInfo);
+}
+
+
+void updateTilemap(InitializingInfo *initInfo) {
+    Tilemap *tilemap = initInfo->tilemap;
+    tilemap->stats = (TilemapStats){  };
+
+    destroyRetiredChunkBuffers(initInfo);
+
+    // Swapping in finished uploads has to happen before the frame records its upload acquires, so the new buffers are owned by the graphics queue before we draw from them
+    uint32_t stillPending = 0;
+    for (int i = 0; i < tilemap->pendingChunksCount; i++) {
+        TilemapChunk *chunk = &tilemap->chunks[tilemap->pendingChunks[i]];
+
+        if (!isUploadComplete(initInfo, chunk->pendingTicket)) {
+            tilemap->pendingChunks[stillPending++] = tilemap->pendingChunks[i];
+            continue;
+        }
+
+        retireChunkBuffer(initInfo, chunk->buffer, &chunk->memory);
+        setChunkContents(tilemap, chunk, chunk->pendingBuffer, chunk->pendingMemory, chunk->pendingInstanceCount);
+        chunk->pending = false;
+    }
+    tilemap->pendingChunksCount = stillPending;
+
+    // A chunk that's still uploading an older version waits until that one is swapped in, so there's never more than one upload per chunk in flight
+    uint32_t stillDirty = 0;
+    for (int i = 0; i < tilemap->dirtyChunksCount; i++) {
+        uint32_t chunkIndex = tilemap->dirtyChunks[i];
+        TilemapChunk *chunk = &tilemap->chunks[chunkIndex];
+
+        if (!chunk->pending && rebuildChunk(initInfo, chunkIndex)) {
+            chunk->dirty = false;
+            tilemap->stats.chunksUploaded++;
+        } else {
+            tilemap->dirtyChunks[stillDirty++] = chunkIndex;
+        }
+    }
+    tilemap->dirtyChunksCount = stillDirty;
+}
+
+// Rounds towards negative infinity, so the camera can go past the map's top left corner
+int64_t floorDivide(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+// Only the chunks under the camera rectangle are visited at all, everything else is culled without being looked at
+void findVisibleChunks(InitializingInfo *initInfo, int64_t *firstX, int64_t *firstY, int64_t *lastX, int64_t *lastY) {
+    Tilemap *tilemap = initInfo->tilemap;
+
+    int64_t chunkPixels = (int64_t)TILEMAP_CHUNK_SIZE * tilemap->info.tileSize;
+    *firstX = floorDivide(tilemap->cameraX, chunkPixels);
+    *firstY = floorDivide(tilemap->cameraY, chunkPixels);
+    *lastX = floorDivide((int64_t)tilemap->cameraX + initInfo->canvasExtent.width - 1, chunkPixels);
+    *lastY = floorDivide((int64_t)tilemap->cameraY + initInfo->canvasExtent.height - 1, chunkPixels);
+
+    *firstX = *firstX < 0 ? 0 : *firstX;
+    *firstY = *firstY < 0 ? 0 : *firstY;
+    *lastX = *lastX >= tilemap->chunksX ? tilemap->chunksX - 1 : *lastX;
+    *lastY = *lastY >= tilemap->chunksY ? tilemap->chunksY - 1 : *lastY;
+}
+
+uint32_t findTilemapDraws(InitializingInfo *initInfo) {
+    Tilemap *tilemap = initInfo->tilemap;
+    tilemap->visibleChunksCount = 0;
+    if (tilemap->filledChunkCount == 0) { return 0; }
+
+    int64_t firstX, firstY, lastX, lastY;
+    findVisibleChunks(initInfo, &firstX, &firstY, &lastX, &lastY);
+
+    for (int64_t y = firstY; y <= lastY; y++) {
+        for (int64_t x = firstX; x <= lastX; x++) {
+            uint32_t chunkIndex = (uint32_t)(y * tilemap->chunksX + x);
+            TilemapChunk *chunk = &tilemap->chunks[chunkIndex];
+            if (chunk->instanceCount == 0) { continue; }
+
+            tilemap->visibleChunks[tilemap->visibleChunksCount++] = chunkIndex;
+
+            tilemap->stats.chunksDrawn++;
+            tilemap->stats.tilesDrawn += chunk->instanceCount;
+        }
+    }
+
+    tilemap->stats.chunksCulled = tilemap->filledChunkCount - tilemap->stats.chunksDrawn;
+
+    return tilemap->visibleChunksCount;
+}
+
+void recordTilemapChunks(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count) {
+    Tilemap *tilemap = initInfo->tilemap;
+    if (count == 0) { return; }
+
+    int64_t chunkPixels = (int64_t)TILEMAP_CHUNK_SIZE * tilemap->info.tileSize;
+    bindSpritePipeline(initInfo, commandBuffer);
+
+    for (uint32_t i = first; i < first + count; i++) {
+        uint32_t chunkIndex = tilemap->visibleChunks[i];
+        TilemapChunk *chunk = &tilemap->chunks[chunkIndex];
+        int64_t x = chunkIndex % tilemap->chunksX;
+        int64_t y = chunkIndex / tilemap->chunksX;
+
+        setSpriteOffset(initInfo, commandBuffer, (float)(x * chunkPixels - tilemap->cameraX), (float)(y * chunkPixels - tilemap->cameraY));
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &chunk->buffer, &offset);
+        vkCmdDraw(commandBuffer, 4, chunk->instanceCount, 0, 0);
+    }
+}
+
+void addTilemapToSoftwareFrame(InitializingInfo *initInfo) {
+    Tilemap *tilemap = initInfo->tilemap;
+
+    int64_t chunkPixels = (int64_t)TILEMAP_CHUNK_SIZE * tilemap->info.tileSize;
+    uint32_t chunkCount = findTilemapDraws(initInfo);
+
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        uint32_t chunkIndex = tilemap->visibleChunks[i];
+        TilemapChunk *chunk = &tilemap->chunks[chunkIndex];
+        int64_t x = chunkIndex % tilemap->chunksX;
+        int64_t y = chunkIndex / tilemap->chunksX;
+
+        addSoftwareSprites(initInfo, chunk->instances, chunk->instanceCount, (float)(x * chunkPixels - tilemap->cameraX), (float)(y * chunkPixels - tilemap->cameraY));
+    }
+}
+
+TilemapStats getTilemapStats(InitializingInfo *initInfo) {
+    return initInfo->tilemap->stats;
+}
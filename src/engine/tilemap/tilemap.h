@@ -0,0 +1,63 @@
+#ifndef TILEMAP
+#define TILEMAP
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+
+// Maps are split into square chunks of this many tiles a side, each with its own vertex buffer
+#define TILEMAP_CHUNK_SIZE 32
+
+// 0 is an empty tile, anything else is 1 + its index into the tileset
+typedef uint16_t TileId;
+
+typedef struct {
+    uint32_t width, height; // In tiles
+    uint32_t tileSize; // In canvas pixels
+
+    // The tileset is one texture split into a grid of equally sized tiles, counted left to right and then top to bottom
+    uint32_t tilesetColumns, tilesetRows;
+    uint32_t textureId; // From registerTexture(), like a sprite's
+    float layer; // Copied onto every tile, but the whole tilemap is drawn under the sprites whatever their layers
+} TilemapInfo;
+
+typedef struct {
+    uint32_t chunksDrawn;
+    uint32_t chunksCulled; // Chunks with tiles in them that were outside the camera
+    uint32_t chunksUploaded; // Chunks rebuilt because their tiles changed
+    uint32_t tilesDrawn;
+} TilemapStats;
+
+
+// tiles is width * height tile ids row by row, or NULL to start out empty
+// Every chunk's tiles are turned into sprites once and uploaded into a device local buffer, so a tile that never changes costs nothing per frame
+int createTilemap(InitializingInfo *initInfo, const TilemapInfo *info, const TileId *tiles);
+// Called by cleanup(), only call it yourself after finishFrames()
+void destroyTilemap(InitializingInfo *initInfo);
+
+TileId getTile(InitializingInfo *initInfo, uint32_t x, uint32_t y);
+// Marks the tile's chunk dirty, it gets rebuilt and uploaded once at the end of the frame no matter how many of its tiles changed
+void setTile(InitializingInfo *initInfo, uint32_t x, uint32_t y, TileId tile);
+
+// The top left corner of the view in map pixels, whole pixels only so tiles always land on the canvas's pixel grid
+void setTilemapCamera(InitializingInfo *initInfo, int32_t x, int32_t y);
+
+// Called by endFrame() before uploads are submitted, starts uploads for dirty chunks and swaps in the ones that finished
+void updateTilemap(InitializingInfo *initInfo);
+// Called by the frame's command buffer recording before anything is recorded, only chunks that overlap the camera get a draw call
+// Returns how many draw calls that is, one per chunk
+uint32_t findTilemapDraws(InitializingInfo *initInfo);
+// Records draw calls first to first + count - 1 of the ones findTilemapDraws() found, inside the render pass
+// Different ranges can be recorded into different command buffers on different threads at the same time
+void recordTilemapChunks(InitializingInfo *initInfo, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count);
+// The software renderer's version, called by endFrame() to add the chunks that overlap the camera to the frame
+void addTilemapToSoftwareFrame(InitializingInfo *initInfo);
+
+// Counts for the last frame that was recorded
+TilemapStats getTilemapStats(InitializingInfo *initInfo);
+
+
+#endif
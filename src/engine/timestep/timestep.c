@@ -0,0 +1,83 @@
+#include "./timestep.h"
+
+#include "../globals/globals.h"
+#include "../ecs/ecs.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+void initFixedTimestep(FixedTimestep *timestep, uint32_t ticksPerSecond) {
+    if (ticksPerSecond == 0) { ticksPerSecond = DEFAULT_TICK_RATE; }
+
+    *timestep = (FixedTimestep){
+        .tickSeconds = 1.0 / ticksPerSecond,
+        .lastCounter = SDL_GetPerformanceCounter()
+    };
+}
+
+void advanceFixedTimestep(FixedTimestep *timestep) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    double seconds = (double)(now - timestep->lastCounter) / (double)SDL_GetPerformanceFrequency();
+    timestep->lastCounter = now;
+
+    advanceFixedTimestepBy(timestep, seconds);
+}
+
+void resyncFixedTimestep(FixedTimestep *timestep) {
+    timestep->lastCounter = SDL_GetPerformanceCounter();
+}
+
+void advanceFixedTimestepBy(FixedTimestep *timestep, double seconds) {
+    if (seconds > MAX_FRAME_SECONDS) { seconds = MAX_FRAME_SECONDS; }
+    if (seconds < 0.0) { seconds = 0.0; }
+
+    timestep->accumulator += seconds;
+    timestep->ticksThisFrame = 0;
+}
+
+bool nextTick(FixedTimestep *timestep) {
+    if (timestep->accumulator < timestep->tickSeconds) { return false; }
+
+    if (timestep->ticksThisFrame == MAX_TICKS_PER_FRAME) {
+        // We're behind by more than we're allowed to catch up on, so let the simulation fall behind real time instead
+        // Only whole ticks are dropped, so the leftover fraction still interpolates smoothly
+        while (timestep->accumulator >= timestep->tickSeconds) {
+            timestep->accumulator -= timestep->tickSeconds;
+            timestep->droppedTicks++;
+        }
+
+        return false;
+    }
+
+    timestep->accumulator -= timestep->tickSeconds;
+    timestep->ticksThisFrame++;
+    timestep->tickNumber++;
+
+    return true;
+}
+
+float getTimestepAlpha(const FixedTimestep *timestep) {
+    float alpha = (float)(timestep->accumulator / timestep->tickSeconds);
+
+    return CLAMP(alpha, 0.0f, 1.0f);
+}
+
+
+void savePreviousPositions(InitializingInfo *initInfo) {
+    if (initInfo->world == NULL) { return; }
+
+    EcsQuery query = {
+        .components = { POSITION_COMPONENT, PREVIOUS_POSITION_COMPONENT },
+        .componentsCount = 2
+    };
+
+    // Both are packed arrays of the same layout, so a chunk is a single copy
+    EcsChunkView view = beginQuery(initInfo, &query);
+    while (nextQueryChunk(&view)) {
+        memcpy(view.columns[1], view.columns[0], view.count * sizeof(PositionComponent));
+    }
+}
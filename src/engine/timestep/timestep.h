@@ -0,0 +1,59 @@
+#ifndef TIMESTEP
+#define TIMESTEP
+
+#include "../globals/globals.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define DEFAULT_TICK_RATE 60
+// The spiral of death clamp: if the simulation can't keep up, at most this many ticks run per frame and the rest of the backlog is dropped
+// Otherwise every slow frame would queue up even more ticks for the next one, which would be slower still
+#define MAX_TICKS_PER_FRAME 8
+// Anything longer than this between two frames (like sitting in a debugger) counts as this long
+#define MAX_FRAME_SECONDS 0.25
+
+
+/*
+Runs the simulation at a fixed rate no matter how fast frames are drawn
+    advanceFixedTimestep(&timestep);
+    while (nextTick(&timestep)) { simulate(timestep.tickSeconds); }
+    initInfo->interpolationAlpha = getTimestepAlpha(&timestep);
+    draw();
+Every tick is the same length, so the simulation behaves the same on a 30 Hz laptop and a 240 Hz monitor
+and doesn't cost more just because frames are being drawn faster
+*/
+typedef struct {
+    double tickSeconds;
+
+    Uint64 lastCounter;
+    double accumulator; // Time that's passed but hasn't been simulated yet
+    uint32_t ticksThisFrame;
+
+    uint64_t tickNumber; // Goes up by one every time nextTick() returns true, so the first tick is tick 1
+    uint64_t droppedTicks; // How many ticks the spiral of death clamp has thrown away
+} FixedTimestep;
+
+
+void initFixedTimestep(FixedTimestep *timestep, uint32_t ticksPerSecond);
+
+// Adds the real time that's passed since the last call (or initFixedTimestep())
+void advanceFixedTimestep(FixedTimestep *timestep);
+// Adds exactly this much time instead, for headless runs and replays that shouldn't depend on how fast the machine is
+void advanceFixedTimestepBy(FixedTimestep *timestep, double seconds);
+// Forgets the real time that's passed since the last advance, so a loop that slept while idle doesn't try to simulate it all at once
+void resyncFixedTimestep(FixedTimestep *timestep);
+// Returns true while there's a whole tick due
+bool nextTick(FixedTimestep *timestep);
+// How far between the last two ticks the current moment is, from 0 to 1
+float getTimestepAlpha(const FixedTimestep *timestep);
+
+// Copies every entity's PositionComponent into its PreviousPositionComponent, call it right before each tick moves anything
+// addSpriteComponents() then draws those entities at interpolationAlpha of the way from the previous position to the current one
+void savePreviousPositions(InitializingInfo *initInfo);
+
+
+#endif
@@ -0,0 +1,482 @@
+#include "./upload.h"
+
+#include "../globals/globals.h"
+#include "../allocator/allocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+
+/*
+Uploads work like this:
+- The data is copied into a host visible staging buffer that's used as a ring, so there's no allocation per upload
+- A copy from the staging buffer into the real resource is recorded into the current batch's command buffer
+- Every frame the batch is submitted to the transfer queue with a fence, and a new batch starts
+- Once the fence signals, the batch's part of the ring can be reused and the resources can be handed over to the graphics queue
+When the transfer queue is from a different family than the graphics queue, the resources have to be explicitly released by the transfer queue and
+acquired by the graphics queue (a queue family ownership transfer), otherwise their contents are undefined on the graphics queue
+*/
+#define STAGING_RING_BYTES (32 * 1024 * 1024)
+#define UPLOAD_BATCH_COUNT 4
+
+
+typedef struct {
+    VkBufferMemoryBarrier *bufferBarriers;
+    uint32_t bufferBarriersCount;
+    uint32_t bufferBarriersCapacity;
+
+    VkImageMemoryBarrier *imageBarriers;
+    uint32_t imageBarriersCount;
+    uint32_t imageBarriersCapacity;
+} BarrierList;
+
+typedef struct {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    bool recording;
+
+    // Where the staging ring's write position was when this batch was submitted, everything before it is free again once the batch is done
+    uint64_t stagingEnd;
+
+    BarrierList releases; // Recorded at the end of this batch
+    BarrierList acquires; // Recorded on the graphics queue once this batch is done
+} UploadBatch;
+
+struct UploadManager {
+    VkCommandPool commandPool;
+    UploadBatch batches[UPLOAD_BATCH_COUNT];
+    bool ownershipTransfer;
+
+    VkBuffer stagingBuffer;
+    GpuAllocation stagingMemory;
+    VkDeviceSize stagingAlignment;
+    // Total bytes ever written to and freed from the ring, the actual offset is these modulo STAGING_RING_BYTES
+    uint64_t stagingWritten;
+    uint64_t stagingReclaimed;
+    // Space from here on can't be reclaimed because it belongs to reservations that haven't been committed yet
+    uint64_t stagingPinnedFrom;
+    uint32_t pendingReservations;
+
+    uint64_t nextBatch; // The batch being recorded right now
+    uint64_t completedBatches; // Every batch below this one is done on the GPU
+
+    BarrierList readyAcquires;
+};
+
+
+void pushBufferBarrier(BarrierList *list, VkBufferMemoryBarrier barrier) {
+    if (list->bufferBarriersCount == list->bufferBarriersCapacity) {
+        list->bufferBarriersCapacity = list->bufferBarriersCapacity == 0 ? 16 : list->bufferBarriersCapacity * 2;
+        list->bufferBarriers = realloc(list->bufferBarriers, list->bufferBarriersCapacity * sizeof(VkBufferMemoryBarrier));
+    }
+    list->bufferBarriers[list->bufferBarriersCount++] = barrier;
+}
+
+void pushImageBarrier(BarrierList *list, VkImageMemoryBarrier barrier) {
+    if (list->imageBarriersCount == list->imageBarriersCapacity) {
+        list->imageBarriersCapacity = list->imageBarriersCapacity == 0 ? 16 : list->imageBarriersCapacity * 2;
+        list->imageBarriers = realloc(list->imageBarriers, list->imageBarriersCapacity * sizeof(VkImageMemoryBarrier));
+    }
+    list->imageBarriers[list->imageBarriersCount++] = barrier;
+}
+
+void moveBarriers(BarrierList *from, BarrierList *to) {
+    for (int i = 0; i < from->bufferBarriersCount; i++) { pushBufferBarrier(to, from->bufferBarriers[i]); }
+    for (int i = 0; i < from->imageBarriersCount; i++) { pushImageBarrier(to, from->imageBarriers[i]); }
+
+    from->bufferBarriersCount = 0;
+    from->imageBarriersCount = 0;
+}
+
+void freeBarriers(BarrierList *list) {
+    free(list->bufferBarriers);
+    free(list->imageBarriers);
+    *list = (BarrierList){  };
+}
+
+
+void updateUploads(InitializingInfo *initInfo) {
+    UploadManager *uploader = initInfo->uploader;
+
+    // Batches run on one queue and finish in order, so we can stop at the first one that isn't done yet
+    while (uploader->completedBatches < uploader->nextBatch) {
+        UploadBatch *batch = &uploader->batches[uploader->completedBatches % UPLOAD_BATCH_COUNT];
+        if (vkGetFenceStatus(initInfo->device, batch->fence) != VK_SUCCESS) { break; }
+
+        uploader->stagingReclaimed = batch->stagingEnd < uploader->stagingPinnedFrom ? batch->stagingEnd : uploader->stagingPinnedFrom;
+        moveBarriers(&batch->acquires, &uploader->readyAcquires);
+        uploader->completedBatches++;
+    }
+}
+
+void waitForOldestBatch(InitializingInfo *initInfo) {
+    UploadManager *uploader = initInfo->uploader;
+    if (uploader->completedBatches == uploader->nextBatch) { return; }
+
+    UploadBatch *batch = &uploader->batches[uploader->completedBatches % UPLOAD_BATCH_COUNT];
+    vkWaitForFences(initInfo->device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    updateUploads(initInfo);
+}
+
+int beginBatch(InitializingInfo *initInfo) {
+    UploadManager *uploader = initInfo->uploader;
+    UploadBatch *batch = &uploader->batches[uploader->nextBatch % UPLOAD_BATCH_COUNT];
+    if (batch->recording) { return EXIT_SUCCESS; }
+
+    // Every batch slot is still on the GPU, which only happens if we're uploading faster than the transfer queue can keep up
+    while (uploader->nextBatch - uploader->completedBatches >= UPLOAD_BATCH_COUNT) { waitForOldestBatch(initInfo); }
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if (vkBeginCommandBuffer(batch->commandBuffer, &beginInfo) != VK_SUCCESS) { return EXIT_FAILURE; }
+    batch->recording = true;
+
+    return EXIT_SUCCESS;
+}
+
+bool allocateStaging(InitializingInfo *initInfo, VkDeviceSize size, VkDeviceSize *offset) {
+    UploadManager *uploader = initInfo->uploader;
+    if (size > STAGING_RING_BYTES) {
+        printf("Upload of %llu bytes is bigger than the whole staging ring!\n", (unsigned long long)size);
+        return false;
+    }
+
+    uint64_t start = (uploader->stagingWritten + uploader->stagingAlignment - 1) / uploader->stagingAlignment * uploader->stagingAlignment;
+    // A copy can't wrap around the end of the buffer, so skip to the start of the ring if it doesn't fit
+    if (start % STAGING_RING_BYTES + size > STAGING_RING_BYTES) { start += STAGING_RING_BYTES - start % STAGING_RING_BYTES; }
+
+    // If the ring is full we have to wait for the GPU to finish with the oldest batch, sending off the current one first if that's what is holding the space
+    while (start + size - uploader->stagingReclaimed > STAGING_RING_BYTES) {
+        // Nothing is using the ring at all, so the bytes we skipped to wrap around don't count against it
+        if (uploader->stagingReclaimed == uploader->stagingWritten) {
+            uploader->stagingReclaimed = start;
+            break;
+        }
+
+        if (uploader->completedBatches == uploader->nextBatch) {
+            if (!uploader->batches[uploader->nextBatch % UPLOAD_BATCH_COUNT].recording) {
+                // No batch holds any of the ring, so the only space still in use is what uncommitted reservations pinned
+                // Anything before that was only ever touched by cancelled reservations, which never move stagingReclaimed on their own
+                uint64_t freeUpTo = uploader->pendingReservations == 0 ? uploader->stagingWritten : uploader->stagingPinnedFrom;
+                if (freeUpTo > uploader->stagingReclaimed) {
+                    uploader->stagingReclaimed = freeUpTo;
+                    continue;
+                }
+
+                // Only uncommitted reservations are left holding the space, and waiting won't free those
+                return false;
+            }
+            if (submitUploads(initInfo) == EXIT_FAILURE) { return false; }
+        }
+        waitForOldestBatch(initInfo);
+    }
+
+    uploader->stagingWritten = start + size;
+    *offset = start % STAGING_RING_BYTES;
+
+    return true;
+}
+
+
+bool reserveUpload(InitializingInfo *initInfo, VkDeviceSize size, UploadReservation *reservation) {
+    UploadManager *uploader = initInfo->uploader;
+
+    VkDeviceSize stagingOffset;
+    uint64_t writtenBefore = uploader->stagingWritten;
+    if (!allocateStaging(initInfo, size, &stagingOffset)) { return false; }
+
+    if (uploader->pendingReservations++ == 0) { uploader->stagingPinnedFrom = writtenBefore; }
+
+    *reservation = (UploadReservation){
+        .data = (char *)uploader->stagingMemory.mapped + stagingOffset,
+        .stagingOffset = stagingOffset,
+        .size = size
+    };
+
+    return true;
+}
+
+void releaseReservation(UploadManager *uploader) {
+    // We don't track each reservation's position, so the whole pinned range is released once the last one is committed
+    if (--uploader->pendingReservations == 0) { uploader->stagingPinnedFrom = UINT64_MAX; }
+}
+
+void cancelUploadReservation(InitializingInfo *initInfo, const UploadReservation *reservation) {
+    releaseReservation(initInfo->uploader);
+}
+
+UploadTicket uploadBuffer(InitializingInfo *initInfo, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+    UploadReservation reservation;
+    if (!reserveUpload(initInfo, size, &reservation)) { return 0; }
+    memcpy(reservation.data, data, size);
+
+    return commitBufferUpload(initInfo, &reservation, dstBuffer, dstOffset);
+}
+
+UploadTicket uploadImage(InitializingInfo *initInfo, VkImage dstImage, VkExtent3D extent, const void *data, VkDeviceSize size, VkImageLayout finalLayout) {
+    UploadReservation reservation;
+    if (!reserveUpload(initInfo, size, &reservation)) { return 0; }
+    memcpy(reservation.data, data, size);
+
+    return commitImageUpload(initInfo, &reservation, dstImage, extent, finalLayout);
+}
+
+
+UploadTicket commitBufferUpload(InitializingInfo *initInfo, const UploadReservation *reservation, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+    UploadManager *uploader = initInfo->uploader;
+    VkDeviceSize stagingOffset = reservation->stagingOffset;
+    VkDeviceSize size = reservation->size;
+
+    releaseReservation(uploader);
+    if (beginBatch(initInfo) == EXIT_FAILURE) { return 0; }
+    UploadBatch *batch = &uploader->batches[uploader->nextBatch % UPLOAD_BATCH_COUNT];
+
+    VkBufferCopy copyRegion = {
+        .srcOffset = stagingOffset,
+        .dstOffset = dstOffset,
+        .size = size
+    };
+    vkCmdCopyBuffer(batch->commandBuffer, uploader->stagingBuffer, dstBuffer, 1, &copyRegion);
+
+    // Without an ownership transfer this is just a regular barrier that makes the copy visible to everything after it
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = uploader->ownershipTransfer ? 0 : VK_ACCESS_MEMORY_READ_BIT,
+        .srcQueueFamilyIndex = uploader->ownershipTransfer ? initInfo->transferQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = uploader->ownershipTransfer ? initInfo->graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+
+        .buffer = dstBuffer,
+        .offset = dstOffset,
+        .size = size
+    };
+    pushBufferBarrier(&batch->releases, barrier);
+
+    if (uploader->ownershipTransfer) {
+        // The acquire has to match the release exactly, apart from the access masks which only apply on their own side
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        pushBufferBarrier(&batch->acquires, barrier);
+    }
+
+    return uploader->nextBatch + 1;
+}
+
+UploadTicket commitImageUpload(InitializingInfo *initInfo, const UploadReservation *reservation, VkImage dstImage, VkExtent3D extent, VkImageLayout finalLayout) {
+    UploadManager *uploader = initInfo->uploader;
+    VkDeviceSize stagingOffset = reservation->stagingOffset;
+
+    releaseReservation(uploader);
+    if (beginBatch(initInfo) == EXIT_FAILURE) { return 0; }
+    UploadBatch *batch = &uploader->batches[uploader->nextBatch % UPLOAD_BATCH_COUNT];
+
+    VkImageSubresourceRange subresourceRange = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1
+    };
+
+    // Coming from VK_IMAGE_LAYOUT_UNDEFINED throws away whatever was in the image, which is fine since we're about to overwrite it
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+
+        .image = dstImage,
+        .subresourceRange = subresourceRange
+    };
+    vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+
+    VkBufferImageCopy copyRegion = {
+        .bufferOffset = stagingOffset,
+        // 0 means the rows are tightly packed
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = extent
+    };
+    vkCmdCopyBufferToImage(batch->commandBuffer, uploader->stagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // The layout transition happens as part of the ownership transfer, so it's in both the release and the acquire
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = uploader->ownershipTransfer ? 0 : VK_ACCESS_MEMORY_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = finalLayout,
+        .srcQueueFamilyIndex = uploader->ownershipTransfer ? initInfo->transferQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = uploader->ownershipTransfer ? initInfo->graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+
+        .image = dstImage,
+        .subresourceRange = subresourceRange
+    };
+    pushImageBarrier(&batch->releases, barrier);
+
+    if (uploader->ownershipTransfer) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        pushImageBarrier(&batch->acquires, barrier);
+    }
+
+    return uploader->nextBatch + 1;
+}
+
+
+int submitUploads(InitializingInfo *initInfo) {
+    UploadManager *uploader = initInfo->uploader;
+    UploadBatch *batch = &uploader->batches[uploader->nextBatch % UPLOAD_BATCH_COUNT];
+    if (!batch->recording) { return EXIT_SUCCESS; }
+
+    // All the barriers for the batch go in one call at the end, rather than one per upload
+    // A transfer only queue doesn't know about graphics stages, so the release just has to finish before the batch does
+    VkPipelineStageFlags dstStage = uploader->ownershipTransfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, NULL,
+        batch->releases.bufferBarriersCount, batch->releases.bufferBarriers, batch->releases.imageBarriersCount, batch->releases.imageBarriers);
+    batch->releases.bufferBarriersCount = 0;
+    batch->releases.imageBarriersCount = 0;
+
+    if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS) { return EXIT_FAILURE; }
+    batch->recording = false;
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->commandBuffer
+    };
+
+    vkResetFences(initInfo->device, 1, &batch->fence);
+    if (vkQueueSubmit(initInfo->transferQueue, 1, &submitInfo, batch->fence) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    batch->stagingEnd = uploader->stagingWritten;
+    uploader->nextBatch++;
+
+    return EXIT_SUCCESS;
+}
+
+bool isUploadComplete(InitializingInfo *initInfo, UploadTicket ticket) {
+    updateUploads(initInfo);
+
+    // Ticket n belongs to batch n - 1
+    return ticket <= initInfo->uploader->completedBatches;
+}
+
+void waitForUpload(InitializingInfo *initInfo, UploadTicket ticket) {
+    UploadManager *uploader = initInfo->uploader;
+
+    if (ticket > uploader->nextBatch) { submitUploads(initInfo); }
+    while (ticket > uploader->completedBatches) { waitForOldestBatch(initInfo); }
+}
+
+void recordUploadAcquires(InitializingInfo *initInfo, VkCommandBuffer commandBuffer) {
+    UploadManager *uploader = initInfo->uploader;
+    updateUploads(initInfo);
+
+    BarrierList *ready = &uploader->readyAcquires;
+    if (ready->bufferBarriersCount == 0 && ready->imageBarriersCount == 0) { return; }
+
+    // The transfer already finished (we saw its fence), so there's nothing to wait on here besides the barrier itself
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL,
+        ready->bufferBarriersCount, ready->bufferBarriers, ready->imageBarriersCount, ready->imageBarriers);
+
+    ready->bufferBarriersCount = 0;
+    ready->imageBarriersCount = 0;
+}
+
+
+int createUploadManager(InitializingInfo *initInfo) {
+    UploadManager *uploader = calloc(1, sizeof(UploadManager));
+    initInfo->uploader = uploader;
+
+    uploader->ownershipTransfer = initInfo->transferQueueFamily != initInfo->graphicsQueueFamily;
+    uploader->stagingPinnedFrom = UINT64_MAX;
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(initInfo->physicalDevice, &deviceProperties);
+    // Image copies need the buffer offset to be a multiple of the texel size and of 4, 16 covers every format we'd upload
+    uploader->stagingAlignment = deviceProperties.limits.optimalBufferCopyOffsetAlignment > 16 ? deviceProperties.limits.optimalBufferCopyOffsetAlignment : 16;
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+
+        .queueFamilyIndex = initInfo->transferQueueFamily,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+    };
+    if (vkCreateCommandPool(initInfo->device, &poolInfo, NULL, &uploader->commandPool) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkCommandBuffer commandBuffers[UPLOAD_BATCH_COUNT];
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+
+        .commandPool = uploader->commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = UPLOAD_BATCH_COUNT
+    };
+    if (vkAllocateCommandBuffers(initInfo->device, &allocInfo, commandBuffers) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    VkFenceCreateInfo fenceInfo = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    for (int i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+        uploader->batches[i].commandBuffer = commandBuffers[i];
+        if (vkCreateFence(initInfo->device, &fenceInfo, NULL, &uploader->batches[i].fence) != VK_SUCCESS) { return EXIT_FAILURE; }
+    }
+
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+
+        .size = STAGING_RING_BYTES,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+    if (vkCreateBuffer(initInfo->device, &bufferInfo, NULL, &uploader->stagingBuffer) != VK_SUCCESS) { return EXIT_FAILURE; }
+
+    // Device local would only waste the small BAR heap, the copy engine reads system memory just fine
+    // Image decoders write straight into reservations and read back earlier rows while doing it, which is painfully slow on uncached memory, so we prefer cached memory
+    if (allocateBufferMemory(initInfo, uploader->stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &uploader->stagingMemory) == EXIT_FAILURE) { return EXIT_FAILURE; }
+    if (uploader->stagingMemory.mapped == NULL) { return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+void destroyUploadManager(InitializingInfo *initInfo) {
+    UploadManager *uploader = initInfo->uploader;
+    if (uploader == NULL) { return; }
+
+    for (int i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+        vkDestroyFence(initInfo->device, uploader->batches[i].fence, NULL);
+        freeBarriers(&uploader->batches[i].releases);
+        freeBarriers(&uploader->batches[i].acquires);
+    }
+    freeBarriers(&uploader->readyAcquires);
+    vkDestroyCommandPool(initInfo->device, uploader->commandPool, NULL);
+
+    vkDestroyBuffer(initInfo->device, uploader->stagingBuffer, NULL);
+    gpuFree(initInfo, &uploader->stagingMemory);
+
+    free(uploader);
+    initInfo->uploader = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef UPLOAD
+#define UPLOAD
+
+#include "../globals/globals.h"
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Identifies the batch an upload went into, 0 is never handed out so it can mean "nothing uploaded"
+typedef uint64_t UploadTicket;
+
+// A piece of the staging ring that can be filled in from any thread and then committed as an upload on the main thread
+typedef struct {
+    void *data;
+    VkDeviceSize stagingOffset;
+    VkDeviceSize size;
+} UploadReservation;
+
+
+int createUploadManager(InitializingInfo *initInfo);
+void destroyUploadManager(InitializingInfo *initInfo);
+
+// These copy data into the staging ring right away and record the copy into the current batch, nothing waits on the GPU unless the ring is full
+// dstBuffer/dstImage must use VK_SHARING_MODE_EXCLUSIVE, their ownership is handed to the graphics queue once the copy is done
+UploadTicket uploadBuffer(InitializingInfo *initInfo, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+// Fills mip level 0 and array layer 0 of a color image, leaving it in finalLayout
+UploadTicket uploadImage(InitializingInfo *initInfo, VkImage dstImage, VkExtent3D extent, const void *data, VkDeviceSize size, VkImageLayout finalLayout);
+
+// Reserved space stays untouched until it's committed, so it can be written to while other uploads come and go
+// Returns false when the ring is full of other reservations, commit some of those before trying again
+bool reserveUpload(InitializingInfo *initInfo, VkDeviceSize size, UploadReservation *reservation);
+UploadTicket commitBufferUpload(InitializingInfo *initInfo, const UploadReservation *reservation, VkBuffer dstBuffer, VkDeviceSize dstOffset);
+UploadTicket commitImageUpload(InitializingInfo *initInfo, const UploadReservation *reservation, VkImage dstImage, VkExtent3D extent, VkImageLayout finalLayout);
+// Gives the space back without uploading anything, for when filling it in failed
+void cancelUploadReservation(InitializingInfo *initInfo, const UploadReservation *reservation);
+
+// Sends the current batch off to the transfer queue, endFrame() calls this every frame so uploads never sit around waiting
+int submitUploads(InitializingInfo *initInfo);
+
+// Once this returns true the resource can be used by anything recorded in endFrame() from now on
+bool isUploadComplete(InitializingInfo *initInfo, UploadTicket ticket);
+// Blocks until the upload is done, for loading screens and the like
+void waitForUpload(InitializingInfo *initInfo, UploadTicket ticket);
+
+// Called at the start of every frame's command buffer to take ownership of everything that finished uploading
+void recordUploadAcquires(InitializingInfo *initInfo, VkCommandBuffer commandBuffer);
+
+
+#endif
@@ -0,0 +1,335 @@
+#include "../../src/engine/asset_pack/asset_pack_format.h"
+#include "../../src/engine/asset_pack/lz4.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <dirent.h>
+    #include <sys/stat.h>
+#endif
+
+
+/*
+Builds an asset pack out of directories of loose files
+Usage: asset_packer <output.pack> <prefix>=<directory>[:lz4] ...
+Every file under each directory ends up in the pack as "<prefix>/<path relative to the directory>"
+Adding :lz4 compresses that directory's files with LZ4, but only keeps the compressed version when it's noticeably smaller
+Uncompressed assets can be used straight out of the mapped pack, so things like SPIR-V are best left uncompressed
+*/
+
+
+typedef struct {
+    char * name;
+    uint64_t hash;
+
+    uint8_t *data; // What gets written into the pack
+    uint64_t storedSize;
+    uint64_t size;
+    AssetCompression compression;
+} PackEntry;
+
+typedef struct {
+    PackEntry *entries;
+    uint32_t count;
+    uint32_t capacity;
+} PackEntries;
+
+
+uint8_t *readWholeFile(const char * path, uint64_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) { return NULL; }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    rewind(file);
+
+    uint8_t *data = malloc(fileSize > 0 ? fileSize : 1);
+    bool read = fileSize >= 0 && fread(data, 1, fileSize, file) == (size_t)fileSize;
+    fclose(file);
+
+    if (!read) {
+        free(data);
+        return NULL;
+    }
+
+    *size = fileSize;
+    return data;
+}
+
+int addFile(PackEntries *entries, const char * path, const char * name, bool compress) {
+    PackEntry entry = { .name = strdup(name), .hash = hashAssetName(name) };
+
+    entry.data = readWholeFile(path, &entry.size);
+    if (entry.data == NULL) {
+        printf("Couldn't read %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (entry.size > INT32_MAX) { compress = false; }
+
+    entry.storedSize = entry.size;
+    entry.compression = ASSET_COMPRESSION_NONE;
+
+    if (compress && entry.size > 0) {
+        int bound = lz4CompressBound((int)entry.size);
+        uint8_t *compressed = malloc(bound);
+        int compressedSize = lz4Compress(entry.data, (int)entry.size, compressed, bound);
+
+        // Decompressing costs time and an allocation at load, so it has to save at least an eighth to be worth it
+        if (compressedSize > 0 && (uint64_t)compressedSize <= entry.size - entry.size / 8) {
+            free(entry.data);
+            entry.data = compressed;
+            entry.storedSize = compressedSize;
+            entry.compression = ASSET_COMPRESSION_LZ4;
+        } else {
+            free(compressed);
+        }
+    }
+
+    if (entries->count == entries->capacity) {
+        entries->capacity = entries->capacity == 0 ? 64 : entries->capacity * 2;
+        entries->entries = realloc(entries->entries, entries->capacity * sizeof(PackEntry));
+    }
+    entries->entries[entries->count++] = entry;
+
+    return EXIT_SUCCESS;
+}
+
+// Walks the directory tree, names always use forward slashes no matter the platform
+int addDirectory(PackEntries *entries, const char * directory, const char * prefix, bool compress) {
+    #ifdef _WIN32
+        char pattern[MAX_PATH];
+        snprintf(pattern, sizeof(pattern), "%s\\*", directory);
+
+        WIN32_FIND_DATAA found;
+        HANDLE search = FindFirstFileA(pattern, &found);
+        if (search == INVALID_HANDLE_VALUE) {
+            printf("Couldn't open directory %s\n", directory);
+            return EXIT_FAILURE;
+        }
+
+        int status = EXIT_SUCCESS;
+        do {
+            if (strcmp(found.cFileName, ".") == 0 || strcmp(found.cFileName, "..") == 0) { continue; }
+
+            char path[MAX_PATH];
+            char name[MAX_PATH];
+            snprintf(path, sizeof(path), "%s\\%s", directory, found.cFileName);
+            snprintf(name, sizeof(name), "%s/%s", prefix, found.cFileName);
+
+            if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                if (addDirectory(entries, path, name, compress) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+            } else if (addFile(entries, path, name, compress) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+        } while (FindNextFileA(search, &found));
+
+        FindClose(search);
+        return status;
+    #else
+        DIR *dir = opendir(directory);
+        if (dir == NULL) {
+            printf("Couldn't open directory %s\n", directory);
+            return EXIT_FAILURE;
+        }
+
+        int status = EXIT_SUCCESS;
+        struct dirent *found;
+        while ((found = readdir(dir)) != NULL) {
+            if (strcmp(found->d_name, ".") == 0 || strcmp(found->d_name, "..") == 0) { continue; }
+
+            size_t pathLength = strlen(directory) + strlen(found->d_name) + 2;
+            size_t nameLength = strlen(prefix) + strlen(found->d_name) + 2;
+            char * path = malloc(pathLength);
+            char * name = malloc(nameLength);
+            snprintf(path, pathLength, "%s/%s", directory, found->d_name);
+            snprintf(name, nameLength, "%s/%s", prefix, found->d_name);
+
+            struct stat fileInfo;
+            if (stat(path, &fileInfo) == 0) {
+                if (S_ISDIR(fileInfo.st_mode)) {
+                    if (addDirectory(entries, path, name, compress) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+                } else if (S_ISREG(fileInfo.st_mode)) {
+                    if (addFile(entries, path, name, compress) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+                }
+            }
+
+            free(path);
+            free(name);
+        }
+
+        closedir(dir);
+        return status;
+    #endif
+}
+
+
+int compareEntries(const void *a, const void *b) {
+    const PackEntry *entryA = a;
+    const PackEntry *entryB = b;
+
+    if (entryA->hash != entryB->hash) { return entryA->hash < entryB->hash ? -1 : 1; }
+    return strcmp(entryA->name, entryB->name);
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool writePadding(FILE *file, uint64_t *position, uint64_t alignment) {
+    static const uint8_t zeros[ASSET_PACK_ALIGNMENT] = { 0 };
+
+    uint64_t padding = alignUp(*position, alignment) - *position;
+    *position += padding;
+
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+int writePack(PackEntries *entries, const char * outputPath) {
+    // Entries are sorted by hash so the engine can binary search them
+    qsort(entries->entries, entries->count, sizeof(PackEntry), compareEntries);
+
+    for (uint32_t i = 1; i < entries->count; i++) {
+        if (strcmp(entries->entries[i - 1].name, entries->entries[i].name) == 0) {
+            printf("%s is in the pack twice!\n", entries->entries[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Work out where everything goes before writing any of it
+    AssetPackEntry *packEntries = calloc(entries->count > 0 ? entries->count : 1, sizeof(AssetPackEntry));
+    uint64_t position = alignUp(sizeof(AssetPackHeader), ASSET_PACK_ALIGNMENT);
+    uint32_t namesSize = 0;
+
+    for (uint32_t i = 0; i < entries->count; i++) {
+        PackEntry *entry = &entries->entries[i];
+
+        packEntries[i] = (AssetPackEntry){
+            .hash = entry->hash,
+            .dataOffset = position,
+            .storedSize = entry->storedSize,
+            .size = entry->size,
+            .nameOffset = namesSize,
+            .nameLength = (uint16_t)strlen(entry->name),
+            .compression = entry->compression
+        };
+
+        position = alignUp(position + entry->storedSize, ASSET_PACK_ALIGNMENT);
+        namesSize += packEntries[i].nameLength;
+    }
+
+    AssetPackHeader header = {
+        .magic = ASSET_PACK_MAGIC,
+        .version = ASSET_PACK_VERSION,
+        .entryCount = entries->count,
+        .entriesOffset = position,
+        .namesOffset = position + (uint64_t)entries->count * sizeof(AssetPackEntry)
+    };
+
+    // Written next to the real file and renamed over it at the end, so a failed pack never replaces a working one
+    size_t tempPathLength = strlen(outputPath) + 5;
+    char * tempPath = malloc(tempPathLength);
+    snprintf(tempPath, tempPathLength, "%s.tmp", outputPath);
+
+    FILE *file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s for writing\n", tempPath);
+        free(tempPath);
+        free(packEntries);
+        return EXIT_FAILURE;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    position = sizeof(header);
+    written = written && writePadding(file, &position, ASSET_PACK_ALIGNMENT);
+
+    for (uint32_t i = 0; i < entries->count && written; i++) {
+        written = fwrite(entries->entries[i].data, 1, entries->entries[i].storedSize, file) == entries->entries[i].storedSize;
+        position += entries->entries[i].storedSize;
+        written = written && writePadding(file, &position, ASSET_PACK_ALIGNMENT);
+    }
+
+    if (entries->count > 0) { written = written && fwrite(packEntries, sizeof(AssetPackEntry), entries->count, file) == entries->count; }
+    for (uint32_t i = 0; i < entries->count && written; i++) {
+        written = fwrite(entries->entries[i].name, 1, packEntries[i].nameLength, file) == packEntries[i].nameLength;
+    }
+
+    written = fclose(file) == 0 && written;
+    free(packEntries);
+
+    if (written) {
+        #ifdef _WIN32
+            remove(outputPath);
+        #endif
+        written = rename(tempPath, outputPath) == 0;
+    }
+    if (!written) {
+        printf("Failed to write %s\n", outputPath);
+        remove(tempPath);
+    }
+    free(tempPath);
+
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <output.pack> <prefix>=<directory>[:lz4] ...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    PackEntries entries = {  };
+    int status = EXIT_SUCCESS;
+
+    for (int i = 2; i < argc; i++) {
+        char * spec = strdup(argv[i]);
+
+        char * directory = strchr(spec, '=');
+        if (directory == NULL) {
+            printf("Expected <prefix>=<directory>, got %s\n", argv[i]);
+            free(spec);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        *directory++ = '\0';
+
+        // Checking from the end so drive letters like C:\ aren't mistaken for the option
+        bool compress = false;
+        size_t length = strlen(directory);
+        if (length > 4 && strcmp(directory + length - 4, ":lz4") == 0) {
+            directory[length - 4] = '\0';
+            compress = true;
+        }
+
+        if (addDirectory(&entries, directory, spec, compress) == EXIT_FAILURE) { status = EXIT_FAILURE; }
+        free(spec);
+    }
+
+    if (status == EXIT_SUCCESS) { status = writePack(&entries, argv[1]); }
+
+    uint64_t rawBytes = 0;
+    uint64_t storedBytes = 0;
+    uint32_t compressedCount = 0;
+    for (uint32_t i = 0; i < entries.count; i++) {
+        rawBytes += entries.entries[i].size;
+        storedBytes += entries.entries[i].storedSize;
+        if (entries.entries[i].compression != ASSET_COMPRESSION_NONE) { compressedCount++; }
+
+        free(entries.entries[i].name);
+        free(entries.entries[i].data);
+    }
+    free(entries.entries);
+
+    if (status == EXIT_SUCCESS) {
+        printf("Packed %u assets (%u compressed) into %s: %llu bytes, %llu before compression\n",
+            entries.count, compressedCount, argv[1], (unsigned long long)storedBytes, (unsigned long long)rawBytes);
+    }
+
+    return status;
+}
@@ -0,0 +1,508 @@
+#include "../../src/engine/globals/globals.h"
+#include "../../src/engine/initialize/initialize.h"
+#include "../../src/engine/cleanup/cleanup.h"
+#include "../../src/engine/frame/frame.h"
+#include "../../src/engine/sprite_batch/sprite_batch.h"
+#include "../../src/engine/tilemap/tilemap.h"
+#include "../../src/engine/allocator/allocator.h"
+#include "../../src/engine/profiler/profiler.h"
+#include "../../src/engine/software_renderer/software_renderer.h"
+#include "../../src/engine/bindless_textures/bindless_textures.h"
+#include "../../src/engine/particles/particles.h"
+
+#include <vulkan/vulkan.h>
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+
+/*
+Runs the renderer headless over a sweep of scene sizes and prints how each one did as JSON
+Usage: pixel_engine_bench [--sprites N,N,...] [--tilemaps N,N,...] [--frames-in-flight N,N,...] [--frames N] [--warmup N]
+                          [--json FILE] [--save-baseline FILE] [--baseline FILE] [--threshold FRACTION] [--software] [--particles N]
+Every combination of the three lists gets its own freshly initialized engine, rendered for --warmup frames that aren't counted and then --frames that are
+The engine prints to stdout as it starts up, so use --json to get a file with nothing but the results in it
+--save-baseline writes the results somewhere --baseline can compare a later run against
+--software runs every configuration on the CPU renderer instead, there's no GPU time then and frames in flight is always 1
+--particles adds a particle system of up to N particles to every configuration, emitting fast enough to stay about full. The software renderer has no particles and ignores it
+The validation layers are on by default (DO_VALIDATION_LAYERS in initialize.c), so a short run on lavapipe with --particles checks the emit, update and finalize passes and the indirect draw
+With --baseline the exit code is nonzero if any p50/p95 frame time or average GPU time got more than --threshold (10% by default) slower
+*/
+
+
+const char * APPLICATION_TITLE = "pixel_engine benchmark";
+const uint32_t APPLICATION_VERSION = VK_MAKE_VERSION(1, 0, 0);
+// Headless mode renders into offscreen images of this size
+const int WIN_WIDTH = 1280;
+const int WIN_HEIGHT = 720;
+
+
+#define MAX_SWEEP_VALUES 16
+// Times this small are mostly noise, so a regression has to be at least this much slower in absolute terms too
+#define REGRESSION_SLACK_MS 0.05
+
+
+typedef struct {
+    uint32_t values[MAX_SWEEP_VALUES];
+    uint32_t count;
+} SweepList;
+
+typedef struct {
+    uint32_t sprites;
+    uint32_t tilemapSize;
+    uint32_t framesInFlight;
+    uint32_t particles;
+} BenchConfig;
+
+typedef struct {
+    BenchConfig config;
+    char name[96];
+    bool ran;
+
+    // Wall time of each frame, from the start of beginFrame() to the end of endFrame()
+    double frameP50Ms, frameP95Ms, frameP99Ms;
+    // The same minus the time spent blocked waiting on the GPU or the swap chain
+    double cpuAvgMs, cpuP95Ms;
+    // Negative when the device can't write timestamps
+    double gpuAvgMs, gpuP95Ms;
+
+    VkDeviceSize gpuMemoryUsed;
+    VkDeviceSize gpuMemoryReserved;
+    uint64_t residentBytes;
+
+    bool regressed;
+} BenchResult;
+
+
+uint32_t benchFrames = 300;
+uint32_t benchWarmupFrames = 30;
+char benchDeviceName[256] = "unknown";
+bool benchSoftware = false;
+uint32_t benchParticles = 0;
+
+
+bool parseSweepList(const char * text, SweepList *list) {
+    list->count = 0;
+
+    while (*text != '\0') {
+        if (list->count == MAX_SWEEP_VALUES) { return false; }
+
+        char *end;
+        list->values[list->count++] = strtoul(text, &end, 10);
+        if (end == text) { return false; }
+
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    return list->count > 0;
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, values has to be sorted
+double percentile(const double *values, uint32_t count, double percent) {
+    if (count == 0) { return -1.0; }
+
+    uint32_t rank = (uint32_t)ceil(percent / 100.0 * count);
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+double average(const double *values, uint32_t count) {
+    if (count == 0) { return -1.0; }
+
+    double total = 0.0;
+    for (uint32_t i = 0; i < count; i++) { total += values[i]; }
+
+    return total / count;
+}
+
+uint64_t readResidentBytes() {
+#ifdef __linux__
+    // The second number in statm is how many pages of the process are actually in memory
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == NULL) { return 0; }
+
+    unsigned long long size = 0, resident = 0;
+    int read = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+
+    return read == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+
+// The same kind of scene as the test application draws, a grid of flat colored sprites reserved 256 at a time
+void addBenchSprites(InitializingInfo *initInfo, uint32_t spriteCount, uint64_t frameNumber) {
+    const uint32_t spritesPerBatch = 256;
+    const float size = 8.0f;
+    uint32_t columns = initInfo->canvasExtent.width / size;
+    if (columns == 0) { columns = 1; }
+
+    for (uint32_t first = 0; first < spriteCount; first += spritesPerBatch) {
+        uint32_t count = spriteCount - first < spritesPerBatch ? spriteCount - first : spritesPerBatch;
+
+        SpriteInstance *sprites = reserveSprites(initInfo, count);
+        if (sprites == NULL) { return; }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index = first + i;
+
+            sprites[i] = (SpriteInstance){
+                .x = (index % columns) * size + (float)((frameNumber + index) % 8),
+                .y = (float)((index / columns) * size),
+                .width = size,
+                .height = size,
+                .u0 = 0.0f, .v0 = 0.0f, .u1 = 1.0f, .v1 = 1.0f,
+                .tint = 0x80000000 | (index * 2654435761u & 0x00FFFFFF),
+                .layer = 0.0f,
+                .textureId = WHITE_TEXTURE_ID
+            };
+        }
+    }
+}
+
+int createBenchTilemap(InitializingInfo *initInfo, uint32_t tilemapSize) {
+    TilemapInfo info = {
+        .width = tilemapSize,
+        .height = tilemapSize,
+        .tileSize = 8,
+        .tilesetColumns = 4,
+        .tilesetRows = 4,
+        .layer = 0.0f
+    };
+
+    TileId *tiles = malloc((size_t)tilemapSize * tilemapSize * sizeof(TileId));
+    for (uint32_t y = 0; y < tilemapSize; y++) {
+        for (uint32_t x = 0; x < tilemapSize; x++) {
+            tiles[y * tilemapSize + x] = ((x / 24) + (y / 24)) % 2 == 0 ? 1 + (x * 7 + y * 13) % 16 : 0;
+        }
+    }
+
+    int result = createTilemap(initInfo, &info, tiles);
+    free(tiles);
+
+    return result;
+}
+
+// A fountain like the demo's, every particle lives 3 seconds on average so the rate keeps it about full
+int createBenchParticles(InitializingInfo *initInfo, uint32_t maxParticles) {
+    ParticleSystemInfo info = {
+        .maxParticles = maxParticles,
+        .gravityY = 60.0f
+    };
+    if (createParticleSystem(initInfo, &info) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    ParticleEmitter emitter = {
+        .x = initInfo->canvasExtent.width * 0.5f,
+        .y = initInfo->canvasExtent.height - 1.0f,
+        .direction = -1.5707963f,
+        .spread = 1.2f,
+        .minSpeed = 40.0f,
+        .maxSpeed = 120.0f,
+        .minLifetime = 2.0f,
+        .maxLifetime = 4.0f,
+        .rate = maxParticles / 3.0f,
+        .color = 0xFF40A0FF
+    };
+    setParticleEmitter(initInfo, &emitter);
+
+    return EXIT_SUCCESS;
+}
+
+// Scrolls diagonally and flips one tile a frame, so culling and chunk re-uploads both get exercised
+void updateBenchTilemap(InitializingInfo *initInfo, uint32_t tilemapSize, uint64_t frameNumber) {
+    uint32_t mapPixels = tilemapSize * 8;
+    uint32_t range = mapPixels > initInfo->canvasExtent.width ? mapPixels - initInfo->canvasExtent.width : 1;
+    uint32_t position = frameNumber % (2 * range);
+    int32_t camera = position < range ? position : 2 * range - position;
+    setTilemapCamera(initInfo, camera, camera / 2);
+
+    uint32_t x = (camera / 8 + frameNumber % 16) % tilemapSize;
+    uint32_t y = (camera / 16 + frameNumber % 9) % tilemapSize;
+    setTile(initInfo, x, y, getTile(initInfo, x, y) == 0 ? 1 + frameNumber % 16 : 0);
+}
+
+
+int runBenchConfig(BenchResult *result) {
+    BenchConfig config = result->config;
+
+    InitializingInfo initInfo = {
+        .headless = true,
+        .softwareRendering = benchSoftware,
+        .maxFramesInFlight = config.framesInFlight,
+        .maxSprites = config.sprites,
+        // The profiler is what gets us GPU times, and it costs next to nothing on the CPU
+        .profiling = true
+    };
+    if (initialize(&initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    // initialize() falls back to the software renderer by itself when there's no usable device
+    if (initInfo.softwareRendering) {
+        snprintf(benchDeviceName, sizeof(benchDeviceName), "software renderer (%s)", getSoftwareRendererStats(&initInfo).kernels);
+    } else {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(initInfo.physicalDevice, &deviceProperties);
+        snprintf(benchDeviceName, sizeof(benchDeviceName), "%s", deviceProperties.deviceName);
+    }
+
+    if (config.tilemapSize > 0 && createBenchTilemap(&initInfo, config.tilemapSize) == EXIT_FAILURE) {
+        cleanup(&initInfo);
+        return EXIT_FAILURE;
+    }
+    if (config.particles > 0 && !initInfo.softwareRendering && createBenchParticles(&initInfo, config.particles) == EXIT_FAILURE) {
+        cleanup(&initInfo);
+        return EXIT_FAILURE;
+    }
+
+    double *frameMs = malloc(benchFrames * sizeof(double));
+    double *cpuMs = malloc(benchFrames * sizeof(double));
+    double *gpuMs = malloc(benchFrames * sizeof(double));
+    uint32_t framesMeasured = 0;
+    uint32_t gpuFramesMeasured = 0;
+    uint64_t lastGpuFrame = UINT64_MAX;
+
+    int runResult = EXIT_SUCCESS;
+    for (uint32_t i = 0; i < benchWarmupFrames + benchFrames; i++) {
+        if (beginFrame(&initInfo) == EXIT_FAILURE) { runResult = EXIT_FAILURE; break; }
+        addBenchSprites(&initInfo, config.sprites, initInfo.frameNumber);
+        if (initInfo.tilemap != NULL) { updateBenchTilemap(&initInfo, config.tilemapSize, initInfo.frameNumber); }
+        // A fixed step so every run simulates the same particles no matter how fast the frames are
+        if (initInfo.particles != NULL) { simulateParticles(&initInfo, 1.0f / 60.0f); }
+        if (endFrame(&initInfo) == EXIT_FAILURE) { runResult = EXIT_FAILURE; break; }
+
+        if (i < benchWarmupFrames) { continue; }
+
+        FrameTimings timings = initInfo.lastFrameTimings;
+        frameMs[framesMeasured] = timings.cpuFrameMs;
+        cpuMs[framesMeasured] = timings.cpuFrameMs - timings.cpuWaitMs - timings.acquireWaitMs;
+        framesMeasured++;
+
+        // GPU times come back a few frames late, and only count once the frame they belong to is past the warmup
+        ProfiledGpuFrame gpuFrame = getLastProfiledGpuFrame(&initInfo);
+        if (gpuFrame.frameNumber != UINT64_MAX && gpuFrame.frameNumber != lastGpuFrame && gpuFrame.frameNumber >= benchWarmupFrames) {
+            gpuMs[gpuFramesMeasured++] = gpuFrame.gpuMs;
+            lastGpuFrame = gpuFrame.frameNumber;
+        }
+    }
+    if (finishFrames(&initInfo) == EXIT_FAILURE) { runResult = EXIT_FAILURE; }
+
+    qsort(frameMs, framesMeasured, sizeof(double), compareDoubles);
+    qsort(cpuMs, framesMeasured, sizeof(double), compareDoubles);
+    qsort(gpuMs, gpuFramesMeasured, sizeof(double), compareDoubles);
+
+    result->frameP50Ms = percentile(frameMs, framesMeasured, 50.0);
+    result->frameP95Ms = percentile(frameMs, framesMeasured, 95.0);
+    result->frameP99Ms = percentile(frameMs, framesMeasured, 99.0);
+    result->cpuAvgMs = average(cpuMs, framesMeasured);
+    result->cpuP95Ms = percentile(cpuMs, framesMeasured, 95.0);
+    result->gpuAvgMs = average(gpuMs, gpuFramesMeasured);
+    result->gpuP95Ms = percentile(gpuMs, gpuFramesMeasured, 95.0);
+
+    // Measured while everything is still alive, so it's the scene's footprint and not what's left after cleanup
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(initInfo.physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        GpuHeapStats heapStats = getGpuHeapStats(&initInfo, i);
+        result->gpuMemoryUsed += heapStats.usedBytes;
+        result->gpuMemoryReserved += heapStats.reservedBytes;
+    }
+    result->residentBytes = readResidentBytes();
+    result->ran = runResult == EXIT_SUCCESS && framesMeasured > 0;
+
+    free(frameMs);
+    free(cpuMs);
+    free(gpuMs);
+
+    if (cleanup(&initInfo) == EXIT_FAILURE) { return EXIT_FAILURE; }
+
+    return result->ran ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// One line per configuration: name, p50, p95, p99 and average GPU time, all in milliseconds
+int saveBaseline(const char * path, const BenchResult *results, uint32_t resultsCount) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) { return EXIT_FAILURE; }
+
+    for (uint32_t i = 0; i < resultsCount; i++) {
+        if (!results[i].ran) { continue; }
+        fprintf(file, "%s %.4f %.4f %.4f %.4f\n", results[i].name, results[i].frameP50Ms, results[i].frameP95Ms, results[i].frameP99Ms, results[i].gpuAvgMs);
+    }
+
+    return fclose(file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool isRegression(const char * name, const char * metric, double baseline, double current, double threshold) {
+    // A negative time means it wasn't measured in one of the runs, like GPU times on a device without timestamps
+    if (baseline < 0.0 || current < 0.0) { return false; }
+    if (current <= baseline * (1.0 + threshold) + REGRESSION_SLACK_MS) { return false; }
+
+    fprintf(stderr, "Regression in %s: %s went from %.3f ms to %.3f ms (+%.1f%%)\n", name, metric, baseline, current, (current / baseline - 1.0) * 100.0);
+    return true;
+}
+
+// Configurations that aren't in the baseline are skipped, so adding new sweep values never fails a run
+int compareWithBaseline(const char * path, BenchResult *results, uint32_t resultsCount, double threshold, bool *regressed) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Couldn't open the baseline %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    char name[96];
+    double p50, p95, p99, gpuAvg;
+    while (fscanf(file, "%95s %lf %lf %lf %lf", name, &p50, &p95, &p99, &gpuAvg) == 5) {
+        for (uint32_t i = 0; i < resultsCount; i++) {
+            BenchResult *result = &results[i];
+            if (!result->ran || strcmp(result->name, name) != 0) { continue; }
+
+            // p99 is left out on purpose, a single hiccup from the OS is enough to move it
+            if (isRegression(name, "p50 frame time", p50, result->frameP50Ms, threshold)) { result->regressed = true; }
+            if (isRegression(name, "p95 frame time", p95, result->frameP95Ms, threshold)) { result->regressed = true; }
+            if (isRegression(name, "average GPU time", gpuAvg, result->gpuAvgMs, threshold)) { result->regressed = true; }
+            if (result->regressed) { *regressed = true; }
+        }
+    }
+
+    fclose(file);
+
+    return EXIT_SUCCESS;
+}
+
+
+void writeJsonMs(FILE *file, double value) {
+    if (value < 0.0) { fprintf(file, "null"); }
+    else { fprintf(file, "%.4f", value); }
+}
+
+void writeResultsJson(FILE *file, const BenchResult *results, uint32_t resultsCount) {
+    fprintf(file, "{\n  \"device\": \"");
+    // Device names don't have quotes in them in practice, but one would break the whole file
+    for (const char *c = benchDeviceName; *c != '\0'; c++) { if (*c != '"' && *c != '\\') { fputc(*c, file); } }
+    fprintf(file, "\",\n  \"frames\": %u,\n  \"warmup_frames\": %u,\n  \"results\": [", benchFrames, benchWarmupFrames);
+
+    for (uint32_t i = 0; i < resultsCount; i++) {
+        const BenchResult *result = &results[i];
+
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"sprites\": %u, \"tilemap\": %u, \"frames_in_flight\": %u, \"particles\": %u, \"ran\": %s,",
+            i == 0 ? "" : ",", result->name, result->config.sprites, result->config.tilemapSize, result->config.framesInFlight, result->config.particles, result->ran ? "true" : "false");
+
+        fprintf(file, "\n     \"frame_ms\": {\"p50\": ");
+        writeJsonMs(file, result->ran ? result->frameP50Ms : -1.0);
+        fprintf(file, ", \"p95\": ");
+        writeJsonMs(file, result->ran ? result->frameP95Ms : -1.0);
+        fprintf(file, ", \"p99\": ");
+        writeJsonMs(file, result->ran ? result->frameP99Ms : -1.0);
+        fprintf(file, "}, \"cpu_ms\": {\"avg\": ");
+        writeJsonMs(file, result->ran ? result->cpuAvgMs : -1.0);
+        fprintf(file, ", \"p95\": ");
+        writeJsonMs(file, result->ran ? result->cpuP95Ms : -1.0);
+        fprintf(file, "}, \"gpu_ms\": {\"avg\": ");
+        writeJsonMs(file, result->ran ? result->gpuAvgMs : -1.0);
+        fprintf(file, ", \"p95\": ");
+        writeJsonMs(file, result->ran ? result->gpuP95Ms : -1.0);
+        fprintf(file, "},");
+
+        fprintf(file, "\n     \"gpu_memory_used_bytes\": %llu, \"gpu_memory_reserved_bytes\": %llu, \"resident_bytes\": %llu, \"regressed\": %s}",
+            (unsigned long long)result->gpuMemoryUsed, (unsigned long long)result->gpuMemoryReserved, (unsigned long long)result->residentBytes,
+            result->regressed ? "true" : "false");
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    SweepList sprites = { .values = { 1000, 10000, 50000 }, .count = 3 };
+    SweepList tilemaps = { .values = { 0, 512 }, .count = 2 };
+    SweepList framesInFlight = { .values = { 1, 2, 3 }, .count = 3 };
+    const char * jsonPath = NULL;
+    const char * baselinePath = NULL;
+    const char * saveBaselinePath = NULL;
+    double threshold = 0.10;
+
+    for (int i = 1; i < argc; i++) {
+        bool valid = true;
+
+        if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) { valid = parseSweepList(argv[++i], &sprites); }
+        else if (strcmp(argv[i], "--tilemaps") == 0 && i + 1 < argc) { valid = parseSweepList(argv[++i], &tilemaps); }
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) { valid = parseSweepList(argv[++i], &framesInFlight); }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) { benchFrames = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) { benchWarmupFrames = strtoul(argv[++i], NULL, 10); }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) { jsonPath = argv[++i]; }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) { baselinePath = argv[++i]; }
+        else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc) { saveBaselinePath = argv[++i]; }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) { threshold = strtod(argv[++i], NULL); }
+        else if (strcmp(argv[i], "--software") == 0) { benchSoftware = true; }
+        else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) { benchParticles = strtoul(argv[++i], NULL, 10); }
+        else { valid = false; }
+
+        if (!valid) {
+            fprintf(stderr, "Bad argument %s, see the top of tools/bench/bench.c for usage\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (benchFrames == 0) { benchFrames = 1; }
+
+    uint32_t resultsCount = sprites.count * tilemaps.count * framesInFlight.count;
+    BenchResult *results = calloc(resultsCount, sizeof(BenchResult));
+
+    int exitCode = EXIT_SUCCESS;
+    uint32_t r = 0;
+    for (uint32_t f = 0; f < framesInFlight.count; f++) {
+        for (uint32_t t = 0; t < tilemaps.count; t++) {
+            for (uint32_t s = 0; s < sprites.count; s++) {
+                BenchResult *result = &results[r++];
+                // 0 frames in flight would make initialize() pick the default, which would then be reported under the wrong name
+                result->config = (BenchConfig){ .sprites = sprites.values[s], .tilemapSize = tilemaps.values[t], .framesInFlight = framesInFlight.values[f] > 0 ? framesInFlight.values[f] : 1, .particles = benchParticles };
+                // Particles only show up in the name when there are some, so baselines saved without them still match
+                int nameLength = snprintf(result->name, sizeof(result->name), "sprites=%u,tilemap=%u,frames_in_flight=%u", result->config.sprites, result->config.tilemapSize, result->config.framesInFlight);
+                if (benchParticles > 0) { snprintf(result->name + nameLength, sizeof(result->name) - nameLength, ",particles=%u", benchParticles); }
+
+                fprintf(stderr, "Running %s\n", result->name);
+                if (runBenchConfig(result) == EXIT_FAILURE) {
+                    fprintf(stderr, "%s failed to run\n", result->name);
+                    exitCode = EXIT_FAILURE;
+                }
+            }
+        }
+    }
+
+    bool regressed = false;
+    if (baselinePath != NULL && compareWithBaseline(baselinePath, results, resultsCount, threshold, &regressed) == EXIT_FAILURE) { exitCode = EXIT_FAILURE; }
+    if (regressed) { exitCode = EXIT_FAILURE; }
+
+    if (saveBaselinePath != NULL && saveBaseline(saveBaselinePath, results, resultsCount) == EXIT_FAILURE) {
+        fprintf(stderr, "Couldn't write the baseline to %s\n", saveBaselinePath);
+        exitCode = EXIT_FAILURE;
+    }
+
+    FILE *jsonFile = jsonPath != NULL ? fopen(jsonPath, "w") : stdout;
+    if (jsonFile == NULL) {
+        fprintf(stderr, "Couldn't open %s\n", jsonPath);
+        jsonFile = stdout;
+        exitCode = EXIT_FAILURE;
+    }
+    writeResultsJson(jsonFile, results, resultsCount);
+    if (jsonFile != stdout) { fclose(jsonFile); }
+
+    free(results);
+
+    return exitCode;
+}